@@ -52,12 +52,28 @@ AclStore::AclStore(AbstractDb& db):
    } 
    mTlsPeerNameCursor = mTlsPeerNameList.begin();
    mAddressCursor = mAddressList.begin();
+   publishTable();
 }
 
 AclStore::~AclStore()
 {
 }
 
+void
+AclStore::publishTable()
+{
+   AclTable* table = new AclTable;
+   for(TlsPeerNameList::const_iterator it = mTlsPeerNameList.begin(); it != mTlsPeerNameList.end(); it++)
+   {
+      table->addTlsPeerName(it->mTlsPeerName);
+   }
+   for(AddressList::const_iterator it = mAddressList.begin(); it != mAddressList.end(); it++)
+   {
+      table->addAddress(*it);
+   }
+   mTable.publish(table);
+}
+
 bool
 AclStore::addAcl(const resip::Data& tlsPeerName,
                   const resip::Data& address,
@@ -114,6 +130,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mAddressList.push_back(addressRecord);
          mAddressCursor = mAddressList.begin();  // Put cursor back at start
+         publishTable();
       }
    }
    else
@@ -125,6 +142,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mTlsPeerNameList.push_back(tlsPeerNameRecord); 
          mTlsPeerNameCursor = mTlsPeerNameList.begin(); // Put cursor back at start
+         publishTable();
       }
    }
    return true;
@@ -311,6 +329,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findAddressKey(key))
       {
          mAddressCursor = mAddressList.erase(mAddressCursor);
+         publishTable();
       }
    }
    else
@@ -319,6 +338,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findTlsPeerNameKey(key))
       {
          mTlsPeerNameCursor = mTlsPeerNameList.erase(mTlsPeerNameCursor);
+         publishTable();
       }
    }
 }
@@ -496,16 +516,13 @@ AclStore::getAddressMask( const resip::Data& key )
 bool 
 AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 {
-   ReadLock lock(mMutex);
+   SnapshotPtr<AclTable>::Reader table(mTable);
    for(std::list<Data>::const_iterator it = tlsPeerNames.begin(); it != tlsPeerNames.end(); it++)
    {
-      for(TlsPeerNameList::iterator i = mTlsPeerNameList.begin(); i != mTlsPeerNameList.end(); i++)
+      if(table->isTlsPeerNameTrusted(*it))
       {
-         if(isEqualNoCase(i->mTlsPeerName, *it))
-         {
-            InfoLog (<< "AclStore - Tls peer name IS trusted: " << *it);
-            return true;
-         }
+         InfoLog (<< "AclStore - Tls peer name IS trusted: " << *it);
+         return true;
       }
    }
    return false;
@@ -515,12 +532,126 @@ AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 bool 
 AclStore::isAddressTrusted(const Tuple& address)
 {
-   ReadLock lock(mMutex);
-   for(AddressList::iterator i = mAddressList.begin(); i != mAddressList.end(); i++)
+   SnapshotPtr<AclTable>::Reader table(mTable);
+   return table->isAddressTrusted(address);
+}
+
+
+AclStore::AclTable::AclTable()
+{
+   mV4.push_back(Node());
+   mV6.push_back(Node());
+}
+
+
+void
+AclStore::AclTable::addTlsPeerName(const Data& tlsPeerName)
+{
+   Data name(tlsPeerName);
+   mTlsPeerNames.insert(name.lowercase());
+}
+
+
+bool
+AclStore::AclTable::isTlsPeerNameTrusted(const Data& tlsPeerName) const
+{
+   Data name(tlsPeerName);
+   return mTlsPeerNames.find(name.lowercase()) != mTlsPeerNames.end();
+}
+
+
+const unsigned char*
+AclStore::AclTable::addressBits(const Tuple& address, unsigned int& bits)
+{
+   const sockaddr& sa = address.getSockaddr();
+   if(sa.sa_family == AF_INET)
+   {
+      bits = 32;
+      return (const unsigned char*)&((const sockaddr_in*)&sa)->sin_addr;
+   }
+#ifdef USE_IPV6
+   else if(sa.sa_family == AF_INET6)
+   {
+      bits = 128;
+      return (const unsigned char*)&((const sockaddr_in6*)&sa)->sin6_addr;
+   }
+#endif
+   bits = 0;
+   return 0;
+}
+
+
+AclStore::AclTable::Trie*
+AclStore::AclTable::trieFor(const Tuple& address)
+{
+   return address.getSockaddr().sa_family == AF_INET ? &mV4 : &mV6;
+}
+
+
+const AclStore::AclTable::Trie*
+AclStore::AclTable::trieFor(const Tuple& address) const
+{
+   return address.getSockaddr().sa_family == AF_INET ? &mV4 : &mV6;
+}
+
+
+void
+AclStore::AclTable::addAddress(const AddressRecord& record)
+{
+   unsigned int bits;
+   const unsigned char* addr = addressBits(record.mAddressTuple, bits);
+   if(!addr)
    {
-      if(i->mAddressTuple.isEqualWithMask(address, i->mMask, i->mAddressTuple.getPort() == 0))
+      return;
+   }
+   Trie& trie = *trieFor(record.mAddressTuple);
+   unsigned int depth = record.mMask < 0 ? 0 : resipMin((unsigned int)record.mMask, bits);
+   unsigned int node = 0;
+   for(unsigned int i = 0; i < depth; i++)
+   {
+      unsigned int bit = (addr[i/8] >> (7 - i%8)) & 1;
+      if(trie[node].mChild[bit] == 0)
       {
-         return true;
+         trie[node].mChild[bit] = (unsigned int)trie.size();
+         trie.push_back(Node());  // may move trie[node]
+      }
+      node = trie[node].mChild[bit];
+   }
+   trie[node].mRecords.push_back(record);
+}
+
+
+bool
+AclStore::AclTable::isAddressTrusted(const Tuple& address) const
+{
+   unsigned int bits;
+   const unsigned char* addr = addressBits(address, bits);
+   if(!addr)
+   {
+      return false;
+   }
+   const Trie& trie = *trieFor(address);
+   unsigned int node = 0;
+   for(unsigned int i = 0; ; i++)
+   {
+      // the ACLs here cover the address as far as their mask goes; port
+      // and transport are left to the tuple comparison
+      const AddressList& records = trie[node].mRecords;
+      for(AddressList::const_iterator it = records.begin(); it != records.end(); it++)
+      {
+         if(it->mAddressTuple.isEqualWithMask(address, it->mMask, it->mAddressTuple.getPort() == 0))
+         {
+            return true;
+         }
+      }
+      if(i == bits)
+      {
+         break;
+      }
+      node = trie[node].mChild[(addr[i/8] >> (7 - i%8)) & 1];
+      if(node == 0)
+      {
+         break;
       }
    }
    return false;
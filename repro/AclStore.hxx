@@ -2,8 +2,11 @@
 #define REPRO_ACLSTORE_HXX
 
 #include <list>
+#include <set>
+#include <vector>
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
+#include "rutil/SnapshotPtr.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Tuple.hxx"
 #include "repro/AbstractDb.hxx"
@@ -88,6 +91,42 @@ class AclStore
       TlsPeerNameList::iterator mTlsPeerNameCursor;
       AddressList mAddressList;
       AddressList::iterator mAddressCursor;
+
+      // What the trust checks work on, without locking. Rebuilt from the
+      // lists above on every change.
+      class AclTable
+      {
+         public:
+            AclTable();
+
+            void addTlsPeerName(const resip::Data& tlsPeerName);
+            bool isTlsPeerNameTrusted(const resip::Data& tlsPeerName) const;
+
+            void addAddress(const AddressRecord& record);
+            bool isAddressTrusted(const resip::Tuple& address) const;
+
+         private:
+            // Binary trie over the address bits, one per IP version. An
+            // address ACL hangs off the node for its first mMask bits, so a
+            // lookup only looks at the ACLs along the path of the address.
+            struct Node
+            {
+               Node() { mChild[0] = mChild[1] = 0; }
+               unsigned int mChild[2];  // 0 if none; the root is never a child
+               AddressList mRecords;
+            };
+            typedef std::vector<Node> Trie;
+
+            static const unsigned char* addressBits(const resip::Tuple& address, unsigned int& bits);
+            Trie* trieFor(const resip::Tuple& address);
+            const Trie* trieFor(const resip::Tuple& address) const;
+
+            std::set<resip::Data> mTlsPeerNames;  // lowercase
+            Trie mV4;
+            Trie mV6;
+      };
+      void publishTable(); // with mMutex held for writing
+      resip::SnapshotPtr<AclTable> mTable;
 };
 
 }
@@ -118,6 +118,12 @@ class AsyncProcessor : public Processor
       // return true to queue to stack when complete, false when no response is required
       virtual bool asyncProcess(AsyncProcessorMessage* msg)=0;
 
+      // Called from WorkerThreads instead of asyncProcess() when msg waited
+      // past the dispatcher's deadline. Processors that wait for the result
+      // should mark msg as failed and return true, so that process() can
+      // answer the request.
+      virtual bool asyncExpired(AsyncProcessorMessage* msg) { return false; }
+
    protected:
       Dispatcher* mAsyncDispatcher;
 };
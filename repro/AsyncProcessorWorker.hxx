@@ -24,6 +24,16 @@ public:
       assert(false);  // unexpected message type
       return false;
    }
+   virtual bool expired(resip::ApplicationMessage* msg)
+   {
+      AsyncProcessorMessage* pmsg = dynamic_cast<AsyncProcessorMessage*>(msg);
+      if(pmsg)
+      {
+         return pmsg->getAsyncProcessor().asyncExpired(pmsg);
+      }
+      assert(false);  // unexpected message type
+      return false;
+   }
    virtual Worker* clone() const
    {
       return new AsyncProcessorWorker();
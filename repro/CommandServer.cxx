@@ -18,6 +18,7 @@
 #include "repro/XmlRpcConnection.hxx"
 #include "repro/ReproRunner.hxx"
 #include "repro/CommandServer.hxx"
+#include "repro/Store.hxx"
 
 using namespace repro;
 using namespace resip;
@@ -97,6 +98,10 @@ CommandServer::handleRequest(unsigned int connectionId, unsigned int requestId,
       {
          handleGetDnsCacheRequest(connectionId, requestId, xml);
       }
+      else if(isEqualNoCase(xml.getTag(), "ClearUserAuthCache"))
+      {
+         handleClearUserAuthCacheRequest(connectionId, requestId, xml);
+      }
       else if(isEqualNoCase(xml.getTag(), "GetCongestionStats"))
       {
          handleGetCongestionStatsRequest(connectionId, requestId, xml);
@@ -234,6 +239,21 @@ CommandServer::onDnsCacheDumpRetrieved(std::pair<unsigned long, unsigned long> k
    }
 }
 
+void 
+CommandServer::handleClearUserAuthCacheRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleClearUserAuthCacheRequest");
+
+   Store* store = mReproRunner.getProxy()->getConfig().getDataStore();
+   if(!store || !store->mUserStore.getAuthCache())
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "User auth cache not enabled.");
+      return;
+   }
+   store->mUserStore.clearAuthCache();
+   sendResponse(connectionId, requestId, Data::Empty, 200, "User auth cache cleared.");
+}
+
 void 
 CommandServer::handleGetCongestionStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
 {
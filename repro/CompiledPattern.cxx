@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "repro/CompiledPattern.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+using namespace repro;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+CompiledPattern::CompiledPattern(const Data& pattern, int flags) :
+   mPattern(pattern),
+   mExact(false),
+   mValid(false)
+{
+   mValid = regcomp(&mRegex, pattern.c_str(), flags | REG_EXTENDED) == 0;
+   if (mValid && !(flags & REG_ICASE))
+   {
+      mPrefix = literalPrefix(pattern, mExact);
+   }
+   DebugLog(<< "Compiled " << pattern << (mValid ? "" : " (invalid)")
+            << " prefix=" << mPrefix << (mExact ? " exact" : ""));
+}
+
+CompiledPattern::~CompiledPattern()
+{
+   if (mValid)
+   {
+      regfree(&mRegex);
+   }
+}
+
+bool
+CompiledPattern::match(const Data& subject, size_t nmatch, regmatch_t* pmatch) const
+{
+   if (!mValid)
+   {
+      return false;
+   }
+   if (!mPrefix.empty() &&
+       (subject.size() < mPrefix.size() ||
+        memcmp(subject.data(), mPrefix.data(), mPrefix.size()) != 0))
+   {
+      return false;
+   }
+   if (mExact)
+   {
+      if (subject.size() != mPrefix.size())
+      {
+         return false;
+      }
+      if (pmatch && nmatch > 0)
+      {
+         pmatch[0].rm_so = 0;
+         pmatch[0].rm_eo = (regoff_t)subject.size();
+         for (size_t i = 1; i < nmatch; ++i)
+         {
+            pmatch[i].rm_so = -1;
+            pmatch[i].rm_eo = -1;
+         }
+      }
+      return true;
+   }
+   if (!pmatch)
+   {
+      nmatch = 0;
+   }
+   return regexec(&mRegex, subject.c_str(), nmatch, pmatch, 0) == 0;
+}
+
+Data
+CompiledPattern::literalPrefix(const Data& pattern, bool& exact)
+{
+   exact = false;
+   const char* p = pattern.data();
+   const size_t size = pattern.size();
+   if (size == 0 || p[0] != '^')
+   {
+      return Data::Empty;
+   }
+
+   // An alternation anywhere could make the leading literal optional.
+   bool inBracket = false;
+   for (size_t i = 0; i < size; ++i)
+   {
+      if (inBracket)
+      {
+         if (p[i] == ']')
+         {
+            inBracket = false;
+         }
+      }
+      else if (p[i] == '\\')
+      {
+         ++i;
+      }
+      else if (p[i] == '[')
+      {
+         inBracket = true;
+         // a leading ']' (or "^]") is part of the set
+         if (i + 1 < size && p[i + 1] == '^') ++i;
+         if (i + 1 < size && p[i + 1] == ']') ++i;
+      }
+      else if (p[i] == '|')
+      {
+         return Data::Empty;
+      }
+   }
+
+   Data prefix;
+   size_t lastLiteralStart = 0;
+   size_t i = 1;
+   while (i < size)
+   {
+      char c = p[i];
+      if (c == '\\')
+      {
+         // \. and friends are literals; \w, \b, \1 and the like are not
+         if (i + 1 >= size || isalnum((unsigned char)p[i + 1]) || p[i + 1] == '<' ||
+             p[i + 1] == '>' || p[i + 1] == '`' || p[i + 1] == '\'')
+         {
+            break;
+         }
+         lastLiteralStart = prefix.size();
+         prefix += p[i + 1];
+         i += 2;
+      }
+      else if (strchr(".[]()*+?{}|^$", c))
+      {
+         break;
+      }
+      else
+      {
+         lastLiteralStart = prefix.size();
+         prefix += c;
+         ++i;
+      }
+   }
+
+   if (i < size)
+   {
+      char c = p[i];
+      if (c == '*' || c == '?' || c == '{')
+      {
+         // the last literal is optional or repeated an unknown number of times
+         prefix = prefix.substr(0, lastLiteralStart);
+      }
+      else if (c == '$' && i + 1 == size)
+      {
+         exact = true;
+      }
+   }
+   else
+   {
+      // "^literal" matches anything starting with it
+   }
+   return prefix;
+}
+
+PrefixIndex::PrefixIndex() :
+   mNodes(1),
+   mSize(0)
+{
+}
+
+void
+PrefixIndex::add(const Data& prefix, unsigned int id)
+{
+   unsigned int node = 0;
+   for (Data::size_type i = 0; i < prefix.size(); ++i)
+   {
+      std::map<char, unsigned int>::iterator child = mNodes[node].mChildren.find(prefix[i]);
+      if (child == mNodes[node].mChildren.end())
+      {
+         unsigned int next = (unsigned int)mNodes.size();
+         mNodes[node].mChildren[prefix[i]] = next;
+         mNodes.push_back(Node());
+         node = next;
+      }
+      else
+      {
+         node = child->second;
+      }
+   }
+   mNodes[node].mIds.push_back(id);
+   ++mSize;
+}
+
+void
+PrefixIndex::find(const Data& subject, std::vector<unsigned int>& ids) const
+{
+   size_t first = ids.size();
+   unsigned int node = 0;
+   Data::size_type i = 0;
+   for (;;)
+   {
+      const Node& n = mNodes[node];
+      ids.insert(ids.end(), n.mIds.begin(), n.mIds.end());
+      if (i == subject.size())
+      {
+         break;
+      }
+      std::map<char, unsigned int>::const_iterator child = n.mChildren.find(subject[i++]);
+      if (child == n.mChildren.end())
+      {
+         break;
+      }
+      node = child->second;
+   }
+   std::sort(ids.begin() + first, ids.end());
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
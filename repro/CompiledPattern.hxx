@@ -0,0 +1,139 @@
+#if !defined(REPRO_COMPILEDPATTERN_HXX)
+#define REPRO_COMPILEDPATTERN_HXX
+
+#ifdef WIN32
+#include <pcreposix.h>
+#else
+#include <regex.h>
+#endif
+
+#include <map>
+#include <vector>
+
+#include "rutil/Data.hxx"
+
+namespace repro
+{
+
+/**
+   A POSIX extended regular expression, compiled once, together with what
+   can be learnt from its text without running it: the literal every match
+   has to start with (for patterns anchored with '^'), and whether the
+   pattern is nothing but such a literal ("^literal$"). Subjects that do not
+   start with the literal are rejected without calling regexec(), and
+   exact literals are compared rather than executed.
+
+   Immutable once constructed, so it may be shared between threads and
+   between successive versions of a store's lookup table.
+*/
+class CompiledPattern
+{
+   public:
+      /// @param flags as for regcomp(); REG_EXTENDED is always added
+      CompiledPattern(const resip::Data& pattern, int flags);
+      ~CompiledPattern();
+
+      bool isValid() const { return mValid; }
+      const resip::Data& getPattern() const { return mPattern; }
+
+      /// Literal that every match starts with; may be empty.
+      const resip::Data& getPrefix() const { return mPrefix; }
+
+      /**
+         Like regexec() on subject, returning true on a match. pmatch may be
+         0 (nmatch is then ignored); if given, unused entries are set to -1.
+      */
+      bool match(const resip::Data& subject, size_t nmatch, regmatch_t* pmatch) const;
+
+      /**
+         The literal prefix of an extended regular expression as explained
+         above; exact is set if the pattern matches that literal only.
+         Conservative: returns less than it could rather than too much.
+      */
+      static resip::Data literalPrefix(const resip::Data& pattern, bool& exact);
+
+   private:
+      resip::Data mPattern;
+      resip::Data mPrefix;
+      bool mExact;
+      bool mValid;
+      regex_t mRegex;
+
+      // disabled
+      CompiledPattern(const CompiledPattern&);
+      CompiledPattern& operator=(const CompiledPattern&);
+};
+
+/**
+   Maps literal prefixes to ids, and finds all ids whose prefix starts a
+   given subject with one walk down a trie.
+*/
+class PrefixIndex
+{
+   public:
+      PrefixIndex();
+
+      void add(const resip::Data& prefix, unsigned int id);
+
+      /// Appends to ids, in ascending order, every id whose prefix starts subject.
+      void find(const resip::Data& subject, std::vector<unsigned int>& ids) const;
+
+      bool empty() const { return mSize == 0; }
+
+   private:
+      struct Node
+      {
+         std::map<char, unsigned int> mChildren;
+         std::vector<unsigned int> mIds;
+      };
+      std::vector<Node> mNodes;
+      size_t mSize;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
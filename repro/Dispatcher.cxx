@@ -1,26 +1,57 @@
 #include "repro/Dispatcher.hxx"
 #include "resip/stack/Message.hxx"
 #include "resip/stack/SipStack.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/MpscQueue.hxx"
+#include "rutil/Timer.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
+#include <algorithm>
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::REPRO
 
 namespace repro
 {
 
+// every live Dispatcher, for encodePrometheus()
+static resip::Mutex dispatchersMutex;
+static std::vector<Dispatcher*> dispatchers;
+
 Dispatcher::Dispatcher(std::auto_ptr<Worker> prototype,
                         resip::SipStack* stack,
                         int workers, 
-                        bool startImmediately):
+                        bool startImmediately,
+                        const resip::Data& name):
    mStack(stack),
-   mFifo(0,0),
-   mAcceptingWork(false),
+   mAcceptingWork(0),
+   mPosting(0),
    mShutdown(false),
    mStarted(false),
-   mWorkerPrototype(prototype.release())
+   mWorkerPrototype(prototype.release()),
+   mName(name),
+   mMaxQueueTimeMs(0),
+   mNextQueue(0),
+   mSleeping(0)
 {
+   unsigned int id = mStatistics.addCounter("tasks_posted", "Messages posted to the thread bank");
+   assert(id == TasksPosted);
+   id = mStatistics.addCounter("tasks_stolen", "Messages a worker took from another worker's queue");
+   assert(id == TasksStolen);
+   id = mStatistics.addCounter("tasks_expired", "Messages given up on because they waited past their deadline");
+   assert(id == TasksExpired);
+   id = mStatistics.addHistogram("queue_wait", "Time messages waited for a worker");
+   assert(id == QueueWait);
+   (void)id;
+
    for(int i=0; i<workers;i++)
    {
-      mWorkerThreads.push_back(new WorkerThread(mWorkerPrototype->clone(),mFifo,mStack));
+      mQueues.push_back(new WorkQueue);
+      mWorkerThreads.push_back(new WorkerThread(mWorkerPrototype->clone(),*this,(unsigned int)i,mStack));
+   }
+
+   {
+      resip::Lock lock(dispatchersMutex);
+      dispatchers.push_back(this);
    }
    
    if(startImmediately)
@@ -31,6 +62,11 @@ Dispatcher::Dispatcher(std::auto_ptr<Worker> prototype,
 
 Dispatcher::~Dispatcher()
 {
+   {
+      resip::Lock lock(dispatchersMutex);
+      dispatchers.erase(std::find(dispatchers.begin(), dispatchers.end(), this));
+   }
+
    shutdownAll();
    
    std::vector<WorkerThread*>::iterator i;
@@ -41,43 +77,193 @@ Dispatcher::~Dispatcher()
 
    mWorkerThreads.clear();
 
-   while(!mFifo.empty())
+   std::vector<WorkQueue*>::iterator q;
+   for(q=mQueues.begin(); q!=mQueues.end(); ++q)
    {
-      delete mFifo.getNext();
+      for(int p=0; p<Priorities; ++p)
+      {
+         std::deque<Task>::iterator t;
+         for(t=(*q)->mTasks[p].begin(); t!=(*q)->mTasks[p].end(); ++t)
+         {
+            delete t->mMessage;
+         }
+      }
+      delete *q;
    }
+
+   mQueues.clear();
    
    delete mWorkerPrototype;
    
 }
 
 bool
-Dispatcher::post(std::auto_ptr<resip::ApplicationMessage>& work)
+Dispatcher::post(std::auto_ptr<resip::ApplicationMessage>& work,
+                 Priority priority,
+                 unsigned int maxQueueTimeMs)
 {
-   resip::ReadLock r(mMutex);
-   if(mAcceptingWork)
+   assert(priority >= HighPriority && priority < Priorities);
+
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+   resip::MpscAtomic::add(&mPosting, 1);
+   if(!resip::MpscAtomic::load(&mAcceptingWork) || mQueues.empty())
    {
-      mFifo.add(work.release(),
-                  resip::TimeLimitFifo<resip::ApplicationMessage>::InternalElement);
-      return true;
+      resip::MpscAtomic::sub(&mPosting, 1);
+      //If we aren't accepting work, the auto ptr is not released. (We don't
+      // take ownership, and the caller gets to handle the contents of the 
+      // auto_ptr)
+      return false;
+   }
+#else
+   resip::Lock accepting(mMutex);
+   if(!mAcceptingWork || mQueues.empty())
+   {
+      return false;
+   }
+#endif
+
+   Task task;
+   task.mPosted = resip::Timer::getTimeMicroSec();
+   if(maxQueueTimeMs == 0)
+   {
+      maxQueueTimeMs = mMaxQueueTimeMs;
+   }
+   task.mDeadline = maxQueueTimeMs ? task.mPosted + UInt64(maxQueueTimeMs)*1000 : 0;
+   task.mMessage = work.release();
+
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+   UInt32 next = resip::MpscAtomic::add(&mNextQueue, 1);
+#else
+   UInt32 next = mNextQueue++;  // under mMutex
+#endif
+   WorkQueue& queue = *mQueues[next % mQueues.size()];
+   {
+      resip::Lock lock(queue.mMutex);
+      queue.mTasks[priority].push_back(task);
+   }
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+   resip::MpscAtomic::sub(&mPosting, 1);
+#endif
+   mStatistics.increment(TasksPosted);
+
+   // A worker increments mSleeping before it looks at the queues under
+   // their locks, so if it missed the task pushed above we see its count
+   // here.
+   if(mSleeping)
+   {
+      resip::Lock lock(mWakeMutex);
+      mWake.signal();
+   }
+   return true;
+}
+
+resip::ApplicationMessage*
+Dispatcher::getNext(unsigned int worker, unsigned int ms, bool& expired)
+{
+   Task task;
+   if(!take(worker, task))
+   {
+      {
+         resip::Lock lock(mWakeMutex);
+         ++mSleeping;
+         if(!hasWork())
+         {
+            mWake.wait(mWakeMutex, ms);
+         }
+         --mSleeping;
+      }
+      if(!take(worker, task))
+      {
+         return 0;
+      }
+   }
+
+   UInt64 now = resip::Timer::getTimeMicroSec();
+   mStatistics.record(QueueWait, now > task.mPosted ? now - task.mPosted : 0);
+   expired = task.mDeadline != 0 && now > task.mDeadline;
+   if(expired)
+   {
+      mStatistics.increment(TasksExpired);
+      WarningLog(<< "Giving up on " << *task.mMessage << " after it waited "
+                 << (now - task.mPosted)/1000 << "ms for a worker");
+   }
+   return task.mMessage;
+}
+
+bool
+Dispatcher::take(unsigned int worker, Task& task)
+{
+   // Higher lanes of every queue come first; within a lane the worker's own
+   // queue comes first and the oldest message of a queue is taken.
+   const unsigned int n = (unsigned int)mQueues.size();
+   for(int p=0; p<Priorities; ++p)
+   {
+      for(unsigned int i=0; i<n; ++i)
+      {
+         WorkQueue& queue = *mQueues[(worker + i) % n];
+         resip::Lock lock(queue.mMutex);
+         std::deque<Task>& tasks = queue.mTasks[p];
+         if(!tasks.empty())
+         {
+            task = tasks.front();
+            tasks.pop_front();
+            if(i != 0)
+            {
+               mStatistics.increment(TasksStolen);
+            }
+            return true;
+         }
+      }
    }
-   
    return false;
-   
-   //If we aren't accepting work, the auto ptr is not released. (We don't
-   // take ownership, and the caller gets to handle the contents of the 
-   // auto_ptr)
+}
+
+bool
+Dispatcher::hasWork() const
+{
+   return fifoCountDepth() != 0;
+}
+
+void
+Dispatcher::setMaxQueueTime(unsigned int ms)
+{
+   mMaxQueueTimeMs = ms;
 }
 
 size_t
 Dispatcher::fifoCountDepth() const 
 {
-   return mFifo.getCountDepth();
+   size_t depth = 0;
+   std::vector<WorkQueue*>::const_iterator q;
+   for(q=mQueues.begin(); q!=mQueues.end(); ++q)
+   {
+      resip::Lock lock((*q)->mMutex);
+      for(int p=0; p<Priorities; ++p)
+      {
+         depth += (*q)->mTasks[p].size();
+      }
+   }
+   return depth;
 }
 
 time_t
 Dispatcher::fifoTimeDepth() const 
 {
-   return mFifo.getTimeDepth();
+   UInt64 now = resip::Timer::getTimeMicroSec();
+   UInt64 oldest = now;
+   std::vector<WorkQueue*>::const_iterator q;
+   for(q=mQueues.begin(); q!=mQueues.end(); ++q)
+   {
+      resip::Lock lock((*q)->mMutex);
+      for(int p=0; p<Priorities; ++p)
+      {
+         if(!(*q)->mTasks[p].empty())
+         {
+            oldest = resip::resipMin(oldest, (*q)->mTasks[p].front().mPosted);
+         }
+      }
+   }
+   return (time_t)((now - oldest)/1000000);
 }
 
 int
@@ -86,33 +272,55 @@ Dispatcher::workPoolSize() const
    return (int)mWorkerThreads.size();
 }
 
+void
+Dispatcher::setAcceptingWork(bool accepting)
+{
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+   resip::MpscAtomic::store(&mAcceptingWork, accepting ? 1 : 0);
+   // a post() that saw the old value is counted in mPosting
+   while(!accepting && resip::MpscAtomic::load(&mPosting) != 0)
+   {
+      resip::MpscAtomic::yield();
+   }
+#else
+   mAcceptingWork = accepting ? 1 : 0;
+#endif
+}
+
 void
 Dispatcher::stop()
 {
-   resip::WriteLock w(mMutex);
-   mAcceptingWork=false;
+   resip::Lock lock(mMutex);
+   setAcceptingWork(false);
 }
 
 void
 Dispatcher::resume()
 {
-   resip::WriteLock w(mMutex);
-   mAcceptingWork = !mShutdown;
+   resip::Lock lock(mMutex);
+   setAcceptingWork(!mShutdown);
 }
 
 void
 Dispatcher::shutdownAll()
 {
-   resip::WriteLock w(mMutex);
+   resip::Lock lock(mMutex);
    if(!mShutdown)
    {
-      mAcceptingWork=false;
+      setAcceptingWork(false);
       mShutdown=true;
       
       std::vector<WorkerThread*>::iterator i;
       for(i=mWorkerThreads.begin(); i!=mWorkerThreads.end(); ++i)
       {
          (*i)->shutdown();
+      }
+      {
+         resip::Lock wake(mWakeMutex);
+         mWake.broadcast();
+      }
+      for(i=mWorkerThreads.begin(); i!=mWorkerThreads.end(); ++i)
+      {
          (*i)->join();
       }
    }
@@ -121,7 +329,7 @@ Dispatcher::shutdownAll()
 void 
 Dispatcher::startAll()
 {
-   resip::WriteLock w(mMutex);
+   resip::Lock lock(mMutex);
    if(!mShutdown && !mStarted)
    {
       std::vector<WorkerThread*>::iterator i;
@@ -130,8 +338,31 @@ Dispatcher::startAll()
          (*i)->run();
       }
       mStarted=true;
-      mAcceptingWork=true;
+      setAcceptingWork(true);
+   }
+}
+
+EncodeStream&
+Dispatcher::encodePrometheus(EncodeStream& strm)
+{
+   resip::Lock lock(dispatchersMutex);
+   std::vector<Dispatcher*>::const_iterator i;
+   for(i=dispatchers.begin(); i!=dispatchers.end(); ++i)
+   {
+      const Dispatcher& dispatcher = **i;
+      if(dispatcher.mName.empty())
+      {
+         continue;
+      }
+      resip::Data prefix("repro_");
+      prefix += dispatcher.mName;
+      prefix += "_dispatcher_";
+      dispatcher.mStatistics.encodePrometheus(strm, prefix);
+      strm << "# HELP " << prefix << "queue_depth Messages waiting for a worker\n"
+           << "# TYPE " << prefix << "queue_depth gauge\n"
+           << prefix << "queue_depth " << dispatcher.fifoCountDepth() << "\n";
    }
+   return strm;
 }
 
 } //namespace repro
@@ -4,9 +4,12 @@
 #include "repro/WorkerThread.hxx"
 #include "repro/Worker.hxx"
 #include "resip/stack/ApplicationMessage.hxx"
-#include "rutil/TimeLimitFifo.hxx"
-#include "rutil/RWMutex.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/Lock.hxx"
+#include "rutil/ThreadStatistics.hxx"
+#include <deque>
+#include <memory>
 #include <vector>
 
 namespace resip
@@ -34,6 +37,19 @@ namespace repro
    user must do is subclass Worker to do the work needed, and pass an instance
    of this class when constructing the Dispatcher. Dispatcher will clone this
    Worker as many times as needed to fill the thread bank. 
+
+   Each worker thread owns a queue; posted messages are spread over the
+   queues round-robin and a worker whose own queue is empty takes work from
+   the others, so a worker stuck in a slow database call does not hold up
+   the messages behind it and posters rarely contend on the same lock.
+   Every queue holds one lane per Priority, and workers always drain the
+   higher lanes of all queues first. A message may carry a deadline: if it
+   has waited longer than that when a worker gets to it, the worker hands
+   it to Worker::expired() instead of processing it, which normally marks
+   it failed and sends it back, so that the originator can still answer.
+
+   Dispatchers given a name publish their queue-wait latency, depth and
+   counts through encodePrometheus().
    
    @note The functions in this class are intended to be thread-safe.
 */
@@ -41,6 +57,14 @@ namespace repro
 class Dispatcher
 {
    public:
+
+      enum Priority
+      {
+         HighPriority = 0,
+         NormalPriority,
+         LowPriority,
+         Priorities
+      };
    
       /**
          @param prototype The prototypical instance of Worker.
@@ -51,11 +75,15 @@ class Dispatcher
          
          @param startImmediately Whether to start this thread bank on 
             construction.
+
+         @param name Names this thread bank in the metrics; an unnamed
+            Dispatcher publishes none.
       */
       Dispatcher(std::auto_ptr<Worker> prototype, 
                   resip::SipStack* stack,
                   int workers=2, 
-                  bool startImmediately=true);
+                  bool startImmediately=true,
+                  const resip::Data& name=resip::Data::Empty);
 
       virtual ~Dispatcher();
       
@@ -66,11 +94,26 @@ class Dispatcher
             It is understood that any information that needs to be conveyed
             back to the originator will be placed in the message by the Workers
             in the thread bank.
+
+         @param priority The lane to queue the message in.
+
+         @param maxQueueTimeMs How long the message may wait for a worker
+            before it is given up on (see Worker::expired()); 0 uses the
+            Dispatcher's setMaxQueueTime().
             
          @returns true iff this message was successfully posted. (This may not
             be the case if this Dispatcher is in the process of shutting down)
       */
-      virtual bool post(std::auto_ptr<resip::ApplicationMessage>& work);
+      virtual bool post(std::auto_ptr<resip::ApplicationMessage>& work,
+                        Priority priority=NormalPriority,
+                        unsigned int maxQueueTimeMs=0);
+
+      /**
+         Sets how long, in milliseconds, messages posted without a deadline
+         of their own may wait for a worker; 0 (the default) lets them wait
+         forever.
+      */
+      void setMaxQueueTime(unsigned int ms);
 
       /**
          @returns The number of messages in this Dispatcher's queue
@@ -78,8 +121,8 @@ class Dispatcher
       size_t fifoCountDepth() const;
       
       /**
-         @returns The time between which the front of the queue was posted and
-            the back of the queue was posted.
+         @returns How long, in seconds, the oldest message in this
+            Dispatcher's queues has been waiting.
       */ 
       time_t fifoTimeDepth() const;
       
@@ -91,7 +134,7 @@ class Dispatcher
       /**
          This Dispatcher will stop accepting new
          work, but processing will continue normally on the messages already
-         in the queue.
+         in the queue. No post() succeeds once this has returned.
       */
       void stop();
       
@@ -111,20 +154,80 @@ class Dispatcher
       */
       void startAll();
 
+      /**
+         Writes the metrics of every named Dispatcher in the Prometheus text
+         exposition format, each prefixed with repro_<name>_dispatcher_.
+      */
+      static EncodeStream& encodePrometheus(EncodeStream& strm);
+
       resip::SipStack* mStack;
 
       
    protected:
+      friend class WorkerThread;
+
+      struct Task
+      {
+         resip::ApplicationMessage* mMessage;
+         UInt64 mPosted;      // microseconds
+         UInt64 mDeadline;    // microseconds, 0 for none
+      };
+
+      struct WorkQueue
+      {
+         resip::Mutex mMutex;
+         std::deque<Task> mTasks[Priorities];
+      };
+
+      /**
+         Called by worker thread worker for its next message; returns 0 if
+         none arrived within ms milliseconds. expired is set if the message
+         waited past its deadline.
+      */
+      resip::ApplicationMessage* getNext(unsigned int worker, unsigned int ms, bool& expired);
+
+      bool take(unsigned int worker, Task& task);
+      bool hasWork() const;
+      void setAcceptingWork(bool accepting);
 
-      resip::TimeLimitFifo<resip::ApplicationMessage> mFifo;
-      bool mAcceptingWork;
+      // Set and cleared under mMutex. post() counts itself in mPosting
+      // before it looks at mAcceptingWork, and setAcceptingWork(false)
+      // waits for the count to drop, so no post() gets past a stop().
+      volatile UInt32 mAcceptingWork;
+      volatile UInt32 mPosting;
       bool mShutdown;
       bool mStarted;
       Worker* mWorkerPrototype;
+      const resip::Data mName;
+      volatile unsigned int mMaxQueueTimeMs;
 
-      resip::RWMutex mMutex;
+      // serializes stop(), resume(), startAll() and shutdownAll(), and
+      // post() where there are no atomic operations
+      resip::Mutex mMutex;
 
       std::vector<WorkerThread*> mWorkerThreads;
+      std::vector<WorkQueue*> mQueues;
+      // where post() puts the next message; bumped atomically, or under
+      // mMutex where there are no atomic operations
+      volatile UInt32 mNextQueue;
+
+      // idle workers sleep on mWake; mSleeping counts them so that post()
+      // only takes mWakeMutex when there is someone to wake
+      resip::Mutex mWakeMutex;
+      resip::Condition mWake;
+      volatile unsigned int mSleeping;
+
+      enum
+      {
+         TasksPosted,
+         TasksStolen,
+         TasksExpired
+      };
+      enum
+      {
+         QueueWait
+      };
+      resip::ThreadStatistics mStatistics;
 
    private:
       //No copying!
@@ -32,65 +32,60 @@ FilterStore::FilterStore(AbstractDb& db):
       FilterOp filter;
       filter.filterRecord =  mDb.getFilter(key);
       filter.key = key;
-      filter.pcond1 = 0;
-      filter.pcond2 = 0;
-      
-      int flags = REG_EXTENDED;
-      if(filter.filterRecord.mActionData.find("$") == Data::npos)
-      {
-         flags |= REG_NOSUB;
-      }
-
-      if(!filter.filterRecord.mCondition1Regex.empty())
-      {
-         filter.pcond1 = new regex_t;
-         int ret = regcomp(filter.pcond1, filter.filterRecord.mCondition1Regex.c_str(), flags);
-         if(ret != 0)
-         {
-            delete filter.pcond1;
-            ErrLog( << "Condition1Regex has invalid match expression: "
-                   << filter.filterRecord.mCondition1Regex);
-            filter.pcond1 = 0;
-         }
-      }
-
-      if(!filter.filterRecord.mCondition2Regex.empty())
-      {
-         filter.pcond2 = new regex_t;
-         int ret = regcomp(filter.pcond2, filter.filterRecord.mCondition2Regex.c_str(), flags);
-         if(ret != 0)
-         {
-            delete filter.pcond2;
-            ErrLog( << "Condition2Regex has invalid match expression: "
-                   << filter.filterRecord.mCondition2Regex);
-            filter.pcond2 = 0;
-         }
-      }
+      compile(filter);
 
       mFilterOperators.insert(filter);
 
       key = mDb.nextFilterKey();
    } 
    mCursor = mFilterOperators.begin();
+   publishTable();
 }
 
 
 FilterStore::~FilterStore()
 {
-   for(FilterOpList::iterator i = mFilterOperators.begin(); i != mFilterOperators.end(); i++)
+   mFilterOperators.clear();
+}
+
+
+void
+FilterStore::compile(FilterOp& filter)
+{
+   int flags = REG_EXTENDED;
+   if(filter.filterRecord.mActionData.find("$") == Data::npos)
    {
-      if (i->pcond1)
+      flags |= REG_NOSUB;
+   }
+
+   if(!filter.filterRecord.mCondition1Regex.empty())
+   {
+      filter.pcond1.reset(new CompiledPattern(filter.filterRecord.mCondition1Regex, flags));
+      if(!filter.pcond1->isValid())
       {
-         regfree(i->pcond1);
-         delete i->pcond1;
+         ErrLog( << "Condition1Regex has invalid match expression: "
+                << filter.filterRecord.mCondition1Regex);
+         filter.pcond1.reset();
       }
-      if (i->pcond2)
+   }
+
+   if(!filter.filterRecord.mCondition2Regex.empty())
+   {
+      filter.pcond2.reset(new CompiledPattern(filter.filterRecord.mCondition2Regex, flags));
+      if(!filter.pcond2->isValid())
       {
-         regfree(i->pcond2);
-         delete i->pcond2;
+         ErrLog( << "Condition2Regex has invalid match expression: "
+                << filter.filterRecord.mCondition2Regex);
+         filter.pcond2.reset();
       }
    }
-   mFilterOperators.clear();
+}
+
+
+void
+FilterStore::publishTable()
+{
+   mTable.publish(new FilterTable(mFilterOperators.begin(), mFilterOperators.end()));
 }
 
 
@@ -129,39 +124,14 @@ FilterStore::addFilter(const resip::Data& cond1Header,
    }
 
    filter.key = key;
-   filter.pcond1 = 0;
-   filter.pcond2 = 0;
-   int flags = REG_EXTENDED;
-   if(filter.filterRecord.mActionData.find("$") == Data::npos)
-   {
-      flags |= REG_NOSUB;
-   }
-   if(!filter.filterRecord.mCondition1Regex.empty())
-   {
-      filter.pcond1 = new regex_t;
-      int ret = regcomp(filter.pcond1, filter.filterRecord.mCondition1Regex.c_str(), flags);
-      if(ret != 0)
-      {
-         delete filter.pcond1;
-         filter.pcond1 = 0;
-      }
-   }
-   if(!filter.filterRecord.mCondition2Regex.empty())
-   {
-      filter.pcond2 = new regex_t;
-      int ret = regcomp(filter.pcond2, filter.filterRecord.mCondition2Regex.c_str(), flags);
-      if(ret != 0)
-      {
-         delete filter.pcond2;
-         filter.pcond2 = 0;
-      }
-   }
+   compile(filter);
 
    {
       WriteLock lock(mMutex);
       mFilterOperators.insert( filter );
+      mCursor = mFilterOperators.begin(); 
+      publishTable();
    }
-   mCursor = mFilterOperators.begin(); 
 
    return true;
 }
@@ -212,16 +182,6 @@ FilterStore::eraseFilter(const resip::Data& key)
          {
             FilterOpList::iterator i = it;
             it++;
-            if(i->pcond1)
-            {
-               regfree(i->pcond1);
-               delete i->pcond1;
-            }
-            if(i->pcond2)
-            {
-               regfree(i->pcond2);
-               delete i->pcond2;
-            }
             mFilterOperators.erase(i);
          }
          else
@@ -229,8 +189,9 @@ FilterStore::eraseFilter(const resip::Data& key)
             it++;
          }
       }
+      mCursor = mFilterOperators.begin();  // reset the cursor since it may have been on deleted filter
+      publishTable();
    }
-   mCursor = mFilterOperators.begin();  // reset the cursor since it may have been on deleted filter
 }
 
 
@@ -361,9 +322,8 @@ FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerNa
 }
 
 bool 
-FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, regex_t *regex, Data& rewrite)
+FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, const CompiledPattern& regex, Data& rewrite)
 {
-   int ret;
    assert(conditionNum < 10);
    
    // TODO - !cj! www.pcre.org looks like it has better performance
@@ -372,8 +332,7 @@ FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match,
    const int nmatch=10;  // replacements $x1-$x9 are allowed, where x is the condition number
    regmatch_t pmatch[nmatch];
 
-   ret = regexec(regex, header.c_str(), nmatch, pmatch, 0/*eflags*/);
-   if (ret != 0)
+   if (!regex.match(header, nmatch, pmatch))
    {
       // did not match 
       return false;
@@ -426,15 +385,14 @@ FilterStore::process(const SipMessage& request,
                      short& action,
                      Data& actionData)
 {
-   if(mFilterOperators.empty()) return false;  // If there are no filters bail early to save a few cycles (size check is atomic enough, we don't need a lock)
-
-   ReadLock lock(mMutex);
+   SnapshotPtr<FilterTable>::Reader table(mTable);
+   if(table->empty()) return false;  // If there are no filters bail early to save a few cycles
 
    Data method(request.methodStr());
    Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
 
-   for (FilterOpList::iterator it = mFilterOperators.begin();
-        it != mFilterOperators.end(); it++)
+   for (FilterTable::const_iterator it = table->begin();
+        it != table->end(); it++)
    {
       const AbstractDb::FilterRecord& rec = it->filterRecord;
 
@@ -459,7 +417,7 @@ FilterStore::process(const SipMessage& request,
       list<Data> condition1Headers;
       list<Data> condition2Headers;
       actionData = rec.mActionData;
-      if(!rec.mCondition1Header.empty() && it->pcond1)
+      if(!rec.mCondition1Header.empty() && it->pcond1.get())
       {
          getHeaderFromSipMessage(request, rec.mCondition1Header, condition1Headers);
 
@@ -468,7 +426,7 @@ FilterStore::process(const SipMessage& request,
          bool match = false;
          for(; hit != condition1Headers.end() && match == false; hit++)
          {
-            match = applyRegex(1, *hit, rec.mCondition1Regex, it->pcond1, actionData);
+            match = applyRegex(1, *hit, rec.mCondition1Regex, *it->pcond1, actionData);
             DebugLog( << "  Cond1 HeaderName=" << rec.mCondition1Header << ", Value=" << *hit << ", Regex=" << rec.mCondition1Regex << ", match=" << match);
          }
          if(!match)
@@ -477,7 +435,7 @@ FilterStore::process(const SipMessage& request,
             continue;
          }
       }
-      if(!rec.mCondition2Header.empty() && it->pcond2)
+      if(!rec.mCondition2Header.empty() && it->pcond2.get())
       {
          getHeaderFromSipMessage(request, rec.mCondition2Header, condition2Headers);
 
@@ -486,7 +444,7 @@ FilterStore::process(const SipMessage& request,
          bool match = false;
          for(; hit != condition2Headers.end() && match == false; hit++)
          {
-            match = applyRegex(2, *hit, rec.mCondition2Regex, it->pcond2, actionData);
+            match = applyRegex(2, *hit, rec.mCondition2Regex, *it->pcond2, actionData);
             DebugLog( << "  Cond2 HeaderName=" << rec.mCondition2Header << ", Value=" << *hit << ", Regex=" << rec.mCondition2Regex << ", match=" << match);
          }
          if(!match)
@@ -511,27 +469,27 @@ FilterStore::test(const resip::Data& cond1Header,
                   short& action,
                   resip::Data& actionData)
 {
-   ReadLock lock(mMutex);
+   SnapshotPtr<FilterTable>::Reader table(mTable);
 
-   for (FilterOpList::iterator it = mFilterOperators.begin();
-        it != mFilterOperators.end(); it++)
+   for (FilterTable::const_iterator it = table->begin();
+        it != table->end(); it++)
    {
       const AbstractDb::FilterRecord& rec = it->filterRecord;
       actionData = rec.mActionData;
 
       // Check condition 1 regex
-      if(!rec.mCondition1Header.empty() && it->pcond1)
+      if(!rec.mCondition1Header.empty() && it->pcond1.get())
       {
-         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, it->pcond1, actionData))
+         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, *it->pcond1, actionData))
          {
             continue;
          }
       }
 
       // Check condition 2 regex
-      if(!rec.mCondition2Header.empty() && it->pcond2)
+      if(!rec.mCondition2Header.empty() && it->pcond2.get())
       {
-         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, it->pcond2, actionData))
+         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, *it->pcond2, actionData))
          {
             continue;
          }
@@ -1,19 +1,17 @@
 #if !defined(REPRO_FILTERSTORE_HXX)
 #define REPRO_FILTERSTORE_HXX
 
-#ifdef WIN32
-#include <pcreposix.h>
-#else
-#include <regex.h>
-#endif
-
 #include <set>
 #include <list>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
+#include "rutil/SharedPtr.hxx"
+#include "rutil/SnapshotPtr.hxx"
 
 #include "repro/AbstractDb.hxx"
+#include "repro/CompiledPattern.hxx"
 
 namespace resip
 {
@@ -97,7 +95,7 @@ class FilterStore
       bool applyRegex(int conditionNum,
                       const resip::Data& header, 
                       const resip::Data& match, 
-                      regex_t *regex, 
+                      const CompiledPattern& regex, 
                       resip::Data& rewrite);
 
       AbstractDb& mDb;  
@@ -106,16 +104,24 @@ class FilterStore
       {
          public:
             Key key;
-            regex_t *pcond1;
-            regex_t *pcond2;
+            resip::SharedPtr<CompiledPattern> pcond1;  // null if no or an invalid pattern
+            resip::SharedPtr<CompiledPattern> pcond2;
             AbstractDb::FilterRecord filterRecord;
             bool operator<(const FilterOp&) const;
       };
+
+      void compile(FilterOp& filter);
       
       resip::RWMutex mMutex;
       typedef std::multiset<FilterOp> FilterOpList;
       FilterOpList mFilterOperators; 
       FilterOpList::iterator mCursor;
+
+      // What process() and test() work on, without locking: the filters in
+      // order. Rebuilt from mFilterOperators on every change.
+      typedef std::vector<FilterOp> FilterTable;
+      void publishTable(); // with mMutex held for writing
+      resip::SnapshotPtr<FilterTable> mTable;
 };
 
  }
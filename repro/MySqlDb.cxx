@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstring>
 #include <fcntl.h>
 
 #ifdef HAVE_CONFIG_H
@@ -15,6 +16,7 @@
 
 #include "rutil/Data.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
 
@@ -64,28 +66,75 @@ class MySQLInitializer
 };
 static MySQLInitializer g_MySQLInitializer;
 
+// my_bool went away in MySQL 8.0.1; MariaDB keeps it
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_PACKAGE_VERSION_ID) && MYSQL_VERSION_ID >= 80001
+typedef bool MySqlBool;
+#else
+typedef my_bool MySqlBool;
+#endif
+
+MySqlDb::Connection::Connection() :
+   mMysql(0),
+   mConnected(false)
+{
+   memset(mStatements, 0, sizeof(mStatements));
+}
+
+MySqlDb::ConnectionLock::ConnectionLock(const MySqlDb& db) :
+   mDb(db),
+   mConnection(db.transactionConnection()),
+   mTransaction(mConnection != 0)
+{
+   if(!mConnection)
+   {
+      mConnection = mDb.checkout();
+   }
+}
+
+MySqlDb::ConnectionLock::~ConnectionLock()
+{
+   if(!mTransaction)
+   {
+      mDb.checkin(mConnection);
+   }
+}
+
 MySqlDb::MySqlDb(const Data& server, 
                  const Data& user, 
                  const Data& password, 
                  const Data& databaseName, 
                  unsigned int port, 
-                 const Data& customUserAuthQuery) :
+                 const Data& customUserAuthQuery,
+                 unsigned int connections) :
    mDBServer(server),
    mDBUser(user),
    mDBPassword(password),
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0),
    mConnected(false)
 { 
-   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   if(connections == 0)
+   {
+      connections = 1;
+   }
+   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port
+            << ", connections=" << connections);
 
    for (int i=0;i<MaxTable;i++)
    {
       mResult[i]=0;
    }
 
+   ThreadIf::tlsKeyCreate(mTransactionKey, 0);
+
+   for(unsigned int i = 0; i < connections; i++)
+   {
+      mConnections.push_back(new Connection);
+   }
+   // checked out last first, so put the first connection at the back
+   mIdleConnections.assign(mConnections.rbegin(), mConnections.rend());
+
    mysql_library_init(0, 0, 0);
    if(!mysql_thread_safe())
    {
@@ -93,14 +142,35 @@ MySqlDb::MySqlDb(const Data& server,
    }
    else
    {
-      connectToDatabase();
+      for(unsigned int i = 0; i < connections; i++)
+      {
+         if(connectToDatabase(*mConnections[i]) == 0)
+         {
+            mConnected = true;
+         }
+      }
    }
 }
 
 
 MySqlDb::~MySqlDb()
 {
-   disconnectFromDatabase();
+   for (int i=0;i<MaxTable;i++)
+   {
+      if (mResult[i])
+      {  
+         mysql_free_result(mResult[i]); 
+         mResult[i]=0;
+      }
+   }
+
+   for(std::vector<Connection*>::iterator i = mConnections.begin(); i != mConnections.end(); ++i)
+   {
+      disconnectFromDatabase(**i);
+      delete *i;
+   }
+
+   ThreadIf::tlsKeyDelete(mTransactionKey);
 }
 
 void
@@ -113,44 +183,71 @@ MySqlDb::initialize() const
    }
 }
 
+MySqlDb::Connection*
+MySqlDb::checkout() const
+{
+   Lock lock(mPoolMutex);
+   while(mIdleConnections.empty())
+   {
+      mConnectionReturned.wait(mPoolMutex);
+   }
+   Connection* conn = mIdleConnections.back();
+   mIdleConnections.pop_back();
+   return conn;
+}
+
 void
-MySqlDb::disconnectFromDatabase() const
+MySqlDb::checkin(Connection* conn) const
 {
-   if(mConn)
+   Lock lock(mPoolMutex);
+   mIdleConnections.push_back(conn);
+   mConnectionReturned.signal();
+}
+
+MySqlDb::Connection*
+MySqlDb::transactionConnection() const
+{
+   return static_cast<Connection*>(ThreadIf::tlsGetValue(mTransactionKey));
+}
+
+void
+MySqlDb::disconnectFromDatabase(Connection& conn) const
+{
+   if(conn.mMysql)
    {
-      for (int i=0;i<MaxTable;i++)
+      for (int i=0;i<MaxStatements;i++)
       {
-         if (mResult[i])
-         {  
-            mysql_free_result(mResult[i]); 
-            mResult[i]=0;
+         if (conn.mStatements[i])
+         {
+            mysql_stmt_close(conn.mStatements[i]);
+            conn.mStatements[i]=0;
          }
       }
    
-      mysql_close(mConn);
-      mConn = 0;
-      mConnected = false;
+      mysql_close(conn.mMysql);
+      conn.mMysql = 0;
+      conn.mConnected = false;
    }
 }
 
 int 
-MySqlDb::connectToDatabase() const
+MySqlDb::connectToDatabase(Connection& conn) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(conn);
 
    // Now try to connect
-   assert(mConn == 0);
-   assert(mConnected == false);
+   assert(conn.mMysql == 0);
+   assert(conn.mConnected == false);
 
-   mConn = mysql_init(0);
-   if(mConn == 0)
+   conn.mMysql = mysql_init(0);
+   if(conn.mMysql == 0)
    {
       ErrLog( << "MySQL init failed: insufficient memory.");
       return CR_OUT_OF_MEMORY;
    }
 
-   MYSQL* ret = mysql_real_connect(mConn,
+   MYSQL* ret = mysql_real_connect(conn.mMysql,
                                    mDBServer.c_str(),   // hostname
                                    mDBUser.c_str(),     // user
                                    mDBPassword.c_str(), // password
@@ -161,22 +258,22 @@ MySqlDb::connectToDatabase() const
 
    if (ret == 0)
    { 
-      int rc = mysql_errno(mConn);
-      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(mConn));
-      mysql_close(mConn); 
-      mConn = 0;
-      mConnected = false;
+      int rc = mysql_errno(conn.mMysql);
+      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(conn.mMysql));
+      mysql_close(conn.mMysql); 
+      conn.mMysql = 0;
+      conn.mConnected = false;
       return rc;
    }
    else
    {
-      mConnected = true;
+      conn.mConnected = true;
       return 0;
    }
 }
 
 int
-MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
+MySqlDb::query(Connection& conn, const Data& queryCommand, MYSQL_RES** result) const
 {
    int rc = 0;
 
@@ -184,37 +281,37 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
 
    DebugLog( << "MySqlDb::query: executing query: " << queryCommand);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !mConnected)
+   if(conn.mMysql == 0 || !conn.mConnected)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(conn);
    }
    if(rc == 0)
    {
-      assert(mConn!=0);
-      assert(mConnected);
-      rc = mysql_query(mConn,queryCommand.c_str());
+      assert(conn.mMysql!=0);
+      assert(conn.mConnected);
+      rc = mysql_query(conn.mMysql,queryCommand.c_str());
       if(rc != 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(conn.mMysql);
          if(rc == CR_SERVER_GONE_ERROR ||
             rc == CR_SERVER_LOST)
          {
             // First failure is a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            rc = connectToDatabase(conn);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               rc = mysql_query(mConn,queryCommand.c_str());
+               rc = mysql_query(conn.mMysql,queryCommand.c_str());
                if( rc != 0)
                {
-                  ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+                  rc = mysql_errno(conn.mMysql);
+                  ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(conn.mMysql));
                }
             }
          }
          else
          {
-            ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(conn.mMysql));
          }
       }
    }
@@ -222,13 +319,13 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
    // Now store result - if pointer to result pointer was supplied and no errors
    if(rc == 0 && result)
    {
-      *result = mysql_store_result(mConn);
+      *result = mysql_store_result(conn.mMysql);
       if(*result == 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(conn.mMysql);
          if(rc != 0)
          {
-            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(conn.mMysql));
          }
       }
    }
@@ -240,11 +337,225 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
    return rc;
 }
 
+int
+MySqlDb::execute(Connection& conn,
+                 unsigned int statement,
+                 const Data* params,
+                 unsigned int numParams,
+                 std::vector<Data>* fields) const
+{
+   initialize();
+
+   MYSQL_STMT* stmt = 0;
+   int rc = prepare(conn, statement, stmt);
+   if(rc == 0)
+   {
+      rc = executePrepared(stmt, params, numParams);
+   }
+   if(rc == CR_SERVER_GONE_ERROR ||
+      rc == CR_SERVER_LOST)
+   {
+      // First failure is a connection error - re-connect (which closes the
+      // statements prepared on the connection, stmt among them) and then
+      // try again
+      stmt = 0;
+      rc = connectToDatabase(conn);
+      if(rc == 0)
+      {
+         rc = prepare(conn, statement, stmt);
+      }
+      if(rc == 0)
+      {
+         rc = executePrepared(stmt, params, numParams);
+      }
+   }
+   if(rc == 0 && fields)
+   {
+      rc = fetchPrepared(stmt, *fields);
+   }
+
+   if(rc != 0)
+   {
+      ErrLog( << "MySQL statement failed: error=" << rc << ": "
+              << (stmt ? mysql_stmt_error(stmt) : (conn.mMysql ? mysql_error(conn.mMysql) : "not connected")));
+      ErrLog( << " SQL Statement was: " << statementText(statement));
+   }
+   return rc;
+}
+
+int
+MySqlDb::prepare(Connection& conn, unsigned int statement, MYSQL_STMT*& stmt) const
+{
+   assert(statement < MaxStatements);
+   stmt = 0;
+   if(conn.mMysql == 0 || !conn.mConnected)
+   {
+      int rc = connectToDatabase(conn);
+      if(rc != 0)
+      {
+         return rc;
+      }
+   }
+
+   if(conn.mStatements[statement] == 0)
+   {
+      MYSQL_STMT* prepared = mysql_stmt_init(conn.mMysql);
+      if(prepared == 0)
+      {
+         return CR_OUT_OF_MEMORY;
+      }
+      Data text(statementText(statement));
+      if(mysql_stmt_prepare(prepared, text.c_str(), (unsigned long)text.size()) != 0)
+      {
+         int rc = mysql_stmt_errno(prepared);
+         ErrLog( << "MySQL prepare failed: error=" << rc << ": " << mysql_stmt_error(prepared));
+         mysql_stmt_close(prepared);
+         return rc;
+      }
+      conn.mStatements[statement] = prepared;
+   }
+   stmt = conn.mStatements[statement];
+   return 0;
+}
+
+int
+MySqlDb::executePrepared(MYSQL_STMT* stmt, const Data* params, unsigned int numParams) const
+{
+   std::vector<MYSQL_BIND> binds(numParams);
+   std::vector<unsigned long> lengths(numParams);
+   if(numParams > 0)
+   {
+      memset(&binds[0], 0, numParams * sizeof(MYSQL_BIND));
+   }
+   for(unsigned int i = 0; i < numParams; i++)
+   {
+      lengths[i] = (unsigned long)params[i].size();
+      binds[i].buffer_type = MYSQL_TYPE_STRING;
+      binds[i].buffer = (void*)params[i].data();
+      binds[i].buffer_length = lengths[i];
+      binds[i].length = &lengths[i];
+   }
+
+   if((numParams > 0 && mysql_stmt_bind_param(stmt, &binds[0]) != 0) ||
+      mysql_stmt_execute(stmt) != 0)
+   {
+      return mysql_stmt_errno(stmt);
+   }
+   return 0;
+}
+
+int
+MySqlDb::fetchPrepared(MYSQL_STMT* stmt, std::vector<Data>& fields) const
+{
+   MYSQL_RES* metadata = mysql_stmt_result_metadata(stmt);
+   if(metadata == 0)
+   {
+      return mysql_stmt_errno(stmt);
+   }
+   unsigned int columns = mysql_num_fields(metadata);
+   mysql_free_result(metadata);
+
+   if(mysql_stmt_store_result(stmt) != 0)
+   {
+      return mysql_stmt_errno(stmt);
+   }
+
+   // Bind no buffers, so that each fetch only reports the lengths; the
+   // columns are then fetched into Datas of the right size.
+   std::vector<MYSQL_BIND> binds(columns);
+   std::vector<unsigned long> lengths(columns);
+   std::vector<MySqlBool> nulls(columns);
+   memset(&binds[0], 0, columns * sizeof(MYSQL_BIND));
+   for(unsigned int i = 0; i < columns; i++)
+   {
+      binds[i].buffer_type = MYSQL_TYPE_STRING;
+      binds[i].length = &lengths[i];
+      binds[i].is_null = &nulls[i];
+   }
+
+   int rc = mysql_stmt_bind_result(stmt, &binds[0]) != 0 ? mysql_stmt_errno(stmt) : 0;
+   while(rc == 0)
+   {
+      int fetched = mysql_stmt_fetch(stmt);
+      if(fetched == MYSQL_NO_DATA)
+      {
+         break;
+      }
+      if(fetched != 0 && fetched != MYSQL_DATA_TRUNCATED)
+      {
+         rc = mysql_stmt_errno(stmt);
+         break;
+      }
+      for(unsigned int i = 0; i < columns && rc == 0; i++)
+      {
+         Data value;
+         if(!nulls[i] && lengths[i] > 0)
+         {
+            MYSQL_BIND column;
+            memset(&column, 0, sizeof(column));
+            column.buffer_type = MYSQL_TYPE_STRING;
+            column.buffer = value.getBuf((Data::size_type)lengths[i]);
+            column.buffer_length = lengths[i];
+            if(mysql_stmt_fetch_column(stmt, &column, i, 0) != 0)
+            {
+               rc = mysql_stmt_errno(stmt);
+            }
+         }
+         fields.push_back(value);
+      }
+   }
+   mysql_stmt_free_result(stmt);
+   return rc;
+}
+
+Data
+MySqlDb::statementText(unsigned int statement) const
+{
+   switch(statement)
+   {
+      case UserAuthStatement:
+         return "SELECT passwordHash FROM users WHERE user=? AND domain=?";
+      case UserStatement:
+         return "SELECT user, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM users WHERE user=? AND domain=?";
+      case SiloRecordsStatement:
+         return Data("SELECT value FROM ") + tableName(SiloTable) + " WHERE attr2=?";
+      default:
+         break;
+   }
+
+   assert(statement >= TableStatements);
+   Table table = (Table)((statement - TableStatements) / RecordStatements);
+   Data text;
+   {
+      DataStream ds(text);
+      switch((statement - TableStatements) % RecordStatements)
+      {
+         case ReadRecordStatement:
+            ds << "SELECT value FROM " << tableName(table) << " WHERE attr=?";
+            break;
+         case WriteRecordStatement:
+            ds << "REPLACE INTO " << tableName(table) << " SET attr=?, value=?";
+            break;
+         case WriteRecordWithSecondaryKeyStatement:
+            ds << "REPLACE INTO " << tableName(table) << " SET attr=?, attr2=?, value=?";
+            break;
+         case EraseRecordStatement:
+            ds << "DELETE FROM " << tableName(table) << " WHERE attr=?";
+            break;
+         case EraseRecordBySecondaryKeyStatement:
+            ds << "DELETE FROM " << tableName(table) << " WHERE attr2=?";
+            break;
+      }
+   }
+   return text;
+}
+
 int
 MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
+   ConnectionLock conn(*this);
    MYSQL_RES* result=0;
-   int rc = query(queryCommand, &result);
+   int rc = query(*conn, queryCommand, &result);
       
    if(rc == 0)
    {
@@ -263,10 +574,10 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
       }
       else
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno((*conn).mMysql);
          if(rc != 0)
          {
-            ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error((*conn).mMysql));
          }
       }
       mysql_free_result(result);
@@ -275,9 +586,22 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
 }
 
 resip::Data& 
-MySqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
+MySqlDb::escapeString(Connection& conn, const resip::Data& str, resip::Data& escapedStr) const
 {
-   escapedStr.truncate2(mysql_real_escape_string(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+   if(conn.mMysql == 0 || !conn.mConnected)
+   {
+      connectToDatabase(conn);
+   }
+   char* buf = escapedStr.getBuf(str.size()*2+1);
+   if(conn.mMysql)
+   {
+      escapedStr.truncate2(mysql_real_escape_string(conn.mMysql, buf, str.c_str(), str.size()));
+   }
+   else
+   {
+      // not connected, so the query will fail anyway
+      escapedStr.truncate2(mysql_escape_string(buf, str.c_str(), str.size()));
+   }
    return escapedStr;
 }
 
@@ -308,7 +632,8 @@ MySqlDb::addUser(const AbstractDb::Key& key, const AbstractDb::UserRecord& rec)
          << "', forwardAddress='" << rec.forwardAddress
          << "'";
    }
-   return query(command, 0) == 0;
+   ConnectionLock conn(*this);
+   return query(*conn, command, 0) == 0;
 }
 
 
@@ -321,7 +646,8 @@ MySqlDb::eraseUser(const AbstractDb::Key& key )
       ds << "DELETE FROM users ";
       userWhereClauseToDataStream(key, ds);
    }
-   query(command, 0);
+   ConnectionLock conn(*this);
+   query(*conn, command, 0);
 }
 
 
@@ -330,41 +656,31 @@ MySqlDb::getUser( const AbstractDb::Key& key ) const
 {
    AbstractDb::UserRecord  ret;
 
-   Data command;
-   {
-      DataStream ds(command);
-      ds << "SELECT user, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM users ";
-      userWhereClauseToDataStream(key, ds);
-   }
-   
-   MYSQL_RES* result=0;
-   if(query(command, &result) != 0)
-   {
-      return ret;
-   }
-   
-   if (result==0)
+   Data params[2];
+   getUserAndDomainFromKey(key, params[0], params[1]);
+
+   std::vector<Data> fields;
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
-      return ret;
+      ConnectionLock conn(*this);
+      if(execute(*conn, UserStatement, params, 2, &fields) != 0)
+      {
+         return ret;
+      }
    }
 
-   MYSQL_ROW row = mysql_fetch_row(result);
-   if (row)
+   if (fields.size() >= 8)
    {
       int col = 0;
-      ret.user            = Data(row[col++]);
-      ret.domain          = Data(row[col++]);
-      ret.realm           = Data(row[col++]);
-      ret.passwordHash    = Data(row[col++]);
-      ret.passwordHashAlt = Data(row[col++]);
-      ret.name            = Data(row[col++]);
-      ret.email           = Data(row[col++]);
-      ret.forwardAddress  = Data(row[col++]);
+      ret.user            = fields[col++];
+      ret.domain          = fields[col++];
+      ret.realm           = fields[col++];
+      ret.passwordHash    = fields[col++];
+      ret.passwordHashAlt = fields[col++];
+      ret.name            = fields[col++];
+      ret.email           = fields[col++];
+      ret.forwardAddress  = fields[col++];
    }
 
-   mysql_free_result(result);
-
    return ret;
 }
 
@@ -374,28 +690,36 @@ MySqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
    std::vector<Data> ret;
 
-   Data command;
+   Data user;
+   Data domain;
+   getUserAndDomainFromKey(key, user, domain);
+
+   // Note: domain is empty when querying for HTTP admin user - for this special user, 
+   // we will only check the repro db, by not adding the UNION statement below
+   if(!mCustomUserAuthQuery.empty() && !domain.empty())  
    {
-      DataStream ds(command);
-      Data user;
-      Data domain;
-      getUserAndDomainFromKey(key, user, domain);
-      ds << "SELECT passwordHash FROM users WHERE user = '" << user << "' AND domain = '" << domain << "' ";
-   
-      // Note: domain is empty when querying for HTTP admin user - for this special user, 
-      // we will only check the repro db, by not adding the UNION statement below
-      if(!mCustomUserAuthQuery.empty() && !domain.empty())  
+      Data command;
       {
+         DataStream ds(command);
+         ds << "SELECT passwordHash FROM users WHERE user = '" << user << "' AND domain = '" << domain << "' ";
          ds << " UNION " << mCustomUserAuthQuery;
-         ds.flush();
-         command.replace("$user", user);
-         command.replace("$domain", domain);
       }
-   }
+      command.replace("$user", user);
+      command.replace("$domain", domain);
 
-   if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+      if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+      {
+         return Data::Empty;
+      }
+   }
+   else
    {
-      return Data::Empty;
+      Data params[2] = { user, domain };
+      ConnectionLock conn(*this);
+      if(execute(*conn, UserAuthStatement, params, 2, &ret) != 0 || ret.size() == 0)
+      {
+         return Data::Empty;
+      }
    }
    
    DebugLog( << "Auth password is " << ret.front());
@@ -416,15 +740,18 @@ MySqlDb::firstUserKey()
    
    Data command("SELECT user, domain FROM users");
 
-   if(query(command, &mResult[UserTable]) != 0)
    {
-      return Data::Empty;
-   }
+      ConnectionLock conn(*this);
+      if(query(*conn, command, &mResult[UserTable]) != 0)
+      {
+         return Data::Empty;
+      }
 
-   if(mResult[UserTable] == 0)
-   {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
-      return Data::Empty;
+      if(mResult[UserTable] == 0)
+      {
+         ErrLog( << "MySQL store result failed: error=" << mysql_errno((*conn).mMysql) << ": " << mysql_error((*conn).mMysql));
+         return Data::Empty;
+      }
    }
    
    return nextUserKey();
@@ -453,38 +780,48 @@ MySqlDb::nextUserKey()
 }
 
 
+bool
+MySqlDb::getSiloRecords(const Key& skey, AbstractDb::SiloRecordList& recordList)
+{
+   std::vector<Data> values;
+   {
+      ConnectionLock conn(*this);
+      if(execute(*conn, SiloRecordsStatement, &skey, 1, &values) != 0)
+      {
+         return false;
+      }
+   }
+
+   AbstractDb::SiloRecord rec;
+   for(std::vector<Data>::iterator i = values.begin(); i != values.end(); ++i)
+   {
+      Data data = i->base64decode();
+      decodeSiloRecord(data, rec);
+      recordList.push_back(rec);
+   }
+   return true;
+}
+
+
 bool 
 MySqlDb::dbWriteRecord(const Table table, 
                        const resip::Data& pKey, 
                        const resip::Data& pData)
 {
-   Data command;
-
    // Check if there is a secondary key or not and get it's value
    char* secondaryKey;
    unsigned int secondaryKeyLen;
-   Data escapedKey;
+   ConnectionLock conn(*this);
    if(AbstractDb::getSecondaryKey(table, pKey, pData, (void**)&secondaryKey, &secondaryKeyLen) == 0)
    {
-      Data escapedSKey;
-      Data sKey(Data::Share, secondaryKey, secondaryKeyLen);
-      DataStream ds(command);
-      ds << "REPLACE INTO " << tableName(table)
-         << " SET attr='" << escapeString(pKey, escapedKey)
-         << "', attr2='" << escapeString(sKey, escapedSKey)
-         << "', value='"  << pData.base64encode()
-         << "'";
+      Data params[3] = { pKey, Data(Data::Share, secondaryKey, secondaryKeyLen), pData.base64encode() };
+      return execute(*conn, recordStatement(table, WriteRecordWithSecondaryKeyStatement), params, 3, 0) == 0;
    }
    else
    {
-      DataStream ds(command);
-      ds << "REPLACE INTO " << tableName(table) 
-         << " SET attr='" << escapeString(pKey, escapedKey)
-         << "', value='"  << pData.base64encode()
-         << "'";
+      Data params[2] = { pKey, pData.base64encode() };
+      return execute(*conn, recordStatement(table, WriteRecordStatement), params, 2, 0) == 0;
    }
-
-   return query(command, 0) == 0;
 }
 
 bool 
@@ -492,38 +829,21 @@ MySqlDb::dbReadRecord(const Table table,
                       const resip::Data& pKey, 
                       resip::Data& pData) const
 { 
-   Data command;
-   Data escapedKey;
+   std::vector<Data> values;
    {
-      DataStream ds(command);
-      ds << "SELECT value FROM " << tableName(table) 
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "'";
-   }
-
-   MYSQL_RES* result = 0;
-   if(query(command, &result) != 0)
-   {
-      return false;
+      ConnectionLock conn(*this);
+      if(execute(*conn, recordStatement(table, ReadRecordStatement), &pKey, 1, &values) != 0)
+      {
+         return false;
+      }
    }
 
-   if (result == 0)
+   if(values.empty())
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
       return false;
    }
-   else
-   {
-      bool success = false;
-      MYSQL_ROW row=mysql_fetch_row(result);
-      if(row)
-      {
-         pData = Data(Data::Share, row[0], (Data::size_type)strlen(row[0])).base64decode();
-         success = true;
-      }
-      mysql_free_result(result);
-      return success;
-   }
+   pData = values.front().base64decode();
+   return true;
 }
 
 
@@ -532,21 +852,10 @@ MySqlDb::dbEraseRecord(const Table table,
                        const resip::Data& pKey,
                        bool isSecondaryKey) // allows deleting records from a table that supports secondary keying using a secondary key
 { 
-   Data command;
-   {
-      DataStream ds(command);
-      Data escapedKey;
-      ds << "DELETE FROM " << tableName(table);
-      if(isSecondaryKey)
-      {
-         ds << " WHERE attr2='" << escapeString(pKey, escapedKey) << "'";
-      }
-      else
-      {
-         ds << " WHERE attr='" << escapeString(pKey, escapedKey) << "'";
-      }
-   }   
-   query(command, 0);
+   ConnectionLock conn(*this);
+   execute(*conn, 
+           recordStatement(table, isSecondaryKey ? EraseRecordBySecondaryKeyStatement : EraseRecordStatement), 
+           &pKey, 1, 0);
 }
 
 
@@ -568,14 +877,15 @@ MySqlDb::dbNextKey(const Table table, bool first)
          ds << "SELECT attr FROM " << tableName(table);
       }
       
-      if(query(command, &mResult[table]) != 0)
+      ConnectionLock conn(*this);
+      if(query(*conn, command, &mResult[table]) != 0)
       {
          return Data::Empty;
       }
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: error=" << mysql_errno((*conn).mMysql) << ": " << mysql_error((*conn).mMysql));
          return Data::Empty;
       }
    }
@@ -615,6 +925,7 @@ MySqlDb::dbNextRecord(const Table table,
          mResult[table] = 0;
       }
       
+      ConnectionLock conn(*this);
       Data command;
       {
          DataStream ds(command);
@@ -624,7 +935,7 @@ MySqlDb::dbNextRecord(const Table table,
             Data escapedKey;
             // dbNextRecord is used to iterator through database tables that support duplication records
             // it is only appropriate for MySQL tables that contain the attr2 non-unique index (secondary key)
-            ds << " WHERE attr2='" << escapeString(key, escapedKey) << "'";
+            ds << " WHERE attr2='" << escapeString(*conn, key, escapedKey) << "'";
          }
          if(forUpdate)
          {
@@ -632,14 +943,14 @@ MySqlDb::dbNextRecord(const Table table,
          }
       }
 
-      if(query(command, &mResult[table]) != 0)
+      if(query(*conn, command, &mResult[table]) != 0)
       {
          return false;
       }
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: error=" << mysql_errno((*conn).mMysql) << ": " << mysql_error((*conn).mMysql));
          return false;
       }
    }
@@ -665,27 +976,56 @@ MySqlDb::dbNextRecord(const Table table,
 bool 
 MySqlDb::dbBeginTransaction(const Table table)
 {
+   // The transaction's statements must all run on one connection, so the
+   // thread keeps it until the transaction ends.
+   Connection* conn = transactionConnection();
+   if(conn == 0)
+   {
+      conn = checkout();
+      ThreadIf::tlsSetValue(mTransactionKey, conn);
+   }
+
    Data command("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
-   if(query(command, 0) == 0)
+   if(query(*conn, command, 0) == 0)
    {
       command = "START TRANSACTION";
-      return query(command, 0) == 0;
+      if(query(*conn, command, 0) == 0)
+      {
+         return true;
+      }
    }
+
+   ThreadIf::tlsSetValue(mTransactionKey, 0);
+   checkin(conn);
    return false;
 }
 
+bool
+MySqlDb::endTransaction(const char* command)
+{
+   Connection* conn = transactionConnection();
+   if(conn == 0)
+   {
+      ConnectionLock lock(*this);
+      return query(*lock, command, 0) == 0;
+   }
+
+   bool ret = query(*conn, command, 0) == 0;
+   ThreadIf::tlsSetValue(mTransactionKey, 0);
+   checkin(conn);
+   return ret;
+}
+
 bool 
 MySqlDb::dbCommitTransaction(const Table table)
 {
-   Data command("COMMIT");
-   return query(command, 0) == 0;
+   return endTransaction("COMMIT");
 }
 
 bool 
 MySqlDb::dbRollbackTransaction(const Table table)
 {
-   Data command("ROLLBACK");
-   return query(command, 0) == 0;
+   return endTransaction("ROLLBACK");
 }
 
 static const char usersavp[] = "usersavp";
@@ -7,7 +7,12 @@
 #include <mysql/mysql.h>
 #endif
 
+#include <vector>
+
+#include "rutil/Condition.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -18,6 +23,22 @@ namespace resip
 namespace repro
 {
 
+/**
+   AbstractDb on a MySQL server, through a pool of connections.
+
+   Every operation checks a connection out of the pool for as long as it
+   runs, so as many threads can query at once as there are connections;
+   a thread that finds them all in use waits for one.  A thread inside a
+   transaction (dbBeginTransaction() to dbCommitTransaction() or
+   dbRollbackTransaction()) keeps the connection the transaction runs on.
+
+   The frequent queries - user auth info and user records, single record
+   reads, writes and erases (static registrations, the message silo) and
+   the silo lookup by destination - are prepared statements, prepared on
+   each connection the first time they are used there.  A connection whose
+   server went away is reconnected, and its statements prepared again, by
+   the one thread using it, without holding up the others.
+*/
 class MySqlDb: public AbstractDb
 {
    public:
@@ -26,7 +47,8 @@ class MySqlDb: public AbstractDb
               const resip::Data& password, 
               const resip::Data& databaseName, 
               unsigned int port, 
-              const resip::Data& customUserAuthQuery);
+              const resip::Data& customUserAuthQuery,
+              unsigned int connections = 1);
       
       virtual ~MySqlDb();
       
@@ -39,6 +61,8 @@ class MySqlDb: public AbstractDb
       virtual Key firstUserKey();// return empty if no more
       virtual Key nextUserKey(); // return empty if no more 
 
+      virtual bool getSiloRecords(const Key& skey, SiloRecordList& recordList); 
+
       // Perform a query that expects a single result/row - returns all column/field data in a vector
       virtual int singleResultQuery(const resip::Data& queryCommand, std::vector<resip::Data>& fields) const;
 
@@ -64,11 +88,78 @@ class MySqlDb: public AbstractDb
       virtual bool dbCommitTransaction(const Table table);
       virtual bool dbRollbackTransaction(const Table table);
 
+      // The prepared statements: a few fixed ones, then RecordStatements
+      // for each table
+      typedef enum
+      {
+         UserAuthStatement = 0,
+         UserStatement,
+         SiloRecordsStatement,
+         TableStatements
+      } Statement;
+      typedef enum
+      {
+         ReadRecordStatement = 0,
+         WriteRecordStatement,
+         WriteRecordWithSecondaryKeyStatement,
+         EraseRecordStatement,
+         EraseRecordBySecondaryKeyStatement,
+         RecordStatements
+      } RecordStatement;
+      enum { MaxStatements = TableStatements + MaxTable * RecordStatements };
+
+      static unsigned int recordStatement(Table table, RecordStatement statement)
+      {
+         return TableStatements + table * RecordStatements + statement;
+      }
+
+      class Connection
+      {
+         public:
+            Connection();
+
+            MYSQL* mMysql;
+            bool mConnected;
+            MYSQL_STMT* mStatements[MaxStatements];  // 0 until first used
+      };
+
+      /** Holds a connection checked out of the pool for as long as it
+          lives; see the class comment. */
+      class ConnectionLock
+      {
+         public:
+            ConnectionLock(const MySqlDb& db);
+            ~ConnectionLock();
+            Connection& operator*() const { return *mConnection; }
+
+         private:
+            const MySqlDb& mDb;
+            Connection* mConnection;
+            bool mTransaction;
+      };
+      friend class ConnectionLock;
+
+      Connection* checkout() const;
+      void checkin(Connection* conn) const;
+      Connection* transactionConnection() const;
+      bool endTransaction(const char* command);
+
       void initialize() const;
-      void disconnectFromDatabase() const;
-      int connectToDatabase() const;
-      int query(const resip::Data& queryCommand, MYSQL_RES** result) const;
-      resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
+      void disconnectFromDatabase(Connection& conn) const;
+      int connectToDatabase(Connection& conn) const;
+      int query(Connection& conn, const resip::Data& queryCommand, MYSQL_RES** result) const;
+      // Runs a prepared statement; if fields is given, every column of
+      // every row of the result is appended to it.
+      int execute(Connection& conn,
+                  unsigned int statement,
+                  const resip::Data* params,
+                  unsigned int numParams,
+                  std::vector<resip::Data>* fields) const;
+      int prepare(Connection& conn, unsigned int statement, MYSQL_STMT*& stmt) const;
+      int executePrepared(MYSQL_STMT* stmt, const resip::Data* params, unsigned int numParams) const;
+      int fetchPrepared(MYSQL_STMT* stmt, std::vector<resip::Data>& fields) const;
+      resip::Data statementText(unsigned int statement) const;
+      resip::Data& escapeString(Connection& conn, const resip::Data& str, resip::Data& escapedStr) const;
 
       resip::Data mDBServer;
       resip::Data mDBUser;
@@ -77,13 +168,22 @@ class MySqlDb: public AbstractDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable MYSQL* mConn;
-      mutable MYSQL_RES* mResult[MaxTable];
-      mutable volatile bool mConnected;
+      std::vector<Connection*> mConnections;
       // when multiple threads are in use with the same connection, you need to 
       // mutex calls to mysql_query and mysql_store_result: 
       // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html
-      mutable resip::Mutex mMutex;  
+      // so each connection is used by one thread at a time; the idle ones
+      // are kept here, the most recently used last
+      mutable std::vector<Connection*> mIdleConnections;
+      mutable resip::Mutex mPoolMutex;
+      mutable resip::Condition mConnectionReturned;
+      // the Connection a thread's transaction runs on, if any
+      resip::ThreadIf::TlsKey mTransactionKey;
+
+      // results of the first/next key and record iterations, which are
+      // stored on the client and do not need their connection
+      mutable MYSQL_RES* mResult[MaxTable];
+      bool mConnected;
 
       const char* tableName( Table table ) const;
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
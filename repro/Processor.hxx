@@ -11,6 +11,19 @@ namespace repro
 class ProcessorChain;
 class RequestContext;
 
+/**
+   A step of a ProcessorChain. One Processor object serves every
+   RequestContext; with NumProxyWorkerThreads it is called from several
+   threads at once, each with a different RequestContext. So process() must
+   keep the state of a request in the RequestContext (or its KeyValueStore),
+   not in the Processor, and protect anything else it changes (stores,
+   caches, counters) with a lock; configuration read at construction may
+   be used freely. A RequestContext is only ever processed by one thread,
+   and asynchronous work posted back through the proxy returns to that
+   thread. The proxy only uses worker threads if every processor in its
+   chains is on the list in Proxy.cxx of the ones checked for this, so a
+   new processor has to be added there to allow them.
+*/
 class Processor
 {
    public:
@@ -151,6 +151,40 @@ ProcessorChain::setChainType(ChainType type)
    }
 }
 
+void
+ProcessorChain::makeReady()
+{
+   if(!mChainReady)
+   {
+      onChainComplete();
+   }
+   for(Chain::iterator it = mChain.begin() ; it != mChain.end(); it++)
+   {
+      ProcessorChain* chain = dynamic_cast<ProcessorChain*>(*it);
+      if(chain)
+      {
+         chain->makeReady();
+      }
+   }
+}
+
+void
+ProcessorChain::getProcessorNames(std::vector<Data>& names) const
+{
+   for(Chain::const_iterator it = mChain.begin() ; it != mChain.end(); it++)
+   {
+      const ProcessorChain* chain = dynamic_cast<const ProcessorChain*>(*it);
+      if(chain)
+      {
+         chain->getProcessorNames(names);
+      }
+      else
+      {
+         names.push_back((*it)->getName());
+      }
+   }
+}
+
 void
 ProcessorChain::onChainComplete()
 {
@@ -35,6 +35,15 @@ class ProcessorChain : public Processor
 
       virtual processor_action_t process(RequestContext &);
 
+      /** Numbers the processors, of nested chains too; otherwise done when
+          the chain is first used. For chains that will be used by several
+          threads, before they start. */
+      void makeReady();
+
+      /// Appends the names of the processors, those of nested chains
+      /// instead of the chains themselves.
+      void getProcessorNames(std::vector<resip::Data>& names) const;
+
       typedef std::vector<Processor*> Chain;
 
       virtual void setChainType(ChainType type);
@@ -19,6 +19,8 @@
 #include "rutil/Inserter.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
+#include <algorithm>
+
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::REPRO
 
 using namespace resip;
@@ -94,6 +96,8 @@ Proxy::Proxy(SipStack& stack,
      mRequestProcessorChain(requestP), 
      mResponseProcessorChain(responseP),
      mTargetProcessorChain(targetP),
+     mContexts(0),
+     mNumWorkers(config.getConfigUnsignedLong("NumProxyWorkerThreads", 0)),
      mUserStore(config.getDataStore()->mUserStore),
      mOptionsHandler(0),
      mRequestContextFactory(new RequestContextFactory),
@@ -101,6 +105,10 @@ Proxy::Proxy(SipStack& stack,
      mRegistrationAccountingEnabled(config.getConfigBool("RegistrationAccountingEnabled", false)),
      mAccountingCollector(0)
 {
+   int res = ThreadIf::tlsKeyCreate(mContextsKey, 0);
+   assert(res == 0);
+   (void)res;
+
    FlowTokenSalt = Random::getCryptoRandom(20);   // 20-octet Crypto Random Key for Salting Flow Token HMACs
 
    mFifo.setDescription("Proxy::mFifo");
@@ -121,8 +129,24 @@ Proxy::~Proxy()
 {
    shutdown();
    join();
+
+   size_t serverContexts = mContexts.mServerRequestContexts.size();
+   size_t clientContexts = mContexts.mClientRequestContexts.size();
+   for (std::vector<Worker*>::iterator i = mWorkers.begin(); i != mWorkers.end(); ++i)
+   {
+      (*i)->shutdown();
+   }
+   for (std::vector<Worker*>::iterator i = mWorkers.begin(); i != mWorkers.end(); ++i)
+   {
+      (*i)->join();
+      serverContexts += (*i)->mContexts.mServerRequestContexts.size();
+      clientContexts += (*i)->mContexts.mClientRequestContexts.size();
+      delete *i;
+   }
+
    delete mAccountingCollector;
-   InfoLog (<< "Proxy::thread shutdown with " << mServerRequestContexts.size() << " ServerRequestContexts and " << mClientRequestContexts.size() << " ClientRequestContexts.");
+   ThreadIf::tlsKeyDelete(mContextsKey);
+   InfoLog (<< "Proxy::thread shutdown with " << serverContexts << " ServerRequestContexts and " << clientContexts << " ClientRequestContexts.");
 }
 
 void 
@@ -149,19 +173,112 @@ Proxy::getUserStore()
    return mUserStore;
 }
 
+// The processors that have been checked to keep the state of a request in
+// the RequestContext and to lock whatever else they change, so that
+// NumProxyWorkerThreads may run them on several threads at once.  Any other
+// processor, such as MessageSilo or those added by plugins, keeps the proxy
+// on one thread.
+static const char* const ConcurrentProcessors[] =
+{
+   "StrictRouteFixup",
+   "IsTrustedNode",
+   "CertificateAuthenticator",
+   "CookieAuthenticator",
+   "DigestAuthenticator",
+   "AmIResponsible",
+   "RequestFilter",
+   "StaticRoute",
+   "SimpleStaticRoute",
+   "LocationServer",
+   "OutboundTargetHandler",
+   "RecursiveRedirectHandler",
+   "GeoProximityTargetHandler",
+   "QValueTargetHandler",
+   "SimpleTargetHandler"
+};
+
+bool
+Proxy::workersAllowed() const
+{
+   std::vector<Data> names;
+   mRequestProcessorChain.getProcessorNames(names);
+   mResponseProcessorChain.getProcessorNames(names);
+   mTargetProcessorChain.getProcessorNames(names);
+   for (std::vector<Data>::const_iterator i = names.begin(); i != names.end(); ++i)
+   {
+      const char* const* end = ConcurrentProcessors + sizeof(ConcurrentProcessors) / sizeof(ConcurrentProcessors[0]);
+      if (std::find(ConcurrentProcessors, end, *i) == end)
+      {
+         WarningLog (<< "Processor " << *i << " is not known to be safe on several threads, "
+                     << "ignoring NumProxyWorkerThreads=" << mNumWorkers);
+         return false;
+      }
+   }
+   return true;
+}
+
 void
 Proxy::thread()
 {
    InfoLog (<< "Proxy::thread start");
 
+   ThreadIf::tlsSetValue(mContextsKey, &mContexts);
+   if (mNumWorkers > 0 && !workersAllowed())
+   {
+      mNumWorkers = 0;
+   }
+   if (mNumWorkers == 0)
+   {
+      processMessages(*this, mFifo, mContexts);
+      InfoLog (<< "Proxy::thread exit");
+      return;
+   }
+
+   // processors are given their addresses on first use, which must not
+   // happen on several workers at once
+   mRequestProcessorChain.makeReady();
+   mResponseProcessorChain.makeReady();
+   mTargetProcessorChain.makeReady();
+   for (unsigned int i = 0; i < mNumWorkers; ++i)
+   {
+      mWorkers.push_back(new Worker(*this, i));
+      mWorkers.back()->run();
+   }
+   InfoLog (<< "Proxy::thread dispatching to " << mNumWorkers << " workers");
+
    while (!isShutdown())
+   {
+      try
+      {
+         Message* msg = mFifo.getNext(100);
+         if (msg)
+         {
+            mWorkers[getWorker(*msg)]->mFifo.add(msg, TimeLimitFifo<Message>::InternalElement);
+         }
+      }
+      catch (BaseException& e)
+      {
+         ErrLog (<< "Caught: " << e);
+      }
+      catch (...)
+      {
+         ErrLog (<< "Caught unknown exception");
+      }
+   }
+   InfoLog (<< "Proxy::thread exit");
+}
+
+void
+Proxy::processMessages(ThreadIf& thread, TimeLimitFifo<Message>& fifo, RequestContexts& contexts)
+{
+   while (!thread.isShutdown())
    {
       Message* msg=0;
       //DebugLog (<< "TransactionUser::postToTransactionUser " << " &=" << &mFifo << " size=" << mFifo.size());
 
       try
       {
-         if ((msg = mFifo.getNext(100)) != 0)
+         if ((msg = fifo.getNext(100)) != 0)
          {
             DebugLog (<< "Got: " << *msg);
          
@@ -171,6 +288,7 @@ Proxy::thread()
          
             if (sip)
             {
+               sip->traceHop(MessageTrace::TuReceived);
                Data tid(sip->getTransactionId());
                tid.lowercase();
                if (sip->isRequest())
@@ -289,9 +407,9 @@ Proxy::thread()
                   
                   if (sip->method() == CANCEL)
                   {
-                     HashMap<Data,RequestContext*>::iterator i = mServerRequestContexts.find(tid);
+                     HashMap<Data,RequestContext*>::iterator i = contexts.mServerRequestContexts.find(tid);
 
-                     if(i == mServerRequestContexts.end())
+                     if(i == contexts.mServerRequestContexts.end())
                      {
                         SipMessage response;
                         Helper::makeResponse(response,*sip,481);
@@ -329,16 +447,16 @@ Proxy::thread()
                      
                      RequestContext* context=0;
 
-                     HashMap<Data,RequestContext*>::iterator i = mServerRequestContexts.find(tid);
+                     HashMap<Data,RequestContext*>::iterator i = contexts.mServerRequestContexts.find(tid);
                      
                      // .bwc. This might be an ACK/200, or a stray ACK/failure
-                     if(i == mServerRequestContexts.end())
+                     if(i == contexts.mServerRequestContexts.end())
                      {
                         context = mRequestContextFactory->createRequestContext(*this, 
                                                      mRequestProcessorChain, 
                                                      mResponseProcessorChain, 
                                                      mTargetProcessorChain);
-                        mServerRequestContexts[tid] = context;
+                        contexts.mServerRequestContexts[tid] = context;
                      }
                      else // .bwc. ACK/failure
                      {
@@ -365,7 +483,7 @@ Proxy::thread()
                      InfoLog (<< "New RequestContext tid=" << tid << " : " << sip->brief());
                      
 
-                     if(mServerRequestContexts.count(tid) == 0)
+                     if(contexts.mServerRequestContexts.count(tid) == 0)
                      {
                         RequestContext* context = mRequestContextFactory->createRequestContext(*this,
                                                                      mRequestProcessorChain, 
@@ -373,8 +491,8 @@ Proxy::thread()
                                                                      mTargetProcessorChain);
                         InfoLog (<< "Inserting new RequestContext tid=" << tid
                                   << " -> " << *context);
-                        mServerRequestContexts[tid] = context;
-                        //DebugLog (<< "RequestContexts: " << InserterP(mServerRequestContexts));  For a busy proxy - this generates a HUGE log statement!
+                        contexts.mServerRequestContexts[tid] = context;
+                        //DebugLog (<< "RequestContexts: " << InserterP(contexts.mServerRequestContexts));  For a busy proxy - this generates a HUGE log statement!
                         try
                         {
                            context->process(std::auto_ptr<resip::SipMessage>(sip));
@@ -409,8 +527,8 @@ Proxy::thread()
                   InfoLog (<< "Looking up RequestContext tid=" << tid);
                
                   // TODO  is there a problem with a stray 200?
-                  HashMap<Data,RequestContext*>::iterator i = mClientRequestContexts.find(tid);
-                  if (i != mClientRequestContexts.end())
+                  HashMap<Data,RequestContext*>::iterator i = contexts.mClientRequestContexts.find(tid);
+                  if (i != contexts.mClientRequestContexts.end())
                   {
                      try
                      {
@@ -435,9 +553,9 @@ Proxy::thread()
                Data tid(app->getTransactionId());
                tid.lowercase();
                DebugLog(<< "Trying to dispatch : " << *app );
-               HashMap<Data,RequestContext*>::iterator i=mServerRequestContexts.find(tid);
+               HashMap<Data,RequestContext*>::iterator i=contexts.mServerRequestContexts.find(tid);
                // the underlying RequestContext may not exist
-               if (i != mServerRequestContexts.end())
+               if (i != contexts.mServerRequestContexts.end())
                {
                   DebugLog(<< "Sending " << *app << " to " << *(i->second));
                   // This goes in as a Message and not an ApplicationMessage
@@ -456,7 +574,7 @@ Proxy::thread()
                   
                   if (eraseThisTid)
                   {
-                     mServerRequestContexts.erase(i);
+                     contexts.mServerRequestContexts.erase(i);
                   }
                }
                else
@@ -471,8 +589,8 @@ Proxy::thread()
                tid.lowercase();
                if (term->isClientTransaction())
                {
-                  HashMap<Data,RequestContext*>::iterator i=mClientRequestContexts.find(tid);
-                  if (i != mClientRequestContexts.end())
+                  HashMap<Data,RequestContext*>::iterator i=contexts.mClientRequestContexts.find(tid);
+                  if (i != contexts.mClientRequestContexts.end())
                   {
                      try
                      {
@@ -482,7 +600,12 @@ Proxy::thread()
                      {
                         ErrLog(<<"Uncaught exception in process: " << e);
                      }
-                     mClientRequestContexts.erase(i);
+                     contexts.mClientRequestContexts.erase(i);
+                     if (mNumWorkers > 0)
+                     {
+                        Lock lock(mClientWorkersMutex);
+                        mClientWorkers.erase(tid);
+                     }
                   }
                   else
                   {
@@ -491,8 +614,8 @@ Proxy::thread()
                }
                else 
                {
-                  HashMap<Data,RequestContext*>::iterator i=mServerRequestContexts.find(tid);
-                  if (i != mServerRequestContexts.end())
+                  HashMap<Data,RequestContext*>::iterator i=contexts.mServerRequestContexts.find(tid);
+                  if (i != contexts.mServerRequestContexts.end())
                   {
                      try
                      {
@@ -502,7 +625,7 @@ Proxy::thread()
                      {
                         ErrLog(<<"Uncaught exception in process: " << e);
                      }
-                     mServerRequestContexts.erase(i);
+                     contexts.mServerRequestContexts.erase(i);
                   }
                   else
                   {
@@ -522,7 +645,77 @@ Proxy::thread()
          ErrLog (<< "Caught unknown exception");
       }
    }
-   InfoLog (<< "Proxy::thread exit");
+}
+
+unsigned int
+Proxy::getWorker(const Message& msg)
+{
+   const SipMessage* sip = dynamic_cast<const SipMessage*>(&msg);
+   const ApplicationMessage* app = dynamic_cast<const ApplicationMessage*>(&msg);
+   const TransactionTerminated* term = dynamic_cast<const TransactionTerminated*>(&msg);
+
+   Data tid;
+   bool client = false;
+   if (sip)
+   {
+      tid = sip->getTransactionId();
+      tid.lowercase();
+      if (sip->isResponse())
+      {
+         client = true;
+      }
+      else if (sip->method() == ACK && sip->mIsBadAck200)
+      {
+         // the key of the RequestContext, as in processMessages()
+         static Data ack("ack");
+         tid += ack;
+      }
+   }
+   else if (app)
+   {
+      tid = app->getTransactionId();
+      tid.lowercase();
+   }
+   else if (term)
+   {
+      tid = term->getTransactionId();
+      tid.lowercase();
+      client = term->isClientTransaction();
+   }
+
+   if (client)
+   {
+      // a stray goes to any worker, to be dropped there
+      Lock lock(mClientWorkersMutex);
+      HashMap<Data, unsigned int>::const_iterator i = mClientWorkers.find(tid);
+      return i != mClientWorkers.end() ? i->second : 0;
+   }
+   return (unsigned int)(tid.hash() % mWorkers.size());
+}
+
+Proxy::RequestContexts&
+Proxy::getCurrentContexts()
+{
+   RequestContexts* contexts = static_cast<RequestContexts*>(ThreadIf::tlsGetValue(mContextsKey));
+   assert(contexts);
+   return *contexts;
+}
+
+Proxy::Worker::Worker(Proxy& proxy, unsigned int index) :
+   mFifo(0, 0),
+   mContexts(index),
+   mProxy(proxy)
+{
+   mFifo.setDescription("Proxy::Worker::mFifo");
+}
+
+void
+Proxy::Worker::thread()
+{
+   InfoLog (<< "Proxy::Worker " << mContexts.mWorker << " start");
+   ThreadIf::tlsSetValue(mProxy.mContextsKey, &mContexts);
+   mProxy.processMessages(*this, mFifo, mContexts);
+   InfoLog (<< "Proxy::Worker " << mContexts.mWorker << " exit");
 }
 
 void
@@ -534,10 +727,17 @@ Proxy::send(const SipMessage& msg)
 void
 Proxy::addClientTransaction(const Data& transactionId, RequestContext* rc)
 {
-   if(mClientRequestContexts.count(transactionId) == 0)
+   RequestContexts& contexts = getCurrentContexts();
+   if(contexts.mClientRequestContexts.count(transactionId) == 0)
    {
       InfoLog (<< "add client transaction tid=" << transactionId << " " << rc);
-      mClientRequestContexts[transactionId] = rc;
+      contexts.mClientRequestContexts[transactionId] = rc;
+      if (mNumWorkers > 0)
+      {
+         // before the request is sent, so it is there for the responses
+         Lock lock(mClientWorkersMutex);
+         mClientWorkers[transactionId] = contexts.mWorker;
+      }
    }
    else
    {
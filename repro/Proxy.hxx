@@ -3,12 +3,14 @@
 
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "rutil/HashMap.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/ThreadIf.hxx"
+#include "rutil/TimeLimitFifo.hxx"
 #include "rutil/KeyValueStore.hxx"
 #include "repro/AccountingCollector.hxx"
 #include "repro/RequestContext.hxx"
@@ -47,6 +49,22 @@ class RequestContextFactory
       virtual ~RequestContextFactory() {}
 };
 
+/**
+   The proxy core. Its thread takes everything the stack posts to the
+   proxy and runs it through the RequestContexts and their processor chains.
+
+   With NumProxyWorkerThreads set, the RequestContexts are split among that
+   many worker threads instead and the proxy's own thread only dispatches
+   to them: a request, and with it its CANCEL, ACK, timers and other
+   application messages, goes to the worker picked by the hash of its
+   server transaction id, and the responses and terminations of the client
+   transactions a RequestContext creates go to the worker that created
+   them. A RequestContext is therefore only ever touched by one thread; the
+   processors, the RequestContextFactory and the OptionsHandler are shared
+   by all workers (see Processor for what that requires of them). The
+   workers are only used if every processor in the chains is one that has
+   been checked for this; otherwise the proxy stays on its own thread.
+*/
 class Proxy : public resip::TransactionUser, public resip::ThreadIf
 {
    public:
@@ -103,7 +121,8 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       void setServerText(const resip::Data& text) { mServerText = text; }
       const resip::Data& getServerText() const { return mServerText; }
 
-      // Accessor for global extensible state storage for monkeys
+      // Accessor for global extensible state storage for monkeys; shared by
+      // all worker threads, so only to be written before run()
       resip::KeyValueStore& getKeyValueStore() { return mKeyValueStore; }
 
       void doSessionAccounting(const resip::SipMessage& sip, bool received, RequestContext& context);
@@ -113,6 +132,42 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       virtual const resip::Data& name() const;
 
    private:
+      /** a map from transaction id to RequestContext. Store the server
+          transaction and client transactions in this map. The
+          TransactionTerminated events from the stack will be passed to the
+          RequestContext. Each thread that processes messages has its own.
+      */
+      class RequestContexts
+      {
+         public:
+            RequestContexts(unsigned int worker) : mWorker(worker) {}
+
+            const unsigned int mWorker;
+            HashMap<resip::Data, RequestContext*> mClientRequestContexts;
+            HashMap<resip::Data, RequestContext*> mServerRequestContexts;
+      };
+
+      class Worker : public resip::ThreadIf
+      {
+         public:
+            Worker(Proxy& proxy, unsigned int index);
+            virtual void thread();
+
+            resip::TimeLimitFifo<resip::Message> mFifo;
+            RequestContexts mContexts;
+
+         private:
+            Proxy& mProxy;
+      };
+
+      /// Runs the messages from fifo through contexts until thread is shut down.
+      void processMessages(resip::ThreadIf& thread, resip::TimeLimitFifo<resip::Message>& fifo, RequestContexts& contexts);
+      /// Whether every processor of the chains may run on several workers.
+      bool workersAllowed() const;
+      /// The worker that owns the RequestContext msg is for.
+      unsigned int getWorker(const resip::Message& msg);
+      RequestContexts& getCurrentContexts();
+
       resip::SipStack& mStack;
       ProxyConfig& mConfig;
       resip::NameAddr mRecordRoute;
@@ -132,13 +187,16 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       ProcessorChain& mResponseProcessorChain;
       ProcessorChain& mTargetProcessorChain;
       
-      /** a map from transaction id to RequestContext. Store the server
-          transaction and client transactions in this map. The
-          TransactionTerminated events from the stack will be passed to the
-          RequestContext
-      */
-      HashMap<resip::Data, RequestContext*> mClientRequestContexts;
-      HashMap<resip::Data, RequestContext*> mServerRequestContexts;
+      // used when there are no workers
+      RequestContexts mContexts;
+
+      unsigned int mNumWorkers;
+      std::vector<Worker*> mWorkers;
+      // the worker of each client transaction, for dispatching its responses
+      resip::Mutex mClientWorkersMutex;
+      HashMap<resip::Data, unsigned int> mClientWorkers;
+      // RequestContexts of the current thread
+      resip::ThreadIf::TlsKey mContextsKey;
       
       UserStore &mUserStore;
       std::set<resip::Data> mSupportedOptions;
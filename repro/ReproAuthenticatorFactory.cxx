@@ -58,7 +58,8 @@ ReproAuthenticatorFactory::init()
          numAuthGrabberWorkerThreads = 1; // must have at least one thread
       }
       std::auto_ptr<Worker> grabber(new UserAuthGrabber(mProxyConfig.getDataStore()->mUserStore));
-      mAuthRequestDispatcher.reset(new Dispatcher(grabber, &mSipStack, numAuthGrabberWorkerThreads));
+      mAuthRequestDispatcher.reset(new Dispatcher(grabber, &mSipStack, numAuthGrabberWorkerThreads, true, "auth"));
+      mAuthRequestDispatcher->setMaxQueueTime(mProxyConfig.getConfigInt("AuthGrabberMaxQueueTime", 0));
    }
 
    // TODO: should be implemented using AbstractDb
@@ -174,6 +175,7 @@ ReproAuthenticatorFactory::getServerAuthManager()
       {
          mServerAuthManager.reset(new ReproServerAuthManager(*mDum,
                                   getDispatcher(),
+                                  mProxyConfig.getDataStore()->mUserStore,
                                   mProxyConfig.getDataStore()->mAclStore,
                                   !mProxyConfig.getConfigBool("DisableAuthInt", false) /*useAuthInt*/,
                                   mProxyConfig.getConfigBool("RejectBadNonces", false),
@@ -34,10 +34,13 @@
 #include "resip/stack/Compression.hxx"
 #include "resip/stack/EventStackThread.hxx"
 #include "resip/stack/InteropHelper.hxx"
+#include "resip/stack/MessageTrace.hxx"
 #include "resip/stack/ConnectionManager.hxx"
 #include "resip/stack/WsCookieContextFactory.hxx"
+#include "resip/stack/UdpTransport.hxx"
 
 #include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/dum/ShardedRegistrationDatabase.hxx"
 #include "resip/dum/MasterProfile.hxx"
 #include "resip/dum/DialogUsageManager.hxx"
 #include "resip/dum/DumThread.hxx"
@@ -248,6 +251,7 @@ ReproRunner::run(int argc, char** argv)
                    mProxyConfig->getConfigData("LogFilename", "repro.log", true).c_str(),
                    isEqualNoCase(loggingType, "file") ? &g_ReproLogger : 0, // if logging to file then write WARNINGS, and Errors to console still
                    syslogFacilityName);
+   Log::setAsynchronous(mProxyConfig->getConfigUnsignedLong("LogAsyncBufferBytes", 0));
 
    InfoLog( << "Starting repro version " << VersionUtils::instance().releaseVersion() << "...");
 
@@ -672,13 +676,35 @@ ReproRunner::createSipStack()
 
    // Create the SipStack Object
    assert(!mSipStack);
-   mSipStack = new SipStack(security,
-                            dnsServers,
-                            mAsyncProcessHandler,
-                            /*stateless*/false,
-                            /*socketFunc*/0,
-                            compression,
-                            mFdPollGrp);
+   SipStackOptions options;
+   options.mSecurity = security;
+   options.mExtraNameserverList = &dnsServers;
+   options.mAsyncProcessHandler = mAsyncProcessHandler;
+   options.mCompression = compression;
+   options.mPollGrp = mFdPollGrp;
+   // Transaction processing can only be spread across shards when each
+   // shard gets its own thread
+   if(mProxyConfig->getConfigBool("ThreadedStack", true))
+   {
+      options.mTransactionControllerShards = 
+         resipMax(1UL, mProxyConfig->getConfigUnsignedLong("TransactionControllerShards", 1));
+   }
+   options.mLockFreeStateMachineFifo = mProxyConfig->getConfigBool("LockFreeStateMachineFifo", false);
+#ifdef USE_SSL
+   options.mTlsHandshakeThreads = mProxyConfig->getConfigUnsignedLong("TlsHandshakeThreads", 0);
+   options.mTlsSessionCacheSize = mProxyConfig->getConfigUnsignedLong("TlsSessionCacheSize", 0);
+   options.mTlsSessionTickets = mProxyConfig->getConfigBool("TlsSessionTickets", true);
+#endif
+   mSipStack = new SipStack(options);
+
+   mSipStack->getDnsStub().setDnsCacheSize(mProxyConfig->getConfigInt("DNSCacheSize", 512));
+   mSipStack->getDnsStub().setDnsCachePrefetch(mProxyConfig->getConfigInt("DNSCachePrefetchPercent", 10));
+   mSipStack->getDnsStub().setDnsCacheStaleTTL(mProxyConfig->getConfigInt("DNSCacheServeStaleSecs", 0));
+   Data dnsCacheFile = mProxyConfig->getConfigData("DNSCacheFile", Data::Empty, true);
+   if (!dnsCacheFile.empty())
+   {
+      mSipStack->getDnsStub().setDnsCacheSnapshot(dnsCacheFile, mProxyConfig->getConfigInt("DNSCacheSaveInterval", 300));
+   }
 
    // Set any enum suffixes from configuration
    std::vector<Data> enumSuffixes;
@@ -788,6 +814,8 @@ ReproRunner::createSipStack()
    {
       mSipStack->statisticsManagerEnabled() = false;
    }
+   MessageTrace::setSampleRate(mProxyConfig->getConfigInt("MessageTraceSampleRate", 0));
+   MessageTrace::setSlowThresholdMs(mProxyConfig->getConfigInt("MessageTraceSlowMs", 500));
 
    // Create Congestion Manager, if required
    assert(!mCongestionManager);
@@ -837,7 +865,8 @@ ReproRunner::createDatastore()
                        mProxyConfig->getConfigData("MySQLPassword", Data::Empty),
                        mProxyConfig->getConfigData("MySQLDatabaseName", Data::Empty),
                        mProxyConfig->getConfigUnsignedLong("MySQLPort", 0),
-                       mProxyConfig->getConfigData("MySQLCustomUserAuthQuery", Data::Empty));
+                       mProxyConfig->getConfigData("MySQLCustomUserAuthQuery", Data::Empty),
+                       mProxyConfig->getConfigUnsignedLong("MySQLConnectionPoolSize", 4));
    }
    Data runtimeMySQLServer;
    mProxyConfig->getConfigValue("RuntimeMySQLServer", runtimeMySQLServer);
@@ -848,7 +877,8 @@ ReproRunner::createDatastore()
                        mProxyConfig->getConfigData("RuntimeMySQLPassword", Data::Empty),
                        mProxyConfig->getConfigData("RuntimeMySQLDatabaseName", Data::Empty),
                        mProxyConfig->getConfigUnsignedLong("RuntimeMySQLPort", 0),
-                       mProxyConfig->getConfigData("MySQLCustomUserAuthQuery", Data::Empty));
+                       mProxyConfig->getConfigData("MySQLCustomUserAuthQuery", Data::Empty),
+                       mProxyConfig->getConfigUnsignedLong("RuntimeMySQLConnectionPoolSize", 4));
    }
 #endif
    if (!mAbstractDb)
@@ -870,13 +900,37 @@ ReproRunner::createDatastore()
    }
    mProxyConfig->createDataStore(mAbstractDb, mRuntimeAbstractDb);
 
+   // Cache user credentials in front of the (runtime) database
+   int userAuthCacheSize = mProxyConfig->getConfigInt("UserAuthCacheSize", 0);
+   if(userAuthCacheSize > 0)
+   {
+      mProxyConfig->getDataStore()->mUserStore.enableAuthCache(userAuthCacheSize,
+                                                               mProxyConfig->getConfigInt("UserAuthCacheTTL", 300),
+                                                               mProxyConfig->getConfigInt("UserAuthCacheNegativeTTL", 30));
+   }
+
    // Create ImMemory Registration Database
    mRegSyncPort = mProxyConfig->getConfigInt("RegSyncPort", 0);
    // We only need removed records to linger if we have reg sync enabled
    if(!mRestarting)  // If we are restarting then we left the InMemoryRegistrationDb intact at shutdown - don't recreate
    {
       assert(!mRegistrationPersistenceManager);
-      mRegistrationPersistenceManager = new InMemorySyncRegDb(mRegSyncPort ? 86400 /* 24 hours */ : 0 /* removeLingerSecs */);  // !slg! could make linger time a setting
+      unsigned long regDbShards = mProxyConfig->getConfigUnsignedLong("RegistrationDatabaseShards", 0);
+      if(regDbShards && !mRegSyncPort)
+      {
+         mRegistrationPersistenceManager = 
+            new ShardedRegistrationDatabase(false /* checkExpiry */,
+                                            regDbShards,
+                                            mProxyConfig->getConfigUnsignedLong("RegistrationSweepInterval", 60));
+      }
+      else
+      {
+         if(regDbShards)
+         {
+            WarningLog(<< "RegistrationDatabaseShards is ignored when RegSyncPort is set");
+         }
+         mRegistrationPersistenceManager = new InMemorySyncRegDb(mRegSyncPort ? 86400 /* 24 hours */ : 0 /* removeLingerSecs */);  // !slg! could make linger time a setting
+      }
    }
    assert(mRegistrationPersistenceManager);
 
@@ -1020,7 +1074,10 @@ ReproRunner::createProxy()
       assert(!mAsyncProcessorDispatcher);
       mAsyncProcessorDispatcher = new Dispatcher(std::auto_ptr<Worker>(new AsyncProcessorWorker), 
                                                  mSipStack, 
-                                                 numAsyncProcessorWorkerThreads);
+                                                 numAsyncProcessorWorkerThreads,
+                                                 true,
+                                                 "async_processor");
+      mAsyncProcessorDispatcher->setMaxQueueTime(mProxyConfig->getConfigInt("AsyncProcessorMaxQueueTime", 0));
    }
 
    std::vector<Plugin*>::iterator it;
@@ -1440,6 +1497,8 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
          // Transport1TlsClientVerification = None
          // Transport1RecordRouteUri = sip:sipdomain.com;transport=TLS
          // Transport1RcvBufLen = 2000
+         // Transport1ReceiveSockets = 4
+         // Transport1BatchSize = 32
 
          allTransportsSpecifyRecordRoute = true;
 
@@ -1461,6 +1520,8 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
             Data tlsConnectionMethodKey(settingKeyBase + "TlsConnectionMethod");
             Data recordRouteUriSettingKey(settingKeyBase + "RecordRouteUri");
             Data rcvBufSettingKey(settingKeyBase + "RcvBufLen");
+            Data receiveSocketsSettingKey(settingKeyBase + "ReceiveSockets");
+            Data batchSizeSettingKey(settingKeyBase + "BatchSize");
 
             // Parse out interface settings
             ParseBuffer pb(interfaceSettings);
@@ -1532,6 +1593,28 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                }
 #endif
 
+               unsigned long receiveSockets = mProxyConfig->getConfigUnsignedLong(receiveSocketsSettingKey, 1);
+               if(receiveSockets > 1 && tt != UDP)
+               {
+                  CritLog(<< receiveSocketsSettingKey << " is only supported for UDP transports, ignoring");
+                  receiveSockets = 1;
+               }
+               unsigned long batchSize = mProxyConfig->getConfigUnsignedLong(batchSizeSettingKey, 0);
+               if(batchSize > 0 && tt != UDP)
+               {
+                  CritLog(<< batchSizeSettingKey << " is only supported for UDP transports, ignoring");
+                  batchSize = 0;
+               }
+               unsigned transportFlags = 0;
+               if(receiveSockets > 1)
+               {
+                  transportFlags |= RESIP_TRANSPORT_FLAG_REUSEPORT;
+               }
+               if(batchSize > 0)
+               {
+                  transportFlags |= RESIP_TRANSPORT_FLAG_BATCHIO;
+               }
+
                Transport *t = mSipStack->addTransport(tt,
                                  port,
                                  DnsUtil::isIpV6Address(ipAddr) ? V6 : V4,
@@ -1540,7 +1623,7 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                                  tlsDomain,
                                  tlsPrivateKeyPassPhrase,  // private key passphrase
                                  sslType, // sslType
-                                 0,            // transport flags
+                                 transportFlags, // transport flags
                                  tlsCertificate, tlsPrivateKey,
                                  cvm,          // tls client verification mode
                                  useEmailAsSIP,
@@ -1548,6 +1631,16 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
 
                if (t)
                {
+                  // must come before the receive sockets, which copy it
+                  if (batchSize > 0)
+                  {
+                     dynamic_cast<UdpTransport*>(t)->setBatchSize(batchSize);
+                  }
+                  if (receiveSockets > 1)
+                  {
+                     dynamic_cast<UdpTransport*>(t)->addReceiveSockets(receiveSockets-1);
+                  }
+
                   int rcvBufLen = mProxyConfig->getConfigInt(rcvBufSettingKey, 0);
                   if (rcvBufLen >0 )
                   {
@@ -15,6 +15,7 @@ using namespace repro;
 
 ReproServerAuthManager::ReproServerAuthManager(DialogUsageManager& dum,
                                                Dispatcher* authRequestDispatcher,
+                                               UserStore& userStore,
                                                AclStore& aclDb,
                                                bool useAuthInt,
                                                bool rejectBadNonces,
@@ -23,6 +24,7 @@ ReproServerAuthManager::ReproServerAuthManager(DialogUsageManager& dum,
    ServerAuthManager(dum, dum.dumIncomingTarget(), challengeThirdParties, staticRealm),
    mDum(dum),
    mAuthRequestDispatcher(authRequestDispatcher),
+   mUserStore(userStore),
    mAclDb(aclDb),
    mUseAuthInt(useAuthInt),
    mRejectBadNonces(rejectBadNonces)
@@ -66,6 +68,20 @@ ReproServerAuthManager::requestCredential(const Data& user,
                                           const Auth& auth,
                                           const Data& transactionId )
 {
+   // Credentials in the UserStore's auth cache are handed straight back to
+   // DUM, without waiting for an auth grabber thread
+   Data a1;
+   if(mUserStore.getCachedUserAuthInfo(user, realm, a1))
+   {
+      UserAuthInfo* cached = new UserAuthInfo(user, realm, a1, transactionId);
+      if(a1.empty())
+      {
+         cached->setMode(UserAuthInfo::UserUnknown);
+      }
+      mDum.post(cached);
+      return;
+   }
+
    // Build a UserAuthInfo object and pass to UserAuthGrabber to have a1 password filled in
    UserAuthInfo* async = new UserAuthInfo(user,realm,transactionId,&mDum);
    std::auto_ptr<ApplicationMessage> app(async);
@@ -18,12 +18,14 @@ class DialogUsageManager;
 namespace repro
 {
 class AclStore;
+class UserStore;
 
 class ReproServerAuthManager: public resip::ServerAuthManager
 {
    public:
       ReproServerAuthManager(resip::DialogUsageManager& dum, 
                              Dispatcher* authRequestDispatcher,
+                             UserStore& userStore,
                              AclStore& aclDb,
                              bool useAuthInt,
                              bool rejectBadNonces,
@@ -47,6 +49,7 @@ class ReproServerAuthManager: public resip::ServerAuthManager
    private:
       resip::DialogUsageManager& mDum;
       Dispatcher* mAuthRequestDispatcher;
+      UserStore& mUserStore;
       AclStore&  mAclDb;
       bool mUseAuthInt;
       bool mRejectBadNonces;
@@ -917,6 +917,7 @@ RequestContext::postAck200Done()
 void
 RequestContext::send(SipMessage& msg)
 {
+   msg.traceHop(MessageTrace::Processed);
    mProxy.send(msg);
 }
 
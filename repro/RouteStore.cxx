@@ -30,49 +30,59 @@ RouteStore::RouteStore(AbstractDb& db):
       RouteOp route;
       route.routeRecord =  mDb.getRoute(key);
       route.key = key;
-      route.preq = 0;
-      
-      if(!route.routeRecord.mMatchingPattern.empty())
-      {
-         int flags = REG_EXTENDED;
-         if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
-         {
-            flags |= REG_NOSUB;
-         }
-         route.preq = new regex_t;
-         int ret = regcomp(route.preq, route.routeRecord.mMatchingPattern.c_str(), flags);
-         if(ret != 0)
-         {
-            delete route.preq;
-            ErrLog(<< "Routing rule has invalid match expression: "
-                   << route.routeRecord.mMatchingPattern);
-            route.preq = 0;
-         }
-      }
+      compile(route);
 
       mRouteOperators.insert( route );
 
       key = mDb.nextRouteKey();
    } 
    mCursor = mRouteOperators.begin();
+   publishTable();
 }
 
 
 RouteStore::~RouteStore()
 {
-   for(RouteOpList::iterator i = mRouteOperators.begin(); i != mRouteOperators.end(); i++)
+   mRouteOperators.clear();
+}
+
+
+void
+RouteStore::compile(RouteOp& route)
+{
+   if(!route.routeRecord.mMatchingPattern.empty())
    {
-      if ( i->preq )
+      int flags = REG_EXTENDED;
+      if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
+      {
+         flags |= REG_NOSUB;
+      }
+      route.preq.reset(new CompiledPattern(route.routeRecord.mMatchingPattern, flags));
+      if(!route.preq->isValid())
       {
-         regfree ( i->preq );
-         delete i->preq;
+         ErrLog(<< "Routing rule has invalid match expression: "
+                << route.routeRecord.mMatchingPattern);
+         route.preq.reset();
+      }
+   }
+}
 
-         // !abr! Can't modify elements in a set
-         // i->preq = 0;
 
+void
+RouteStore::publishTable()
+{
+   RouteTable* table = new RouteTable;
+   table->mRoutes.reserve(mRouteOperators.size());
+   for(RouteOpList::const_iterator it = mRouteOperators.begin(); it != mRouteOperators.end(); it++)
+   {
+      // routes without a (valid) pattern never match
+      if(it->preq.get())
+      {
+         table->mIndex.add(it->preq->getPrefix(), (unsigned int)table->mRoutes.size());
+         table->mRoutes.push_back(*it);
       }
    }
-   mRouteOperators.clear();
+   mTable.publish(table);
 }
 
       
@@ -103,28 +113,14 @@ RouteStore::addRoute(const resip::Data& method,
    }
 
    route.key = key;
-   route.preq = 0;
-   if( !route.routeRecord.mMatchingPattern.empty() )
-   {
-     int flags = REG_EXTENDED;
-     if( route.routeRecord.mRewriteExpression.find("$") == Data::npos )
-     {
-       flags |= REG_NOSUB;
-     }
-     route.preq = new regex_t;
-     int ret = regcomp( route.preq, route.routeRecord.mMatchingPattern.c_str(), flags );
-     if( ret != 0 )
-     {
-       delete route.preq;
-       route.preq = 0;
-     }
-   }
+   compile(route);
 
    {
       WriteLock lock(mMutex);
       mRouteOperators.insert( route );
+      mCursor = mRouteOperators.begin(); 
+      publishTable();
    }
-   mCursor = mRouteOperators.begin(); 
 
    return true;
 }
@@ -172,15 +168,6 @@ RouteStore::eraseRoute(const resip::Data& key )
          {
             RouteOpList::iterator i = it;
             it++;
-            if ( i->preq )
-            {
-               regfree ( i->preq );
-               delete i->preq;
-
-               // !abr! Can't modify elements in a set
-               //i->preq = 0;
-
-            }
             mRouteOperators.erase(i);
          }
          else
@@ -188,8 +175,9 @@ RouteStore::eraseRoute(const resip::Data& key )
             it++;
          }
       }
+      mCursor = mRouteOperators.begin();  // reset the cursor since it may have been on deleted route
+      publishTable();
    }
-   mCursor = mRouteOperators.begin();  // reset the cursor since it may have been on deleted route
 }
 
 
@@ -285,19 +273,25 @@ RouteStore::process(const resip::Uri& ruri,
                     const resip::Data& event )
 {
    RouteStore::UriList targetSet;
-   if(mRouteOperators.empty()) return targetSet;  // If there are no routes bail early to save a few cycles (size check is atomic enough, we don't need a lock)
+   SnapshotPtr<RouteTable>::Reader table(mTable);
+   if(table->mRoutes.empty()) return targetSet;  // If there are no routes bail early to save a few cycles
 
-   ReadLock lock(mMutex);
+   Data uri(Data::from(ruri));
 
-   for (RouteOpList::iterator it = mRouteOperators.begin();
-        it != mRouteOperators.end(); it++)
+   // Only routes whose pattern can match this URI, in route order
+   std::vector<unsigned int> candidates;
+   table->mIndex.find(uri, candidates);
+
+   for (std::vector<unsigned int>::const_iterator it = candidates.begin();
+        it != candidates.end(); it++)
    {
+      const RouteOp& route = table->mRoutes[*it];
       DebugLog( << "Consider route " // << *it
                 << " reqUri=" << ruri
                 << " method=" << method 
                 << " event=" << event );
 
-      const AbstractDb::RouteRecord& rec = it->routeRecord;
+      const AbstractDb::RouteRecord& rec = route.routeRecord;
       
       if(!rec.mMethod.empty())
       {
@@ -318,23 +312,11 @@ RouteStore::process(const resip::Uri& ruri,
       }
       const Data& rewrite = rec.mRewriteExpression;
       const Data& match = rec.mMatchingPattern;
-      if ( it->preq ) 
       {
-         int ret;
-         // TODO - !cj! www.pcre.org looks like it has better performance
-         // !mbg! is this true now that the compiled regexp is used?
-         Data uri;
-         {
-            DataStream s(uri);
-            s << ruri;
-            s.flush();
-         }
-         
          const int nmatch=10;
          regmatch_t pmatch[nmatch];
          
-         ret = regexec(it->preq, uri.c_str(), nmatch, pmatch, 0/*eflags*/);
-         if ( ret != 0 )
+         if ( !route.preq->match(uri, nmatch, pmatch) )
          {
             // did not match 
             DebugLog( << "  Skipped - request URI "<< uri << " did not match " << match );
@@ -1,19 +1,17 @@
 #if !defined(REPRO_ROUTESTORE_HXX)
 #define REPRO_ROUTESTORE_HXX
 
-#ifdef WIN32
-#include <pcreposix.h>
-#else
-#include <regex.h>
-#endif
-
 #include <set>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
+#include "rutil/SharedPtr.hxx"
+#include "rutil/SnapshotPtr.hxx"
 #include "resip/stack/Uri.hxx"
 
 #include "repro/AbstractDb.hxx"
+#include "repro/CompiledPattern.hxx"
 
 
 namespace repro
@@ -69,15 +67,29 @@ class RouteStore
       {
          public:
             Key key;
-            regex_t *preq;
+            resip::SharedPtr<CompiledPattern> preq;  // null if no or an invalid pattern
             AbstractDb::RouteRecord routeRecord;
             bool operator<(const RouteOp&) const;
       };
       
+      void compile(RouteOp& route);
+
       resip::RWMutex mMutex;
       typedef std::multiset<RouteOp> RouteOpList;
       RouteOpList mRouteOperators; 
       RouteOpList::iterator mCursor;
+
+      // What process() works on, without locking: the routes with a pattern
+      // in order, indexed by the literal prefixes of their patterns.
+      // Rebuilt from mRouteOperators on every change.
+      class RouteTable
+      {
+         public:
+            std::vector<RouteOp> mRoutes;
+            PrefixIndex mIndex;
+      };
+      void publishTable(); // with mMutex held for writing
+      resip::SnapshotPtr<RouteTable> mTable;
 };
 
  }
@@ -0,0 +1,182 @@
+#include <cassert>
+
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+#include "repro/UserAuthCache.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+UserAuthCache::UserAuthCache(unsigned int maxEntries, unsigned int ttl, unsigned int negativeTtl) :
+   mMaxPerShard(maxEntries > Shards ? (maxEntries + Shards - 1) / Shards : 1),
+   mTtl(ttl),
+   mNegativeTtl(negativeTtl)
+{
+   unsigned int id = mStatistics.addCounter("hits", "Credential lookups answered from the user auth cache");
+   assert(id == Hits);
+   id = mStatistics.addCounter("misses", "Credentials read from the database into the user auth cache");
+   assert(id == Misses);
+   (void)id;
+
+   InfoLog(<< "Caching up to " << mMaxPerShard * Shards << " user credentials for " << mTtl
+           << "s, unknown users for " << mNegativeTtl << "s");
+}
+
+UserAuthCache::~UserAuthCache()
+{
+}
+
+bool
+UserAuthCache::lookup(const Data& key, Data& a1)
+{
+   Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+   if (i == s.mIndex.end())
+   {
+      return false;
+   }
+   if (i->second->mExpires <= Timer::getTimeSecs())
+   {
+      s.mEntries.erase(i->second);
+      s.mIndex.erase(i);
+      return false;
+   }
+   s.mEntries.splice(s.mEntries.begin(), s.mEntries, i->second);
+   a1 = i->second->mA1;
+   mStatistics.increment(Hits);
+   return true;
+}
+
+unsigned int
+UserAuthCache::generation(const Data& key) const
+{
+   const Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   return s.mGeneration;
+}
+
+void
+UserAuthCache::add(const Data& key, const Data& a1, unsigned int generation)
+{
+   mStatistics.increment(Misses);
+   unsigned int ttl = a1.empty() ? mNegativeTtl : mTtl;
+   if (ttl == 0)
+   {
+      return;
+   }
+
+   Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   if (s.mGeneration != generation)
+   {
+      DebugLog(<< "Not caching credentials for " << key << ": invalidated while they were read");
+      return;
+   }
+
+   map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+   if (i != s.mIndex.end())
+   {
+      s.mEntries.erase(i->second);
+   }
+   Entry entry;
+   entry.mKey = key;
+   entry.mA1 = a1;
+   entry.mExpires = Timer::getTimeSecs() + ttl;
+   s.mEntries.push_front(entry);
+   s.mIndex[key] = s.mEntries.begin();
+
+   while (s.mEntries.size() > mMaxPerShard)
+   {
+      s.mIndex.erase(s.mEntries.back().mKey);
+      s.mEntries.pop_back();
+   }
+}
+
+void
+UserAuthCache::invalidate(const Data& key)
+{
+   Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   ++s.mGeneration;
+   map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+   if (i != s.mIndex.end())
+   {
+      s.mEntries.erase(i->second);
+      s.mIndex.erase(i);
+   }
+}
+
+void
+UserAuthCache::clear()
+{
+   for (unsigned int i = 0; i < Shards; ++i)
+   {
+      Lock lock(mShards[i].mMutex);
+      ++mShards[i].mGeneration;
+      mShards[i].mEntries.clear();
+      mShards[i].mIndex.clear();
+   }
+}
+
+size_t
+UserAuthCache::size() const
+{
+   size_t n = 0;
+   for (unsigned int i = 0; i < Shards; ++i)
+   {
+      Lock lock(mShards[i].mMutex);
+      n += mShards[i].mIndex.size();
+   }
+   return n;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
@@ -0,0 +1,145 @@
+#if !defined(REPRO_USERAUTHCACHE_HXX)
+#define REPRO_USERAUTHCACHE_HXX
+
+#include <list>
+#include <map>
+
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadStatistics.hxx"
+#include "rutil/compat.hxx"
+
+namespace repro
+{
+
+/**
+   A bounded in-memory cache of digest A1 hashes, keyed like the UserStore
+   (user@realm), that sits in front of the database so that repeated
+   authentications of the same user (re-REGISTERs, mostly) need no
+   database round trip.
+
+   Users the database does not know are cached too, with an empty A1 and
+   their own (usually shorter) lifetime, so that a misconfigured or hostile
+   client cannot make every request reach the database either.
+
+   The cache is split into shards by key hash, each with its own lock, LRU
+   list and share of the capacity. Every shard keeps a generation that
+   invalidate() and clear() bump: a reader takes the generation before it
+   queries the database and hands it to add(), which then ignores the
+   answer if the entry was invalidated in between, so a lookup racing a
+   user edit cannot put the old hash back.
+*/
+class UserAuthCache
+{
+   public:
+      /**
+         @param maxEntries  The most entries kept, positive and negative.
+         @param ttl         How long, in seconds, a retrieved A1 is kept.
+         @param negativeTtl How long, in seconds, an unknown user is kept;
+                            0 disables negative caching.
+      */
+      UserAuthCache(unsigned int maxEntries, unsigned int ttl, unsigned int negativeTtl);
+      ~UserAuthCache();
+
+      /// true if key is cached; a1 is then empty for unknown users
+      bool lookup(const resip::Data& key, resip::Data& a1);
+
+      /// the generation to pass to add() for a database read about to start
+      unsigned int generation(const resip::Data& key) const;
+      void add(const resip::Data& key, const resip::Data& a1, unsigned int generation);
+
+      void invalidate(const resip::Data& key);
+      void clear();
+
+      size_t size() const;
+      /// lookups answered from the cache
+      UInt64 getHits() const { return mStatistics.getCounter(Hits); }
+      /// answers read from the database, i.e. calls to add()
+      UInt64 getMisses() const { return mStatistics.getCounter(Misses); }
+
+   private:
+      enum { Shards = 16 };
+
+      struct Entry
+      {
+         resip::Data mKey;
+         resip::Data mA1;
+         UInt64 mExpires;   // seconds
+      };
+      typedef std::list<Entry> Entries;
+
+      struct Shard
+      {
+         Shard() : mGeneration(0) {}
+         mutable resip::Mutex mMutex;
+         Entries mEntries;                                  // most recently used first
+         std::map<resip::Data, Entries::iterator> mIndex;
+         unsigned int mGeneration;
+      };
+
+      Shard& shard(const resip::Data& key) { return mShards[key.hash() % Shards]; }
+      const Shard& shard(const resip::Data& key) const { return mShards[key.hash() % Shards]; }
+
+      const size_t mMaxPerShard;
+      const unsigned int mTtl;
+      const unsigned int mNegativeTtl;
+      Shard mShards[Shards];
+
+      enum
+      {
+         Hits,
+         Misses
+      };
+      resip::ThreadStatistics mStatistics;
+
+      // disabled
+      UserAuthCache(const UserAuthCache&);
+      UserAuthCache& operator=(const UserAuthCache&);
+};
+
+}
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
@@ -30,7 +30,7 @@ class UserAuthGrabber : public Worker
          if(uinf)
          {
             uinf->mRec.passwordHash = mUserStore.getUserAuthInfo(uinf->user(), uinf->realm());
-            uinf->setMode(resip::UserAuthInfo::RetrievedA1);
+            uinf->setMode(uinf->A1().empty() ? resip::UserAuthInfo::UserUnknown : resip::UserAuthInfo::RetrievedA1);
             DebugLog(<<"Grabbed user info for " 
                            << uinf->user() <<"@"<<uinf->realm()
                            << " : " << uinf->A1());
@@ -55,6 +55,25 @@ class UserAuthGrabber : public Worker
          return false;
       }
       
+      // the request is answered as if the database had failed
+      virtual bool expired(resip::ApplicationMessage* msg)
+      {
+         repro::UserInfoMessage* uinf = dynamic_cast<UserInfoMessage*>(msg);
+         resip::UserAuthInfo* uainf = dynamic_cast<resip::UserAuthInfo*>(msg);
+         if(uinf)
+         {
+            uinf->setMode(resip::UserAuthInfo::Error);
+            return true;
+         }
+         else if(uainf)
+         {
+            uainf->setMode(resip::UserAuthInfo::Error);
+            return true;
+         }
+         WarningLog(<<"Did not recognize message type...");
+         return false;
+      }
+
       virtual UserAuthGrabber* clone() const
       {
          return new UserAuthGrabber(mUserStore);
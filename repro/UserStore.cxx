@@ -40,7 +40,54 @@ UserStore::getUserAuthInfo(  const resip::Data& user,
                              const resip::Data& realm ) const
 {
    Key key =  buildKey(user, realm);
-   return mDb.getUserAuthInfo( key );
+   if (!mAuthCache.get())
+   {
+      return mDb.getUserAuthInfo( key );
+   }
+
+   Data a1;
+   if (mAuthCache->lookup(key, a1))
+   {
+      return a1;
+   }
+   unsigned int generation = mAuthCache->generation(key);
+   a1 = mDb.getUserAuthInfo( key );
+   mAuthCache->add(key, a1, generation);
+   return a1;
+}
+
+void
+UserStore::enableAuthCache( unsigned int maxEntries,
+                            unsigned int ttl,
+                            unsigned int negativeTtl )
+{
+   mAuthCache.reset(new UserAuthCache(maxEntries, ttl, negativeTtl));
+}
+
+bool
+UserStore::getCachedUserAuthInfo( const resip::Data& user,
+                                  const resip::Data& realm,
+                                  resip::Data& a1 ) const
+{
+   return mAuthCache.get() && mAuthCache->lookup(buildKey(user, realm), a1);
+}
+
+void
+UserStore::clearAuthCache()
+{
+   if (mAuthCache.get())
+   {
+      mAuthCache->clear();
+   }
+}
+
+void
+UserStore::invalidateAuthCache( const Key& key )
+{
+   if (mAuthCache.get())
+   {
+      mAuthCache->invalidate(key);
+   }
 }
 
 bool 
@@ -89,13 +136,32 @@ UserStore::addUser( const Data& username,
    rec.email = emailAddress;
    rec.forwardAddress = Data::Empty;
 
-   return mDb.addUser( buildKey(username,domain), rec);
+   bool ret = mDb.addUser( buildKey(username,domain), rec);
+
+   // Invalidate after the write, so that a lookup which read the old record
+   // cannot cache it.  The credentials are looked up by user@realm, the
+   // record is stored under user@domain; they are usually the same.
+   invalidateAuthCache(buildKey(username, realm));
+   invalidateAuthCache(buildKey(username, domain));
+   return ret;
 }
 
 void 
 UserStore::eraseUser( const Key& key )
 { 
+   if (!mAuthCache.get())
+   {
+      mDb.eraseUser( key );
+      return;
+   }
+
+   AbstractDb::UserRecord rec = mDb.getUser(key);
    mDb.eraseUser( key );
+   if (!rec.user.empty())
+   {
+      mAuthCache->invalidate(buildKey(rec.user, rec.realm));
+   }
+   mAuthCache->invalidate(key);
 }
 
 bool
@@ -110,12 +176,24 @@ UserStore::updateUser( const Key& originalKey,
                        const resip::Data& passwordHashAlt)
 {
    Key newkey = buildKey(user, domain);
+
+   // The credentials were cached under the old record's user@realm, which
+   // the write below may overwrite, so read it first.
+   AbstractDb::UserRecord old;
+   if (mAuthCache.get())
+   {
+      old = mDb.getUser(originalKey);
+   }
    
    bool ret = addUser(user, domain, realm, password, applyA1HashToPassword, fullName, emailAddress, passwordHashAlt);
    if ( newkey != originalKey )
    {
       eraseUser(originalKey);
    }
+   if (!old.user.empty())
+   {
+      invalidateAuthCache(buildKey(old.user, old.realm));
+   }
    return ret;
 }
 
@@ -6,6 +6,9 @@
 #include "resip/stack/Message.hxx"
 
 #include "repro/AbstractDb.hxx"
+#include "repro/UserAuthCache.hxx"
+
+#include <memory>
 
 namespace resip
 {
@@ -30,6 +33,27 @@ class UserStore
 
       resip::Data getUserAuthInfo( const resip::Data& user,
                                    const resip::Data& realm ) const;
+
+      /** Puts a UserAuthCache in front of getUserAuthInfo(); edits made
+          through this UserStore invalidate it.  Call before the store is
+          used by other threads. */
+      void enableAuthCache( unsigned int maxEntries,
+                            unsigned int ttl,
+                            unsigned int negativeTtl );
+
+      /** Answers from the auth cache only, never the database, so it may be
+          called on threads that must not block.  Returns true if the user
+          is cached; a1 is then empty if the user is known not to exist. */
+      bool getCachedUserAuthInfo( const resip::Data& user,
+                                  const resip::Data& realm,
+                                  resip::Data& a1 ) const;
+
+      /** Drops all cached credentials, for instance after the user table
+          was changed behind repro's back. */
+      void clearAuthCache();
+
+      /// 0 if the auth cache is not enabled
+      const UserAuthCache* getAuthCache() const { return mAuthCache.get(); }
       
       bool addUser( const resip::Data& user, 
                     const resip::Data& domain, 
@@ -58,8 +82,10 @@ class UserStore
       static Key buildKey(const resip::Data& user, const resip::Data& domain);
 
    private:
+      void invalidateAuthCache( const Key& key );
 
       AbstractDb& mDb;
+      std::auto_ptr<UserAuthCache> mAuthCache;
 };
 
  }
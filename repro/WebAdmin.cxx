@@ -12,6 +12,7 @@
 #include "resip/stack/Symbols.hxx"
 #include "resip/stack/Tuple.hxx"
 #include "resip/stack/SipStack.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Logger.hxx"
@@ -22,6 +23,7 @@
 #include "rutil/TransportType.hxx"
 
 #include "repro/ReproVersion.hxx"
+#include "repro/Dispatcher.hxx"
 #include "repro/Proxy.hxx"
 #include "repro/HttpBase.hxx"
 #include "repro/HttpConnection.hxx"
@@ -213,6 +215,7 @@ WebAdmin::buildPage( const Data& uri,
    // if this is not a valid page, redirect it
    if (
       ( pageName != Data("index.html") ) && 
+      ( pageName != Data("metrics") ) && 
       ( pageName != Data("input") ) && 
       ( pageName != Data("cert.cer") ) && 
       ( ! pageName.prefix("cert") ) && 
@@ -245,6 +248,39 @@ WebAdmin::buildPage( const Data& uri,
       return;
    }
 
+   // counters and latency histograms for Prometheus to scrape; reading
+   // them takes no lock the stack's threads could contend on
+   if ( pageName == Data("metrics") )
+   {
+      Data metrics;
+      {
+         DataStream s(metrics);
+         StackStatistics::encodePrometheus(s);
+         Dispatcher::encodePrometheus(s);
+         const UserAuthCache* authCache = mStore.mUserStore.getAuthCache();
+         if (authCache)
+         {
+            s << "# HELP repro_user_auth_cache_hits_total Credential lookups answered from the user auth cache\n"
+              << "# TYPE repro_user_auth_cache_hits_total counter\n"
+              << "repro_user_auth_cache_hits_total " << authCache->getHits() << "\n"
+              << "# HELP repro_user_auth_cache_misses_total Credentials read from the database into the user auth cache\n"
+              << "# TYPE repro_user_auth_cache_misses_total counter\n"
+              << "repro_user_auth_cache_misses_total " << authCache->getMisses() << "\n"
+              << "# HELP repro_user_auth_cache_entries Credentials in the user auth cache\n"
+              << "# TYPE repro_user_auth_cache_entries gauge\n"
+              << "repro_user_auth_cache_entries " << authCache->size() << "\n";
+         }
+         s << "# HELP resip_log_lines_dropped_total Log lines dropped because an asynchronous log buffer was full\n"
+           << "# TYPE resip_log_lines_dropped_total counter\n"
+           << "resip_log_lines_dropped_total " << Log::getDroppedLines() << "\n";
+         s << "# HELP resip_tls_handshake_queue_depth TLS handshake steps waiting for a handshake thread\n"
+           << "# TYPE resip_tls_handshake_queue_depth gauge\n"
+           << "resip_tls_handshake_queue_depth " << mProxy.getStack().getTlsHandshakeQueueDepth() << "\n";
+      }
+      setPage( metrics, pageNumber, 200, Mime("text","plain") );
+      return;
+   }
+
    // certificate pages 
    if ( pageName.prefix("cert") || pageName == Data("cert.cer") )
    {
@@ -18,6 +18,11 @@ class Worker
       
       // return true to queue to stack when complete, false when no response is required
       virtual bool process(resip::ApplicationMessage* msg)=0;
+
+      // called instead of process() for a message that waited past its
+      // Dispatcher deadline; mark it as failed and return true to queue it
+      // to the stack, so that its originator can answer, or false to drop it
+      virtual bool expired(resip::ApplicationMessage* msg) { return false; }
       virtual Worker* clone() const=0;
 };
 }
@@ -1,4 +1,5 @@
 #include "repro/WorkerThread.hxx"
+#include "repro/Dispatcher.hxx"
 
 #include "resip/stack/SipStack.hxx"
 #include "resip/stack/ApplicationMessage.hxx"
@@ -10,10 +11,12 @@ namespace repro
 {
 
 WorkerThread::WorkerThread(Worker* worker,
-                        resip::TimeLimitFifo<resip::ApplicationMessage>& fifo,
+                        Dispatcher& dispatcher,
+                        unsigned int index,
                         resip::SipStack* stack):
    mWorker(worker),
-   mFifo(fifo),
+   mDispatcher(dispatcher),
+   mIndex(index),
    mStack(stack)
 {}
 
@@ -28,15 +31,16 @@ void
 WorkerThread::thread()
 {
    resip::ApplicationMessage* msg;
+   bool expired = false;
    bool queueToStack;
    if(mWorker && !isShutdown())
    {
       mWorker->onStart();
       while(mWorker && !isShutdown())
       {
-         if( (msg=mFifo.getNext(100)) != 0 )
+         if( (msg=mDispatcher.getNext(mIndex, 100, expired)) != 0 )
          {
-            queueToStack = mWorker->process(msg);
+            queueToStack = expired ? mWorker->expired(msg) : mWorker->process(msg);
 
             if(queueToStack && mStack)
             {
@@ -3,7 +3,6 @@
 
 #include "rutil/ThreadIf.hxx"
 #include "repro/Worker.hxx"
-#include "rutil/TimeLimitFifo.hxx"
 #include "resip/stack/ApplicationMessage.hxx"
 
 namespace resip
@@ -13,18 +12,21 @@ class SipStack;
 
 namespace repro
 {
+class Dispatcher;
 
 class WorkerThread : public resip::ThreadIf
 {
 
    public:
-      WorkerThread(Worker* impl,resip::TimeLimitFifo<resip::ApplicationMessage>& fifo,resip::SipStack* stack);
+      WorkerThread(Worker* impl,Dispatcher& dispatcher,unsigned int index,resip::SipStack* stack);
       virtual ~WorkerThread();
       void thread();
       
    protected:
       Worker* mWorker;
-      resip::TimeLimitFifo<resip::ApplicationMessage>& mFifo;
+      Dispatcher& mDispatcher;
+      // which of mDispatcher's queues is this thread's own
+      const unsigned int mIndex;
       resip::SipStack* mStack;
 
 };
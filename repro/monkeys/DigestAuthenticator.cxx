@@ -32,6 +32,7 @@ DigestAuthenticator::DigestAuthenticator(ProxyConfig& config,
                                          const Data& staticRealm) :
    Processor("DigestAuthenticator"),
    mAuthRequestDispatcher(authRequestDispatcher),
+   mUserStore(config.getDataStore() ? &config.getDataStore()->mUserStore : 0),
    mStaticRealm(staticRealm),
    mNoIdentityHeaders(config.getConfigBool("DisableIdentity", false)),
    mHttpHostname(config.getConfigData("HttpHostname", "")),
@@ -106,204 +107,214 @@ DigestAuthenticator::process(repro::RequestContext &rc)
    }
    else if (userInfo)
    {
-      // Handle response from user authentication database
-      sipMessage = &rc.getOriginalRequest();
-      const Data& realm = userInfo->realm();
-      const Data& user = userInfo->user();
-      InfoLog (<< "Received user auth info for " << user << " at realm " << realm);
-      Helper::AuthResult authResult = Helper::Failed;
-      switch(userInfo->getMode())
-      {
-         case UserAuthInfo::UserUnknown:
-            authResult = Helper::Failed;
-            break;
+      return processUserInfo(rc, userInfo);
+   }
 
-         case UserAuthInfo::RetrievedA1:
-            {
-               const Data& a1 = userInfo->A1();
-               StackLog (<< "Received user auth info for " << user << " at realm " << realm 
-                         <<  " a1 is " << a1);
+   return Continue;
+}
 
-               pair<Helper::AuthResult,Data> result =
-                  Helper::advancedAuthenticateRequest(*sipMessage, realm, a1, 3000); // was 15
-               authResult = result.first;
-            }
-            break;
+repro::Processor::processor_action_t
+DigestAuthenticator::processUserInfo(repro::RequestContext &rc, UserInfoMessage *userInfo)
+{
+   // Handle response from user authentication database
+   SipMessage *sipMessage = &rc.getOriginalRequest();
+   const Data& realm = userInfo->realm();
+   const Data& user = userInfo->user();
+   InfoLog (<< "Received user auth info for " << user << " at realm " << realm);
+   Helper::AuthResult authResult = Helper::Failed;
+   switch(userInfo->getMode())
+   {
+      case UserAuthInfo::UserUnknown:
+         authResult = Helper::Failed;
+         break;
 
-         case UserAuthInfo::Stale:
-            authResult = Helper::Expired;
-            break;
+      case UserAuthInfo::RetrievedA1:
+         {
+            const Data& a1 = userInfo->A1();
+            StackLog (<< "Received user auth info for " << user << " at realm " << realm 
+                      <<  " a1 is " << a1);
 
-         case UserAuthInfo::DigestAccepted:
-            authResult = Helper::Authenticated;
-            break;
+            pair<Helper::AuthResult,Data> result =
+               Helper::advancedAuthenticateRequest(*sipMessage, realm, a1, 3000); // was 15
+            authResult = result.first;
+         }
+         break;
 
-         case UserAuthInfo::DigestNotAccepted:
-            authResult = Helper::Failed;
-            break;
+      case UserAuthInfo::Stale:
+         authResult = Helper::Expired;
+         break;
 
-         case UserAuthInfo::Error:
-            authResult = Helper::Failed;
-            WarningLog(<<"UserInfoMessage mode == ERROR");
-            break;
+      case UserAuthInfo::DigestAccepted:
+         authResult = Helper::Authenticated;
+         break;
 
-         default:
-            authResult = Helper::Failed;
-            ErrLog(<<"Unrecognised UserInfoMessage mode value: " << userInfo->getMode());
-      }
+      case UserAuthInfo::DigestNotAccepted:
+         authResult = Helper::Failed;
+         break;
 
-      switch (authResult)
-      {
-         case Helper::Failed:
-            InfoLog (<< "Authentication failed for " << user << " at realm " << realm << ". Sending 403");
+      case UserAuthInfo::Error:
+         // the credentials could not be read (eg. the lookup timed out)
+         WarningLog(<<"UserInfoMessage mode == ERROR");
+         rc.sendResponse(*auto_ptr<SipMessage>
+                         (Helper::makeResponse(*sipMessage, 503, "Server Error")));
+         return SkipAllChains;
+
+      default:
+         authResult = Helper::Failed;
+         ErrLog(<<"Unrecognised UserInfoMessage mode value: " << userInfo->getMode());
+   }
+
+   switch (authResult)
+   {
+      case Helper::Failed:
+         InfoLog (<< "Authentication failed for " << user << " at realm " << realm << ". Sending 403");
+         rc.sendResponse(*auto_ptr<SipMessage>
+                         (Helper::makeResponse(*sipMessage, 403, "Authentication Failed")));
+         return SkipAllChains;
+     
+         // !abr! Eventually, this should just append a counter to
+         // the nonce, and increment it on each challenge. 
+         // If this count is smaller than some reasonable limit,
+         // then we re-challenge; otherwise, we send a 403 instead.
+
+      case Helper::Authenticated:
+         InfoLog (<< "Authentication ok for " << user);
+         
+         if(!sipMessage->header(h_From).isWellFormed() ||
+            sipMessage->header(h_From).isAllContacts())
+         {
+            InfoLog(<<"From header is malformed in"
+                           " digest response.");
             rc.sendResponse(*auto_ptr<SipMessage>
-                            (Helper::makeResponse(*sipMessage, 403, "Authentication Failed")));
-            return SkipAllChains;
-        
-            // !abr! Eventually, this should just append a counter to
-            // the nonce, and increment it on each challenge. 
-            // If this count is smaller than some reasonable limit,
-            // then we re-challenge; otherwise, we send a 403 instead.
-
-         case Helper::Authenticated:
-            InfoLog (<< "Authentication ok for " << user);
-            
-            if(!sipMessage->header(h_From).isWellFormed() ||
-               sipMessage->header(h_From).isAllContacts())
-            {
-               InfoLog(<<"From header is malformed in"
-                              " digest response.");
-               rc.sendResponse(*auto_ptr<SipMessage>
-                               (Helper::makeResponse(*sipMessage, 400, "Malformed From header")));
-               return SkipAllChains;               
-            }
-            
-            if (authorizedForThisIdentity(user, realm, sipMessage->header(h_From).uri()))
-            {
-               rc.setDigestIdentity(user);
+                            (Helper::makeResponse(*sipMessage, 400, "Malformed From header")));
+            return SkipAllChains;               
+         }
+         
+         if (authorizedForThisIdentity(user, realm, sipMessage->header(h_From).uri()))
+         {
+            rc.setDigestIdentity(user);
 
-               if(rc.getProxy().isPAssertedIdentityProcessingEnabled())
+            if(rc.getProxy().isPAssertedIdentityProcessingEnabled())
+            {
+               if (sipMessage->exists(h_PPreferredIdentities))
+               {
+                  // Ensure any P-AssertedIdentities present are removed (note: this is an illegal condidition)
+                  sipMessage->remove(h_PAssertedIdentities);
+
+                  // TODO - when we have a concept of multiple identities per user
+                  // find the first sip or sips P-Preferred-Identity header  and the first tel
+                  // bool haveSip = false;
+                  // bool haveTel = false;
+                  // for (;;)
+                  // {
+                  //    if ((i->uri().scheme() == Symbols::SIP) || (i->uri().scheme() == Symbols::SIPS))
+                  //    {
+                  //       if (haveSip)
+                  //       {
+                  //          continue;   // skip all but the first sip: or sips: URL
+                  //       }
+                  //       haveSip = true;
+                  //
+                  //       if (knownSipIdentity( user, realm, i->uri() )  // should be NameAddr?
+                  //       {
+                  //          sipMessage->header(h_PAssertedIdentities).push_back( i->uri() );
+                  //       }
+                  //       else
+                  //       {
+                  //          sipMessage->header(h_PAssertedIdentities).push_back(getDefaultIdentity(user, realm));
+                  //       }
+                  //    }
+                  //    else if ((i->uri().scheme() == Symbols::TEL))
+                  //    {
+                  //       if (haveTel)
+                  //       {
+                  //          continue;  // skip all but the first tel: URL
+                  //       }
+                  //       haveTel = true;
+                  //
+                  //       if (knownTelIdentity( user, realm, i->uri() ))
+                  //       {
+                  //          sipMessage->header(h_PAssertedIdentities).push_back( i->uri() );
+                  //       }
+                  //    }
+                  // }
+
+                  // We currently don't do anything special with the P-Peferred-Identity hint - just
+                  // add default identity
+                  sipMessage->header(h_PAssertedIdentities).push_back(getDefaultIdentity(user, realm, sipMessage->header(h_From)));
+
+                  // Remove the P-Preferered-Identity header
+                  sipMessage->remove(h_PPreferredIdentities);
+               }
+               else
                {
-                  if (sipMessage->exists(h_PPreferredIdentities))
+                  if (!sipMessage->exists(h_PAssertedIdentities))
                   {
-                     // Ensure any P-AssertedIdentities present are removed (note: this is an illegal condidition)
-                     sipMessage->remove(h_PAssertedIdentities);
-
-                     // TODO - when we have a concept of multiple identities per user
-                     // find the first sip or sips P-Preferred-Identity header  and the first tel
-                     // bool haveSip = false;
-                     // bool haveTel = false;
-                     // for (;;)
-                     // {
-                     //    if ((i->uri().scheme() == Symbols::SIP) || (i->uri().scheme() == Symbols::SIPS))
-                     //    {
-                     //       if (haveSip)
-                     //       {
-                     //          continue;   // skip all but the first sip: or sips: URL
-                     //       }
-                     //       haveSip = true;
-                     //
-                     //       if (knownSipIdentity( user, realm, i->uri() )  // should be NameAddr?
-                     //       {
-                     //          sipMessage->header(h_PAssertedIdentities).push_back( i->uri() );
-                     //       }
-                     //       else
-                     //       {
-                     //          sipMessage->header(h_PAssertedIdentities).push_back(getDefaultIdentity(user, realm));
-                     //       }
-                     //    }
-                     //    else if ((i->uri().scheme() == Symbols::TEL))
-                     //    {
-                     //       if (haveTel)
-                     //       {
-                     //          continue;  // skip all but the first tel: URL
-                     //       }
-                     //       haveTel = true;
-                     //
-                     //       if (knownTelIdentity( user, realm, i->uri() ))
-                     //       {
-                     //          sipMessage->header(h_PAssertedIdentities).push_back( i->uri() );
-                     //       }
-                     //    }
-                     // }
-
-                     // We currently don't do anything special with the P-Peferred-Identity hint - just
-                     // add default identity
                      sipMessage->header(h_PAssertedIdentities).push_back(getDefaultIdentity(user, realm, sipMessage->header(h_From)));
-
-                     // Remove the P-Preferered-Identity header
-                     sipMessage->remove(h_PPreferredIdentities);
-                  }
-                  else
-                  {
-                     if (!sipMessage->exists(h_PAssertedIdentities))
-                     {
-                        sipMessage->header(h_PAssertedIdentities).push_back(getDefaultIdentity(user, realm, sipMessage->header(h_From)));
-                     }
-                     // else  TODO
-                     //  - should implement guidlines in RFC5876 4.5 - whereby the proxy should remove 
-                     //        ignored URI's (ie. a 2nd SIP, SIPS or TEL URI, unknown scheme)
                   }
-               }            
-            
+                  // else  TODO
+                  //  - should implement guidlines in RFC5876 4.5 - whereby the proxy should remove 
+                  //        ignored URI's (ie. a 2nd SIP, SIPS or TEL URI, unknown scheme)
+               }
+            }            
+         
 #if defined(USE_SSL)
-               if(!mNoIdentityHeaders)
+            if(!mNoIdentityHeaders)
+            {
+               static Data http("http://" + mHttpHostname + ":" + Data(mHttpPort) + "/cert?domain=");
+               // .bwc. Leave pre-existing Identity headers alone.
+               if(!sipMessage->exists(h_Identity))
                {
-                  static Data http("http://" + mHttpHostname + ":" + Data(mHttpPort) + "/cert?domain=");
-                  // .bwc. Leave pre-existing Identity headers alone.
-                  if(!sipMessage->exists(h_Identity))
+                  sipMessage->header(h_Identity).value() = Data::Empty;  // This is a signal to have the TransportSelector fill in the identity header
+                  if(sipMessage->exists(h_IdentityInfo))
                   {
-                     sipMessage->header(h_Identity).value() = Data::Empty;  // This is a signal to have the TransportSelector fill in the identity header
-                     if(sipMessage->exists(h_IdentityInfo))
+                     InfoLog(<<"Somebody sent us a"
+                           " request with an Identity-Info, but no Identity"
+                           " header. Removing it.");
+                     if(!sipMessage->header(h_IdentityInfo).isWellFormed())
                      {
-                        InfoLog(<<"Somebody sent us a"
-                              " request with an Identity-Info, but no Identity"
-                              " header. Removing it.");
-                        if(!sipMessage->header(h_IdentityInfo).isWellFormed())
-                        {
-                           InfoLog(<<"...and this "
-                              "Identity-Info header was malformed!");
-                        }
-
-                        sipMessage->remove(h_IdentityInfo);
+                        InfoLog(<<"...and this "
+                           "Identity-Info header was malformed!");
                      }
-                     
-                     sipMessage->header(h_IdentityInfo).uri() = http + realm;
-                     InfoLog (<< "Identity-Info=" << sipMessage->header(h_IdentityInfo).uri());
+
+                     sipMessage->remove(h_IdentityInfo);
                   }
+                  
+                  sipMessage->header(h_IdentityInfo).uri() = http + realm;
+                  InfoLog (<< "Identity-Info=" << sipMessage->header(h_IdentityInfo).uri());
                }
-#endif
-            }
-            else
-            {
-               // !rwm! The user is trying to forge a request.  Respond with a 403
-               InfoLog (<< "User: " << user << " at realm: " << realm << 
-                           " trying to forge request from: " << sipMessage->header(h_From).uri());
-               rc.sendResponse(*auto_ptr<SipMessage>
-                               (Helper::makeResponse(*sipMessage, 403)));
-               return SkipAllChains;               
             }
-            
-            return Continue;
+#endif
+         }
+         else
+         {
+            // !rwm! The user is trying to forge a request.  Respond with a 403
+            InfoLog (<< "User: " << user << " at realm: " << realm << 
+                        " trying to forge request from: " << sipMessage->header(h_From).uri());
+            rc.sendResponse(*auto_ptr<SipMessage>
+                            (Helper::makeResponse(*sipMessage, 403)));
+            return SkipAllChains;               
+         }
+         
+         return Continue;
 
-         case Helper::Expired:
-            InfoLog (<< "Authentication expired for " << user);
-            challengeRequest(rc, true);
-            return SkipAllChains;
+      case Helper::Expired:
+         InfoLog (<< "Authentication expired for " << user);
+         challengeRequest(rc, true);
+         return SkipAllChains;
 
-         case Helper::BadlyFormed:
-            InfoLog (<< "Authentication nonce badly formed for " << user);
-            if(mRejectBadNonces)
-            {
-               rc.sendResponse(*auto_ptr<SipMessage>
-                            (Helper::makeResponse(*sipMessage, 403, "Where on earth did you get that nonce?")));
-            }
-            else
-            {
-               challengeRequest(rc, true);
-            }
-            return SkipAllChains;
-      }
+      case Helper::BadlyFormed:
+         InfoLog (<< "Authentication nonce badly formed for " << user);
+         if(mRejectBadNonces)
+         {
+            rc.sendResponse(*auto_ptr<SipMessage>
+                         (Helper::makeResponse(*sipMessage, 403, "Where on earth did you get that nonce?")));
+         }
+         else
+         {
+            challengeRequest(rc, true);
+         }
+         return SkipAllChains;
    }
 
    return Continue;
@@ -411,6 +422,18 @@ DigestAuthenticator::requestUserAuthInfo(repro::RequestContext &rc, resip::Data
 Processor::processor_action_t
 DigestAuthenticator::requestUserAuthInfo(RequestContext &rc, const Auth& auth, UserInfoMessage *userInfo)
 {
+   // Credentials in the UserStore's auth cache can be checked right here,
+   // without waiting for an auth grabber thread
+   Data a1;
+   if (mUserStore && mUserStore->getCachedUserAuthInfo(userInfo->user(), userInfo->realm(), a1))
+   {
+      std::auto_ptr<UserInfoMessage> cached(userInfo);
+      cached->A1() = a1;
+      // an empty A1 is a user the database does not know
+      cached->setMode(a1.empty() ? UserAuthInfo::UserUnknown : UserAuthInfo::RetrievedA1);
+      return processUserInfo(rc, cached.get());
+   }
+
    std::auto_ptr<ApplicationMessage> app(userInfo);
    mAuthRequestDispatcher->post(app);
    return WaitingForEvent;
@@ -15,6 +15,8 @@ namespace resip
 
 namespace repro
 {
+  class UserStore;
+
   class DigestAuthenticator : public Processor
   {
     public:
@@ -29,11 +31,14 @@ namespace repro
       virtual void challengeRequest(RequestContext &, bool stale = false);
       virtual processor_action_t requestUserAuthInfo(RequestContext &, resip::Data & realm);
       virtual processor_action_t requestUserAuthInfo(RequestContext &, const resip::Auth& auth, UserInfoMessage *userInfo);
+      // checks the credentials in userInfo against the original request
+      virtual processor_action_t processUserInfo(RequestContext &, UserInfoMessage *userInfo);
       virtual resip::Data getRealm(RequestContext &);
       virtual bool isMyRealm(RequestContext &, const resip::Data& realm);
       
     private:
       Dispatcher* mAuthRequestDispatcher;
+      UserStore* mUserStore;
       resip::Data mStaticRealm;
       bool mNoIdentityHeaders;
       resip::Data mHttpHostname;  // Used in identity headers
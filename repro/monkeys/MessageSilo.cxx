@@ -192,8 +192,9 @@ MessageSilo::process(RequestContext& context)
          async->mSourceUri = Data::from(from);
          time(&async->mOriginalSendTime);  // Get now timestamp
 
-         // Dispatch async request to worker thread pool
-         mAsyncDispatcher->post(async_ptr);
+         // Dispatch async request to worker thread pool; storing the message
+         // can wait behind work that holds up a request
+         mAsyncDispatcher->post(async_ptr, Dispatcher::LowPriority);
 
          SipMessage response;
          InfoLog(<<"Message was Silo'd responding with a " << mSuccessStatusCode);
@@ -332,7 +333,7 @@ MessageSilo::onAdd(resip::ServerRegistrationHandle h, const resip::SipMessage& r
    async->mAor = reg.header(h_To).uri().getAOR(false /* addPort? */);
    async->mRequestContacts = h->getRequestContacts();
    std::auto_ptr<ApplicationMessage> async_ptr(async);
-   mAsyncDispatcher->post(async_ptr);
+   mAsyncDispatcher->post(async_ptr, Dispatcher::LowPriority);
    return true;
 }
 
@@ -31,7 +31,8 @@ public:
                              TransactionUser* passedtu,
                              Data& query) :
       AsyncProcessorMessage(proc,tid,passedtu),
-      mQuery(query)
+      mQuery(query),
+      mQueryResult(-1)
    {
    }
 
@@ -76,7 +77,8 @@ RequestFilter::RequestFilter(ProxyConfig& config,
                     config.getConfigData(mySQLSettingPrefix + "MySQLPassword", ""),
                     config.getConfigData(mySQLSettingPrefix + "MySQLDatabaseName", ""),
                     config.getConfigUnsignedLong(mySQLSettingPrefix + "MySQLPort", 0),
-                    Data::Empty);
+                    Data::Empty,
+                    config.getConfigUnsignedLong(mySQLSettingPrefix + "MySQLConnectionPoolSize", 4));
    }
 #endif
 }
@@ -211,6 +213,17 @@ RequestFilter::asyncProcess(AsyncProcessorMessage* msg)
    return false;
 }
 
+bool
+RequestFilter::asyncExpired(AsyncProcessorMessage* msg)
+{
+   // the request gets the database error behavior
+   RequestFilterAsyncMessage* async = dynamic_cast<RequestFilterAsyncMessage*>(msg);
+   assert(async);
+   async->mQueryResult = -1;
+   async->mQueryResultData.clear();
+   return true;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -26,6 +26,7 @@ class RequestFilter : public AsyncProcessor
 
       // Virtual method called from WorkerThreads
       virtual bool asyncProcess(AsyncProcessorMessage* msg);
+      virtual bool asyncExpired(AsyncProcessorMessage* msg);
 
    private:
       short parseActionResult(const resip::Data& result, resip::Data& rejectReason);
@@ -0,0 +1,158 @@
+#include "repro/MySqlDb.hxx"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+// Measures how MySqlDb user auth lookups per second scale with the size of
+// its connection pool, with one lookup thread per pooled connection.
+//
+// usage: benchMySqlDb server user password database [port [seconds [aor]]]
+//
+// The database needs the repro tables; aor (default bench@localhost) should
+// name a row in the users table so that each lookup returns a hash.
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+namespace
+{
+
+class LookupThread : public ThreadIf
+{
+   public:
+      LookupThread(MySqlDb& db, const Data& aor, UInt64 endMs) :
+         mDb(db),
+         mAor(aor),
+         mEndMs(endMs),
+         mLookups(0),
+         mFound(0)
+      {
+      }
+
+      virtual void thread()
+      {
+         while(Timer::getTimeMs() < mEndMs)
+         {
+            if(!mDb.getUserAuthInfo(mAor).empty())
+            {
+               ++mFound;
+            }
+            ++mLookups;
+         }
+      }
+
+      MySqlDb& mDb;
+      const Data mAor;
+      const UInt64 mEndMs;
+      UInt64 mLookups;
+      UInt64 mFound;
+};
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   if(argc < 5)
+   {
+      cerr << "usage: " << argv[0] << " server user password database [port [seconds [aor]]]" << endl;
+      return 1;
+   }
+
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   const Data server(argv[1]);
+   const Data user(argv[2]);
+   const Data password(argv[3]);
+   const Data database(argv[4]);
+   const unsigned int port = argc > 5 ? atoi(argv[5]) : 3306;
+   const unsigned int seconds = argc > 6 ? atoi(argv[6]) : 5;
+   const Data aor(argc > 7 ? argv[7] : "bench@localhost");
+
+   const unsigned int poolSizes[] = { 1, 2, 4, 8, 16 };
+   for(unsigned int p = 0; p < sizeof(poolSizes)/sizeof(poolSizes[0]); p++)
+   {
+      MySqlDb db(server, user, password, database, port, Data::Empty, poolSizes[p]);
+      if(!db.isSane())
+      {
+         cerr << "could not connect to " << server << endl;
+         return 1;
+      }
+
+      vector<LookupThread*> threads;
+      const UInt64 startMs = Timer::getTimeMs();
+      for(unsigned int t = 0; t < poolSizes[p]; t++)
+      {
+         threads.push_back(new LookupThread(db, aor, startMs + seconds*1000));
+         threads.back()->run();
+      }
+
+      UInt64 lookups = 0;
+      UInt64 found = 0;
+      for(vector<LookupThread*>::iterator i = threads.begin(); i != threads.end(); ++i)
+      {
+         (*i)->join();
+         lookups += (*i)->mLookups;
+         found += (*i)->mFound;
+         delete *i;
+      }
+      const UInt64 elapsedMs = Timer::getTimeMs() - startMs;
+
+      cout << "pool size " << poolSizes[p] << ": "
+           << lookups << " lookups (" << found << " found) in " << elapsedMs << " ms, "
+           << (elapsedMs ? lookups * 1000 / elapsedMs : 0) << " queries/sec" << endl;
+   }
+
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ */
@@ -0,0 +1,197 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include "repro/AclStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+/*
+   Checks the AclStore address trie against the plain list walk it
+   replaced: random IPv4 ACLs, with masks, ports and transports, are
+   added and removed, and random source addresses must be trusted by the
+   store exactly when one of the ACLs matches them.
+   Arguments: [seed]
+*/
+
+struct Acl
+{
+   Data address;
+   short mask;
+   short port;
+   short transport;
+};
+
+static Data
+randomAddress()
+{
+   // a small address space, so that masks overlap and addresses hit
+   return Data("10.") + Data((int)(random() % 2)) + "." + Data((int)(random() % 4)) + "." + Data((int)(random() % 8));
+}
+
+static bool
+linearTrusted(const vector<Acl>& acls, const Tuple& source)
+{
+   for (vector<Acl>::const_iterator i = acls.begin(); i != acls.end(); ++i)
+   {
+      Tuple acl(i->address, i->port, (TransportType)i->transport);
+      if (acl.isEqualWithMask(source, i->mask, i->port == 0))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+static void
+checkAgainstLinear(AclStore& store, const vector<Acl>& acls, int lookups)
+{
+   const TransportType transports[] = { UDP, TCP };
+   const int ports[] = { 5060, 5061 };
+   for (int n = 0; n < lookups; ++n)
+   {
+      Tuple source(randomAddress(), ports[random() % 2], transports[random() % 2]);
+      bool expected = linearTrusted(acls, source);
+      if (store.isAddressTrusted(source) != expected)
+      {
+         cerr << "ACL lookup for " << source << " should give " << expected << endl;
+         assert(0);
+      }
+   }
+}
+
+static void
+testAddressTrie(unsigned int seed)
+{
+   srandom(seed);
+   MemoryDb db;
+   AclStore store(db);
+   vector<Acl> acls;
+
+   const short masks[] = { 8, 15, 16, 23, 24, 29, 30, 31, 32 };
+   const short ports[] = { 0, 5060, 5061 };
+   const short transports[] = { UDP, TCP };
+
+   // nothing is trusted by an empty store
+   checkAgainstLinear(store, acls, 100);
+
+   for (int round = 0; round < 40; ++round)
+   {
+      Acl acl;
+      acl.address = randomAddress();
+      acl.mask = masks[random() % (sizeof(masks) / sizeof(masks[0]))];
+      acl.port = ports[random() % 3];
+      acl.transport = transports[random() % 2];
+      if (store.addAcl(Data::Empty, acl.address, acl.mask, acl.port, V4, acl.transport))
+      {
+         acls.push_back(acl);
+      }
+      checkAgainstLinear(store, acls, 200);
+
+      if (round % 4 == 3 && !acls.empty())
+      {
+         size_t victim = random() % acls.size();
+         const Acl& gone = acls[victim];
+         store.eraseAcl(Data::Empty, gone.address, gone.mask, gone.port, V4, gone.transport);
+         acls.erase(acls.begin() + victim);
+         checkAgainstLinear(store, acls, 200);
+      }
+   }
+   assert(!acls.empty());
+}
+
+static void
+testTlsPeerNames()
+{
+   MemoryDb db;
+   AclStore store(db);
+   assert(store.addAcl("proxy.example.com", Data::Empty, 0, 0, 0, 0));
+   assert(store.addAcl("Gateway.Example.com", Data::Empty, 0, 0, 0, 0));
+   assert(!store.addAcl("proxy.example.com", Data::Empty, 0, 0, 0, 0));
+
+   list<Data> names;
+   assert(!store.isTlsPeerNameTrusted(names));
+   names.push_back("other.example.com");
+   assert(!store.isTlsPeerNameTrusted(names));
+   names.push_back("gateway.example.com");
+   assert(store.isTlsPeerNameTrusted(names));
+
+   store.eraseAcl("Gateway.Example.com", Data::Empty, 0, 0, 0, 0);
+   assert(!store.isTlsPeerNameTrusted(names));
+   names.push_back("proxy.example.com");
+   assert(store.isTlsPeerNameTrusted(names));
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   unsigned int seed = argc > 1 ? atoi(argv[1]) : 1;
+   for (unsigned int i = 0; i < 10; ++i)
+   {
+      testAddressTrie(seed + i);
+   }
+   testTlsPeerNames();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,305 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "repro/CompiledPattern.hxx"
+#include "repro/RouteStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+#include "resip/stack/Uri.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+/*
+   Checks the literal prefixes CompiledPattern extracts from route and
+   filter patterns, that matching through the prefix gives the same
+   answers as plain regexec(), and that the PrefixIndex behind RouteStore
+   hands routes back in route order.
+*/
+
+static void
+checkPrefix(const char* pattern, const char* prefix, bool exact)
+{
+   bool isExact = !exact;
+   Data result = CompiledPattern::literalPrefix(pattern, isExact);
+   if (result != prefix || isExact != exact)
+   {
+      cerr << "literalPrefix(" << pattern << ") gave \"" << result << "\" exact=" << isExact
+           << ", expected \"" << prefix << "\" exact=" << exact << endl;
+      assert(0);
+   }
+}
+
+static void
+testLiteralPrefix()
+{
+   // unanchored patterns may match anywhere
+   checkPrefix("", "", false);
+   checkPrefix("sip:alice@example.com", "", false);
+   checkPrefix(".*@example\\.com$", "", false);
+
+   // anchored, up to the first metacharacter
+   checkPrefix("^sip:alice@", "sip:alice@", false);
+   checkPrefix("^sip:alice.*", "sip:alice", false);
+   checkPrefix("^sip:\\d+@", "sip:", false);
+   checkPrefix("^sip:a+", "sip:a", false);
+
+   // escaped punctuation is a literal
+   checkPrefix("^sip:a\\.b\\.com", "sip:a.b.com", false);
+   checkPrefix("^sip:a\\|b", "sip:a|b", false);
+   checkPrefix("^sip:a\\[b", "sip:a[b", false);
+
+   // a repeat applies to the last literal, which then may not be there
+   checkPrefix("^sip:1234*", "sip:123", false);
+   checkPrefix("^sip:1234?", "sip:123", false);
+   checkPrefix("^sip:1234{2}", "sip:123", false);
+   checkPrefix("^sip:a\\.*", "sip:a", false);
+   checkPrefix("^a*", "", false);
+
+   // bracket sets stop the prefix
+   checkPrefix("^sip:[0-9]+@", "sip:", false);
+   checkPrefix("^sip:[ab]c", "sip:", false);
+
+   // any alternation could make the prefix optional, so is given up on;
+   // a '|' inside a bracket set is just a character
+   checkPrefix("^sip:alice|^sip:bob", "", false);
+   checkPrefix("^sip:a|b", "", false);
+   checkPrefix("^sip:(alice|bob)@", "", false);
+   checkPrefix("^sip:[a|b]c", "sip:", false);
+   checkPrefix("^sip:[]|]c", "sip:", false);
+
+   // exact literals
+   checkPrefix("^sip:alice@example\\.com$", "sip:alice@example.com", true);
+   checkPrefix("^$", "", true);
+   checkPrefix("^sip:a*$", "sip:", false);
+   checkPrefix("^sip:a$b", "sip:a", false);
+}
+
+static void
+testMatch()
+{
+   const char* patterns[] =
+   {
+      "sip:.*@example\\.com",
+      "^sip:(.*)@example\\.com$",
+      "^sip:alice@example\\.com$",
+      "^sip:alice@",
+      "^sip:a\\.b",
+      "^sip:1234*",
+      "^sip:[0-9]+@(.*)$",
+      "^sip:alice|^tel:",
+      "^$",
+      0
+   };
+   const char* subjects[] =
+   {
+      "",
+      "sip:alice@example.com",
+      "sip:alice@example.comx",
+      "sip:bob@example.com",
+      "xsip:alice@example.com",
+      "sip:a.b",
+      "sip:axb",
+      "sip:123",
+      "sip:12344444",
+      "sip:1235",
+      "sip:555@pstn.example.com",
+      "tel:+15555",
+      "SIP:ALICE@EXAMPLE.COM",
+      0
+   };
+   int flags[] = { 0, REG_ICASE };
+
+   for (int f = 0; f < 2; ++f)
+   {
+      for (const char** p = patterns; *p; ++p)
+      {
+         CompiledPattern compiled(*p, flags[f]);
+         assert(compiled.isValid());
+         assert(compiled.getPattern() == *p);
+         if (flags[f] & REG_ICASE)
+         {
+            // a case insensitive match can not start with a fixed literal
+            assert(compiled.getPrefix().empty());
+         }
+
+         regex_t reference;
+         int ret = regcomp(&reference, *p, REG_EXTENDED | flags[f]);
+         assert(ret == 0);
+
+         for (const char** s = subjects; *s; ++s)
+         {
+            const size_t nmatch = 3;
+            regmatch_t expected[nmatch];
+            regmatch_t got[nmatch];
+            bool isMatch = regexec(&reference, *s, nmatch, expected, 0) == 0;
+            if (compiled.match(*s, nmatch, got) != isMatch)
+            {
+               cerr << "pattern " << *p << " flags " << flags[f] << " subject " << *s
+                    << " expected match=" << isMatch << endl;
+               assert(0);
+            }
+            assert(compiled.match(*s, 0, 0) == isMatch);
+            if (isMatch)
+            {
+               for (size_t i = 0; i < nmatch; ++i)
+               {
+                  assert(got[i].rm_so == expected[i].rm_so);
+                  assert(got[i].rm_eo == expected[i].rm_eo);
+               }
+            }
+         }
+         regfree(&reference);
+      }
+   }
+
+   // an invalid pattern never matches
+   CompiledPattern invalid("^sip:(alice", 0);
+   assert(!invalid.isValid());
+   assert(!invalid.match("sip:(alice", 0, 0));
+}
+
+static void
+testPrefixIndex()
+{
+   PrefixIndex index;
+   assert(index.empty());
+   index.add("sip:", 5);
+   index.add("", 1);
+   index.add("sip:a", 0);
+   index.add("sip:ab", 3);
+   index.add("tel:", 2);
+   index.add("sip:a", 4);
+   index.add("sip:abc", 6);
+   assert(!index.empty());
+
+   vector<unsigned int> ids;
+   index.find("sip:abd", ids);
+   assert(ids.size() == 5);
+   assert(ids[0] == 0 && ids[1] == 1 && ids[2] == 3 && ids[3] == 4 && ids[4] == 5);
+
+   // find() appends
+   ids.assign(1, 99);
+   index.find("tel:+1555", ids);
+   assert(ids.size() == 3);
+   assert(ids[0] == 99 && ids[1] == 1 && ids[2] == 2);
+
+   ids.clear();
+   index.find("", ids);
+   assert(ids.size() == 1 && ids[0] == 1);
+
+   ids.clear();
+   index.find("sip:abc", ids);
+   assert(ids.size() == 6);
+   for (unsigned int i = 0; i < ids.size(); ++i)
+   {
+      assert(ids[i] == (i < 2 ? i : i + 1));
+   }
+}
+
+static void
+testRouteOrder()
+{
+   MemoryDb db;
+   RouteStore store(db);
+
+   // added out of order, with different prefixes and none at all
+   assert(store.addRoute("", "", "^sip:bob", "sip:four@example.net", 4));
+   assert(store.addRoute("", "", "^sip:alice@example\\.com$", "sip:three@example.net", 3));
+   assert(store.addRoute("", "", "sip:.*", "sip:two@example.net", 2));
+   assert(store.addRoute("", "", "^sip:(.*)@example\\.com$", "sip:$1@one.example.net", 1));
+   assert(store.addRoute("", "", "^tel:", "sip:zero@example.net", 0));
+   assert(store.addRoute("INVITE", "", "^sip:alice", "sip:five@example.net", 5));
+   assert(store.addRoute("", "", "^SIP:ALICE", "sip:six@example.net", 6));
+
+   RouteStore::UriList targets = store.process(Uri("sip:alice@example.com"), "INVITE", Data::Empty);
+   assert(targets.size() == 4);
+   RouteStore::UriList::const_iterator i = targets.begin();
+   assert(i->user() == "alice" && i->host() == "one.example.net");
+   assert((++i)->user() == "two");
+   assert((++i)->user() == "three");
+   assert((++i)->user() == "five");
+
+   targets = store.process(Uri("sip:alice@example.com"), "MESSAGE", Data::Empty);
+   assert(targets.size() == 3);
+   assert(targets.back().user() == "three");
+
+   targets = store.process(Uri("sip:bob@example.com"), "INVITE", Data::Empty);
+   assert(targets.size() == 3);
+   i = targets.begin();
+   assert(i->user() == "bob");
+   assert((++i)->user() == "two");
+   assert((++i)->user() == "four");
+
+   targets = store.process(Uri("sip:carol@example.org"), "INVITE", Data::Empty);
+   assert(targets.size() == 1);
+   assert(targets.front().user() == "two");
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testLiteralPrefix();
+   testMatch();
+   testPrefixIndex();
+   testRouteOrder();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
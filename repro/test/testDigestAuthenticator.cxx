@@ -0,0 +1,213 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+
+#include "repro/Dispatcher.hxx"
+#include "repro/ProcessorChain.hxx"
+#include "repro/Proxy.hxx"
+#include "repro/ProxyConfig.hxx"
+#include "repro/RequestContext.hxx"
+#include "repro/Worker.hxx"
+#include "repro/monkeys/DigestAuthenticator.hxx"
+#include "repro/test/MemoryDb.hxx"
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+/*
+   Runs requests with Proxy-Authorization headers through a
+   DigestAuthenticator whose UserStore has an auth cache, checking the
+   credentials that are answered from the cache: users the cache knows
+   not to exist must be rejected however the response was computed (an
+   empty A1 is not a password), wrong passwords must be rejected, and
+   the right password let through.
+*/
+
+static const Data Realm("example.com");
+
+// never started, it stands in for the auth grabbers
+class IdleWorker : public Worker
+{
+   public:
+      virtual bool process(ApplicationMessage* msg) { assert(false); return false; }
+      virtual Worker* clone() const { return new IdleWorker; }
+};
+
+class TestConfig : public ProxyConfig
+{
+   public:
+      virtual void printHelpText(int argc, char **argv) {}
+};
+
+// answers requests without a transaction in the stack
+class TestRequestContext : public RequestContext
+{
+   public:
+      TestRequestContext(Proxy& proxy, ProcessorChain& chain, SipMessage* request)
+         : RequestContext(proxy, chain, chain, chain),
+           mStatusCode(0)
+      {
+         mOriginalRequest = request;
+         mCurrentEvent = request;
+      }
+
+      virtual void send(SipMessage& msg)
+      {
+         assert(msg.isResponse());
+         mStatusCode = msg.header(h_StatusLine).statusCode();
+      }
+
+      int mStatusCode;
+};
+
+static SipMessage*
+makeRequest(const Data& user)
+{
+   Data text("MESSAGE sip:bob@example.com SIP/2.0\r\n"
+             "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK-digest-test\r\n"
+             "Max-Forwards: 70\r\n"
+             "From: <sip:" + user + "@example.com>;tag=1\r\n"
+             "To: <sip:bob@example.com>\r\n"
+             "Call-ID: digest-test\r\n"
+             "CSeq: 1 MESSAGE\r\n"
+             "Content-Length: 0\r\n"
+             "\r\n");
+   return SipMessage::make(text);
+}
+
+// a request with the response to a fresh challenge, computed from a1
+static SipMessage*
+makeAuthorizedRequest(const Data& user, const Data& a1)
+{
+   SipMessage* request = makeRequest(user);
+   auto_ptr<SipMessage> challenge(Helper::makeProxyChallenge(*request, Realm));
+   unsigned int nonceCount = 0;
+   Data nonceCountString;
+   request->header(h_ProxyAuthorizations).push_back(
+      Helper::makeChallengeResponseAuthWithA1(*request, user, a1,
+                                              challenge->header(h_ProxyAuthenticates).front(),
+                                              "cnonce", nonceCount, nonceCountString));
+   return request;
+}
+
+static Data
+a1Of(const Data& user, const Data& password)
+{
+   return Data(user + ":" + Realm + ":" + password).md5();
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   MemoryDb db;
+   TestConfig config;
+   config.createDataStore(&db);
+   UserStore& users = config.getDataStore()->mUserStore;
+   users.enableAuthCache(100, 300, 30);
+   assert(users.addUser("alice", Realm, Realm, "secret", true, "Alice", "alice@example.com"));
+
+   // only cached users can be answered without an auth grabber
+   Dispatcher grabbers(auto_ptr<Worker>(new IdleWorker), 0, 1, false);
+
+   SipStack stack;
+   ProcessorChain chain(Processor::REQUEST_CHAIN);
+   Proxy proxy(stack, config, chain, chain, chain);
+   DigestAuthenticator authenticator(config, &grabbers, Realm);
+
+   // what the auth grabbers would have left in the cache
+   assert(!users.getUserAuthInfo("alice", Realm).empty());
+   assert(users.getUserAuthInfo("mallory", Realm).empty());
+   Data a1;
+   assert(users.getCachedUserAuthInfo("mallory", Realm, a1));
+
+   {
+      // a response computed with an empty A1 must not let an unknown
+      // user in
+      TestRequestContext rc(proxy, chain, makeAuthorizedRequest("mallory", Data::Empty));
+      assert(authenticator.process(rc) == Processor::SkipAllChains);
+      assert(rc.mStatusCode == 403);
+   }
+   {
+      TestRequestContext rc(proxy, chain, makeAuthorizedRequest("mallory", a1Of("mallory", "guess")));
+      assert(authenticator.process(rc) == Processor::SkipAllChains);
+      assert(rc.mStatusCode == 403);
+   }
+   {
+      TestRequestContext rc(proxy, chain, makeAuthorizedRequest("alice", a1Of("alice", "wrong")));
+      assert(authenticator.process(rc) == Processor::SkipAllChains);
+      assert(rc.mStatusCode == 403);
+   }
+   {
+      TestRequestContext rc(proxy, chain, makeAuthorizedRequest("alice", a1Of("alice", "secret")));
+      assert(authenticator.process(rc) == Processor::Continue);
+      assert(rc.mStatusCode == 0);
+      assert(rc.getDigestIdentity() == "alice");
+   }
+   {
+      // users that are not cached wait for an auth grabber
+      TestRequestContext rc(proxy, chain, makeAuthorizedRequest("carol", a1Of("carol", "secret")));
+      assert(authenticator.process(rc) == Processor::WaitingForEvent);
+      assert(rc.mStatusCode == 0);
+   }
+
+   cout << "PASSED" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
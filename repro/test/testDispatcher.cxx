@@ -1,309 +1,313 @@
-#include "repro/Worker.hxx"
-#include "repro/Dispatcher.hxx"
+#include <cassert>
+#include <iostream>
+#include <vector>
 
-#include "resip/stack/SipStack.hxx"
-#include "resip/stack/StackThread.hxx"
-#include "resip/stack/TransactionUser.hxx"
+#include "repro/Dispatcher.hxx"
+#include "repro/Worker.hxx"
 #include "resip/stack/ApplicationMessage.hxx"
-
+#include "rutil/Condition.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Time.hxx"
 
-#include <iostream>
-#include <cassert>
+using namespace resip;
+using namespace repro;
+using namespace std;
 
-//main is way down at the bottom.
+/*
+   Runs a Dispatcher without a stack against a Worker that logs what it
+   was given: higher priority lanes must be drained first, a worker must
+   take the messages queued for a worker that is stuck, messages that
+   waited past their deadline must go to Worker::expired() instead of
+   Worker::process(), and post() must be refused while stopped.
+*/
 
-namespace test
-{
-
-class DummyWorkMessage : public resip::ApplicationMessage
+class TestMessage : public ApplicationMessage
 {
    public:
-      DummyWorkMessage(resip::TransactionUser* passedTU, resip::Data string=resip::Data::Empty)
-      {
-         tu=passedTU;
-         mTid="";
-         mQuery=string;
-         wait=false;
-      }
-      
-      
-      DummyWorkMessage(const DummyWorkMessage& orig)
-      {
-         tu=orig.tu;
-         mTid=orig.mTid;
-         mQuery=orig.mQuery;
-         mResult=orig.mResult;
-         wait=orig.wait;
-      }
-      
-      virtual ~DummyWorkMessage(){}
-      
-      resip::Data& result()
-      {
-         return mResult;
-      }
-      
-      resip::Data& query()
-      {
-         return mQuery;
-      }
-      
-      virtual DummyWorkMessage* clone() const {return new DummyWorkMessage(*this);};
-      virtual const resip::Data& getTransactionId() const {return mTid;};
-
-      virtual std::ostream& encode(std::ostream& ostr) const { ostr << "DummyWorkMessage("<<mTid<<") "; return ostr; };
-      virtual std::ostream& encodeBrief(std::ostream& ostr) const{ ostr << "DummyWorkMessage("<<mTid<<") "; return ostr; };
-      
-      bool wait;
-
-   private:
-      resip::Data mResult;
-      resip::Data mQuery;
-      resip::Data mTid;
+      TestMessage(const Data& name, bool block=false) : mName(name), mBlock(block) {}
+
+      virtual Message* clone() const { return new TestMessage(*this); }
+      virtual EncodeStream& encode(EncodeStream& strm) const { return strm << "TestMessage(" << mName << ")"; }
+      virtual EncodeStream& encodeBrief(EncodeStream& strm) const { return encode(strm); }
+
+      Data mName;
+      bool mBlock;
 };
 
-class DummyWorker : public repro::Worker
+// what the workers did, in order, and a gate that holds blocking messages
+static Mutex mutex;
+static Condition changed;
+static vector<Data> done;
+static bool gateOpen = true;
+static int blocked = 0;
+
+class TestWorker : public Worker
 {
    public:
-      DummyWorker(){}
-      virtual ~DummyWorker(){}
-      
-      virtual void process(resip::ApplicationMessage* app)
+      virtual bool process(ApplicationMessage* msg)
       {
-         DummyWorkMessage* dwm = dynamic_cast<DummyWorkMessage*>(app);
-         if(dwm)
+         TestMessage* test = dynamic_cast<TestMessage*>(msg);
+         assert(test);
+         Lock lock(mutex);
+         if (test->mBlock)
          {
-            dwm->result()=" I got that thing you sent me.";
-            if(dwm->wait)
+            ++blocked;
+            changed.broadcast();
+            while (!gateOpen)
             {
-               sleep(1);
+               changed.wait(mutex);
             }
+            --blocked;
          }
-         
+         done.push_back(test->mName);
+         changed.broadcast();
+         return false;
       }
-      
-      virtual DummyWorker* clone() const
+
+      virtual bool expired(ApplicationMessage* msg)
       {
-         return new DummyWorker;
+         TestMessage* test = dynamic_cast<TestMessage*>(msg);
+         assert(test);
+         Lock lock(mutex);
+         done.push_back("expired " + test->mName);
+         changed.broadcast();
+         return false;
       }
-};
-
 
+      virtual Worker* clone() const { return new TestWorker; }
+};
 
-class DummyTU : public resip::TransactionUser
+class TestDispatcher : public Dispatcher
 {
    public:
-      DummyTU(resip::SipStack* stack)
+      TestDispatcher(int workers)
+         : Dispatcher(std::auto_ptr<Worker>(new TestWorker), 0, workers)
       {
-         mName="DummyTU";
-         mStack=stack;
-         mStack->registerTransactionUser(*this);
-         DummyWorker* dw = new DummyWorker;
-         std::auto_ptr<repro::Worker> worker(dw);
-         mDispatcher = new repro::Dispatcher(worker,mStack,3,false);
       }
 
-      virtual ~DummyTU()
-      {
-         delete mDispatcher;
-      }
+      UInt64 stolen() const { return mStatistics.getCounter(TasksStolen); }
+      UInt64 expired() const { return mStatistics.getCounter(TasksExpired); }
+};
 
-      virtual void go()
-      {
-         assert(mDispatcher);
-         DummyWorkMessage* lost = new DummyWorkMessage(this);
-         
-         //Dispatcher should not be accepting work yet
-         assert(!mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(lost)));
-                  
-         mDispatcher->startAll();
-         
-         DummyWorkMessage* a = new DummyWorkMessage(this,"A");
-         DummyWorkMessage* b = new DummyWorkMessage(this,"B");
-         DummyWorkMessage* c = new DummyWorkMessage(this,"C");
-         DummyWorkMessage* d = new DummyWorkMessage(this,"D");
-         
-         std::auto_ptr<resip::ApplicationMessage> aa(a);
-         std::auto_ptr<resip::ApplicationMessage> ab(b);
-         std::auto_ptr<resip::ApplicationMessage> ac(c);
-         std::auto_ptr<resip::ApplicationMessage> ad(d);
-         
-         assert(mDispatcher->post(aa));
-         assert(mDispatcher->post(ab));
-         assert(mDispatcher->post(ac));
-         assert(mDispatcher->post(ad));
-         
-         bool gotA=false;
-         bool gotB=false;
-         bool gotC=false;
-         bool gotD=false;
-         int i=0;
-         resip::Message* msg;
-         
-         for( i=0; i<4 ;i++)
-         {
-            assert(msg = mFifo.getNext(1000));
-            
-            DummyWorkMessage* dwm = dynamic_cast<DummyWorkMessage*>(msg);
-            
-            assert(dwm);
+static bool
+post(Dispatcher& dispatcher, TestMessage* msg,
+     Dispatcher::Priority priority=Dispatcher::NormalPriority,
+     unsigned int maxQueueTimeMs=0)
+{
+   std::auto_ptr<ApplicationMessage> work(msg);
+   return dispatcher.post(work, priority, maxQueueTimeMs);
+}
 
-            if(dwm->result()==" I got that thing you sent me.")
-            {
-               if(dwm->query()=="A")  gotA=true;
-               if(dwm->query()=="B")  gotB=true;
-               if(dwm->query()=="C")  gotC=true;
-               if(dwm->query()=="D")  gotD=true;
-            }
-            
-            delete dwm;
+static void
+closeGate()
+{
+   Lock lock(mutex);
+   gateOpen = false;
+   done.clear();
+}
 
-         }
-         
-         assert(i==4);
-         assert(gotA && gotB && gotC && gotD);
-         
-         mDispatcher->stop();
-         
-         lost = new DummyWorkMessage(this,"");
-         
-         //We stopped the thread bank, it should not be accepting work.
-         assert(!mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(lost)));
-         
-         mDispatcher->resume();
-         
-         DummyWorkMessage* wasteTime1 = new DummyWorkMessage(this,"Take your time.");
-         DummyWorkMessage* wasteTime2 = new DummyWorkMessage(this,"Take your time.");
-         DummyWorkMessage* wasteTime3 = new DummyWorkMessage(this,"Take your time.");
-         DummyWorkMessage* wasteTime4 = new DummyWorkMessage(this,"Take your time.");
-         wasteTime1->wait=true;
-         wasteTime2->wait=true;
-         wasteTime3->wait=true;
-         wasteTime4->wait=true;
-         
-         assert(mDispatcher->fifoCountDepth()==0);
-         
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(wasteTime1));
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(wasteTime2));
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(wasteTime3));
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(wasteTime4));
-         mDispatcher->stop();
-         
-         usleep(1000);
-         //Three in the thread bank, one in the queue.
-         assert(mDispatcher->fifoCountDepth()==1);
-         
-         for( i=0; i<4 ;i++)
-         {
-            assert(msg = mFifo.getNext(2000));
-            
-            DummyWorkMessage* dwm = dynamic_cast<DummyWorkMessage*>(msg);
-            
-            assert(dwm);
-
-            assert(dwm->result()==" I got that thing you sent me.");
-            
-            delete dwm;
-         }
-         
-         assert(!(msg=mFifo.getNext(1000)));
-         
-         mDispatcher->resume();
-         
-         DummyWorkMessage* clog1 = new DummyWorkMessage(this);
-         DummyWorkMessage* clog2 = new DummyWorkMessage(this);
-         DummyWorkMessage* clog3 = new DummyWorkMessage(this);
-         clog1->wait=true;
-         clog2->wait=true;
-         clog3->wait=true;
-         
-         //Three threads in the bank, each waiting for 1 sec
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(clog1));
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(clog2));
-         mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(clog3));
-
-         usleep(100);
-         
-         for(i=0;i<1000;i++)
-         {
-            DummyWorkMessage* pummel = new DummyWorkMessage(this);
-            std::auto_ptr<resip::ApplicationMessage>batter(pummel);
-            assert(mDispatcher->post(batter));
-         }
+static void
+openGate()
+{
+   Lock lock(mutex);
+   gateOpen = true;
+   changed.broadcast();
+}
 
-         
-         usleep(100000);
-         
-         assert(msg=mFifo.getNext(1000));
-         
-         delete msg;
-         
-         
-         
-         for(i=0;i<1002;i++)
-         {
-            msg=mFifo.getNext(10);
-            assert(msg);
-            delete msg;
-         }
+// waits until count workers are held at the gate
+static void
+waitBlocked(int count)
+{
+   Lock lock(mutex);
+   while (blocked != count)
+   {
+      bool signaled = changed.wait(mutex, 5000);
+      assert(signaled);
+   }
+}
 
-         mDispatcher->shutdownAll();
-         
-         
-         lost = new DummyWorkMessage(this);
-         assert(!(mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(lost))));
-         
-         
-         
-         delete mDispatcher;
-         
-         
-         DummyWorker* dw = new DummyWorker;
-         std::auto_ptr<repro::Worker> worker(dw);
-         //Stack ptr set to null.
-         mDispatcher = new repro::Dispatcher(worker,0,3,true);
-         
-         std::cout << "The following error message is intentional." << std::endl;
-         
-         lost = new DummyWorkMessage(this);
-         assert(mDispatcher->post(std::auto_ptr<resip::ApplicationMessage>(lost)));
-         
-         assert(!(msg=mFifo.getNext(100)));
-         
-         
-         
-      }
-      
-      virtual const resip::Data& name() const
+// waits until count messages have been logged
+static void
+waitDone(size_t count)
+{
+   Lock lock(mutex);
+   while (done.size() < count)
+   {
+      bool signaled = changed.wait(mutex, 5000);
+      assert(signaled);
+   }
+}
+
+static void
+testPriorities()
+{
+   TestDispatcher dispatcher(1);
+   closeGate();
+   assert(post(dispatcher, new TestMessage("block", true)));
+   waitBlocked(1);
+
+   assert(post(dispatcher, new TestMessage("low 1"), Dispatcher::LowPriority));
+   assert(post(dispatcher, new TestMessage("normal 1"), Dispatcher::NormalPriority));
+   assert(post(dispatcher, new TestMessage("high 1"), Dispatcher::HighPriority));
+   assert(post(dispatcher, new TestMessage("low 2"), Dispatcher::LowPriority));
+   assert(post(dispatcher, new TestMessage("normal 2"), Dispatcher::NormalPriority));
+   assert(post(dispatcher, new TestMessage("high 2"), Dispatcher::HighPriority));
+   assert(dispatcher.fifoCountDepth() == 6);
+
+   openGate();
+   waitDone(7);
+
+   const char* expected[] = { "block", "high 1", "high 2", "normal 1", "normal 2", "low 1", "low 2" };
+   Lock lock(mutex);
+   for (size_t i = 0; i < done.size(); ++i)
+   {
+      assert(done[i] == expected[i]);
+   }
+}
+
+static void
+testStealing()
+{
+   const size_t Count = 20;
+   TestDispatcher dispatcher(2);
+   closeGate();
+   assert(post(dispatcher, new TestMessage("block", true)));
+   waitBlocked(1);
+
+   // half of these land in the queue of the blocked worker, and the other
+   // worker must get them all done while it stays blocked
+   UInt64 stolenBefore = dispatcher.stolen();
+   for (size_t i = 0; i < Count; ++i)
+   {
+      assert(post(dispatcher, new TestMessage(Data((int)i))));
+   }
+   waitDone(Count);
+   {
+      Lock lock(mutex);
+      assert(blocked == 1);
+      assert(done.size() == Count);
+   }
+   assert(dispatcher.stolen() > stolenBefore);
+   assert(dispatcher.fifoCountDepth() == 0);
+
+   openGate();
+   waitDone(Count + 1);
+}
+
+static void
+testDeadlines()
+{
+   TestDispatcher dispatcher(1);
+   closeGate();
+   assert(post(dispatcher, new TestMessage("block", true)));
+   waitBlocked(1);
+
+   assert(post(dispatcher, new TestMessage("late"), Dispatcher::NormalPriority, 20));
+   assert(post(dispatcher, new TestMessage("patient")));
+   dispatcher.setMaxQueueTime(20);
+   assert(post(dispatcher, new TestMessage("late by default")));
+   assert(post(dispatcher, new TestMessage("in time"), Dispatcher::NormalPriority, 60000));
+   sleepMs(100);
+
+   openGate();
+   waitDone(5);
+
+   const char* expected[] = { "block", "expired late", "patient", "expired late by default", "in time" };
+   {
+      Lock lock(mutex);
+      for (size_t i = 0; i < done.size(); ++i)
       {
-         return mName;
+         assert(done[i] == expected[i]);
       }
+   }
+   assert(dispatcher.expired() == 2);
+}
 
-      
-   private:
-      repro::Dispatcher* mDispatcher;
-      resip::SipStack* mStack;
-      resip::Data mName;
+static void
+testStop()
+{
+   TestDispatcher dispatcher(2);
+   assert(post(dispatcher, new TestMessage("started")));
 
-};
+   dispatcher.stop();
+   TestMessage* refused = new TestMessage("stopped");
+   std::auto_ptr<ApplicationMessage> work(refused);
+   assert(!dispatcher.post(work));
+   // a refused message stays with the caller
+   assert(work.get() == refused);
 
+   dispatcher.resume();
+   assert(post(dispatcher, new TestMessage("resumed")));
 
+   dispatcher.shutdownAll();
+   assert(!dispatcher.post(work));
+   dispatcher.resume();
+   assert(!dispatcher.post(work));
 }
 
-
 int
-main()
+main(int argc, char** argv)
 {
-   resip::SipStack mStack;
-   resip::StackThread stackThread(mStack);
-   test::DummyTU mTU(&mStack);
-   stackThread.run();
-   
-   mTU.go();
-   std::cout << "PASSED" << std::endl;
-   stackThread.shutdown();
-   stackThread.join();
-   mStack.shutdown();
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   testPriorities();
+   testStealing();
+   testDeadlines();
+   testStop();
+
+   cout << "PASSED" << endl;
+   return 0;
 }
 
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,179 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "repro/MySqlDb.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/ThreadIf.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+/*
+   Runs MySqlDb against servers that are not there: a port nothing listens
+   on, and a listener that drops every connection as soon as it accepts
+   it. The latter fails each connect as a lost connection, the error that
+   makes MySqlDb reconnect and try again, so every operation goes through
+   a reconnect that fails too. All of them must fail cleanly and give
+   their connection back to the pool. Needs no MySQL server.
+*/
+
+// listens on a free port of 127.0.0.1 and closes whatever connects
+class DroppingServer : public ThreadIf
+{
+   public:
+      DroppingServer() : mPort(0)
+      {
+         mFd = ::socket(AF_INET, SOCK_STREAM, 0);
+         assert(mFd >= 0);
+         sockaddr_in addr;
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         int rc = ::bind(mFd, (sockaddr*)&addr, sizeof(addr));
+         assert(rc == 0);
+         rc = ::listen(mFd, 16);
+         assert(rc == 0);
+         socklen_t len = sizeof(addr);
+         rc = ::getsockname(mFd, (sockaddr*)&addr, &len);
+         assert(rc == 0);
+         (void)rc;
+         mPort = ntohs(addr.sin_port);
+      }
+
+      virtual ~DroppingServer()
+      {
+         shutdown();
+         join();
+         ::close(mFd);
+      }
+
+      virtual void thread()
+      {
+         while (!isShutdown())
+         {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(mFd, &fds);
+            timeval timeout = { 0, 100000 };
+            if (::select(mFd + 1, &fds, 0, 0, &timeout) > 0)
+            {
+               int fd = ::accept(mFd, 0, 0);
+               if (fd >= 0)
+               {
+                  ::close(fd);
+               }
+            }
+         }
+      }
+
+      unsigned int mPort;
+
+   private:
+      int mFd;
+};
+
+// a port nothing listens on
+static unsigned int
+closedPort()
+{
+   DroppingServer server;
+   return server.mPort;
+}
+
+static void
+testUnreachable(unsigned int port)
+{
+   // 127.0.0.1 rather than localhost, which would use the unix socket
+   MySqlDb db("127.0.0.1", "repro", "repro", "repro", port, Data::Empty, 2);
+   assert(!db.isSane());
+
+   AbstractDb::UserRecord rec;
+   rec.user = "alice";
+   rec.domain = "example.com";
+   rec.realm = "example.com";
+   rec.passwordHash = "0123456789abcdef0123456789abcdef";
+
+   // more rounds than there are connections, so a connection that is
+   // not given back would block
+   for (int i = 0; i < 5; ++i)
+   {
+      assert(db.getUserAuthInfo("alice@example.com").empty());
+      assert(db.getUser("alice@example.com").user.empty());
+      assert(!db.addUser("alice@example.com", rec));
+      db.eraseUser("alice@example.com");
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   testUnreachable(closedPort());
+
+   DroppingServer server;
+   server.run();
+   testUnreachable(server.mPort);
+
+   cout << "PASSED" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,225 @@
+#include <cassert>
+#include <iostream>
+
+#include "repro/UserAuthCache.hxx"
+#include "repro/UserStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Time.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+/*
+   Checks the UserAuthCache on its own (lifetimes, unknown users,
+   capacity, generations and invalidation) and then through a UserStore,
+   whose edits must drop every cached credential they make stale.
+*/
+
+static void
+testLookup()
+{
+   UserAuthCache cache(100, 300, 30);
+   Data a1;
+   assert(!cache.lookup("alice@example.com", a1));
+
+   cache.add("alice@example.com", "a1 of alice", cache.generation("alice@example.com"));
+   assert(cache.lookup("alice@example.com", a1));
+   assert(a1 == "a1 of alice");
+   assert(!cache.lookup("bob@example.com", a1));
+
+   // unknown users are cached with an empty A1
+   cache.add("mallory@example.com", Data::Empty, cache.generation("mallory@example.com"));
+   a1 = "not touched";
+   assert(cache.lookup("mallory@example.com", a1));
+   assert(a1.empty());
+
+   assert(cache.size() == 2);
+   assert(cache.getHits() == 2);
+   assert(cache.getMisses() == 2);
+}
+
+static void
+testLifetimes()
+{
+   UserAuthCache cache(100, 1, 300);
+   cache.add("alice@example.com", "a1 of alice", cache.generation("alice@example.com"));
+   cache.add("mallory@example.com", Data::Empty, cache.generation("mallory@example.com"));
+   Data a1;
+   assert(cache.lookup("alice@example.com", a1));
+
+   sleepMs(1100);
+   assert(!cache.lookup("alice@example.com", a1));
+   assert(cache.lookup("mallory@example.com", a1));
+   assert(cache.size() == 1);
+
+   // a negative lifetime of 0 keeps unknown users out of the cache
+   UserAuthCache positiveOnly(100, 300, 0);
+   positiveOnly.add("mallory@example.com", Data::Empty, positiveOnly.generation("mallory@example.com"));
+   assert(!positiveOnly.lookup("mallory@example.com", a1));
+   assert(positiveOnly.size() == 0);
+}
+
+static void
+testCapacity()
+{
+   // a single entry per shard
+   UserAuthCache cache(1, 300, 300);
+   for (int i = 0; i < 1000; ++i)
+   {
+      Data key = Data("user") + Data(i) + "@example.com";
+      cache.add(key, "a1", cache.generation(key));
+   }
+   assert(cache.size() <= 16);
+
+   // the most recently added entry survives
+   Data a1;
+   assert(cache.lookup("user999@example.com", a1));
+}
+
+static void
+testGenerations()
+{
+   UserAuthCache cache(100, 300, 30);
+   Data a1;
+
+   // an answer read before an invalidation is not cached
+   unsigned int generation = cache.generation("alice@example.com");
+   cache.invalidate("alice@example.com");
+   cache.add("alice@example.com", "old a1", generation);
+   assert(!cache.lookup("alice@example.com", a1));
+
+   generation = cache.generation("alice@example.com");
+   cache.clear();
+   cache.add("alice@example.com", "old a1", generation);
+   assert(!cache.lookup("alice@example.com", a1));
+
+   cache.add("alice@example.com", "new a1", cache.generation("alice@example.com"));
+   assert(cache.lookup("alice@example.com", a1));
+   assert(a1 == "new a1");
+
+   cache.invalidate("alice@example.com");
+   assert(!cache.lookup("alice@example.com", a1));
+
+   cache.add("alice@example.com", "a1", cache.generation("alice@example.com"));
+   cache.add("bob@example.com", "a1", cache.generation("bob@example.com"));
+   cache.clear();
+   assert(cache.size() == 0);
+}
+
+static bool
+cached(UserStore& store, const Data& user, const Data& realm)
+{
+   Data a1;
+   return store.getCachedUserAuthInfo(user, realm, a1);
+}
+
+static void
+testUserStore()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.enableAuthCache(100, 300, 30);
+
+   // the credentials are cached under user@realm, whatever the domain
+   // of the record (user@domain) is
+   assert(store.addUser("alice", "example.com", "realm.one", "secret", true, "Alice", "alice@example.com"));
+   store.getUserAuthInfo("alice", "realm.one");
+   assert(cached(store, "alice", "realm.one"));
+
+   // moving the user to another realm must drop what was cached under
+   // the old one
+   assert(store.updateUser("alice@example.com", "alice", "example.com", "realm.two", "secret", true, "Alice", "alice@example.com"));
+   assert(!cached(store, "alice", "realm.one"));
+
+   // as must renaming it
+   store.getUserAuthInfo("alice", "realm.two");
+   assert(cached(store, "alice", "realm.two"));
+   assert(store.updateUser("alice@example.com", "alicia", "example.com", "realm.two", "secret", true, "Alice", "alice@example.com"));
+   assert(!cached(store, "alice", "realm.two"));
+
+   // unknown users are cached until they are added
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(cached(store, "bob", "example.com"));
+   assert(store.addUser("bob", "example.com", "example.com", "secret", true, "Bob", "bob@example.com"));
+   assert(!cached(store, "bob", "example.com"));
+   assert(!store.getUserAuthInfo("bob", "example.com").empty());
+
+   Data a1 = store.getUserAuthInfo("bob", "example.com");
+   assert(cached(store, "bob", "example.com"));
+   assert(store.updateUser("bob@example.com", "bob", "example.com", "example.com", "other secret", true, "Bob", "bob@example.com"));
+   assert(!cached(store, "bob", "example.com"));
+   Data changed = store.getUserAuthInfo("bob", "example.com");
+   assert(!changed.empty() && changed != a1);
+
+   store.eraseUser("bob@example.com");
+   assert(!cached(store, "bob", "example.com"));
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   testLookup();
+   testLifetimes();
+   testCapacity();
+   testGenerations();
+   testUserStore();
+
+   cout << "PASSED" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,443 @@
+#include "resip/dum/ShardedRegistrationDatabase.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::DUM
+
+ShardedRegistrationDatabase::ShardedRegistrationDatabase(bool checkExpiry,
+                                                         unsigned int numShards,
+                                                         unsigned int sweepIntervalSecs) :
+   mCheckExpiry(checkExpiry),
+   mSweeper(0)
+{
+   size_t shards = 1;
+   while (shards < numShards)
+   {
+      shards <<= 1;
+   }
+   mShards.reserve(shards);
+   for (size_t i = 0; i < shards; ++i)
+   {
+      mShards.push_back(new Shard);
+   }
+   mShardMask = shards - 1;
+
+   if (sweepIntervalSecs)
+   {
+      mSweeper = new Sweeper(*this, sweepIntervalSecs);
+      mSweeper->run();
+   }
+}
+
+ShardedRegistrationDatabase::~ShardedRegistrationDatabase()
+{
+   if (mSweeper)
+   {
+      mSweeper->shutdown();
+      mSweeper->join();
+      delete mSweeper;
+   }
+   for (std::vector<Shard*>::iterator s = mShards.begin(); s != mShards.end(); ++s)
+   {
+      for (RecordMap::iterator i = (*s)->mRecords.begin(); i != (*s)->mRecords.end(); ++i)
+      {
+         delete i->second.mContacts;
+      }
+      delete *s;
+   }
+}
+
+Data
+ShardedRegistrationDatabase::makeKey(const Uri& aor)
+{
+   return aor.getAOR(true);
+}
+
+ShardedRegistrationDatabase::Shard&
+ShardedRegistrationDatabase::shardFor(const Data& key)
+{
+   // The low bits pick the bucket within the shard; use others here.
+   size_t h = key.hash();
+   return *mShards[(h ^ (h >> 16)) & mShardMask];
+}
+
+ShardedRegistrationDatabase::Record&
+ShardedRegistrationDatabase::getRecord(Shard& shard, const Data& key, const Uri& aor)
+{
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i == shard.mRecords.end())
+   {
+      Record& rec = shard.mRecords[key];
+      rec.mAor = aor;
+      return rec;
+   }
+   return i->second;
+}
+
+void
+ShardedRegistrationDatabase::removeExpired(ContactList& contacts, UInt64 now)
+{
+   for (ContactList::iterator i = contacts.begin(); i != contacts.end(); )
+   {
+      if (i->mRegExpires <= now)
+      {
+         DebugLog(<< "ContactInstanceRecord expired: " << i->mContact);
+         i = contacts.erase(i);
+      }
+      else
+      {
+         ++i;
+      }
+   }
+}
+
+void
+ShardedRegistrationDatabase::addAor(const Uri& aor, const ContactList& contacts)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   Record& rec = getRecord(shard, key, aor);
+   if (rec.mContacts)
+   {
+      *rec.mContacts = contacts;
+   }
+   else
+   {
+      rec.mContacts = new ContactList(contacts);
+   }
+}
+
+void
+ShardedRegistrationDatabase::removeAor(const Uri& aor)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i != shard.mRecords.end())
+   {
+      if (i->second.mContacts)
+      {
+         DebugLog (<< "Removed " << i->second.mContacts->size() << " entries");
+         delete i->second.mContacts;
+         i->second.mContacts = 0;
+      }
+      // A locked record goes when it is unlocked.
+      if (!i->second.mLocked)
+      {
+         shard.mRecords.erase(i);
+      }
+   }
+}
+
+bool
+ShardedRegistrationDatabase::aorIsRegistered(const Uri& aor)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i == shard.mRecords.end() || i->second.mContacts == 0)
+   {
+      return false;
+   }
+   if (mCheckExpiry)
+   {
+      removeExpired(*i->second.mContacts, Timer::getTimeSecs());
+      return !i->second.mContacts->empty();
+   }
+   return true;
+}
+
+void
+ShardedRegistrationDatabase::lockRecord(const Uri& aor)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   // This forces insertion if the record does not yet exist.
+   getRecord(shard, key, aor);
+   // The record may be erased and re-created while we wait.
+   RecordMap::iterator i;
+   while ((i = shard.mRecords.find(key)) != shard.mRecords.end() && i->second.mLocked)
+   {
+      shard.mRecordUnlocked.wait(shard.mMutex);
+   }
+   getRecord(shard, key, aor).mLocked = true;
+}
+
+void
+ShardedRegistrationDatabase::unlockRecord(const Uri& aor)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
+
+   // The record must have been inserted when we locked it in the first place
+   assert(i != shard.mRecords.end());
+
+   if (i->second.mContacts == 0)
+   {
+      shard.mRecords.erase(i);
+   }
+   else
+   {
+      i->second.mLocked = false;
+   }
+   shard.mRecordUnlocked.broadcast();
+}
+
+RegistrationPersistenceManager::update_status_t
+ShardedRegistrationDatabase::updateContact(const resip::Uri& aor,
+                                           const ContactInstanceRecord& rec)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   Record& record = getRecord(shard, key, aor);
+   if (record.mContacts == 0)
+   {
+      record.mContacts = new ContactList();
+   }
+   ContactList& contacts = *record.mContacts;
+
+   // See if the contact is already present. We use URI matching rules here.
+   for (ContactList::iterator j = contacts.begin(); j != contacts.end(); ++j)
+   {
+      if (*j == rec)
+      {
+         *j = rec;
+         return CONTACT_UPDATED;
+      }
+   }
+
+   // This is a new contact, so we add it to the list.
+   contacts.push_back(rec);
+   return CONTACT_CREATED;
+}
+
+void
+ShardedRegistrationDatabase::removeContact(const Uri& aor,
+                                           const ContactInstanceRecord& rec)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i == shard.mRecords.end() || i->second.mContacts == 0)
+   {
+      return;
+   }
+   ContactList& contacts = *i->second.mContacts;
+
+   // See if the contact is present. We use URI matching rules here.
+   for (ContactList::iterator j = contacts.begin(); j != contacts.end(); ++j)
+   {
+      if (*j == rec)
+      {
+         contacts.erase(j);
+         if (contacts.empty())
+         {
+            delete i->second.mContacts;
+            i->second.mContacts = 0;
+            if (!i->second.mLocked)
+            {
+               shard.mRecords.erase(i);
+            }
+         }
+         return;
+      }
+   }
+}
+
+void
+ShardedRegistrationDatabase::getContacts(const Uri& aor, ContactList& container)
+{
+   Data key(makeKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if (i == shard.mRecords.end() || i->second.mContacts == 0)
+   {
+      container.clear();
+      return;
+   }
+   if (mCheckExpiry)
+   {
+      removeExpired(*i->second.mContacts, Timer::getTimeSecs());
+   }
+   container = *i->second.mContacts;
+}
+
+void
+ShardedRegistrationDatabase::getAors(UriList& container)
+{
+   container.clear();
+   for (std::vector<Shard*>::iterator s = mShards.begin(); s != mShards.end(); ++s)
+   {
+      Lock g((*s)->mMutex);
+      for (RecordMap::const_iterator i = (*s)->mRecords.begin(); i != (*s)->mRecords.end(); ++i)
+      {
+         if (i->second.mContacts)
+         {
+            container.push_back(i->second.mAor);
+         }
+      }
+   }
+}
+
+size_t
+ShardedRegistrationDatabase::sweepExpired(UInt64 now)
+{
+   size_t removed = 0;
+   for (std::vector<Shard*>::iterator s = mShards.begin(); s != mShards.end(); ++s)
+   {
+      // The shard is swept SweepBatchSize records at a time, dropping the
+      // lock in between; each batch resumes at the key of the first record
+      // it has not looked at yet. If that record went away meanwhile the
+      // shard is walked again from the start, up to twice its size. Records
+      // moved around by a rehash may be missed until the next sweep.
+      Data resumeKey;
+      bool resume = false;
+      size_t visited = 0;
+      size_t limit = 0;
+      for (;;)
+      {
+         Lock g((*s)->mMutex);
+         RecordMap& records = (*s)->mRecords;
+         RecordMap::iterator i = records.begin();
+         if (resume)
+         {
+            i = records.find(resumeKey);
+            if (i == records.end())
+            {
+               i = records.begin();
+            }
+         }
+         else
+         {
+            limit = 2 * records.size();
+         }
+
+         for (unsigned int batch = 0; 
+              batch < SweepBatchSize && i != records.end(); 
+              ++batch, ++visited)
+         {
+            Record& rec = i->second;
+            if (rec.mLocked || rec.mContacts == 0)
+            {
+               ++i;
+               continue;
+            }
+            size_t before = rec.mContacts->size();
+            removeExpired(*rec.mContacts, now);
+            removed += before - rec.mContacts->size();
+            if (rec.mContacts->empty())
+            {
+               delete rec.mContacts;
+               records.erase(i++);
+            }
+            else
+            {
+               ++i;
+            }
+         }
+
+         if (i == records.end() || visited >= limit)
+         {
+            break;
+         }
+         resumeKey = i->first;
+         resume = true;
+      }
+   }
+   if (removed)
+   {
+      DebugLog(<< "Swept " << removed << " expired contacts");
+   }
+   return removed;
+}
+
+size_t
+ShardedRegistrationDatabase::size() const
+{
+   size_t count = 0;
+   for (std::vector<Shard*>::const_iterator s = mShards.begin(); s != mShards.end(); ++s)
+   {
+      Lock g((*s)->mMutex);
+      count += (*s)->mRecords.size();
+   }
+   return count;
+}
+
+ShardedRegistrationDatabase::Sweeper::Sweeper(ShardedRegistrationDatabase& db,
+                                              unsigned int intervalSecs) :
+   mDb(db),
+   mIntervalSecs(intervalSecs)
+{
+}
+
+void
+ShardedRegistrationDatabase::Sweeper::thread()
+{
+   while (!waitForShutdown(mIntervalSecs * 1000))
+   {
+      mDb.sweepExpired(Timer::getTimeSecs());
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,181 @@
+#if !defined(RESIP_SHARDEDREGISTRATIONDATABASE_HXX)
+#define RESIP_SHARDEDREGISTRATIONDATABASE_HXX
+
+#include <vector>
+
+#include "resip/dum/RegistrationPersistenceManager.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+/**
+  In-memory persistence manager for large registrars. Behaves like
+  InMemoryRegistrationDatabase, but spreads the AORs over a number of
+  shards, each with its own hash table, mutex and record lock condition,
+  so that REGISTER processing and lookups for different AORs rarely
+  contend.
+
+  AORs are keyed by Uri::getAOR(true) (scheme, user, canonical host and
+  port), which is what ServerRegistration derives its AORs from, so a
+  lookup is one hash and one string compare rather than a walk of Uri
+  comparisons.
+
+  Expired contacts may be removed by sweepExpired(), either called
+  periodically by the application or from an internal thread if a sweep
+  interval is given. The sweep skips locked records and holds a shard's
+  lock for at most SweepBatchSize records at a time, so lookups never
+  wait for more than one batch.
+*/
+class ShardedRegistrationDatabase : public RegistrationPersistenceManager
+{
+   public:
+
+      /**
+       * @param checkExpiry if set, then the methods aorIsRegistered() and
+       *                    getContacts() will check that contacts are
+       *                    not expired before returning an answer.
+       * @param numShards   rounded up to a power of two
+       * @param sweepIntervalSecs if not 0, a thread calls sweepExpired()
+       *                    at this interval
+       */
+      ShardedRegistrationDatabase(bool checkExpiry = false,
+                                  unsigned int numShards = 64,
+                                  unsigned int sweepIntervalSecs = 0);
+      virtual ~ShardedRegistrationDatabase();
+
+      virtual void addAor(const Uri& aor, const ContactList& contacts);
+      virtual void removeAor(const Uri& aor);
+      virtual bool aorIsRegistered(const Uri& aor);
+
+      virtual void lockRecord(const Uri& aor);
+      virtual void unlockRecord(const Uri& aor);
+
+      virtual update_status_t updateContact(const resip::Uri& aor,
+                                             const ContactInstanceRecord& rec);
+      virtual void removeContact(const Uri& aor,
+                                 const ContactInstanceRecord& rec);
+
+      virtual void getContacts(const Uri& aor, ContactList& container);
+
+      /// return all the AOR in the DB
+      virtual void getAors(UriList& container);
+
+      /**
+       * Removes contacts that expired before now (in seconds, as
+       * Timer::getTimeSecs()), and AORs left without contacts, skipping
+       * locked records. Returns the number of contacts removed.
+       */
+      size_t sweepExpired(UInt64 now);
+
+      /// records sweepExpired() looks at per hold of a shard's lock
+      static const unsigned int SweepBatchSize = 64;
+
+      /// number of AORs in the DB
+      size_t size() const;
+      unsigned int getNumShards() const { return (unsigned int)mShards.size(); }
+
+      /// the key an AOR is stored under
+      static Data makeKey(const Uri& aor);
+
+   protected:
+      struct Record
+      {
+         Record() : mContacts(0), mLocked(false) {}
+         Uri mAor;
+         // 0 once the AOR is removed while locked; erased on unlock
+         ContactList* mContacts;
+         bool mLocked;
+      };
+      typedef HashMap<Data, Record> RecordMap;
+
+      struct Shard
+      {
+         RecordMap mRecords;
+         mutable Mutex mMutex;
+         Condition mRecordUnlocked;
+      };
+
+      Shard& shardFor(const Data& key);
+      // finds or creates the record for aor; the shard must be locked
+      Record& getRecord(Shard& shard, const Data& key, const Uri& aor);
+      void removeExpired(ContactList& contacts, UInt64 now);
+
+      std::vector<Shard*> mShards;
+      size_t mShardMask;
+      bool mCheckExpiry;
+
+      class Sweeper : public ThreadIf
+      {
+         public:
+            Sweeper(ShardedRegistrationDatabase& db, unsigned int intervalSecs);
+            virtual void thread();
+         private:
+            ShardedRegistrationDatabase& mDb;
+            unsigned int mIntervalSecs;
+      };
+      Sweeper* mSweeper;
+
+   private:
+      // disabled
+      ShardedRegistrationDatabase(const ShardedRegistrationDatabase&);
+      ShardedRegistrationDatabase& operator=(const ShardedRegistrationDatabase&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,356 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "resip/dum/InMemoryRegistrationDatabase.hxx"
+#include "resip/dum/ShardedRegistrationDatabase.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// Functional checks of ShardedRegistrationDatabase, then a REGISTER refresh
+// storm against LocationServer style lookups, for it and for
+// InMemoryRegistrationDatabase.
+//
+// usage: testRegistrationDatabase [phones [registrar-threads [lookup-threads]]]
+
+static ContactInstanceRecord
+makeContact(unsigned int phone, UInt64 expires)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(Uri("sip:phone" + Data(phone) + "@192.0.2.1:5060"));
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = Timer::getTimeSecs();
+   return rec;
+}
+
+static Uri
+makeAor(unsigned int phone)
+{
+   return Uri("sip:phone" + Data(phone) + "@example.com");
+}
+
+static void
+testSharded()
+{
+   ShardedRegistrationDatabase db(true, 5);
+   assert(db.getNumShards() == 8);
+   UInt64 now = Timer::getTimeSecs();
+
+   Uri aor("sip:alice@Example.COM");
+   ContactList contacts;
+   db.lockRecord(aor);
+   assert(!db.aorIsRegistered(aor));
+   assert(db.updateContact(aor, makeContact(1, now + 3600)) == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.updateContact(aor, makeContact(2, now + 3600)) == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.updateContact(aor, makeContact(1, now + 7200)) == RegistrationPersistenceManager::CONTACT_UPDATED);
+   db.unlockRecord(aor);
+
+   // the host is canonical
+   Uri same("sip:alice@example.com");
+   assert(db.aorIsRegistered(same));
+   db.getContacts(same, contacts);
+   assert(contacts.size() == 2);
+   assert(contacts.front().mRegExpires == now + 7200);
+   assert(!db.aorIsRegistered(Uri("sip:Alice@example.com")));
+
+   RegistrationPersistenceManager::UriList aors;
+   db.getAors(aors);
+   assert(aors.size() == 1 && aors.front() == aor);
+
+   db.removeContact(aor, makeContact(2, 0));
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 1);
+   db.removeContact(aor, makeContact(1, 0));
+   assert(!db.aorIsRegistered(aor));
+   assert(db.size() == 0);
+
+   // a removed AOR stays until unlocked
+   db.addAor(aor, ContactList(1, makeContact(1, now + 60)));
+   db.lockRecord(aor);
+   db.removeAor(aor);
+   assert(db.size() == 1);
+   assert(!db.aorIsRegistered(aor));
+   db.unlockRecord(aor);
+   assert(db.size() == 0);
+
+   // expired contacts are hidden, and swept unless locked
+   Uri bob("sip:bob@example.com");
+   Uri carol("sip:carol@example.com");
+   db.updateContact(aor, makeContact(1, now - 1));
+   db.updateContact(aor, makeContact(2, now + 60));
+   db.updateContact(bob, makeContact(3, now - 1));
+   db.updateContact(carol, makeContact(4, now - 1));
+   db.lockRecord(carol);
+   assert(db.sweepExpired(now) == 2);
+   assert(db.size() == 2);
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 1);
+   assert(!db.aorIsRegistered(bob));
+   db.unlockRecord(carol);
+   assert(db.sweepExpired(now) == 1);
+   assert(db.size() == 1);
+
+   cerr << "ShardedRegistrationDatabase OK" << endl;
+}
+
+// Keeps adding and removing AORs while a sweep runs.
+class Churn : public ThreadIf
+{
+   public:
+      Churn(ShardedRegistrationDatabase& db, UInt64 now) : mDb(db), mNow(now) {}
+
+      virtual void thread()
+      {
+         for (unsigned int p = 100000; !isShutdown(); ++p)
+         {
+            mDb.updateContact(makeAor(p), makeContact(p, mNow + 60));
+            mDb.removeAor(makeAor(p - 50));
+         }
+      }
+
+   private:
+      ShardedRegistrationDatabase& mDb;
+      UInt64 mNow;
+};
+
+static void
+testShardedSweep()
+{
+   // one shard, so the sweep has to take many batches
+   ShardedRegistrationDatabase db(true, 1);
+   const unsigned int phones = 20 * ShardedRegistrationDatabase::SweepBatchSize + 7;
+   UInt64 now = Timer::getTimeSecs();
+   for (unsigned int p = 0; p < phones; ++p)
+   {
+      db.updateContact(makeAor(p), makeContact(p, p % 3 ? now + 60 : now - 1));
+   }
+   unsigned int expired = (phones + 2) / 3;
+   assert(db.sweepExpired(now) == expired);
+   assert(db.size() == phones - expired);
+   assert(db.sweepExpired(now) == 0);
+
+   // records coming and going between batches don't upset the sweep, and
+   // the live ones survive it
+   for (unsigned int p = 0; p < phones; p += 3)
+   {
+      db.updateContact(makeAor(p), makeContact(p, now - 1));
+   }
+   Churn churn(db, now);
+   churn.run();
+   size_t swept = db.sweepExpired(now);
+   churn.shutdown();
+   churn.join();
+   assert(swept <= expired);
+   swept += db.sweepExpired(now);
+   assert(swept == expired);
+   for (unsigned int p = 0; p < phones; ++p)
+   {
+      assert(db.aorIsRegistered(makeAor(p)) == (p % 3 != 0));
+   }
+
+   cerr << "ShardedRegistrationDatabase sweep OK" << endl;
+}
+
+// Refreshes its share of the phones the way ServerRegistration does.
+class Registrar : public ThreadIf
+{
+   public:
+      Registrar(RegistrationPersistenceManager& db, const vector<Uri>& aors,
+                unsigned int first, unsigned int step) :
+         mDb(db), mAors(aors), mFirst(first), mStep(step)
+      {}
+
+      virtual void thread()
+      {
+         ContactList contacts;
+         UInt64 expires = Timer::getTimeSecs() + 3600;
+         for (unsigned int p = mFirst; p < mAors.size(); p += mStep)
+         {
+            mDb.lockRecord(mAors[p]);
+            mDb.getContacts(mAors[p], contacts);
+            mDb.updateContact(mAors[p], makeContact(p, expires));
+            mDb.unlockRecord(mAors[p]);
+         }
+      }
+
+   private:
+      RegistrationPersistenceManager& mDb;
+      const vector<Uri>& mAors;
+      unsigned int mFirst;
+      unsigned int mStep;
+};
+
+// Looks up random phones the way LocationServer does, until shut down.
+class Locator : public ThreadIf
+{
+   public:
+      Locator(RegistrationPersistenceManager& db, const vector<Uri>& aors, unsigned int seed) :
+         mDb(db), mAors(aors), mSeed(seed), mLookups(0)
+      {}
+
+      virtual void thread()
+      {
+         ContactList contacts;
+         while (!isShutdown())
+         {
+            for (int i = 0; i < 100; ++i)
+            {
+               mSeed = mSeed * 1103515245 + 12345;
+               mDb.getContacts(mAors[(mSeed >> 8) % mAors.size()], contacts);
+               assert(contacts.size() == 1);
+               ++mLookups;
+            }
+         }
+      }
+
+      UInt64 getLookups() const { return mLookups; }
+
+   private:
+      RegistrationPersistenceManager& mDb;
+      const vector<Uri>& mAors;
+      unsigned int mSeed;
+      UInt64 mLookups;
+};
+
+static void
+storm(const char* name, RegistrationPersistenceManager& db, const vector<Uri>& aors,
+      unsigned int registrars, unsigned int locators)
+{
+   UInt64 expires = Timer::getTimeSecs() + 3600;
+   UInt64 start = Timer::getTimeMs();
+   for (unsigned int p = 0; p < aors.size(); ++p)
+   {
+      db.updateContact(aors[p], makeContact(p, expires));
+   }
+   UInt64 loadMs = resipMax(UInt64(1), Timer::getTimeMs() - start);
+
+   vector<Locator*> lookups;
+   for (unsigned int i = 0; i < locators; ++i)
+   {
+      lookups.push_back(new Locator(db, aors, i + 1));
+      lookups.back()->run();
+   }
+   vector<Registrar*> refreshes;
+   start = Timer::getTimeMs();
+   for (unsigned int i = 0; i < registrars; ++i)
+   {
+      refreshes.push_back(new Registrar(db, aors, i, registrars));
+      refreshes.back()->run();
+   }
+   for (unsigned int i = 0; i < registrars; ++i)
+   {
+      refreshes[i]->join();
+      delete refreshes[i];
+   }
+   UInt64 stormMs = resipMax(UInt64(1), Timer::getTimeMs() - start);
+   UInt64 lookupCount = 0;
+   for (unsigned int i = 0; i < locators; ++i)
+   {
+      lookups[i]->shutdown();
+      lookups[i]->join();
+      lookupCount += lookups[i]->getLookups();
+      delete lookups[i];
+   }
+
+   cout << name << ": load " << aors.size() * 1000 / loadMs << " AORs/s, storm "
+        << aors.size() * 1000 / stormMs << " refreshes/s with "
+        << lookupCount * 1000 / stormMs << " lookups/s" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int phones = 100000;
+   unsigned int registrars = 4;
+   unsigned int locators = 4;
+   if (argc > 1)
+   {
+      phones = atoi(argv[1]);
+   }
+   if (argc > 2)
+   {
+      registrars = atoi(argv[2]);
+   }
+   if (argc > 3)
+   {
+      locators = atoi(argv[3]);
+   }
+
+   testSharded();
+   testShardedSweep();
+
+   vector<Uri> aors;
+   aors.reserve(phones);
+   for (unsigned int p = 0; p < phones; ++p)
+   {
+      aors.push_back(makeAor(p));
+   }
+   cout << phones << " phones, " << registrars << " registrar threads, "
+        << locators << " lookup threads" << endl;
+   {
+      InMemoryRegistrationDatabase db;
+      storm("InMemoryRegistrationDatabase", db, aors, registrars, locators);
+   }
+   {
+      ShardedRegistrationDatabase db;
+      storm("ShardedRegistrationDatabase", db, aors, registrars, locators);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -8,6 +8,7 @@
 #include "resip/stack/ConnectionManager.hxx"
 #include "resip/stack/InteropHelper.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "resip/stack/TcpBaseTransport.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -35,8 +36,11 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
    : ConnectionBase(transport,who,compression),
      mRequestPostConnectSocketFuncCall(false),
      mInWritable(false),
+     mPollSuspended(false),
      mFlowTimerEnabled(false),
-     mPollItemHandle(0)
+     mPollItemHandle(0),
+     mBytesWritten(0),
+     mWriteCalls(0)
 {
    mWho.mFlowKey=(FlowKey)socket;
    InfoLog (<< "Connection::Connection: new connection created to who: " << mWho);
@@ -55,6 +59,11 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
 
 Connection::~Connection()
 {
+   if (mWriteCalls)
+   {
+      DebugLog(<< "Connection to " << mWho << " wrote " << mBytesWritten << " bytes in "
+               << mWriteCalls << " writes (" << mBytesWritten/mWriteCalls << " bytes/write)");
+   }
    if(mWho.mFlowKey && ConnectionBase::transport())
    {
       getConnectionManager().removeConnection(this);
@@ -76,8 +85,10 @@ Connection::requestWrite(SendData* sendData)
 void 
 Connection::removeFrontOutstandingSend()
 {
-   delete mOutstandingSends.front();
+   // the queue is linked through the SendData, so unlink before deleting
+   SendData* sent = mOutstandingSends.front();
    mOutstandingSends.pop_front();
+   delete sent;
 
    if (mOutstandingSends.empty())
    {
@@ -156,6 +167,7 @@ Connection::performWrite()
             oldSd->sigcompId,
             false);
       assert(dataWs && dataWs->data.data());
+      dataWs->encodeStart = oldSd->encodeStart;
       uBuffer = (UInt8*)dataWs->data.data();
 
       uBuffer[0] = 0x82;
@@ -186,7 +198,7 @@ Connection::performWrite()
       }
 
       memcpy(uBuffer, dataRaw.data(), dataRaw.size());
-      mOutstandingSends.front() = dataWs;
+      mOutstandingSends.replaceFront(dataWs);
       dataWs = 0;
       delete oldSd;
    }
@@ -212,7 +224,8 @@ Connection::performWrite()
                                      oldSd->transactionId,
                                      oldSd->sigcompId,
                                      true);
-      mOutstandingSends.front() = newSd;
+      newSd->encodeStart = oldSd->encodeStart;
+      mOutstandingSends.replaceFront(newSd);
       delete oldSd;
       delete sm;
    }
@@ -225,11 +238,38 @@ Connection::performWrite()
       mTransport->callSocketFunc(getSocket());
    }
 
-   const Data& data = mOutstandingSends.front()->data;
+   SendData* front = mOutstandingSends.front();
+   WriteBuffer buffers[MaxWriteBuffers];
+   buffers[0].mData = front->data.data() + mSendPos;
+   buffers[0].mLength = int(front->data.size() - mSendPos);
+   int count = 1;
 
-   int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
+   // Plain SIP over a stream can be sent back to back, so hand the socket
+   // as much of the queue as we can in one go. WebSocket and sigcomp
+   // transform one message at a time, above, so they are sent one by one.
+   if (mSendingTransmissionFormat == Uncompressed)
+   {
+      int gathered = buffers[0].mLength;
+      for (SendData* sd = SendDataQueue::next(front);
+           sd && sd->command == SendData::NoCommand &&
+              count < MaxWriteBuffers && gathered < MaxWriteBytes;
+           sd = SendDataQueue::next(sd))
+      {
+         if (sd->data.empty())
+         {
+            break;
+         }
+         buffers[count].mData = sd->data.data();
+         buffers[count].mLength = int(sd->data.size());
+         gathered += buffers[count].mLength;
+         ++count;
+      }
+   }
+
+   int nBytes = (count == 1) ? write(buffers[0].mData, buffers[0].mLength)
+                             : writeBuffers(buffers, count);
 
-   //DebugLog (<< "Tried to send " << data.size() - mSendPos << " bytes, sent " << nBytes << " bytes");
+   //DebugLog (<< "Tried to send " << count << " buffers, sent " << nBytes << " bytes");
 
    if (nBytes < 0)
    {
@@ -245,18 +285,42 @@ Connection::performWrite()
    }
    else
    {
+      ++mWriteCalls;
+      mBytesWritten += nBytes;
+      StackStatistics::increment(StackStatistics::StreamWrites);
+      StackStatistics::increment(StackStatistics::StreamWriteBytes, nBytes);
+
       // Safe because of the conditional above ( < 0 ).
       Data::size_type bytesWritten = static_cast<Data::size_type>(nBytes);
-      mSendPos += bytesWritten;
-      if (mSendPos == data.size())
+      Data::size_type left = bytesWritten;
+      int i = 0; // messages finished
+      for (; i < count && left > 0; ++i)
       {
+         Data::size_type pending = static_cast<Data::size_type>(buffers[i].mLength);
+         if (left < pending)
+         {
+            mSendPos += left;
+            break;
+         }
+         left -= pending;
          mSendPos = 0;
+         if (mOutstandingSends.front()->encodeStart)
+         {
+            StackStatistics::recordSince(StackStatistics::Transmit, mOutstandingSends.front()->encodeStart);
+         }
          removeFrontOutstandingSend();
       }
+      StackStatistics::increment(StackStatistics::StreamWriteMessages, i);
       return bytesWritten;
    }
 }
 
+int
+Connection::writeBuffers(const WriteBuffer* buffers, int count)
+{
+   assert(count > 0);
+   return write(buffers[0].mData, buffers[0].mLength);
+}
 
 bool 
 Connection::performWrites(unsigned int max)
@@ -285,6 +349,18 @@ Connection::ensureWritable()
    }
 }
 
+void
+Connection::suspendPolling()
+{
+   getConnectionManager().suspendPolling(this);
+}
+
+void
+Connection::resumePolling()
+{
+   getConnectionManager().resumePolling(this);
+}
+
 ConnectionManager&
 Connection::getConnectionManager() const
 {
@@ -100,6 +100,11 @@ class Connection : public ConnectionBase,
       void enableFlowTimer();
       bool isFlowTimerEnabled() { return mFlowTimerEnabled; }
 
+      /// Bytes handed to the socket (or SSL) since this connection was created
+      UInt64 getBytesWritten() const { return mBytesWritten; }
+      /// Number of successful write system calls (or SSL_writes) made
+      UInt64 getWriteCalls() const { return mWriteCalls; }
+
       bool mRequestPostConnectSocketFuncCall;
       static volatile bool mEnablePostConnectSocketFuncCall;
       static void setEnablePostConnectSocketFuncCall(bool enabled = true) { mEnablePostConnectSocketFuncCall = enabled; }
@@ -109,9 +114,33 @@ class Connection : public ConnectionBase,
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+
+      /// One piece of a gathering write
+      struct WriteBuffer
+      {
+         const char* mData;
+         int mLength;
+      };
+
+      /** Writes as much of buffers[0..count), in order, as can be written
+          without blocking; same return convention as write(). Only called
+          with count > 1. The default writes the first buffer alone;
+          transports that can gather override this. */
+      virtual int writeBuffers(const WriteBuffer* buffers, int count);
+
+      /// most SendData coalesced into one writeBuffers() call
+      static const int MaxWriteBuffers = 64;
+      /// coalescing stops once this many bytes are gathered
+      static const int MaxWriteBytes = 64*1024;
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
+      /** Stops watching the socket, for when another thread has taken over
+          the connection for a while; writes requested meanwhile are only
+          noted. resumePolling() starts watching it again. */
+      void suspendPolling();
+      void resumePolling();
+
       /* callback method of FdPollItemIf */
       virtual void processPollEvent(FdPollEventMask mask);
 
@@ -119,8 +148,11 @@ class Connection : public ConnectionBase,
       ConnectionManager& getConnectionManager() const;
       void removeFrontOutstandingSend();
       bool mInWritable;
+      bool mPollSuspended;
       bool mFlowTimerEnabled;
       FdPollItemHandle mPollItemHandle;
+      UInt64 mBytesWritten;
+      UInt64 mWriteCalls;
       
       /// no default c'tor
       Connection();
@@ -14,6 +14,7 @@
 #include "resip/stack/WsCookieContext.hxx"
 #include "resip/stack/WsCookieContextFactory.hxx"
 #include "resip/stack/Symbols.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "rutil/WinLeakCheck.hxx"
 #include "rutil/SharedPtr.hxx"
 #include "rutil/Sha1.hxx"
@@ -103,8 +104,8 @@ ConnectionBase::~ConnectionBase()
       mTransport->fail(sendData->transactionId,
          mFailureReason ? mFailureReason : TransportFailure::ConnectionUnknown,
          mFailureSubCode);
-      delete sendData;
       mOutstandingSends.pop_front();
+      delete sendData;
    }
    delete [] mBuffer;
    delete mMessage;
@@ -201,10 +202,15 @@ ConnectionBase::preparseNewBytes(int bytesRead)
       {
          unsigned int chunkLength = (unsigned int)mBufferPos + bytesRead;
          char *unprocessedCharPtr;
+         UInt64 scanStart = Timer::getTimeMicroSec();
          MsgHeaderScanner::ScanChunkResult scanChunkResult =
             mMsgHeaderScanner.scanChunk(mBuffer,
                                         chunkLength,
                                         &unprocessedCharPtr);
+         if (scanChunkResult == MsgHeaderScanner::scrEnd)
+         {
+            StackStatistics::recordSince(StackStatistics::Parse, scanStart);
+         }
          if (scanChunkResult == MsgHeaderScanner::scrError)
          {
             //.jacob. Not a terribly informative warning.
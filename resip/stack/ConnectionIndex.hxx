@@ -0,0 +1,401 @@
+#if !defined(RESIP_CONNECTIONINDEX_HXX)
+#define RESIP_CONNECTIONINDEX_HXX
+
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "rutil/compat.hxx"
+#include "rutil/Socket.hxx"
+#include "resip/stack/Tuple.hxx"
+
+namespace resip
+{
+
+/**
+   Occupancy and probing figures of a TupleIndex, see
+   ConnectionManager::getTableStats().
+*/
+class ConnectionTableStats
+{
+   public:
+      ConnectionTableStats() :
+         mSize(0),
+         mCapacity(0),
+         mMeanProbeLength(0),
+         mMaxProbeLength(0),
+         mLookups(0),
+         mLookupProbes(0),
+         mFdDirect(0),
+         mFdOverflow(0)
+      {}
+
+      double loadFactor() const
+      {
+         return mCapacity ? double(mSize)/double(mCapacity) : 0;
+      }
+
+      /// entries in the address index
+      size_t mSize;
+      /// slots in the address index
+      size_t mCapacity;
+      /// average number of slots visited to find a present entry
+      double mMeanProbeLength;
+      /// longest such search
+      unsigned int mMaxProbeLength;
+      /// lookups by address so far, and the slots they visited in total
+      UInt64 mLookups;
+      UInt64 mLookupProbes;
+      /// entries in the fd index that are held in the flat vector, and in
+      /// the overflow map (fds too large to index directly)
+      size_t mFdDirect;
+      size_t mFdOverflow;
+};
+
+EncodeStream& operator<<(EncodeStream& strm, const ConnectionTableStats& stats);
+
+/**
+   @internal
+   @brief Open addressing (linear probing) hash index of objects by the
+   Tuple they return from who().
+
+   Only the object pointer and the hash of its Tuple are stored, 16 bytes per
+   slot, so a lookup usually touches one cache line of the table plus the
+   object it finds. Removal uses backward shifting, so there are no
+   tombstones and probe lengths do not degrade with churn. The table is kept
+   at most 70% full.
+
+   Tuples are compared with Tuple::operator==, so like the std::map this
+   replaces, the connection id (mFlowKey) and target domain are ignored.
+*/
+template <class T>
+class TupleIndex
+{
+   public:
+      TupleIndex() :
+         mSlots(MinCapacity),
+         mSize(0),
+         mLookups(0),
+         mLookupProbes(0)
+      {}
+
+      size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+      T* find(const Tuple& tuple) const
+      {
+         size_t h = hash(tuple);
+         size_t mask = mSlots.size() - 1;
+         ++mLookups;
+         for (size_t i = h & mask; ; i = (i+1) & mask)
+         {
+            ++mLookupProbes;
+            const Slot& s = mSlots[i];
+            if (s.mValue == 0)
+            {
+               return 0;
+            }
+            if (s.mHash == h && s.mValue->who() == tuple)
+            {
+               return s.mValue;
+            }
+         }
+      }
+
+      /// value must not be in the index, and no equal Tuple either
+      void insert(T* value)
+      {
+         assert(value);
+         if ((mSize+1)*10 > mSlots.size()*7)
+         {
+            rehash(mSlots.size()*2);
+         }
+         place(Slot(hash(value->who()), value));
+         ++mSize;
+      }
+
+      /// Removes exactly this object; returns false if it was not indexed.
+      bool erase(T* value)
+      {
+         size_t mask = mSlots.size() - 1;
+         size_t i = hash(value->who()) & mask;
+         while (mSlots[i].mValue != value)
+         {
+            if (mSlots[i].mValue == 0)
+            {
+               return false;
+            }
+            i = (i+1) & mask;
+         }
+
+         // shift later members of the cluster back so that none of them
+         // ends up behind an empty slot
+         for (size_t j = (i+1) & mask; mSlots[j].mValue; j = (j+1) & mask)
+         {
+            size_t home = mSlots[j].mHash & mask;
+            // move j into the hole at i unless its home lies in (i, j]
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+               mSlots[i] = mSlots[j];
+               i = j;
+            }
+         }
+         mSlots[i] = Slot();
+         --mSize;
+         return true;
+      }
+
+      /// appends every indexed object to out
+      void values(std::vector<T*>& out) const
+      {
+         for (typename Slots::const_iterator i = mSlots.begin(); i != mSlots.end(); ++i)
+         {
+            if (i->mValue)
+            {
+               out.push_back(i->mValue);
+            }
+         }
+      }
+
+      /// fills in the address index part of stats; walks the whole table
+      void getStats(ConnectionTableStats& stats) const
+      {
+         size_t mask = mSlots.size() - 1;
+         UInt64 total = 0;
+         stats.mMaxProbeLength = 0;
+         for (size_t i = 0; i < mSlots.size(); ++i)
+         {
+            if (mSlots[i].mValue)
+            {
+               unsigned int probes = (unsigned int)((i - (mSlots[i].mHash & mask)) & mask) + 1;
+               total += probes;
+               stats.mMaxProbeLength = resipMax(stats.mMaxProbeLength, probes);
+            }
+         }
+         stats.mSize = mSize;
+         stats.mCapacity = mSlots.size();
+         stats.mMeanProbeLength = mSize ? double(total)/double(mSize) : 0;
+         stats.mLookups = mLookups;
+         stats.mLookupProbes = mLookupProbes;
+      }
+
+      /**
+         Hashes what Tuple::operator== compares (except the network
+         namespace): address, port and transport type, through a 64 bit
+         multiplicative mix so that the low bits used to pick a slot depend
+         on all of them.
+      */
+      static size_t hash(const Tuple& tuple)
+      {
+         const sockaddr& sa = tuple.getSockaddr();
+         UInt64 h;
+#ifdef USE_IPV6
+         if (sa.sa_family == AF_INET6)
+         {
+            const sockaddr_in6& in6 = reinterpret_cast<const sockaddr_in6&>(sa);
+            UInt32 words[4];
+            memcpy(words, &in6.sin6_addr, sizeof(words));
+            h = mix((UInt64(words[0]) << 32) | words[1]);
+            h = mix(h ^ ((UInt64(words[2]) << 32) | words[3]));
+            h = mix(h ^ ((UInt64(in6.sin6_port) << 8) | UInt64(tuple.getType())));
+         }
+         else
+#endif
+         {
+            const sockaddr_in& in4 = reinterpret_cast<const sockaddr_in&>(sa);
+            h = mix((UInt64(in4.sin_addr.s_addr) << 32) |
+                    (UInt64(in4.sin_port) << 8) |
+                    UInt64(tuple.getType()));
+         }
+         return size_t(h);
+      }
+
+   private:
+      static const size_t MinCapacity = 64;
+
+      struct Slot
+      {
+         Slot() : mHash(0), mValue(0) {}
+         Slot(size_t hash, T* value) : mHash(hash), mValue(value) {}
+         size_t mHash;
+         T* mValue;
+      };
+      typedef std::vector<Slot> Slots;
+
+      static UInt64 mix(UInt64 k)
+      {
+         // the finalizer of MurmurHash3
+         k ^= k >> 33;
+         k *= UInt64(0xff51afd7ed558ccdULL);
+         k ^= k >> 33;
+         k *= UInt64(0xc4ceb9fe1a85ec53ULL);
+         k ^= k >> 33;
+         return k;
+      }
+
+      void place(const Slot& slot)
+      {
+         size_t mask = mSlots.size() - 1;
+         size_t i = slot.mHash & mask;
+         while (mSlots[i].mValue)
+         {
+            i = (i+1) & mask;
+         }
+         mSlots[i] = slot;
+      }
+
+      void rehash(size_t capacity)
+      {
+         Slots old(capacity);
+         old.swap(mSlots);
+         for (typename Slots::const_iterator i = old.begin(); i != old.end(); ++i)
+         {
+            if (i->mValue)
+            {
+               place(*i);
+            }
+         }
+      }
+
+      Slots mSlots;
+      size_t mSize;
+      mutable UInt64 mLookups;
+      mutable UInt64 mLookupProbes;
+};
+
+/**
+   @internal
+   @brief Index of objects by socket descriptor.
+
+   Descriptors are small integers on most platforms, so they index a flat
+   vector directly; anything beyond MaxDirect (or Windows SOCKET handles
+   that happen to be large) goes to an overflow map.
+*/
+template <class T>
+class FdIndex
+{
+   public:
+      FdIndex() : mDirect(0) {}
+
+      size_t size() const { return mDirect + mOverflow.size(); }
+
+      T* find(Socket fd) const
+      {
+         if (isDirect(fd))
+         {
+            return size_t(fd) < mSlots.size() ? mSlots[size_t(fd)] : 0;
+         }
+         typename Overflow::const_iterator i = mOverflow.find(fd);
+         return i == mOverflow.end() ? 0 : i->second;
+      }
+
+      void insert(Socket fd, T* value)
+      {
+         if (isDirect(fd))
+         {
+            if (size_t(fd) >= mSlots.size())
+            {
+               mSlots.resize(resipMax(size_t(fd)+1, mSlots.size()*2), 0);
+            }
+            if (mSlots[size_t(fd)] == 0)
+            {
+               ++mDirect;
+            }
+            mSlots[size_t(fd)] = value;
+         }
+         else
+         {
+            mOverflow[fd] = value;
+         }
+      }
+
+      void erase(Socket fd)
+      {
+         if (isDirect(fd))
+         {
+            if (size_t(fd) < mSlots.size() && mSlots[size_t(fd)])
+            {
+               mSlots[size_t(fd)] = 0;
+               --mDirect;
+            }
+         }
+         else
+         {
+            mOverflow.erase(fd);
+         }
+      }
+
+      void getStats(ConnectionTableStats& stats) const
+      {
+         stats.mFdDirect = mDirect;
+         stats.mFdOverflow = mOverflow.size();
+      }
+
+   private:
+      static const size_t MaxDirect = 1 << 22;
+      typedef std::map<Socket, T*> Overflow;
+
+      static bool isDirect(Socket fd)
+      {
+         return size_t(fd) < MaxDirect;
+      }
+
+      std::vector<T*> mSlots;
+      size_t mDirect;
+      Overflow mOverflow;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
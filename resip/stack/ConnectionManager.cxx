@@ -36,6 +36,12 @@ ConnectionManager::ConnectionManager() :
 
 ConnectionManager::~ConnectionManager()
 {
+   if(!mAddrMap.empty())
+   {
+      ConnectionTableStats stats;
+      getTableStats(stats);
+      InfoLog(<< "Connection table at shutdown: " << stats);
+   }
    closeConnections();
    assert(mReadHead->empty());
    assert(mWriteHead->empty());
@@ -46,10 +52,37 @@ ConnectionManager::~ConnectionManager()
 void 
 ConnectionManager::closeConnections()
 {
-   while (!mAddrMap.empty())
+   // each delete removes the connection from the maps
+   std::vector<Connection*> connections;
+   mAddrMap.values(connections);
+   for (std::vector<Connection*>::iterator i = connections.begin(); 
+        i != connections.end(); ++i)
    {
-      delete mAddrMap.begin()->second;
+      delete *i;
    }
+   assert(mAddrMap.empty());
+}
+
+void
+ConnectionManager::getTableStats(ConnectionTableStats& stats) const
+{
+   mAddrMap.getStats(stats);
+   mIdMap.getStats(stats);
+}
+
+EncodeStream&
+resip::operator<<(EncodeStream& strm, const ConnectionTableStats& stats)
+{
+   strm << "connections=" << stats.mSize
+        << " slots=" << stats.mCapacity
+        << " load=" << stats.loadFactor()
+        << " meanProbe=" << stats.mMeanProbeLength
+        << " maxProbe=" << stats.mMaxProbeLength
+        << " lookups=" << stats.mLookups
+        << " probesPerLookup=" << (stats.mLookups ? double(stats.mLookupProbes)/double(stats.mLookups) : 0)
+        << " fdDirect=" << stats.mFdDirect
+        << " fdOverflow=" << stats.mFdOverflow;
+   return strm;
 }
 
 Connection*
@@ -57,19 +90,19 @@ ConnectionManager::findConnection(const Tuple& addr)
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = mIdMap.find((Socket)addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who() == addr)
+         if(conn->who() == addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -83,11 +116,11 @@ ConnectionManager::findConnection(const Tuple& addr)
       }
    }
    
-   AddrMap::iterator i = mAddrMap.find(addr);
-   if (i != mAddrMap.end())
+   Connection* conn = mAddrMap.find(addr);
+   if (conn)
    {
       DebugLog(<<"Found connection for tuple "<< addr );
-      return i->second;
+      return conn;
    }
 
    DebugLog(<<"Could not find a connection for " << addr);
@@ -99,19 +132,19 @@ ConnectionManager::findConnection(const Tuple& addr) const
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::const_iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = mIdMap.find((Socket)addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who()==addr)
+         if(conn->who()==addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -120,11 +153,11 @@ ConnectionManager::findConnection(const Tuple& addr) const
       }
    }
    
-   AddrMap::const_iterator i = mAddrMap.find(addr);
-   if (i != mAddrMap.end())
+   Connection* conn = mAddrMap.find(addr);
+   if (conn)
    {
       DebugLog(<<"Found connection for tuple "<< addr );
-      return i->second;
+      return conn;
    }
 
    DebugLog(<<"Could not find a connection for " << addr);
@@ -155,6 +188,11 @@ ConnectionManager::buildFdSet(FdSet& fdset)
 void
 ConnectionManager::addToWritable(Connection* conn)
 {
+   if ( conn->mPollSuspended )
+   {
+      // resumePolling() looks at mInWritable
+      return;
+   }
    if ( mPollGrp ) 
    {
       mPollGrp->modPollItem(conn->mPollItemHandle, FPEM_Read|FPEM_Write|FPEM_Error);
@@ -168,6 +206,10 @@ ConnectionManager::addToWritable(Connection* conn)
 void
 ConnectionManager::removeFromWritable(Connection* conn)
 {
+   if ( conn->mPollSuspended )
+   {
+      return;
+   }
    if ( mPollGrp ) 
    {
       mPollGrp->modPollItem(conn->mPollItemHandle, FPEM_Read|FPEM_Error);
@@ -179,15 +221,51 @@ ConnectionManager::removeFromWritable(Connection* conn)
    }
 }
 
+void
+ConnectionManager::suspendPolling(Connection* conn)
+{
+   assert(!conn->mPollSuspended);
+   conn->mPollSuspended = true;
+   if ( mPollGrp ) 
+   {
+      mPollGrp->modPollItem(conn->mPollItemHandle, FPEM_Error);
+   }
+   else
+   {
+      conn->ConnectionReadList::remove();
+      conn->ConnectionWriteList::remove();
+   }
+}
+
+void
+ConnectionManager::resumePolling(Connection* conn)
+{
+   assert(conn->mPollSuspended);
+   conn->mPollSuspended = false;
+   if ( mPollGrp ) 
+   {
+      mPollGrp->modPollItem(conn->mPollItemHandle,
+                            conn->mInWritable ? FPEM_Read|FPEM_Write|FPEM_Error : FPEM_Read|FPEM_Error);
+   }
+   else
+   {
+      mReadHead->push_back(conn);
+      if (conn->mInWritable)
+      {
+         mWriteHead->push_back(conn);
+      }
+   }
+}
+
 void
 ConnectionManager::addConnection(Connection* connection)
 {
-   assert(mAddrMap.find(connection->who())==mAddrMap.end());
+   assert(mAddrMap.find(connection->who())==0);
 
    DebugLog (<< "ConnectionManager::addConnection() " << connection->mWho.mFlowKey  << ":" << connection->who() << ", totalConnections=" << mIdMap.size());
    
-   mAddrMap[connection->who()] = connection;
-   mIdMap[connection->who().mFlowKey] = connection;
+   mAddrMap.insert(connection);
+   mIdMap.insert((Socket)connection->who().mFlowKey, connection);
 
    if ( mPollGrp ) 
    {
@@ -206,9 +284,7 @@ ConnectionManager::addConnection(Connection* connection)
       gc(MinimumGcAge, 0);  // cleanup all connections that haven't seen data in last x ms
    }
 
-   //DebugLog (<< "count=" << mAddrMap.count(connection->who()) << "who=" << connection->who() << " mAddrMap=" << Inserter(mAddrMap));
-   //assert(mAddrMap.begin()->first == connection->who());
-   assert(mAddrMap.count(connection->who()) == 1);
+   assert(mAddrMap.find(connection->who()) == connection);
 }
 
 void
@@ -216,8 +292,8 @@ ConnectionManager::removeConnection(Connection* connection)
 {
    //DebugLog (<< "ConnectionManager::removeConnection()");
 
-   mIdMap.erase(connection->mWho.mFlowKey);
-   mAddrMap.erase(connection->mWho);
+   mIdMap.erase((Socket)connection->mWho.mFlowKey);
+   mAddrMap.erase(connection);
 
    if ( mPollGrp ) 
    {
@@ -225,7 +301,7 @@ ConnectionManager::removeConnection(Connection* connection)
    }
    else
    {
-      assert(!mReadHead->empty());
+      assert(connection->mPollSuspended || !mReadHead->empty());
       connection->ConnectionReadList::remove();
       connection->ConnectionWriteList::remove();
       if(connection->isFlowTimerEnabled())
@@ -306,13 +382,13 @@ ConnectionManager::gc(UInt64 relThreshold, unsigned int maxToRemove)
       else
       {
          rlim_t& soft_limit = rlim.rlim_cur;
-         AddrMap::size_type conn_count = mAddrMap.size();
-         AddrMap::size_type headroom = soft_limit - conn_count;
+         size_t conn_count = mAddrMap.size();
+         size_t headroom = soft_limit - conn_count;
          DebugLog(<< "GC headroom check: soft_limit = " << soft_limit << ", managed connection count = " << conn_count << ", headroom = " << headroom << ", minimum headroom = " << MinimumGcHeadroom);
          if(headroom < MinimumGcHeadroom)
          {
             WarningLog(<< "actual headroom = " << headroom << ", MinimumGcHeadroom = " << MinimumGcHeadroom << ", garbage collector making extra effort to reclaim file descriptors");
-            AddrMap::size_type mustRemove = MinimumGcHeadroom - headroom;
+            size_t mustRemove = MinimumGcHeadroom - headroom;
             unsigned int remainder = gcWithTarget(mustRemove);
             numRemoved += (mustRemove - remainder);
             if(remainder > 0)
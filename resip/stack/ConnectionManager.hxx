@@ -1,9 +1,8 @@
 #ifndef RESIP_ConnectionMgr_hxx
 #define RESIP_ConnectionMgr_hxx 
 
-#include <map>
-#include "rutil/HashMap.hxx"
 #include "resip/stack/Connection.hxx"
+#include "resip/stack/ConnectionIndex.hxx"
 
 namespace resip
 {
@@ -14,7 +13,8 @@ class FdPollGrp;
    orders for read and write.  Maintains least-recently-used connections list
    for garbage collection.
 
-   Maintains mapping from Tuple to Connection.
+   Maintains mapping from Tuple to Connection (a hash index) and from
+   socket to Connection (a vector indexed by fd).
  */
 class ConnectionManager
 {
@@ -42,6 +42,12 @@ class ConnectionManager
       Connection* findConnection(const Tuple& tuple);
       const Connection* findConnection(const Tuple& tuple) const;
 
+      /// number of managed connections
+      size_t size() const { return mAddrMap.size(); }
+
+      /// load factor and probe lengths of the connection tables
+      void getTableStats(ConnectionTableStats& stats) const;
+
       /// populate the fdset againt the read and write lists
       void setPollGrp(FdPollGrp *grp);
       void buildFdSet(FdSet& fdset);
@@ -50,9 +56,11 @@ class ConnectionManager
    private:
       void addToWritable(Connection* conn); // add the specified conn to end
       void removeFromWritable(Connection* conn); // remove the current mWriteMark
+      void suspendPolling(Connection* conn); // watch for nothing but errors
+      void resumePolling(Connection* conn); // back to reads, and writes if mInWritable
 
-      typedef std::map<Tuple, Connection*> AddrMap;
-      typedef std::map<Socket, Connection*> IdMap;
+      typedef TupleIndex<Connection> AddrMap;
+      typedef FdIndex<Connection> IdMap;
 
       void addConnection(Connection* connection);
       void removeConnection(Connection* connection);
@@ -29,6 +29,11 @@ class ContentsFactory : public ContentsFactoryBase
          return new T(hfv, contentType);
       }
 
+      virtual Contents* create(const HeaderFieldValue& hfv, const Mime& contentType, PoolBase* pool) const
+      {
+         return new (pool) T(hfv, contentType);
+      }
+
       virtual Contents* convert(Contents* c) const
       {
          return dynamic_cast<T*>(c);
@@ -34,6 +34,14 @@ ContentsFactoryBase::~ContentsFactoryBase()
    }
 }
 
+Contents*
+ContentsFactoryBase::create(const HeaderFieldValue& hfv,
+                            const Mime& contentType,
+                            PoolBase* /* pool */) const
+{
+   return create(hfv, contentType);
+}
+
 HashMap<Mime, ContentsFactoryBase*>& 
 ContentsFactoryBase::getFactoryMap()
 {
@@ -3,6 +3,7 @@
 
 #include "resip/stack/Mime.hxx"
 #include "rutil/HashMap.hxx"
+#include "rutil/PoolBase.hxx"
 
 namespace resip
 {
@@ -20,6 +21,11 @@ class ContentsFactoryBase
       virtual ~ContentsFactoryBase();
       virtual Contents* create(const HeaderFieldValue& hfv, 
                                const Mime& contentType) const = 0;
+      /// As above, but the contents may be constructed in memory from pool.
+      /// The default ignores pool and allocates from the heap.
+      virtual Contents* create(const HeaderFieldValue& hfv,
+                               const Mime& contentType,
+                               PoolBase* pool) const;
       virtual Contents* convert(Contents* c) const = 0;
 
       static HashMap<Mime, ContentsFactoryBase*>& getFactoryMap();
@@ -34,7 +34,8 @@ using namespace resip;
 
 DnsInterface::DnsInterface(DnsStub& dnsStub) : 
    mUdpOnlyOnNumeric(false),
-   mDnsStub(dnsStub)
+   mDnsStub(dnsStub),
+   mMarkManager(&dnsStub)
 {
 #ifdef USE_DNS_VIP
    mDnsStub.setResultTransform(&mVip);
@@ -103,7 +103,7 @@ class DnsInterface
 
       DnsStub& mDnsStub;  
       RRVip mVip;                      // Ensure all access is from DnsThread/DnsStub fifo for thread safety
-      TupleMarkManager mMarkManager;   // Ensure all access is from DnsThread/DnsStub fifo for thread safety
+      TupleMarkManager mMarkManager;   // Changes only from DnsThread/DnsStub fifo; getMarkType() from anywhere
 };
 
 }
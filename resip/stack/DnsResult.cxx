@@ -37,6 +37,7 @@
 #include "rutil/dns/DnsNaptrRecord.hxx"
 #include "resip/stack/DnsResult.hxx"
 #include "resip/stack/DnsInterface.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "resip/stack/Tuple.hxx"
 #include "resip/stack/Uri.hxx"
 #include "rutil/WinLeakCheck.hxx"  // not compatible with placement new used below
@@ -103,6 +104,7 @@ DnsResult::DnsResult(DnsInterface& interfaceObj, DnsStub& dns, RRVip& vip, DnsHa
      mPort(-1),
      mHaveChosenTransport(false),
      mType(Pending),
+     mLookupStart(0),
      mCumulativeWeight(0),
      mHaveReturnedResults(false)
 {
@@ -122,6 +124,12 @@ DnsResult::transition(Type t)
    {
       assert(0);
    }
+
+   if (mLookupStart && (t == Available || t == Finished))
+   {
+      StackStatistics::recordSince(StackStatistics::DnsResolution, mLookupStart);
+      mLookupStart = 0;
+   }
    
    mType = t;
 }
@@ -259,6 +267,7 @@ void
 DnsResult::lookup(const Uri& uri)
 {
    DebugLog (<< "DnsResult::lookup " << uri);
+   mLookupStart = Timer::getTimeMicroSec();
 
    // Dispatch lookup request to DnsThread
    LookupCommand *command = new LookupCommand(*this, uri);
@@ -276,6 +276,9 @@ class DnsResult : public DnsResultSink, public EnumResultSink
       */
       Type mType;
 
+      // when lookup() was called; cleared once the first result is in
+      UInt64 mLookupStart;
+
       //Ugly hack
       Data mPassHostFromAAAAtoA;
 
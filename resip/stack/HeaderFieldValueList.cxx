@@ -4,6 +4,7 @@
 
 
 #include <cassert>
+#include <cstring>
 
 #include "resip/stack/HeaderFieldValue.hxx"
 #include "resip/stack/HeaderFieldValueList.hxx"
@@ -23,31 +24,21 @@ HeaderFieldValueList::~HeaderFieldValueList()
 HeaderFieldValueList::HeaderFieldValueList(const HeaderFieldValueList& rhs)
    : mHeaders(),
      mPool(0),
-     mParserContainer(0)
+     mParserContainer(0),
+     mWireLine(0),
+     mVerbatim(false)
 {
-   if (rhs.mParserContainer)
-   {
-      mParserContainer = rhs.mParserContainer->clone();
-   }
-   else if(rhs.mHeaders.size())
-   {
-      mHeaders=rhs.mHeaders;
-   }
+   copyFrom(rhs);
 }
 
 HeaderFieldValueList::HeaderFieldValueList(const HeaderFieldValueList& rhs, PoolBase& pool)
    : mHeaders(StlPoolAllocator<HeaderFieldValue, PoolBase>(&pool)),
      mPool(&pool),
-     mParserContainer(0)
+     mParserContainer(0),
+     mWireLine(0),
+     mVerbatim(false)
 {
-   if (rhs.mParserContainer)
-   {
-      mParserContainer = rhs.mParserContainer->clone();
-   }
-   else if(rhs.mHeaders.size())
-   {
-      mHeaders=rhs.mHeaders;
-   }
+   copyFrom(rhs);
 }
 
 HeaderFieldValueList&
@@ -58,23 +49,120 @@ HeaderFieldValueList::operator=(const HeaderFieldValueList& rhs)
       mHeaders.clear();
 
       freeParserContainer();
+      mWire.clear();
+      dropWire();
+
+      copyFrom(rhs);
+   }
+   
+   return *this;
+}
 
-      if (rhs.mParserContainer != 0)
+void
+HeaderFieldValueList::copyFrom(const HeaderFieldValueList& rhs)
+{
+   if (rhs.mVerbatim && rhs.mParserContainer == 0)
+   {
+      const char* wire = rhs.mWire.getBuffer();
+      const char* wireEnd = wire + rhs.mWire.getLength();
+      const_iterator i = rhs.begin();
+      for (; i != rhs.end(); ++i)
       {
-         mParserContainer = rhs.mParserContainer->clone();
+         if (i->getBuffer() < wire || i->getBuffer() + i->getLength() > wireEnd)
+         {
+            break;
+         }
       }
-      else
+      if (i == rhs.end())
       {
-         mHeaders=rhs.mHeaders;
+         // one allocation for the whole header instead of one per value
+         char* buffer = new char[rhs.mWire.getLength()];
+         memcpy(buffer, wire, rhs.mWire.getLength());
+         mWire.init(buffer, rhs.mWire.getLength(), true);
+         mVerbatim = true;
+         mHeaders.reserve(rhs.size());
+         for (i = rhs.begin(); i != rhs.end(); ++i)
+         {
+            mHeaders.push_back(HeaderFieldValue::Empty);
+            mHeaders.back().init(buffer + (i->getBuffer() - wire), i->getLength(), false);
+         }
+         return;
       }
    }
-   
-   return *this;
+
+   if (rhs.mParserContainer != 0)
+   {
+      mParserContainer = rhs.mParserContainer->clone();
+   }
+   else if(rhs.mHeaders.size())
+   {
+      mHeaders=rhs.mHeaders;
+   }
+
+   if (rhs.mVerbatim)
+   {
+      mWire = rhs.mWire;
+      mVerbatim = true;
+   }
+}
+
+void
+HeaderFieldValueList::addWire(const char* line, const char* valueEnd, 
+                              const char* lo, const char* hi)
+{
+   if (line == 0 || line < lo || valueEnd > hi || valueEnd < line)
+   {
+      dropWire();
+      return;
+   }
+
+   if (mHeaders.size() == 1)
+   {
+      mWire.init(line, valueEnd - line, false);
+      mWireLine = line;
+      mVerbatim = true;
+      return;
+   }
+
+   if (!mVerbatim)
+   {
+      return;
+   }
+
+   const char* start = mWire.getBuffer();
+   const char* end = start + mWire.getLength();
+   if (start < lo)
+   {
+      // an earlier chunk of the message
+      dropWire();
+   }
+   else if (line == mWireLine && valueEnd >= end)
+   {
+      // another comma separated value
+      mWire.init(start, valueEnd - start, false);
+   }
+   else if (line == end + 2 && end[0] == '\r' && end[1] == '\n')
+   {
+      // the next line
+      mWire.init(start, valueEnd - start, false);
+      mWireLine = line;
+   }
+   else
+   {
+      dropWire();
+   }
 }
 
 EncodeStream&
 HeaderFieldValueList::encode(int headerEnum, EncodeStream& str) const
 {
+   if (mVerbatim)
+   {
+      mWire.encode(str);
+      str << Symbols::CRLF;
+      return str;
+   }
+
    const Data& headerName = Headers::getHeaderName(static_cast<Headers::Type>(headerEnum));
 
    if (getParserContainer() != 0)
@@ -112,6 +200,13 @@ HeaderFieldValueList::encode(int headerEnum, EncodeStream& str) const
 EncodeStream&
 HeaderFieldValueList::encode(const Data& headerName, EncodeStream& str) const
 {
+   if (mVerbatim)
+   {
+      mWire.encode(str);
+      str << Symbols::CRLF;
+      return str;
+   }
+
    if (getParserContainer() != 0)
    {
       getParserContainer()->encode(headerName, str);
@@ -177,6 +272,21 @@ HeaderFieldValueList::clear()
 {
    freeParserContainer();
    mHeaders.clear();
+   mWire.clear();
+   dropWire();
+}
+
+void
+HeaderFieldValueList::grow()
+{
+   ListImpl grown(mHeaders.get_allocator());
+   grown.reserve(mHeaders.empty() ? 2 : 2*mHeaders.size());
+   for(iterator i=mHeaders.begin(); i!=mHeaders.end(); ++i)
+   {
+      grown.push_back(HeaderFieldValue::Empty);
+      grown.back().swap(*i);
+   }
+   mHeaders.swap(grown);
 }
 
 bool
@@ -6,16 +6,24 @@
 
 #include "rutil/StlPoolAllocator.hxx"
 #include "rutil/PoolBase.hxx"
+#include "resip/stack/HeaderFieldValue.hxx"
 
 namespace resip
 {
 
 class Data;
 class ParserContainerBase;
-class HeaderFieldValue;
 
 /**
    @internal
+
+   A list that was filled from the wire also remembers the raw text of the
+   whole header: every line of it, names included, if those lines were
+   adjacent in the received message. While that text is known to match
+   the values (see dropWire()) the header is encoded by copying it, rather
+   than by writing the name and each value, or by re-encoding parsers.
+   Copies of the list carry the text along; a list that has not been
+   parsed is copied as one block, with its values pointing into it.
 */
 class HeaderFieldValueList
 {
@@ -25,13 +33,17 @@ class HeaderFieldValueList
       HeaderFieldValueList()
          : mHeaders(), 
            mPool(0),
-           mParserContainer(0)
+           mParserContainer(0),
+           mWireLine(0),
+           mVerbatim(false)
       {}
 
       HeaderFieldValueList(PoolBase& pool)
          : mHeaders(StlPoolAllocator<HeaderFieldValue, PoolBase>(&pool)),
            mPool(&pool),
-           mParserContainer(0)
+           mParserContainer(0),
+           mWireLine(0),
+           mVerbatim(false)
       {}
 
       ~HeaderFieldValueList();
@@ -65,6 +77,10 @@ class HeaderFieldValueList
       */
       void push_back(const char* buffer, size_t length, bool own) 
       {
+         if(mHeaders.size() == mHeaders.capacity())
+         {
+            grow();
+         }
          mHeaders.push_back(HeaderFieldValue::Empty); 
          mHeaders.back().init(buffer,length,own);
       }
@@ -82,6 +98,19 @@ class HeaderFieldValueList
       }
 
       bool parsedEmpty() const;
+
+      /**
+         Called after each value taken from the wire is push_back()ed, in
+         order. line is the start of the header line the value ends on, 
+         valueEnd the end of the value, and [lo, hi) the buffer holding 
+         both. Extends the raw text of the header over the value, or gives 
+         up on it if the value is not adjacent to what came before.
+      */
+      void addWire(const char* line, const char* valueEnd, const char* lo, const char* hi);
+      /// Stops encoding from the raw text; the values may be about to change.
+      void dropWire() { mVerbatim = false; mWireLine = 0; }
+      /// The raw text that encode() copies, if any; without the final CRLF.
+      const HeaderFieldValue* getWire() const { return mVerbatim ? &mWire : 0; }
    private:
       typedef std::vector<HeaderFieldValue, StlPoolAllocator<HeaderFieldValue, PoolBase > >  ListImpl;
    public:
@@ -97,8 +126,17 @@ class HeaderFieldValueList
       ListImpl mHeaders;
       PoolBase* mPool;
       ParserContainerBase* mParserContainer;
+      // Raw text of the header; may own the buffer the values point into,
+      // so it is kept until they go even once it is no longer verbatim.
+      HeaderFieldValue mWire;
+      const char* mWireLine;
+      bool mVerbatim;
 
       void freeParserContainer();
+      void copyFrom(const HeaderFieldValueList& rhs);
+      // Reallocates mHeaders, swapping the values over; letting the vector
+      // grow itself would copy (and so allocate) every value already held.
+      void grow();
 };
 
 }
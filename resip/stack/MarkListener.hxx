@@ -10,6 +10,21 @@ class MarkListener
    public:
       virtual ~MarkListener() {}
       virtual void onMark(const Tuple& target,UInt64& expiry, TupleMarkManager::MarkType& mark)= 0;
+
+      /**
+         Called with all the targets whose marks one pass of
+         TupleMarkManager::expire() removed.  By default calls onMark() for
+         each, with mark OK and expiry 0.
+      */
+      virtual void onExpired(const std::vector<Tuple>& targets)
+      {
+         for (std::vector<Tuple>::const_iterator i = targets.begin(); i != targets.end(); ++i)
+         {
+            UInt64 expiry = 0;
+            TupleMarkManager::MarkType mark = TupleMarkManager::OK;
+            onMark(*i, expiry, mark);
+         }
+      }
 };
 }
 
@@ -0,0 +1,181 @@
+#include <cstring>
+
+#include "resip/stack/MessageTrace.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/MpscQueue.hxx"
+
+using namespace resip;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::SIP
+
+volatile unsigned int MessageTrace::sSampleRate = 0;
+volatile unsigned int MessageTrace::sSlowThresholdMs = 0;
+
+static volatile UInt32 sReceived = 0;
+
+static const char* const HopNames[MessageTrace::MaxHop] =
+{
+   "received",
+   "parsed",
+   "transaction",
+   "tu-queued",
+   "tu-received",
+   "processed",
+   "transmitted"
+};
+
+void
+MessageTrace::setSampleRate(unsigned int oneIn)
+{
+   sSampleRate = oneIn;
+}
+
+void
+MessageTrace::setSlowThresholdMs(unsigned int ms)
+{
+   sSlowThresholdMs = ms;
+}
+
+bool
+MessageTrace::sampleNext(unsigned int rate)
+{
+   return MpscAtomic::add(&sReceived, 1) % rate == 0;
+}
+
+const char*
+MessageTrace::hopName(Hop hop)
+{
+   return hop < MaxHop ? HopNames[hop] : "unknown";
+}
+
+MessageTrace::Record::Record() :
+   mRefs(1),
+   mClaims(0)
+{
+   memset(mHops, 0, sizeof(mHops));
+}
+
+MessageTrace::Record*
+MessageTrace::Record::addRef()
+{
+   MpscAtomic::add(&mRefs, 1);
+   return this;
+}
+
+bool
+MessageTrace::Record::release()
+{
+   return MpscAtomic::sub(&mRefs, 1) == 0;
+}
+
+bool
+MessageTrace::Record::claimReport()
+{
+   return MpscAtomic::add(&mClaims, 1) == 1;
+}
+
+void
+MessageTrace::report(const SipMessage& msg, const UInt64* hops)
+{
+   UInt64 first = 0;
+   UInt64 last = 0;
+   for (int h = 0; h < MaxHop; ++h)
+   {
+      if (hops[h] == 0)
+      {
+         continue;
+      }
+      if (first == 0)
+      {
+         first = last = hops[h];
+         continue;
+      }
+      // Each histogram is the time from the hop before; when that one was
+      // not stamped the interval spans several hops and fits none of them.
+      if (hops[h - 1] != 0)
+      {
+         UInt64 delta = hops[h] > hops[h - 1] ? hops[h] - hops[h - 1] : 0;
+         StackStatistics::record(StackStatistics::Histogram(StackStatistics::TraceParse + h - 1), delta);
+      }
+      last = hops[h] > last ? hops[h] : last;
+   }
+   if (first == 0)
+   {
+      return;
+   }
+   StackStatistics::record(StackStatistics::TraceTotal, last - first);
+
+   unsigned int slowMs = sSlowThresholdMs;
+   if (slowMs != 0 && last - first > UInt64(slowMs) * 1000)
+   {
+      Data hopList;
+      {
+         DataStream strm(hopList);
+         UInt64 previous = first;
+         for (int h = 0; h < MaxHop; ++h)
+         {
+            if (hops[h] == 0)
+            {
+               continue;
+            }
+            strm << " " << HopNames[h] << "+" << (hops[h] > previous ? hops[h] - previous : 0) << "us";
+            previous = hops[h] > previous ? hops[h] : previous;
+         }
+      }
+      WarningLog(<< "Slow message, " << (last - first) / 1000 << " ms: "
+                 << msg.brief() << hopList);
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,152 @@
+#if !defined(RESIP_MESSAGETRACE_HXX)
+#define RESIP_MESSAGETRACE_HXX
+
+#include "rutil/compat.hxx"
+
+namespace resip
+{
+class SipMessage;
+
+/**
+   @brief Samples received SipMessages and follows them through the stack,
+   timestamping each hop, to show which fifo or layer a message waits in.
+
+   Off by default. With setSampleRate(n) every n-th message a transport
+   receives is traced: SipMessage keeps a timestamp per Hop (see
+   SipMessage::traceHop()) in a Record that it shares with its copies, so
+   a trace follows a request through a proxy to the copy that is
+   forwarded. It is reported once, when the first copy is transmitted or
+   else when the last one is destroyed. The time between consecutive hops
+   is then recorded in StackStatistics' trace_* histograms; if the whole
+   trace took longer than the slow threshold it is also logged hop by hop,
+   at warning level.
+
+   When tracing is off, a message costs one test in the transport and one
+   per hop.
+*/
+class MessageTrace
+{
+   public:
+      typedef enum
+      {
+         Received, // transport read it (SipMessage::getCreatedTimeMicroSec())
+         Parsed, // transport handed it to the transaction layer's fifo
+         Transaction, // TransactionState picked it up
+         TuQueued, // posted to the TransactionUser's fifo
+         TuReceived, // the TransactionUser took it out of its fifo
+         Processed, // the TransactionUser sent it (or a copy) on
+         Transmitted, // encoded by TransportSelector::transmit()
+         MaxHop
+      } Hop;
+
+      /// Traces one in every oneIn received messages; 0 turns tracing off.
+      static void setSampleRate(unsigned int oneIn);
+      static unsigned int getSampleRate() { return sSampleRate; }
+
+      /// Traces longer than this are logged; 0 logs none.
+      static void setSlowThresholdMs(unsigned int ms);
+
+      /// Called by transports for every message received.
+      static bool sample()
+      {
+         unsigned int rate = sSampleRate;
+         return rate != 0 && sampleNext(rate);
+      }
+
+      /**
+         Records a finished trace. hops holds MaxHop timestamps
+         (Timer::getTimeMicroSec()), 0 for hops the message did not pass.
+      */
+      static void report(const SipMessage& msg, const UInt64* hops);
+
+      static const char* hopName(Hop hop);
+
+      /**
+         The timestamps of one traced message, shared by reference count
+         between the message and its copies, which may live in different
+         threads.
+      */
+      class Record
+      {
+         public:
+            Record();
+
+            /// Returns this, with one more reference.
+            Record* addRef();
+            /// Drops a reference; true if that was the last one.
+            bool release();
+            /// True for the first caller only; that one reports the trace.
+            bool claimReport();
+
+            /// Timer::getTimeMicroSec() of each hop, 0 if not passed (yet).
+            UInt64 mHops[MaxHop];
+
+         private:
+            volatile UInt32 mRefs;
+            volatile UInt32 mClaims;
+
+            // disabled
+            Record(const Record&);
+            Record& operator=(const Record&);
+      };
+
+   private:
+      static bool sampleNext(unsigned int rate);
+
+      static volatile unsigned int sSampleRate;
+      static volatile unsigned int sSlowThresholdMs;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
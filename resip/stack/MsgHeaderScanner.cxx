@@ -5,6 +5,22 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdio.h>
+
+// SSE2 is part of every x86-64 CPU; AVX2 is used only if the CPU has it,
+// through GCC/clang per-function targets.
+#if !defined(RESIP_MSG_HEADER_SCANNER_NO_SIMD) && !defined(RESIP_MSG_HEADER_SCANNER_DEBUG)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define RESIP_MSG_HEADER_SCANNER_SSE2
+#    include <emmintrin.h>
+#    if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#      define RESIP_MSG_HEADER_SCANNER_AVX2
+#      include <immintrin.h>
+#    endif
+#  endif
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2) && defined(_MSC_VER)
+#  include <intrin.h>
+#endif
 #include "resip/stack/HeaderTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
@@ -412,6 +428,217 @@ static void initStateMachine()
                   sMsgStart); // Arbitrary but possibly handy.
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//   In a few states nearly every character leads back to the same state with
+//   taNone; only a handful of "stop" characters matter. Those long runs
+//   (the bulk of the status line and of every value) may be skipped with
+//   SIMD compares instead of going through the state machine one character
+//   at a time. The text property bits of the skipped characters are
+//   accumulated as the state machine would have.
+//   The sentinel needs no stop: the skip never reads the chunk's terminal
+//   character, leaving the last few characters to the state machine.
+
+enum RunKindEnum
+{
+   rkNone,
+   rk1Value,       // sScanStatusLine, sScan1Value
+   rkNValue,       // sScanNValue
+   rkNValueInAngles,
+   rkNValueInQuotes,
+   numRunKinds
+};
+
+static char runKindOfState[numStates];
+
+static void initRunKinds()
+{
+   for (int state = 0; state < numStates; ++state)
+   {
+      runKindOfState[state] = rkNone;
+   }
+   runKindOfState[sScanStatusLine] = rk1Value;
+   runKindOfState[sScan1Value] = rk1Value;
+   runKindOfState[sScanNValue] = rkNValue;
+   runKindOfState[sScanNValueInAngles] = rkNValueInAngles;
+   runKindOfState[sScanNValueInQuotes] = rkNValueInQuotes;
+}
+
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+
+// The characters that leave (or act in) each run state; unused slots repeat
+// '\r'. Must agree with initStateMachine().
+static const char runStopChars[numRunKinds][5] =
+{
+   { '\r', '\r', '\r', '\r', '\r' },
+   { '\r', '\n', '\r', '\r', '\r' },
+   { '\r', '\n', ',', '<', '"' },
+   { '\r', '\n', '>', '\r', '\r' },
+   { '\r', '\n', '"', '\\', '\r' }
+};
+
+static inline unsigned int lowestSetBit(unsigned int bits)
+{
+#if defined(_MSC_VER)
+   unsigned long index;
+   _BitScanForward(&index, bits);
+   return index;
+#else
+   return __builtin_ctz(bits);
+#endif
+}
+
+// Text property bits of the characters whose bit is set in "take", given
+// per-character match masks.
+static inline MsgHeaderScanner::TextPropBitMask
+textPropsOf(unsigned int take,
+            unsigned int whitespace,
+            unsigned int backslash,
+            unsigned int percent,
+            unsigned int semicolon,
+            unsigned int paren)
+{
+   MsgHeaderScanner::TextPropBitMask props = 0;
+   if (whitespace & take) props |= MsgHeaderScanner::tpbmContainsWhitespace;
+   if (backslash & take) props |= MsgHeaderScanner::tpbmContainsBackslash;
+   if (percent & take) props |= MsgHeaderScanner::tpbmContainsPercent;
+   if (semicolon & take) props |= MsgHeaderScanner::tpbmContainsSemicolon;
+   if (paren & take) props |= MsgHeaderScanner::tpbmContainsParen;
+   return props;
+}
+
+typedef char* (*SkipRunFunc)(char* charPtr,
+                             const char* endPtr,
+                             int runKind,
+                             MsgHeaderScanner::TextPropBitMask* textPropBitMask);
+
+// Returns the first stop character at or after "charPtr", or the point
+// where fewer than 16 characters remain before "endPtr".
+static char* skipRunSse2(char* charPtr,
+                         const char* endPtr,
+                         int runKind,
+                         MsgHeaderScanner::TextPropBitMask* textPropBitMask)
+{
+   const char* stops = runStopChars[runKind];
+   const __m128i stop0 = _mm_set1_epi8(stops[0]);
+   const __m128i stop1 = _mm_set1_epi8(stops[1]);
+   const __m128i stop2 = _mm_set1_epi8(stops[2]);
+   const __m128i stop3 = _mm_set1_epi8(stops[3]);
+   const __m128i stop4 = _mm_set1_epi8(stops[4]);
+   const __m128i space = _mm_set1_epi8(' ');
+   const __m128i tab = _mm_set1_epi8('\t');
+   const __m128i backslash = _mm_set1_epi8('\\');
+   const __m128i percent = _mm_set1_epi8('%');
+   const __m128i semicolon = _mm_set1_epi8(';');
+   const __m128i lparen = _mm_set1_epi8('(');
+   const __m128i rparen = _mm_set1_epi8(')');
+
+   while (endPtr - charPtr >= 16)
+   {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(charPtr));
+      __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, stop0),
+                                               _mm_cmpeq_epi8(v, stop1)),
+                                  _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, stop2),
+                                                            _mm_cmpeq_epi8(v, stop3)),
+                                               _mm_cmpeq_epi8(v, stop4)));
+      unsigned int stopBits = (unsigned int)_mm_movemask_epi8(stop);
+      unsigned int take = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xFFFFu;
+      *textPropBitMask |= textPropsOf(
+         take,
+         (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                                      _mm_cmpeq_epi8(v, tab))),
+         (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)),
+         (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, percent)),
+         (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, semicolon)),
+         (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lparen),
+                                                      _mm_cmpeq_epi8(v, rparen))));
+      if (stopBits)
+      {
+         return charPtr + lowestSetBit(stopBits);
+      }
+      charPtr += 16;
+   }
+   return charPtr;
+}
+
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+
+// As skipRunSse2(), 32 characters at a time.
+__attribute__((target("avx2")))
+static char* skipRunAvx2(char* charPtr,
+                         const char* endPtr,
+                         int runKind,
+                         MsgHeaderScanner::TextPropBitMask* textPropBitMask)
+{
+   const char* stops = runStopChars[runKind];
+   const __m256i stop0 = _mm256_set1_epi8(stops[0]);
+   const __m256i stop1 = _mm256_set1_epi8(stops[1]);
+   const __m256i stop2 = _mm256_set1_epi8(stops[2]);
+   const __m256i stop3 = _mm256_set1_epi8(stops[3]);
+   const __m256i stop4 = _mm256_set1_epi8(stops[4]);
+   const __m256i space = _mm256_set1_epi8(' ');
+   const __m256i tab = _mm256_set1_epi8('\t');
+   const __m256i backslash = _mm256_set1_epi8('\\');
+   const __m256i percent = _mm256_set1_epi8('%');
+   const __m256i semicolon = _mm256_set1_epi8(';');
+   const __m256i lparen = _mm256_set1_epi8('(');
+   const __m256i rparen = _mm256_set1_epi8(')');
+
+   while (endPtr - charPtr >= 32)
+   {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(charPtr));
+      __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, stop0),
+                                                     _mm256_cmpeq_epi8(v, stop1)),
+                                     _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, stop2),
+                                                                     _mm256_cmpeq_epi8(v, stop3)),
+                                                     _mm256_cmpeq_epi8(v, stop4)));
+      unsigned int stopBits = (unsigned int)_mm256_movemask_epi8(stop);
+      unsigned int take = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xFFFFFFFFu;
+      *textPropBitMask |= textPropsOf(
+         take,
+         (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                                            _mm256_cmpeq_epi8(v, tab))),
+         (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)),
+         (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, percent)),
+         (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, semicolon)),
+         (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lparen),
+                                                            _mm256_cmpeq_epi8(v, rparen))));
+      if (stopBits)
+      {
+         return charPtr + lowestSetBit(stopBits);
+      }
+      charPtr += 32;
+   }
+   // finish off with at most one 16 character step
+   return skipRunSse2(charPtr, endPtr, runKind, textPropBitMask);
+}
+
+static bool cpuHasAvx2()
+{
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+}
+
+#endif // RESIP_MSG_HEADER_SCANNER_AVX2
+
+#endif // RESIP_MSG_HEADER_SCANNER_SSE2
+
+static MsgHeaderScanner::ScanImpl bestScanImpl()
+{
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+   if (cpuHasAvx2())
+   {
+      return MsgHeaderScanner::siAvx2;
+   }
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+   return MsgHeaderScanner::siSse2;
+#else
+   return MsgHeaderScanner::siScalar;
+#endif
+}
+
+static MsgHeaderScanner::ScanImpl scanImpl = bestScanImpl();
+
 // Debug follows
 #if defined(RESIP_MSG_HEADER_SCANNER_DEBUG)  
 
@@ -922,6 +1149,10 @@ MsgHeaderScanner::scanChunk(char * chunk,
    char *termCharPtr = chunk + chunkLength;
    char saveChunkTermChar = *termCharPtr;
    *termCharPtr = chunkTermSentinelChar;
+   if (mMsg)
+   {
+      mMsg->setScanBuffer(chunk, termCharPtr);
+   }
    char *textStartCharPtr;
    MsgHeaderScanner::TextPropBitMask localTextPropBitMask = mTextPropBitMask;
    if (mPrevScanChunkNumSavedTextChars == 0)
@@ -932,6 +1163,22 @@ MsgHeaderScanner::scanChunk(char * chunk,
    {
       textStartCharPtr = chunk;
    }
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+   SkipRunFunc skipRun = 0;
+   switch (scanImpl)
+   {
+      case MsgHeaderScanner::siSse2:
+         skipRun = skipRunSse2;
+         break;
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+      case MsgHeaderScanner::siAvx2:
+         skipRun = skipRunAvx2;
+         break;
+#endif
+      default:
+         break;
+   }
+#endif
    --charPtr;  // The loop starts by advancing "charPtr", so pre-adjust it.
    for (;;)
    {
@@ -950,7 +1197,22 @@ MsgHeaderScanner::scanChunk(char * chunk,
       printStateTransition(localState, *charPtr, transitionAction);
 #endif
       localState = transitionInfo->nextState;
-      if (transitionAction == taNone) continue;
+      if (transitionAction == taNone)
+      {
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+         if (skipRun &&
+             runKindOfState[(unsigned)localState] != rkNone &&
+             termCharPtr - charPtr > 16)
+         {
+            // Resume the state machine at the next stop character.
+            charPtr = skipRun(charPtr + 1,
+                              termCharPtr,
+                              runKindOfState[(unsigned)localState],
+                              &localTextPropBitMask) - 1;
+         }
+#endif
+         continue;
+      }
       // END message header character scan block END
       // The loop remainder is executed about 4-5 times per message header line.
       switch (transitionAction)
@@ -1067,9 +1329,47 @@ MsgHeaderScanner::initialize()
 {
    initCharInfoArray();
    initStateMachine();
+   initRunKinds();
    return true;
 }
 
+bool
+MsgHeaderScanner::isScanImplSupported(ScanImpl impl)
+{
+   switch (impl)
+   {
+      case siScalar:
+         return true;
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+      case siSse2:
+         return true;
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+      case siAvx2:
+         return cpuHasAvx2();
+#endif
+      default:
+         return false;
+   }
+}
+
+bool
+MsgHeaderScanner::setScanImpl(ScanImpl impl)
+{
+   if (!isScanImplSupported(impl))
+   {
+      return false;
+   }
+   scanImpl = impl;
+   return true;
+}
+
+MsgHeaderScanner::ScanImpl
+MsgHeaderScanner::getScanImpl()
+{
+   return scanImpl;
+}
+
 
 } //namespace resip
 
@@ -121,6 +121,23 @@ class MsgHeaderScanner
       // !ah! for documentation generation
       static int dumpStateMachine(int fd); 
 
+      // Ways of skipping over the bulk of the status line or of a value,
+      // where the state machine only waits for the next CR, comma, quote or
+      // angle bracket. The SIMD versions look at 16 or 32 characters per
+      // step; the results are identical. By default the best one the build
+      // and the CPU support is used.
+      enum ScanImpl {
+         siScalar,     // One character at a time, all through the state machine.
+         siSse2,
+         siAvx2
+      };
+
+      static bool isScanImplSupported(ScanImpl impl);
+      // Affects all scanners. Returns false, changing nothing, if "impl" is
+      // not supported.
+      static bool setScanImpl(ScanImpl impl);
+      static ScanImpl getScanImpl();
+
    private:
 
 
@@ -1,6 +1,8 @@
 #ifndef RESIP_SendData_HXX
 #define RESIP_SendData_HXX
 
+#include <cassert>
+
 #include "rutil/Data.hxx"
 #include "resip/stack/Tuple.hxx"
 
@@ -20,7 +22,7 @@ class SendData
          EnableFlowTimer
       };
 
-      SendData() : isAlreadyCompressed(false), command(NoCommand)
+      SendData() : isAlreadyCompressed(false), command(NoCommand), encodeStart(0), mNext(0)
       {}
 
       SendData(const Tuple& dest,
@@ -33,7 +35,9 @@ class SendData
          transactionId(tid),
          sigcompId(scid),
          isAlreadyCompressed(isCompressed),
-         command(NoCommand)
+         command(NoCommand),
+         encodeStart(0),
+         mNext(0)
       {
       }
 
@@ -44,7 +48,9 @@ class SendData
          transactionId(Data::Empty),
          sigcompId(Data::Empty),
          isAlreadyCompressed(false),
-         command(NoCommand)
+         command(NoCommand),
+         encodeStart(0),
+         mNext(0)
       {
       }
 
@@ -71,6 +77,89 @@ class SendData
 
       // .bwc. Used for special commands: ie. to close connections, and enable flow timers
       SendDataCommand command;
+
+      // Timer::getTimeMicroSec() when the stack started encoding (or
+      // resending) this; 0 if untracked. Feeds StackStatistics::Transmit.
+      UInt64 encodeStart;
+
+   private:
+      friend class SendDataQueue;
+      // link for SendDataQueue; meaningless outside of a queue
+      SendData* mNext;
+};
+
+/**
+   @internal
+   @brief FIFO of SendData linked through the SendData themselves, so
+   queueing costs no allocation. A SendData may be in at most one queue.
+   The queue does not own its elements; whoever pops one deletes it.
+*/
+class SendDataQueue
+{
+   public:
+      SendDataQueue() : mHead(0), mTail(0), mSize(0) {}
+
+      bool empty() const { return mHead == 0; }
+      size_t size() const { return mSize; }
+
+      SendData* front() const
+      {
+         assert(mHead);
+         return mHead;
+      }
+
+      /// the element after sd in this queue, or 0
+      static SendData* next(const SendData* sd) { return sd->mNext; }
+
+      void push_back(SendData* sd)
+      {
+         sd->mNext = 0;
+         if (mTail)
+         {
+            mTail->mNext = sd;
+         }
+         else
+         {
+            mHead = sd;
+         }
+         mTail = sd;
+         ++mSize;
+      }
+
+      void pop_front()
+      {
+         assert(mHead);
+         SendData* sd = mHead;
+         mHead = sd->mNext;
+         if (mHead == 0)
+         {
+            mTail = 0;
+         }
+         sd->mNext = 0;
+         --mSize;
+      }
+
+      /// puts sd in the place of the front element, which is unlinked
+      void replaceFront(SendData* sd)
+      {
+         assert(mHead);
+         sd->mNext = mHead->mNext;
+         if (mTail == mHead)
+         {
+            mTail = sd;
+         }
+         mHead->mNext = 0;
+         mHead = sd;
+      }
+
+   private:
+      SendData* mHead;
+      SendData* mTail;
+      size_t mSize;
+
+      // no value semantics
+      SendDataQueue(const SendDataQueue&);
+      SendDataQueue& operator=(const SendDataQueue&);
 };
 
 }
@@ -37,10 +37,12 @@ SipMessage::SipMessage(const Tuple *receivedTransportTuple)
 #else
      mUnknownHeaders(),
 #endif
+     mBufferList(StlPoolAllocator<char*, PoolBase >(&mPool)),
      mRequest(false),
      mResponse(false),
      mInvalid(false),
      mCreatedTime(Timer::getTimeMicroSec()),
+     mTrace(0),
      mTlsDomain(Data::Empty)
 {
    if(receivedTransportTuple)
@@ -59,7 +61,9 @@ SipMessage::SipMessage(const SipMessage& from)
 #else
      mUnknownHeaders(),
 #endif
-     mCreatedTime(Timer::getTimeMicroSec())
+     mBufferList(StlPoolAllocator<char*, PoolBase >(&mPool)),
+     mCreatedTime(Timer::getTimeMicroSec()),
+     mTrace(0)
 {
    init(from);
 }
@@ -96,6 +100,7 @@ SipMessage::~SipMessage()
            << std::endl << *this);
    }
 #endif
+   releaseTrace();
    freeMem();
 }
 
@@ -114,6 +119,8 @@ SipMessage::clear(bool leaveResponseStuff)
 
    mUnknownHeaders.clear();
 
+   mScanStart = 0;
+   mScanEnd = 0;
    mStartLine = 0;
    mContents = 0;
    mContentsHfv.clear();
@@ -129,6 +136,12 @@ SipMessage::init(const SipMessage& rhs)
    mIsDecorated = rhs.mIsDecorated;
    mIsBadAck200 = rhs.mIsBadAck200;
    mIsExternal = rhs.mIsExternal;
+   if (mTrace != rhs.mTrace)
+   {
+      // the copy may be the one that travels on (eg. forwarded by a proxy)
+      releaseTrace();
+      mTrace = rhs.mTrace ? rhs.mTrace->addRef() : 0;
+   }
    mReceivedTransportTuple = rhs.mReceivedTransportTuple;
    mSource = rhs.mSource;
    mDestination = rhs.mDestination;
@@ -232,7 +245,7 @@ SipMessage::freeMem(bool leaveResponseStuff)
    {
       clearHeaders();
 
-      for (vector<char*>::iterator i = mBufferList.begin();
+      for (BufferList::iterator i = mBufferList.begin();
            i != mBufferList.end(); i++)
       {
          delete [] *i;
@@ -245,7 +258,7 @@ SipMessage::freeMem(bool leaveResponseStuff)
       mStartLine=0;
    }
 
-   delete mContents;
+   freeContents();
    delete mForceTarget;
    delete mReason;
 
@@ -256,6 +269,20 @@ SipMessage::freeMem(bool leaveResponseStuff)
    }
 }
 
+void
+SipMessage::freeContents()
+{
+   if (mContents && mPool.owns(mContents))
+   {
+      mContents->~Contents();
+      mPool.deallocate(mContents);
+   }
+   else
+   {
+      delete mContents;
+   }
+}
+
 void
 SipMessage::clearHeaders()
 {
@@ -318,10 +345,12 @@ SipMessage::parseAllHeaders()
       ParserContainerBase* pc=0;
       if(mHeaderIndices[i]>0)
       {
-         HeaderFieldValueList* hfvl = ensureHeaders((Headers::Type)i);
+         // not ensureHeaders(); parsing leaves the values as they are
+         HeaderFieldValueList* hfvl = mHeaders[mHeaderIndices[i]];
          if(!Headers::isMulti((Headers::Type)i) && hfvl->parsedEmpty())
          {
             hfvl->push_back(0,0,false);
+            hfvl->dropWire();
          }
 
          if(!(pc=hfvl->getParserContainer()))
@@ -865,6 +894,52 @@ SipMessage::addBuffer(char* buf)
    mBufferList.push_back(buf);
 }
 
+void
+SipMessage::startTrace()
+{
+   if (mTrace == 0)
+   {
+      mTrace = new MessageTrace::Record;
+   }
+   mTrace->mHops[MessageTrace::Received] = mCreatedTime;
+   mTrace->mHops[MessageTrace::Parsed] = Timer::getTimeMicroSec();
+}
+
+void
+SipMessage::endTrace()
+{
+   if (mTrace)
+   {
+      if (mTrace->claimReport())
+      {
+         MessageTrace::report(*this, mTrace->mHops);
+      }
+      if (mTrace->release())
+      {
+         delete mTrace;
+      }
+      mTrace = 0;
+   }
+}
+
+void
+SipMessage::releaseTrace()
+{
+   if (mTrace)
+   {
+      // the last copy reports a trace that none transmitted
+      if (mTrace->release())
+      {
+         if (mTrace->claimReport())
+         {
+            MessageTrace::report(*this, mTrace->mHops);
+         }
+         delete mTrace;
+      }
+      mTrace = 0;
+   }
+}
+
 void 
 SipMessage::setStartLine(const char* st, int len)
 {
@@ -995,7 +1070,7 @@ SipMessage::setContents(auto_ptr<Contents> contents)
 {
    Contents* contentsP = contents.release();
 
-   delete mContents;
+   freeContents();
    mContents = 0;
    mContentsHfv.clear();
 
@@ -1060,6 +1135,8 @@ SipMessage::getContents() const
          StackLog(<< "SipMessage::getContents: ContentType header does not exist - implies no contents");
          return 0;
       }
+      // the Contents object is placed in mPool; see freeContents()
+      SipMessage* nc_this(const_cast<SipMessage*>(this));
       DebugLog(<< "SipMessage::getContents: " 
                << const_header(h_ContentType).type()
                << "/"
@@ -1073,11 +1150,11 @@ SipMessage::getContents() const
                  << const_header(h_ContentType).subType()
                  << ") that is not known, "
                  << "returning as opaque application/octet-stream");
-         mContents = ContentsFactoryBase::getFactoryMap()[OctetContents::getStaticType()]->create(mContentsHfv, OctetContents::getStaticType());
+         mContents = ContentsFactoryBase::getFactoryMap()[OctetContents::getStaticType()]->create(mContentsHfv, OctetContents::getStaticType(), &nc_this->mPool);
       }
       else
       {
-         mContents = ContentsFactoryBase::getFactoryMap()[const_header(h_ContentType)]->create(mContentsHfv, const_header(h_ContentType));
+         mContents = ContentsFactoryBase::getFactoryMap()[const_header(h_ContentType)]->create(mContentsHfv, const_header(h_ContentType), &nc_this->mPool);
       }
       assert( mContents );
       
@@ -1152,6 +1229,7 @@ SipMessage::header(const ExtensionHeader& headerName)
       if (isEqualNoCase(i->first, headerName.getName()))
       {
          HeaderFieldValueList* hfvs = i->second;
+         hfvs->dropWire();
          if (hfvs->getParserContainer() == 0)
          {
             hfvs->setParserContainer(makeParserContainer<StringCategory>(hfvs, Headers::RESIP_DO_NOT_USE));
@@ -1227,6 +1305,7 @@ SipMessage::addHeader(Headers::Type header, const char* headerName, int headerLe
          if (len)
          {
             hfvl->push_back(start, len, false);
+            hfvl->addWire(headerName, start + len, mScanStart, mScanEnd);
          }
       }
       else
@@ -1248,6 +1327,14 @@ SipMessage::addHeader(Headers::Type header, const char* headerName, int headerLe
             return;
          }
          hfvl->push_back(start ? start : Data::Empty.data(), len, false);
+         if (start)
+         {
+            hfvl->addWire(headerName, start + len, mScanStart, mScanEnd);
+         }
+         else
+         {
+            hfvl->dropWire();
+         }
       }
 
    }
@@ -1264,6 +1351,7 @@ SipMessage::addHeader(Headers::Type header, const char* headerName, int headerLe
             if (len)
             {
                i->second->push_back(start, len, false);
+               i->second->addWire(headerName, start + len, mScanStart, mScanEnd);
             }
             return;
          }
@@ -1274,6 +1362,7 @@ SipMessage::addHeader(Headers::Type header, const char* headerName, int headerLe
       if (len)
       {
          hfvs->push_back(start, len, false);
+         hfvs->addWire(headerName, start + len, mScanStart, mScanEnd);
       }
       mUnknownHeaders.push_back(pair<Data, HeaderFieldValueList*>(Data(headerName, headerLen),
                                                                   hfvs));
@@ -1351,6 +1440,8 @@ SipMessage::ensureHeaders(Headers::Type type)
       mHeaderIndices[type]=mHeaders.size()-1;
    }
 
+   // the caller may modify the values
+   hfvl->dropWire();
    return hfvl;
 }
 
@@ -1380,6 +1471,8 @@ SipMessage::ensureHeader(Headers::Type type)
       mHeaders.back()->push_back(0,0,false);
    }
 
+   // the caller may modify the values
+   hfvl->dropWire();
    return hfvl;
 }
 
@@ -17,11 +17,12 @@
 #include "resip/stack/Tuple.hxx"
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/MessageDecorator.hxx"
+#include "resip/stack/MessageTrace.hxx"
 #include "resip/stack/Cookie.hxx"
 #include "resip/stack/WsCookieContext.hxx"
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
-#include "rutil/DinkyPool.hxx"
+#include "rutil/ArenaPool.hxx"
 #include "rutil/StlPoolAllocator.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
@@ -514,6 +515,15 @@ class SipMessage : public TransactionMessage
                      const char* headerName, int headerLen, 
                      const char* start, int len);
 
+      /// @internal The buffer headers are being added from (by 
+      /// MsgHeaderScanner); headers lying entirely within it are later 
+      /// encoded from their received text until they are modified.
+      void setScanBuffer(const char* start, const char* end)
+      {
+         mScanStart = start;
+         mScanEnd = end;
+      }
+
       // Returns the source tuple for the transport that the message was received from
       // only makes sense for messages received from the wire.  Differs from Source
       // since it contains the transport bind address instead of the actual source 
@@ -538,6 +548,27 @@ class SipMessage : public TransactionMessage
 
       UInt64 getCreatedTimeMicroSec() {return mCreatedTime;}
 
+      /**
+         @internal
+         @brief Starts a MessageTrace of this message, stamping the Received
+         (creation) and Parsed hops.
+      */
+      void startTrace();
+      bool isTraced() const { return mTrace != 0; }
+      /// Timestamps hop if this message is being traced.
+      void traceHop(MessageTrace::Hop hop)
+      {
+         if (mTrace)
+         {
+            mTrace->mHops[hop] = Timer::getTimeMicroSec();
+         }
+      }
+      /**
+         Stops tracing this message, reporting the trace to MessageTrace
+         unless a copy already has.
+      */
+      void endTrace();
+
       /// deal with a notion of an "out-of-band" forced target for SIP routing
       void setForceTarget(const Uri& uri);
       void clearForceTarget();
@@ -585,6 +616,8 @@ class SipMessage : public TransactionMessage
       void freeMem(bool leaveResponseStuff=false);
       // Clears mHeaders and cleans up memory
       void clearHeaders();
+      // Destroys mContents, which may live in mPool
+      void freeContents();
       
       // !bwc! Initializes members. Will not free heap-allocated memory.
       // Will begin by calling clear().
@@ -592,6 +625,9 @@ class SipMessage : public TransactionMessage
    
    private:
       void compute2543TransactionHash() const;
+      // Drops this message's share of its trace, reporting it if no other
+      // copy is left to.
+      void releaseTrace();
 
       EncodeStream& 
       encode(EncodeStream& str, bool isSipFrag) const;      
@@ -667,7 +703,10 @@ class SipMessage : public TransactionMessage
       // To profile current sizing, enable DINKYPOOL_PROFILING in SipMessage.cxx 
       // and look for DebugLog message in SipMessage destructor to know when heap
       // allocations are occuring and how much of the pool is used.
-      DinkyPool<3732> mPool;
+      // Headers, parser categories, parameters, the buffer list and the
+      // parsed Contents object all come from here; past the first 3732
+      // bytes the pool grows in 4KB chunks that are freed with the message.
+      ArenaPool<3732> mPool;
 
       typedef std::vector<HeaderFieldValueList*, 
                            StlPoolAllocator<HeaderFieldValueList*, 
@@ -693,7 +732,12 @@ class SipMessage : public TransactionMessage
       Tuple mDestination;
       
       // Raw buffers coming from the Transport. message manages the memory
-      std::vector<char*> mBufferList;
+      typedef std::vector<char*, StlPoolAllocator<char*, PoolBase> > BufferList;
+      BufferList mBufferList;
+
+      // the buffer addHeader() is being called for; see setScanBuffer()
+      const char* mScanStart;
+      const char* mScanEnd;
 
       // special case for the first line of message
       StartLine* mStartLine;
@@ -718,6 +762,9 @@ class SipMessage : public TransactionMessage
       
       UInt64 mCreatedTime;
 
+      // If traced, else 0. Shared with copies of the message.
+      MessageTrace::Record* mTrace;
+
       // used when next element is a strict router OR 
       // client forces next hop OOB
       Uri* mForceTarget;
@@ -35,11 +35,14 @@
 #include "resip/stack/TransactionUserMessage.hxx"
 #include "resip/stack/TransactionControllerThread.hxx"
 #include "resip/stack/TransportSelectorThread.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 #ifdef USE_SSL
 #include "resip/stack/ssl/Security.hxx"
 #include "resip/stack/ssl/DtlsTransport.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "resip/stack/ssl/TlsSessionCache.hxx"
 #include "resip/stack/ssl/TlsTransport.hxx"
 #include "resip/stack/ssl/WssTransport.hxx"
 #endif
@@ -63,6 +66,7 @@ SipStack::SipStack(const SipStackOptions& options) :
    // WARNING - don't forget to add new member initialization to the init() method
    init(options);
    mTUFifo.setDescription("SipStack::mTUFifo");
+   mTUFifo.setWaitStatistic(&StackStatistics::statistics(), StackStatistics::TuFifo);
 }
 
 
@@ -107,6 +111,8 @@ SipStack::SipStack(Security* pSecurity,
    mShuttingDown(false),
    mStatisticsManagerEnabled(true),
    mSocketFunc(socketFunc),
+   mTlsHandshakePool(0),
+   mTlsSessionCache(0),
    mNextTransportKey(1)
 {
    Timer::getTimeMs(); // initalize time offsets
@@ -122,6 +128,7 @@ SipStack::SipStack(Security* pSecurity,
    }
    
    mTUFifo.setDescription("SipStack::mTUFifo");
+   mTUFifo.setWaitStatistic(&StackStatistics::statistics(), StackStatistics::TuFifo);
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
 
 #if 0
@@ -201,8 +208,14 @@ SipStack::init(const SipStackOptions& options)
 
    // WATCHOUT: the transaction controller constructor will
    // grab the security, DnsStub, compression and statsManager
-   mTransactionController = new TransactionController(*this, mAsyncProcessHandler);
+   mTransactionController = new TransactionController(*this, 
+                                                      mAsyncProcessHandler,
+                                                      options.mTransactionControllerShards,
+                                                      options.mLockFreeStateMachineFifo ? FifoLockFreeMpsc : FifoLocking);
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
+   mTransactionController->useTimerWheel(options.mUseTimerWheel);
+   mAppTimers.useTimerWheel(options.mUseTimerWheel);
+   mUseTimerWheel = options.mUseTimerWheel;
    mTransactionControllerThread = 0;
    mTransportSelectorThread = 0;
 
@@ -212,6 +225,16 @@ SipStack::init(const SipStackOptions& options)
    mStatisticsManagerEnabled = true;
    mSocketFunc = options.mSocketFunc;
 
+#ifdef USE_SSL
+   mTlsHandshakePool = options.mTlsHandshakeThreads
+         ? new TlsHandshakePool(options.mTlsHandshakeThreads, mAsyncProcessHandler) : 0;
+   mTlsSessionCache = options.mTlsSessionCacheSize
+         ? new TlsSessionCache(options.mTlsSessionCacheSize, options.mTlsSessionTickets) : 0;
+#else
+   mTlsHandshakePool = 0;
+   mTlsSessionCache = 0;
+#endif
+
    // .kw. note that stats manager has already called getTimeMs()
    Timer::getTimeMs(); // initalize time offsets
    Random::initialize();
@@ -227,11 +250,20 @@ SipStack::~SipStack()
    mDnsThread=0;
    delete mTransactionControllerThread;
    mTransactionControllerThread=0;
+   for(std::vector<TransactionControllerThread*>::iterator i=mTransactionControllerShardThreads.begin();
+         i!=mTransactionControllerShardThreads.end(); ++i)
+   {
+      delete *i;
+   }
+   mTransactionControllerShardThreads.clear();
    delete mTransportSelectorThread;
    mTransportSelectorThread=0;
 
    delete mTransactionController;
 #ifdef USE_SSL
+   // after the transports, whose connections may still be queued in it
+   delete mTlsHandshakePool;
+   delete mTlsSessionCache;
    delete mSecurity;
 #endif
    delete mCompression;
@@ -268,6 +300,21 @@ SipStack::run()
    mTransactionControllerThread=new TransactionControllerThread(*mTransactionController);
    mTransactionControllerThread->run();
 
+   for(std::vector<TransactionControllerThread*>::iterator i=mTransactionControllerShardThreads.begin();
+         i!=mTransactionControllerShardThreads.end(); ++i)
+   {
+      delete *i;
+   }
+   mTransactionControllerShardThreads.clear();
+   for(unsigned int i=1; i<mTransactionController->getNumShards(); ++i)
+   {
+      TransactionControllerThread* shardThread = 
+         new TransactionControllerThread(mTransactionController->getShard(i));
+      mTransactionControllerShardThreads.push_back(shardThread);
+      shardThread->run();
+   }
+   mTransactionController->setShardsHaveOwnThreads(true);
+
    delete mTransportSelectorThread;
    mTransportSelectorThread=new TransportSelectorThread(mTransactionController->transportSelector());
    mTransportSelectorThread->run();
@@ -302,6 +349,14 @@ SipStack::shutdownAndJoinThreads()
       mTransactionControllerThread->join();
    }
 
+   for(std::vector<TransactionControllerThread*>::iterator i=mTransactionControllerShardThreads.begin();
+         i!=mTransactionControllerShardThreads.end(); ++i)
+   {
+      (*i)->shutdown();
+      (*i)->join();
+   }
+   mTransactionController->setShardsHaveOwnThreads(false);
+
    if(mTransportSelectorThread)
    {
       mTransportSelectorThread->shutdown();
@@ -392,6 +447,8 @@ SipStack::addTransport( TransportType protocol,
                                          certificateFilename, 
                                          privateKeyFilename,
                                          privateKeyPassPhrase);
+            static_cast<TlsBaseTransport*>(transport)->setHandshakePool(mTlsHandshakePool);
+            static_cast<TlsBaseTransport*>(transport)->setSessionCache(mTlsSessionCache);
 #else
             CritLog (<< "Can't add TLS transport: TLS not supported in this stack. You don't have openssl.");
             throw Transport::Exception("Can't add TLS transport: TLS not supported in this stack. You don't have openssl.", __FILE__,__LINE__);
@@ -410,6 +467,7 @@ SipStack::addTransport( TransportType protocol,
                                           certificateFilename, 
                                           privateKeyFilename,
                                           privateKeyPassPhrase);
+            static_cast<DtlsTransport*>(transport)->useTimerWheel(mUseTimerWheel);
 #else
             CritLog (<< "Can't add DTLS transport: DTLS not supported in this stack.");
             throw Transport::Exception("Can't add DTLS transport: DTLS not supported in this stack.", __FILE__,__LINE__);
@@ -447,6 +505,8 @@ SipStack::addTransport( TransportType protocol,
                   certificateFilename, 
                   privateKeyFilename,
                   privateKeyPassPhrase);
+            static_cast<TlsBaseTransport*>(transport)->setHandshakePool(mTlsHandshakePool);
+            static_cast<TlsBaseTransport*>(transport)->setSessionCache(mTlsSessionCache);
 #else
             CritLog (<< "Can't add WSS transport: Secure Websockets not supported in this stack. You don't have openssl.");
             throw Transport::Exception("Can't add WSS transport: Secure Websockets not supported in this stack. You don't have openssl.", __FILE__,__LINE__);
@@ -1195,6 +1255,18 @@ SipStack::setEnumDomains(const std::map<Data,Data>& domains)
    mDnsStub->setEnumDomains(domains);
 }
 
+size_t
+SipStack::getTlsHandshakeQueueDepth() const
+{
+#ifdef USE_SSL
+   if (mTlsHandshakePool)
+   {
+      return mTlsHandshakePool->getQueueDepth();
+   }
+#endif
+   return 0;
+}
+
 void
 SipStack::clearDnsCache()
 {
@@ -1234,13 +1306,13 @@ SipStack::dump(EncodeStream& strm)  const
       strm << "domains: " << Inserter(this->mDomains) << std::endl;
    }
    strm << " TUFifo size=" << this->mTUFifo.size() << std::endl
-        << " Timers size=" << this->mTransactionController->mTimers.size() << std::endl;
+        << " Timers size=" << this->mTransactionController->getTimerQueueSize() << std::endl;
    {
       Lock lock(mAppTimerMutex);
       strm << " AppTimers size=" << this->mAppTimers.size() << std::endl;
    }
-   strm << " ServerTransactionMap size=" << this->mTransactionController->mServerTransactionMap.size() << std::endl
-        << " ClientTransactionMap size=" << this->mTransactionController->mClientTransactionMap.size() << std::endl
+   strm << " ServerTransactionMap size=" << this->mTransactionController->getNumServerTransactions() << std::endl
+        << " ClientTransactionMap size=" << this->mTransactionController->getNumClientTransactions() << std::endl
         // !slg! TODO - There is technically a threading concern with the following three lines and the runtime addTransport call
         << " Exact Transports=" << Inserter(this->mTransactionController->mTransportSelector.mExactTransports) << std::endl
         << " Any Transports=" << Inserter(this->mTransactionController->mTransportSelector.mAnyInterfaceTransports) << std::endl
@@ -6,6 +6,7 @@
 #endif
 
 #include <set>
+#include <vector>
 #include <iosfwd>
 
 #include "rutil/CongestionManager.hxx"
@@ -48,6 +49,8 @@ class TransactionUser;
 class AsyncProcessHandler;
 class Compression;
 class FdPollGrp;
+class TlsHandshakePool;
+class TlsSessionCache;
 
 /**
    This class holds constructor-time initialization arguments for SipStack.
@@ -96,6 +99,45 @@ class FdPollGrp;
           See EventStackThread. The SipStack does NOT take ownership;
           the application (or a helper such as EventStackSimpleMgr) must
           release this object after the SipStack is destructed.
+
+       mTransactionControllerShards
+          Number of shards the transaction layer is split into. Each
+          shard owns its own transaction maps, timer queue and state
+          machine fifo, and messages are assigned to a shard by the hash
+          of their Via branch, so no transaction is ever touched by two
+          threads. Only useful when the stack is run() with its own
+          threads, in which case each shard gets a thread. Default 1.
+
+       mUseTimerWheel
+          Keep the transaction timers, application timers and DTLS timers
+          in hierarchical timing wheels instead of binary heaps. Adding
+          and firing a timer becomes O(1), which helps with very large
+          numbers of live transactions. Default false.
+
+       mLockFreeStateMachineFifo
+          Make the state machine fifo(s) of the transaction layer lock-free
+          multi-producer/single-consumer fifos (see FifoLockFreeMpsc), so
+          transport threads hand messages to the transaction layer without
+          contending on a mutex. Default false.
+
+       mTlsHandshakeThreads
+          Number of threads that run the handshakes of TLS and WSS
+          connections (see TlsHandshakePool), keeping the public key
+          operations off the transport threads. The connections stay with
+          their transports. 0 runs handshakes on the transport thread, as
+          before. Requires USE_SSL. Default 0.
+
+       mTlsSessionCacheSize
+          Number of TLS sessions kept for resumption by TLS and WSS
+          transports (see TlsSessionCache): sessions of clients, looked up
+          by session id, and the same number again of our own sessions
+          with peers we connected to, offered when connecting to them
+          again. 0 leaves session caching to OpenSSL. Requires USE_SSL.
+          Default 0.
+
+       mTlsSessionTickets
+          With mTlsSessionCacheSize, also issue and accept session tickets
+          as a server. Default true.
 **/
 class SipStackOptions
 {
@@ -103,7 +145,13 @@ class SipStackOptions
       SipStackOptions()
          : mSecurity(0), mExtraNameserverList(0),
            mAsyncProcessHandler(0), mStateless(false),
-           mSocketFunc(0), mCompression(0), mPollGrp(0)
+           mSocketFunc(0), mCompression(0), mPollGrp(0),
+           mTransactionControllerShards(1),
+           mUseTimerWheel(false),
+           mLockFreeStateMachineFifo(false),
+           mTlsHandshakeThreads(0),
+           mTlsSessionCacheSize(0),
+           mTlsSessionTickets(true)
       {
       }
 
@@ -114,6 +162,12 @@ class SipStackOptions
       AfterSocketCreationFuncPtr mSocketFunc;
       Compression *mCompression;
       FdPollGrp* mPollGrp;
+      unsigned int mTransactionControllerShards;
+      bool mUseTimerWheel;
+      bool mLockFreeStateMachineFifo;
+      unsigned int mTlsHandshakeThreads;
+      unsigned int mTlsSessionCacheSize;
+      bool mTlsSessionTickets;
 };
 
 
@@ -926,7 +980,7 @@ class SipStack : public FdSetIOObserver
       */
       void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
-         mTransactionController->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         mTransactionController->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
       }
 
       inline bool getFixBadCSeqNumbers() const
@@ -1035,6 +1089,12 @@ class SipStack : public FdSetIOObserver
       */
       CongestionManager* getCongestionManager() { return mCongestionManager; }
 
+      /**
+         @brief Number of TLS handshake steps waiting for a handshake thread;
+            always 0 unless SipStackOptions::mTlsHandshakeThreads was set.
+      */
+      size_t getTlsHandshakeQueueDepth() const;
+
       /**
          @brief Accessor for the Compression object the stack is using.
          @return The Compression object being used.
@@ -1111,6 +1171,8 @@ class SipStack : public FdSetIOObserver
       std::auto_ptr<ProducerFifoBuffer<TransactionMessage> > mStateMacFifoBuffer;
 
       TransactionControllerThread* mTransactionControllerThread;
+      /** @brief One thread per additional TransactionController shard **/
+      std::vector<TransactionControllerThread*> mTransactionControllerShardThreads;
       TransportSelectorThread* mTransportSelectorThread;
       bool mInternalThreadsRunning;
       bool mProcessingHasStarted; 
@@ -1143,6 +1205,14 @@ class SipStack : public FdSetIOObserver
 
       AfterSocketCreationFuncPtr mSocketFunc;
 
+      bool mUseTimerWheel;
+
+      /// runs TLS handshakes off the transport threads; may be 0
+      TlsHandshakePool* mTlsHandshakePool;
+
+      /// TLS sessions for resumption, shared by the TLS transports; may be 0
+      TlsSessionCache* mTlsSessionCache;
+
       unsigned int mNextTransportKey;
 
       SharedPtr<Transport::SipMessageLoggingHandler> mTransportSipMessageLoggingHandler;
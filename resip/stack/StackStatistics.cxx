@@ -0,0 +1,153 @@
+#include <cassert>
+
+#include "resip/stack/StackStatistics.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+
+static ThreadStatistics*
+createStackStatistics()
+{
+   ThreadStatistics* stats = new ThreadStatistics;
+   unsigned int id;
+
+   id = stats->addCounter("sip_requests_received", "SIP requests received.");
+   assert(id == StackStatistics::RequestsReceived);
+   id = stats->addCounter("sip_responses_received", "SIP responses received.");
+   assert(id == StackStatistics::ResponsesReceived);
+   id = stats->addCounter("sip_requests_sent", "SIP requests sent, not counting retransmissions.");
+   assert(id == StackStatistics::RequestsSent);
+   id = stats->addCounter("sip_responses_sent", "SIP responses sent, not counting retransmissions.");
+   assert(id == StackStatistics::ResponsesSent);
+   id = stats->addCounter("sip_requests_retransmitted", "SIP request retransmissions.");
+   assert(id == StackStatistics::RequestsRetransmitted);
+   id = stats->addCounter("sip_responses_retransmitted", "SIP response retransmissions.");
+   assert(id == StackStatistics::ResponsesRetransmitted);
+   id = stats->addCounter("tls_sessions_full", "TLS handshakes that set up a new session.");
+   assert(id == StackStatistics::TlsSessionsFull);
+   id = stats->addCounter("tls_sessions_resumed", "TLS handshakes that resumed a cached session or ticket.");
+   assert(id == StackStatistics::TlsSessionsResumed);
+   id = stats->addCounter("udp_rx_batches", "recvmmsg() calls on batched UDP transports that returned datagrams.");
+   assert(id == StackStatistics::UdpRxBatches);
+   id = stats->addCounter("udp_rx_batches_full", "recvmmsg() calls that filled the whole batch.");
+   assert(id == StackStatistics::UdpRxBatchesFull);
+   id = stats->addCounter("udp_rx_batch_datagrams", "Datagrams received by recvmmsg().");
+   assert(id == StackStatistics::UdpRxBatchDatagrams);
+   id = stats->addCounter("udp_tx_batches", "Batches of datagrams given to sendmmsg().");
+   assert(id == StackStatistics::UdpTxBatches);
+   id = stats->addCounter("udp_tx_batches_full", "sendmmsg() batches of the full batch size.");
+   assert(id == StackStatistics::UdpTxBatchesFull);
+   id = stats->addCounter("udp_tx_batch_datagrams", "Datagrams given to sendmmsg().");
+   assert(id == StackStatistics::UdpTxBatchDatagrams);
+   id = stats->addCounter("stream_writes", "Write calls (or SSL_writes) on TCP and TLS connections that wrote data.");
+   assert(id == StackStatistics::StreamWrites);
+   id = stats->addCounter("stream_write_bytes", "Bytes written on TCP and TLS connections.");
+   assert(id == StackStatistics::StreamWriteBytes);
+   id = stats->addCounter("stream_write_messages", "Messages written on TCP and TLS connections; several may share a write.");
+   assert(id == StackStatistics::StreamWriteMessages);
+
+   id = stats->addHistogram("parse", "Time to scan a received message's start line and headers.");
+   assert(id == StackStatistics::Parse);
+   id = stats->addHistogram("tu_fifo", "Time messages wait in a TransactionUser's fifo.");
+   assert(id == StackStatistics::TuFifo);
+   id = stats->addHistogram("dns_resolution", "Time from starting a target lookup to its first result.");
+   assert(id == StackStatistics::DnsResolution);
+   id = stats->addHistogram("transmit", "Time from encoding a message to writing it to the socket.");
+   assert(id == StackStatistics::Transmit);
+
+   id = stats->addHistogram("trace_parse", "Traced messages: from receipt to the transaction fifo.");
+   assert(id == StackStatistics::TraceParse);
+   id = stats->addHistogram("trace_state_machine_fifo", "Traced messages: wait in the transaction fifo.");
+   assert(id == StackStatistics::TraceStateMachineFifo);
+   id = stats->addHistogram("trace_transaction", "Traced messages: transaction processing until posted to the TU.");
+   assert(id == StackStatistics::TraceTransaction);
+   id = stats->addHistogram("trace_tu_fifo", "Traced messages: wait in the TU fifo.");
+   assert(id == StackStatistics::TraceTuFifo);
+   id = stats->addHistogram("trace_tu_processing", "Traced messages: TU processing until sent on.");
+   assert(id == StackStatistics::TraceTuProcessing);
+   id = stats->addHistogram("trace_transmit", "Traced messages: from the TU to being encoded for the wire.");
+   assert(id == StackStatistics::TraceTransmit);
+   id = stats->addHistogram("trace_total", "Traced messages: first to last hop.");
+   assert(id == StackStatistics::TraceTotal);
+
+   id = stats->addHistogram("tls_handshake", "Time from starting a TLS handshake to the connection being up.");
+   assert(id == StackStatistics::TlsHandshake);
+   id = stats->addHistogram("tls_handshake_step", "Time spent in a single SSL_do_handshake() call.");
+   assert(id == StackStatistics::TlsHandshakeStep);
+   id = stats->addHistogram("tls_handshake_queue", "Time TLS handshake steps wait for a handshake thread.");
+   assert(id == StackStatistics::TlsHandshakeQueue);
+   (void)id;
+
+   return stats;
+}
+
+ThreadStatistics&
+StackStatistics::statistics()
+{
+   // never destroyed; threads may still be updating during static destruction
+   static ThreadStatistics* stats = createStackStatistics();
+   return *stats;
+}
+
+void
+StackStatistics::recordSince(Histogram histogram, UInt64 start)
+{
+   UInt64 now = Timer::getTimeMicroSec();
+   record(histogram, now > start ? now - start : 0);
+}
+
+EncodeStream&
+StackStatistics::encodePrometheus(EncodeStream& strm)
+{
+   return statistics().encodePrometheus(strm, "resip_");
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,135 @@
+#if !defined(RESIP_STACKSTATISTICS_HXX)
+#define RESIP_STACKSTATISTICS_HXX
+
+#include "rutil/ThreadStatistics.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Process wide counters and latency histograms of the stack's
+   threads, kept in a ThreadStatistics.
+
+   Updates cost a thread-local lookup and a couple of stores and take no
+   lock, so they are always collected, in every transport, transaction,
+   DNS and TU thread; encodePrometheus() can be called from any thread at
+   any time (repro's WebAdmin serves it as /metrics). This is independent
+   of the periodic StatisticsMessage from StatisticsManager.
+*/
+class StackStatistics
+{
+   public:
+      typedef enum
+      {
+         RequestsReceived,
+         ResponsesReceived,
+         RequestsSent, // not counting retransmissions
+         ResponsesSent, // not counting retransmissions
+         RequestsRetransmitted,
+         ResponsesRetransmitted,
+         TlsSessionsFull, // TLS handshakes that set up a new session
+         TlsSessionsResumed, // TLS handshakes that resumed a session
+         UdpRxBatches, // recvmmsg() calls that returned datagrams
+         UdpRxBatchesFull, // ... that filled the whole batch
+         UdpRxBatchDatagrams, // datagrams received by recvmmsg()
+         UdpTxBatches, // sendmmsg() batches
+         UdpTxBatchesFull, // ... of the full batch size
+         UdpTxBatchDatagrams, // datagrams handed to sendmmsg()
+         StreamWrites, // write calls (or SSL_writes) on TCP/TLS connections
+         StreamWriteBytes, // bytes they accepted
+         StreamWriteMessages, // messages they finished writing
+         MaxCounter
+      } Counter;
+
+      typedef enum
+      {
+         Parse, // scanning a received message's start line and headers
+         TuFifo, // waiting in a TransactionUser's fifo
+         DnsResolution, // from DnsResult::lookup() to the first result
+         Transmit, // from encoding a message to handing it to the socket
+         // hops of messages sampled by MessageTrace
+         TraceParse, // Received to Parsed
+         TraceStateMachineFifo, // Parsed to Transaction
+         TraceTransaction, // Transaction to TuQueued
+         TraceTuFifo, // TuQueued to TuReceived
+         TraceTuProcessing, // TuReceived to Processed
+         TraceTransmit, // Processed to Transmitted
+         TraceTotal, // first to last hop
+         TlsHandshake, // from starting a TLS handshake to the connection being up
+         TlsHandshakeStep, // one SSL_do_handshake() call
+         TlsHandshakeQueue, // wait for a TlsHandshakePool worker
+         MaxHistogram
+      } Histogram;
+
+      static ThreadStatistics& statistics();
+
+      static void increment(Counter counter, UInt64 n = 1)
+      {
+         statistics().increment(counter, n);
+      }
+
+      static void record(Histogram histogram, UInt64 microSeconds)
+      {
+         statistics().record(histogram, microSeconds);
+      }
+
+      /// Records the time from start (as from Timer::getTimeMicroSec()) to now.
+      static void recordSince(Histogram histogram, UInt64 start);
+
+      /// Writes all counters and histograms in Prometheus text format.
+      static EncodeStream& encodePrometheus(EncodeStream& strm);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -2,6 +2,7 @@
 #include "config.h"
 #endif
 
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "resip/stack/StatisticsManager.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -26,6 +27,61 @@ StatisticsManager::~StatisticsManager()
 {
    if ( mPublicPayload )
        delete mPublicPayload;
+
+   for (vector<StatisticsMessage::Payload*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+unsigned int
+StatisticsManager::addShard()
+{
+   Lock lock(mShardsMutex);
+   mShards.push_back(new StatisticsMessage::Payload);
+   return (unsigned int)mShards.size() - 1;
+}
+
+template <typename T, size_t N>
+static void
+addCounts(T (&sum)[N], const T (&shard)[N])
+{
+   for (size_t i = 0; i < N; ++i)
+   {
+      sum[i] += shard[i];
+   }
+}
+
+template <typename T, size_t N, size_t M>
+static void
+addCounts(T (&sum)[N][M], const T (&shard)[N][M])
+{
+   for (size_t i = 0; i < N; ++i)
+   {
+      addCounts(sum[i], shard[i]);
+   }
+}
+
+static void
+addMessageCounts(StatisticsMessage::Payload& sum, const StatisticsMessage::Payload& shard)
+{
+   sum.requestsSent += shard.requestsSent;
+   sum.responsesSent += shard.responsesSent;
+   sum.requestsRetransmitted += shard.requestsRetransmitted;
+   sum.responsesRetransmitted += shard.responsesRetransmitted;
+   sum.requestsReceived += shard.requestsReceived;
+   sum.responsesReceived += shard.responsesReceived;
+
+   addCounts(sum.responsesByCode, shard.responsesByCode);
+   addCounts(sum.requestsSentByMethod, shard.requestsSentByMethod);
+   addCounts(sum.requestsRetransmittedByMethod, shard.requestsRetransmittedByMethod);
+   addCounts(sum.requestsReceivedByMethod, shard.requestsReceivedByMethod);
+   addCounts(sum.responsesSentByMethod, shard.responsesSentByMethod);
+   addCounts(sum.responsesRetransmittedByMethod, shard.responsesRetransmittedByMethod);
+   addCounts(sum.responsesReceivedByMethod, shard.responsesReceivedByMethod);
+   addCounts(sum.responsesSentByMethodByCode, shard.responsesSentByMethodByCode);
+   addCounts(sum.responsesRetransmittedByMethodByCode, shard.responsesRetransmittedByMethodByCode);
+   addCounts(sum.responsesReceivedByMethodByCode, shard.responsesReceivedByMethodByCode);
 }
 
 void 
@@ -38,12 +94,24 @@ void
 StatisticsManager::poll()
 {
    // get snapshot data now..
+   {
+      // the message counters are rebuilt from the shards every time
+      StatisticsMessage::Payload::zeroOut();
+      Lock lock(mShardsMutex);
+      for (vector<StatisticsMessage::Payload*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+      {
+         addMessageCounts(*this, **i);
+      }
+   }
    tuFifoSize = mStack.mTransactionController->getTuFifoSize();
    transportFifoSizeSum = mStack.mTransactionController->sumTransportFifoSizes();
    transactionFifoSize = mStack.mTransactionController->getTransactionFifoSize();
    activeTimers = mStack.mTransactionController->getTimerQueueSize();
    activeClientTransactions = mStack.mTransactionController->getNumClientTransactions();
    activeServerTransactions = mStack.mTransactionController->getNumServerTransactions();
+   pendingDnsQueries = mStack.mDnsStub->getQueriesPending();
+   dnsQueriesSent = mStack.mDnsStub->getQueriesSent();
+   dnsQueriesCoalesced = mStack.mDnsStub->getQueriesCoalesced();
 
    // .kw. At last check payload was > 146kB, which seems too large
    // to alloc on stack. Also, the post'd message has reference
@@ -90,15 +158,29 @@ StatisticsManager::process()
    }
 }
 
+void
+StatisticsManager::zeroOut()
+{
+   StatisticsMessage::Payload::zeroOut();
+   // a shard may be counting while it is cleared; at worst an update is
+   // lost
+   Lock lock(mShardsMutex);
+   for (vector<StatisticsMessage::Payload*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      (*i)->zeroOut();
+   }
+}
+
 bool
-StatisticsManager::sent(SipMessage* msg)
+StatisticsManager::sent(SipMessage* msg, unsigned int shard)
 {
    MethodTypes met = msg->method();
+   StatisticsMessage::Payload& counts = *mShards[shard];
 
    if (msg->isRequest())
    {
-      ++requestsSent;
-      ++requestsSentByMethod[met];
+      ++counts.requestsSent;
+      ++counts.requestsSentByMethod[met];
    }
    else if (msg->isResponse())
    {
@@ -108,9 +190,9 @@ StatisticsManager::sent(SipMessage* msg)
          code = 0;
       }
 
-      ++responsesSent;
-      ++responsesSentByMethod[met];
-      ++responsesSentByMethodByCode[met][code];
+      ++counts.responsesSent;
+      ++counts.responsesSentByMethod[met];
+      ++counts.responsesSentByMethodByCode[met][code];
    }
    
    return false;
@@ -119,42 +201,45 @@ StatisticsManager::sent(SipMessage* msg)
 bool 
 StatisticsManager::retransmitted(MethodTypes met, 
                                  bool request, 
-                                 unsigned int code)
+                                 unsigned int code,
+                                 unsigned int shard)
 {
+   StatisticsMessage::Payload& counts = *mShards[shard];
    if(request)
    {
-      ++requestsRetransmitted;
-      ++requestsRetransmittedByMethod[met];
+      ++counts.requestsRetransmitted;
+      ++counts.requestsRetransmittedByMethod[met];
    }
    else
    {
-      ++responsesRetransmitted;
-      ++responsesRetransmittedByMethod[met];
-      ++responsesRetransmittedByMethodByCode[met][code];
+      ++counts.responsesRetransmitted;
+      ++counts.responsesRetransmittedByMethod[met];
+      ++counts.responsesRetransmittedByMethodByCode[met][code];
    }
    return false;
 }
 
 bool
-StatisticsManager::received(SipMessage* msg)
+StatisticsManager::received(SipMessage* msg, unsigned int shard)
 {
    MethodTypes met = msg->header(h_CSeq).method();
+   StatisticsMessage::Payload& counts = *mShards[shard];
 
    if (msg->isRequest())
    {
-      ++requestsReceived;
-      ++requestsReceivedByMethod[met];
+      ++counts.requestsReceived;
+      ++counts.requestsReceivedByMethod[met];
    }
    else if (msg->isResponse())
    {
-      ++responsesReceived;
-      ++responsesReceivedByMethod[met];
+      ++counts.responsesReceived;
+      ++counts.responsesReceivedByMethod[met];
       int code = msg->const_header(h_StatusLine).statusCode();
       if (code < 0 || code >= MaxCode)
       {
          code = 0;
       }
-      ++responsesReceivedByMethodByCode[met][code];
+      ++counts.responsesReceivedByMethodByCode[met][code];
    }
 
    return false;
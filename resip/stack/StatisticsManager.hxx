@@ -3,6 +3,8 @@
 
 #include "rutil/Timer.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include <vector>
 #include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StatisticsHandler.hxx"
 
@@ -51,10 +53,18 @@ class StatisticsManager : public StatisticsMessage::Payload
       }
 
    private:
+      friend class TransactionController;
       friend class TransactionState;
-      bool sent(SipMessage* msg);
-      bool retransmitted(MethodTypes type, bool request, unsigned int code);
-      bool received(SipMessage* msg);
+
+      // Returns the index of the new shard's message counters, to be passed
+      // to sent(), retransmitted() and received(). Only while no shard is
+      // processing yet.
+      unsigned int addShard();
+
+      bool sent(SipMessage* msg, unsigned int shard);
+      bool retransmitted(MethodTypes type, bool request, unsigned int code, unsigned int shard);
+      bool received(SipMessage* msg, unsigned int shard);
+      void zeroOut();
 
       void poll(); // force an update
 
@@ -69,6 +79,13 @@ class StatisticsManager : public StatisticsMessage::Payload
       // published thru both ExternalHandler and posted to stack as message.
       // This payload is mutex protected.
       StatisticsMessage::AtomicPayload *mPublicPayload;
+
+      // The message counters of each TransactionController shard. Only the
+      // thread servicing a shard bumps its counters, so they take no lock;
+      // poll() sums them into this Payload without one either, which may
+      // miss an update in flight until the next poll.
+      std::vector<StatisticsMessage::Payload*> mShards;
+      Mutex mShardsMutex;
 };
 
 }
@@ -121,6 +121,8 @@ StatisticsMessage::Payload::zeroOut()
    activeClientTransactions = 0;
    activeServerTransactions = 0;
    pendingDnsQueries = 0;
+   dnsQueriesSent = 0;
+   dnsQueriesCoalesced = 0;
    requestsSent = 0;
    responsesSent = 0;
    requestsRetransmitted = 0;
@@ -153,6 +155,8 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       activeClientTransactions = rhs.activeClientTransactions;
       activeServerTransactions = rhs.activeServerTransactions;
       pendingDnsQueries = rhs.pendingDnsQueries;
+      dnsQueriesSent = rhs.dnsQueriesSent;
+      dnsQueriesCoalesced = rhs.dnsQueriesCoalesced;
 
       requestsSent = rhs.requestsSent;
       responsesSent = rhs.responsesSent;
@@ -221,6 +225,10 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " SERVERTX " << stats.activeServerTransactions
         << " TIMERS " << stats.activeTimers
         << std::endl
+        << "DNS summary: pending " << stats.pendingDnsQueries
+        << " sent " << stats.dnsQueriesSent
+        << " coalesced " << stats.dnsQueriesCoalesced
+        << std::endl
         << "Transaction summary: reqi " << stats.requestsReceived
         << " reqo " << stats.requestsSent
         << " rspi " << stats.responsesReceived
@@ -34,7 +34,9 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int openTcpConnections; // .dlb. not implemented
             unsigned int activeClientTransactions;
             unsigned int activeServerTransactions;
-            unsigned int pendingDnsQueries; // .dlb. not implemented
+            unsigned int pendingDnsQueries;
+            unsigned int dnsQueriesSent;
+            unsigned int dnsQueriesCoalesced; // lookups answered by another lookup's query
 
             unsigned int requestsSent; // includes retransmissions
             unsigned int responsesSent; // includes retransmissions
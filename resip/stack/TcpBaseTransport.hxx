@@ -62,6 +62,10 @@ class TcpBaseTransport : public InternalTransport, public FdPollItemIf
       Connection* makeOutgoingConnection(const Tuple &dest,
             TransportFailure::FailureReason &failCode, int &subCode);
 
+      /** Deletes all connections now, rather than when mConnectionManager
+          is destroyed after the derived class. */
+      void closeConnections() { mConnectionManager.closeConnections(); }
+
       static const size_t MaxWriteSize;
       static const size_t MaxReadSize;
 
@@ -7,6 +7,10 @@
 #include "resip/stack/TcpConnection.hxx"
 #include "resip/stack/Tuple.hxx"
 
+#if !defined(WIN32)
+#include <sys/uio.h>
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -108,6 +112,45 @@ TcpConnection::write( const char* buf, const int count )
    return bytesWritten;
 }
 
+int
+TcpConnection::writeBuffers(const WriteBuffer* buffers, int count)
+{
+   assert(count > 0 && count <= MaxWriteBuffers);
+
+#if defined(WIN32)
+   WSABUF bufs[MaxWriteBuffers];
+   for (int i = 0; i < count; ++i)
+   {
+      bufs[i].buf = const_cast<char*>(buffers[i].mData);
+      bufs[i].len = buffers[i].mLength;
+   }
+   DWORD sent = 0;
+   int bytesWritten = (::WSASend(getSocket(), bufs, count, &sent, 0, 0, 0) == 0) ? int(sent) : INVALID_SOCKET;
+#else
+   struct iovec iov[MaxWriteBuffers];
+   for (int i = 0; i < count; ++i)
+   {
+      iov[i].iov_base = const_cast<char*>(buffers[i].mData);
+      iov[i].iov_len = buffers[i].mLength;
+   }
+   int bytesWritten = (int)::writev(getSocket(), iov, count);
+#endif
+
+   if (bytesWritten == INVALID_SOCKET)
+   {
+      int e = getErrno();
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+          return 0;
+      }
+      InfoLog (<< "Failed writev on " << getSocket() << " " << strerror(e));
+      Transport::error(e);
+      return -1;
+   }
+
+   return bytesWritten;
+}
+
 bool 
 TcpConnection::hasDataToRead()
 {
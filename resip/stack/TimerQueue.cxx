@@ -33,10 +33,11 @@ DtlsTimerQueue::DtlsTimerQueue( Fifo<DtlsMessage>& fifo )
 
 DtlsTimerQueue::~DtlsTimerQueue()
 {
-   while(!mTimers.empty())
+   TimerVector timers;
+   drain(timers);
+   for(TimerVector::iterator i = timers.begin(); i != timers.end(); ++i)
    {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
+      delete i->getMessage();
    }
 }
 
@@ -46,9 +47,9 @@ UInt64
 TransactionTimerQueue::add(Timer::Type type, const Data& transactionId, unsigned long msOffset)
 {
    TransactionTimer t(msOffset, type, transactionId);
-   mTimers.push(t);
+   addTimer(t);
    DebugLog (<< "Adding timer: " << Timer::toData(type) << " tid=" << transactionId << " ms=" << msOffset);
-   return mTimers.top().getWhen();
+   return nextTimerWhen();
 }
 
 #ifdef USE_DTLS
@@ -57,18 +58,19 @@ UInt64
 DtlsTimerQueue::add( SSL *ssl, unsigned long msOffset )
 {
    TimerWithPayload t( msOffset, new DtlsMessage( ssl ) ) ;
-   mTimers.push( t ) ;
-   return mTimers.top().getWhen();
+   addTimer( t ) ;
+   return nextTimerWhen();
 }
 
 #endif
 
 BaseTimeLimitTimerQueue::~BaseTimeLimitTimerQueue()
 {
-   while(!mTimers.empty())
+   TimerVector timers;
+   drain(timers);
+   for(TimerVector::iterator i = timers.begin(); i != timers.end(); ++i)
    {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
+      delete i->getMessage();
    }
 }
 
@@ -77,8 +79,8 @@ BaseTimeLimitTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   addTimer(TimerWithPayload(timeMs,payload));
+   return nextTimerWhen();
 }
 
 void
@@ -110,10 +112,11 @@ TuSelectorTimerQueue::TuSelectorTimerQueue(TuSelector& sel) : mFifoSelector(sel)
 
 TuSelectorTimerQueue::~TuSelectorTimerQueue()
 {
-   while(!mTimers.empty())
+   TimerVector timers;
+   drain(timers);
+   for(TimerVector::iterator i = timers.begin(); i != timers.end(); ++i)
    {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
+      delete i->getMessage();
    }
 }
 
@@ -122,8 +125,8 @@ TuSelectorTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   addTimer(TimerWithPayload(timeMs,payload));
+   return nextTimerWhen();
 }
 
 void
@@ -11,14 +11,11 @@
 #include <iosfwd>
 #include "resip/stack/TimerMessage.hxx"
 #include "resip/stack/DtlsMessage.hxx"
+#include "resip/stack/TimerWheel.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Timer.hxx"
 
-// .dlb. 
-// to do: timer wheel for transaction-bound timers and a heap for
-// everything longer.
-
 namespace resip
 {
 
@@ -31,9 +28,10 @@ class TuSelector;
   * @brief This class takes a fifo as a place to where you can write your stuff.
   * When using this in the main loop, call process() on this.
   * During Transaction processing, TimerMessages and SIP messages are generated.
-  * 
-    @todo .dlb. timer wheel for transaction-bound timers and a heap for 
-      everything longer.
+  *
+  * Timers are kept in a binary heap by default; useTimerWheel() switches
+  * to a hierarchical timing wheel (see TimerWheel), which makes adding and
+  * firing a timer O(1) and pays off with many thousands of live timers.
   */
 template <class T>
 class TimerQueue
@@ -43,9 +41,12 @@ class TimerQueue
       // thing subclasses must implement.
       virtual void processTimer(const T& timer)=0;
 
+      TimerQueue() : mWheel(0) {}
+
       /// @brief deletes the message associated with the timer as well.
       virtual ~TimerQueue()
       {
+         delete mWheel;
          //xkd-2004-11-4
          // delete the message associated with the timer
          while (!mTimers.empty())
@@ -54,6 +55,24 @@ class TimerQueue
          }
       }
 
+      /// @brief selects the timing wheel (true) or the heap (false) to hold
+      /// the timers. May only be changed while the queue is empty.
+      void useTimerWheel(bool enable)
+      {
+         assert(empty());
+         if (enable && !mWheel)
+         {
+            mWheel = new TimerWheel<T>;
+         }
+         else if (!enable && mWheel)
+         {
+            delete mWheel;
+            mWheel = 0;
+         }
+      }
+
+      bool usingTimerWheel() const { return mWheel != 0; }
+
       /// @brief provides the time in milliseconds before the next timer will fire
       ///  @retval milliseconds time until the next timer will fire
       ///  @retval 0 implies that timers occur in the past
@@ -61,9 +80,9 @@ class TimerQueue
       ///
       unsigned int msTillNextTimer()
       {
-         if (!mTimers.empty())
+         if (!empty())
          {
-            UInt64 next = mTimers.top().getWhen();
+            UInt64 next = nextTimerWhen();
             UInt64 now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -93,6 +112,26 @@ class TimerQueue
       /// machine fifo and application messages into the TU fifo
       virtual UInt64 process()
       {
+         if (mWheel)
+         {
+            if (!mWheel->empty())
+            {
+               mWheel->expire(Timer::getTimeMs(), mExpired);
+               for (typename TimerVector::const_iterator i = mExpired.begin();
+                    i != mExpired.end(); ++i)
+               {
+                  processTimer(*i);
+               }
+               mExpired.clear();
+
+               if (!mWheel->empty())
+               {
+                  return mWheel->nextWhen();
+               }
+            }
+            return 0;
+         }
+
          if (!mTimers.empty())
          {
             UInt64 now=Timer::getTimeMs();
@@ -112,17 +151,22 @@ class TimerQueue
 
       int size() const
       {
-         return (int)mTimers.size();
+         return mWheel ? (int)mWheel->size() : (int)mTimers.size();
       }
 
       bool empty() const
       {
-         return mTimers.empty();
+         return mWheel ? mWheel->empty() : mTimers.empty();
       }
 
       std::ostream& encode(std::ostream& str) const
       {
-         if(mTimers.size() > 0)
+         if(mWheel && !mWheel->empty())
+         {
+            return str << "TimerQueue[ size =" << mWheel->size()
+                       << " next>=" << mWheel->nextWhen() << "]" ;
+         }
+         else if(mTimers.size() > 0)
          {
             return str << "TimerQueue[ size =" << mTimers.size() 
                        << " top=" << mTimers.top() << "]" ;
@@ -136,7 +180,12 @@ class TimerQueue
 #ifndef RESIP_USE_STL_STREAMS
       EncodeStream& encode(EncodeStream& str) const
       {
-         if(mTimers.size() > 0)
+         if(mWheel && !mWheel->empty())
+         {
+            return str << "TimerQueue[ size =" << mWheel->size()
+                       << " next>=" << mWheel->nextWhen() << "]" ;
+         }
+         else if(mTimers.size() > 0)
          {
             return str << "TimerQueue[ size =" << mTimers.size() 
                        << " top=" << mTimers.top() << "]" ;
@@ -150,7 +199,49 @@ class TimerQueue
 
    protected:
       typedef std::vector<T, std::allocator<T> > TimerVector;
+
+      void addTimer(const T& timer)
+      {
+         if (mWheel)
+         {
+            mWheel->push(timer);
+         }
+         else
+         {
+            mTimers.push(timer);
+         }
+      }
+
+      /// @brief when the earliest timer fires; with the timing wheel this
+      /// may be a little early (never late). Queue must not be empty.
+      UInt64 nextTimerWhen() const
+      {
+         return mWheel ? mWheel->nextWhen() : mTimers.top().getWhen();
+      }
+
+      /// @brief removes all timers, appending them to timers in no
+      /// particular order
+      void drain(TimerVector& timers)
+      {
+         if (mWheel)
+         {
+            mWheel->drain(timers);
+         }
+         while (!mTimers.empty())
+         {
+            timers.push_back(mTimers.top());
+            mTimers.pop();
+         }
+      }
+
+   private:
       std::priority_queue<T, TimerVector, std::greater<T> > mTimers;
+      TimerWheel<T>* mWheel;
+      TimerVector mExpired;
+
+      // disabled
+      TimerQueue(const TimerQueue&);
+      TimerQueue& operator=(const TimerQueue&);
 };
 
 /**
@@ -0,0 +1,359 @@
+#if !defined(RESIP_TIMERWHEEL_HXX)
+#define RESIP_TIMERWHEEL_HXX
+
+#include <cassert>
+#include <vector>
+
+#include "rutil/compat.hxx"
+#include "rutil/Timer.hxx"
+
+namespace resip
+{
+
+/**
+   @internal
+   @brief A hierarchical timing wheel with millisecond resolution.
+
+   Timers are kept in four wheels of 256 slots each.  A timer is placed in
+   the lowest wheel whose slot still separates it from the current time
+   (comparing one byte of the expiry time per wheel), so insertion is O(1)
+   and a timer is moved down at most three times before it fires.  Timers
+   further than 2^32 ms away are parked in an unsorted overflow list.
+
+   T must be copyable and provide UInt64 getWhen() (absolute ms, as from
+   Timer::getTimeMs()).  Timers due in the same millisecond fire in no
+   particular order; across milliseconds they fire in order.
+
+   Used by TimerQueue when TimerQueue::useTimerWheel() is enabled.
+*/
+template <class T>
+class TimerWheel
+{
+   public:
+      TimerWheel() :
+         mNow(Timer::getTimeMs()),
+         mSize(0),
+         mExpired(0),
+         mExpiredMin(0),
+         mOverflow(0),
+         mOverflowMin(0)
+      {
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            for (unsigned int s = 0; s < Slots; ++s)
+            {
+               mSlots[l][s] = 0;
+            }
+            for (unsigned int w = 0; w < Words; ++w)
+            {
+               mOccupied[l][w] = 0;
+            }
+         }
+      }
+
+      ~TimerWheel()
+      {
+         std::vector<T> discard;
+         drain(discard);
+      }
+
+      void push(const T& timer)
+      {
+         place(new Node(timer));
+         ++mSize;
+      }
+
+      size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+      /**
+         Returns a lower bound for the expiry of the earliest timer; exact
+         if that timer is less than 256 ms ahead of the wheel's notion of
+         now. Undefined if empty().
+      */
+      UInt64 nextWhen() const
+      {
+         assert(mSize);
+         if (mExpired)
+         {
+            return mExpiredMin;
+         }
+         unsigned int level;
+         unsigned int slot;
+         if (nextOccupied(level, slot))
+         {
+            return slotStart(level, slot);
+         }
+         assert(mOverflow);
+         return mOverflowMin;
+      }
+
+      /**
+         Removes every timer due at or before now and appends it to
+         expired, earliest millisecond first.
+      */
+      void expire(UInt64 now, std::vector<T>& expired)
+      {
+         for (;;)
+         {
+            takeList(mExpired, expired);
+            if (mSize == 0)
+            {
+               break;
+            }
+
+            unsigned int level;
+            unsigned int slot;
+            if (nextOccupied(level, slot))
+            {
+               UInt64 start = slotStart(level, slot);
+               if (start > now)
+               {
+                  break;
+               }
+               // Nothing lives between mNow and start, so we may jump.
+               mNow = start;
+               cascade(level, slot);
+            }
+            else
+            {
+               assert(mOverflow);
+               UInt64 start = mOverflowMin & ~UInt64(0xFFFFFFFF);
+               if (start > now)
+               {
+                  break;
+               }
+               mNow = start;
+               Node* n = mOverflow;
+               mOverflow = 0;
+               mOverflowMin = 0;
+               replace(n);
+            }
+         }
+         if (now > mNow)
+         {
+            mNow = now;
+         }
+      }
+
+      /// Removes all timers, appending them to timers in no particular order.
+      void drain(std::vector<T>& timers)
+      {
+         takeList(mExpired, timers);
+         takeList(mOverflow, timers);
+         mOverflowMin = 0;
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            for (unsigned int s = 0; s < Slots; ++s)
+            {
+               takeList(mSlots[l][s], timers);
+            }
+            for (unsigned int w = 0; w < Words; ++w)
+            {
+               mOccupied[l][w] = 0;
+            }
+         }
+         assert(mSize == 0);
+      }
+
+   private:
+      static const unsigned int Levels = 4;
+      static const unsigned int SlotBits = 8;
+      static const unsigned int Slots = 1 << SlotBits;
+      static const unsigned int Words = Slots / 64;
+
+      struct Node
+      {
+         Node(const T& timer) : mTimer(timer), mNext(0) {}
+         T mTimer;
+         Node* mNext;
+      };
+
+      void place(Node* n)
+      {
+         UInt64 when = n->mTimer.getWhen();
+         if (when <= mNow)
+         {
+            if (mExpired == 0 || when < mExpiredMin)
+            {
+               mExpiredMin = when;
+            }
+            n->mNext = mExpired;
+            mExpired = n;
+            return;
+         }
+
+         UInt64 diff = when ^ mNow;
+         if (diff >> (Levels*SlotBits))
+         {
+            if (mOverflow == 0 || when < mOverflowMin)
+            {
+               mOverflowMin = when;
+            }
+            n->mNext = mOverflow;
+            mOverflow = n;
+            return;
+         }
+
+         unsigned int level = Levels - 1;
+         while (level > 0 && (diff >> (level*SlotBits)) == 0)
+         {
+            --level;
+         }
+         unsigned int slot = (unsigned int)(when >> (level*SlotBits)) & (Slots-1);
+         n->mNext = mSlots[level][slot];
+         mSlots[level][slot] = n;
+         mOccupied[level][slot/64] |= UInt64(1) << (slot%64);
+      }
+
+      // re-places every node of a detached list against the current mNow
+      void replace(Node* n)
+      {
+         while (n)
+         {
+            Node* next = n->mNext;
+            place(n);
+            n = next;
+         }
+      }
+
+      void cascade(unsigned int level, unsigned int slot)
+      {
+         Node* n = mSlots[level][slot];
+         mSlots[level][slot] = 0;
+         mOccupied[level][slot/64] &= ~(UInt64(1) << (slot%64));
+         replace(n);
+      }
+
+      /**
+         Finds the lowest level holding any timer, and the first occupied
+         slot on it. By construction all occupied slots on a level lie
+         after the slot mNow currently points at.
+      */
+      bool nextOccupied(unsigned int& level, unsigned int& slot) const
+      {
+         for (level = 0; level < Levels; ++level)
+         {
+            unsigned int current = (unsigned int)(mNow >> (level*SlotBits)) & (Slots-1);
+            for (unsigned int w = current/64; w < Words; ++w)
+            {
+               UInt64 bits = mOccupied[level][w];
+               if (w == current/64)
+               {
+                  // only slots after current
+                  bits &= (current%64 == 63) ? 0 : (~UInt64(0) << (current%64 + 1));
+               }
+               if (bits)
+               {
+                  slot = w*64 + lowestBit(bits);
+                  return true;
+               }
+            }
+         }
+         return false;
+      }
+
+      UInt64 slotStart(unsigned int level, unsigned int slot) const
+      {
+         unsigned int shift = level*SlotBits;
+         UInt64 above = (mNow >> (shift + SlotBits)) << (shift + SlotBits);
+         return above | (UInt64(slot) << shift);
+      }
+
+      static unsigned int lowestBit(UInt64 bits)
+      {
+#if defined(__GNUC__)
+         return (unsigned int)__builtin_ctzll(bits);
+#else
+         unsigned int n = 0;
+         while ((bits & 1) == 0)
+         {
+            bits >>= 1;
+            ++n;
+         }
+         return n;
+#endif
+      }
+
+      void takeList(Node*& head, std::vector<T>& out)
+      {
+         Node* n = head;
+         head = 0;
+         while (n)
+         {
+            Node* next = n->mNext;
+            out.push_back(n->mTimer);
+            delete n;
+            --mSize;
+            n = next;
+         }
+      }
+
+      // wheel time; every timer in the wheels is due after mNow
+      UInt64 mNow;
+      size_t mSize;
+      Node* mSlots[Levels][Slots];
+      UInt64 mOccupied[Levels][Words];
+      Node* mExpired;
+      UInt64 mExpiredMin;
+      Node* mOverflow;
+      UInt64 mOverflowMin;
+
+      // disabled
+      TimerWheel(const TimerWheel&);
+      TimerWheel& operator=(const TimerWheel&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -5,17 +5,20 @@
 #include "resip/stack/AbandonServerTransaction.hxx"
 #include "resip/stack/ApplicationMessage.hxx"
 #include "resip/stack/CancelClientInviteTransaction.hxx"
+#include "resip/stack/DnsResultMessage.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/AddTransport.hxx"
 #include "resip/stack/RemoveTransport.hxx"
 #include "resip/stack/TerminateFlow.hxx"
 #include "resip/stack/EnableFlowTimer.hxx"
+#include "resip/stack/KeepAliveMessage.hxx"
 #include "resip/stack/ZeroOutStatistics.hxx"
 #include "resip/stack/PollStatistics.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionController.hxx"
 #include "resip/stack/TransactionState.hxx"
+#include "resip/stack/TransportFailure.hxx"
 #ifdef USE_SSL
 #include "resip/stack/ssl/Security.hxx"
 #endif
@@ -37,25 +40,62 @@ unsigned int TransactionController::MaxTUFifoSize = 0;
 unsigned int TransactionController::MaxTUFifoTimeDepthSecs = 0;
 
 TransactionController::TransactionController(SipStack& stack, 
-                                                AsyncProcessHandler* handler) :
+                                                AsyncProcessHandler* handler,
+                                                unsigned int numShards,
+                                                FifoMode stateMacFifoMode) :
    mStack(stack),
    mDiscardStrayResponses(true),
    mFixBadDialogIdentifiers(true),
    mFixBadCSeqNumbers(true),
-   mStateMacFifo(handler),
+   mStateMacFifo(handler, stateMacFifoMode),
    mStateMacFifoOutBuffer(mStateMacFifo),
    mCongestionManager(0),
    mTuSelector(stack.mTuSelector),
-   mTransportSelector(mStateMacFifo,
-                      stack.getSecurity(),
-                      stack.getDnsStub(),
-                      stack.getCompression()),
+   mOwnTransportSelector(new TransportSelector(mStateMacFifo,
+                                               stack.getSecurity(),
+                                               stack.getDnsStub(),
+                                               stack.getCompression())),
+   mTransportSelector(*mOwnTransportSelector),
    mTimers(mTimerFifo),
    mShuttingDown(false),
    mStatsManager(stack.mStatsManager),
+   mStatsShard(mStatsManager.addShard()),
+   mShardsHaveOwnThreads(false),
    mHostname(DnsUtil::getLocalHostName())
 {
    mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
+   if(numShards > 1)
+   {
+      mTransportSelector.enableMultiThreadedTransmit();
+      for(unsigned int i=1; i<numShards; ++i)
+      {
+         mShards.push_back(new TransactionController(*this, handler, stateMacFifoMode));
+      }
+      InfoLog(<< "Transaction processing is split across " << numShards << " shards");
+   }
+}
+
+TransactionController::TransactionController(TransactionController& primary,
+                                             AsyncProcessHandler* handler,
+                                             FifoMode stateMacFifoMode) :
+   mStack(primary.mStack),
+   mDiscardStrayResponses(primary.mDiscardStrayResponses),
+   mFixBadDialogIdentifiers(primary.mFixBadDialogIdentifiers),
+   mFixBadCSeqNumbers(primary.mFixBadCSeqNumbers),
+   mStateMacFifo(handler, stateMacFifoMode),
+   mStateMacFifoOutBuffer(mStateMacFifo),
+   mCongestionManager(0),
+   mTuSelector(primary.mTuSelector),
+   mOwnTransportSelector(0),
+   mTransportSelector(primary.mTransportSelector),
+   mTimers(mTimerFifo),
+   mShuttingDown(false),
+   mStatsManager(primary.mStatsManager),
+   mStatsShard(mStatsManager.addShard()),
+   mShardsHaveOwnThreads(false),
+   mHostname(primary.mHostname)
+{
+   mStateMacFifo.setDescription("TransactionController::mStateMacFifo(shard)");
 }
 
 #if defined(WIN32) && !defined(__GNUC__)
@@ -64,6 +104,13 @@ TransactionController::TransactionController(SipStack& stack,
 
 TransactionController::~TransactionController()
 {
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      delete *i;
+   }
+   mShards.clear();
+
    if(mClientTransactionMap.size())
    {
       WarningLog(<< "On shutdown, there are Client TransactionStates remaining!");
@@ -86,15 +133,81 @@ void
 TransactionController::shutdown()
 {
    mShuttingDown = true;
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      (*i)->mShuttingDown = true;
+   }
    mTransportSelector.shutdown();
 }
 
+TransactionController&
+TransactionController::getShard(unsigned int i)
+{
+   assert(i < getNumShards());
+   return i==0 ? *this : *mShards[i-1];
+}
+
+TransactionController&
+TransactionController::selectShard(const Data& tid)
+{
+   if(mShards.empty() || tid.empty())
+   {
+      return *this;
+   }
+   size_t shard = tid.caseInsensitiveTokenHash() % getNumShards();
+   return shard==0 ? *this : *mShards[shard-1];
+}
+
+TransactionController&
+TransactionController::selectShard(TransactionMessage* msg)
+{
+   if(mShards.empty())
+   {
+      return *this;
+   }
+
+   // Only messages that belong to a specific transaction are moved to
+   // another shard; everything else (transport add/remove, flow control,
+   // statistics, keepalives) is handled by the primary.
+   SipMessage* sip = dynamic_cast<SipMessage*>(msg);
+   if(sip)
+   {
+      if(dynamic_cast<KeepAliveMessage*>(sip))
+      {
+         return *this;
+      }
+      try
+      {
+         return selectShard(sip->getTransactionId());
+      }
+      catch(resip::BaseException&)
+      {
+         // Let the primary deal with (and drop) it
+         return *this;
+      }
+   }
+
+   if(dynamic_cast<TransportFailure*>(msg) ||
+      dynamic_cast<DnsResultMessage*>(msg) ||
+      dynamic_cast<AbandonServerTransaction*>(msg) ||
+      dynamic_cast<CancelClientInviteTransaction*>(msg))
+   {
+      return selectShard(msg->getTransactionId());
+   }
+   return *this;
+}
+
 void
 TransactionController::process(int timeout)
 {
+   // Shards drain their fifos like the primary, but only the primary
+   // (which waits for all of them) tells the TU that the stack is done
    if (mShuttingDown && 
+       mOwnTransportSelector.get() &&
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
+       getTransactionFifoSize()==0 &&
        !mStack.mTUFifo.messageAvailable() &&
        mTransportSelector.isFinished())
 // !dcm! -- why would one wait for the Tu's fifo to be empty before delivering a
@@ -105,6 +218,15 @@ TransactionController::process(int timeout)
    }
    else
    {
+      if(!mShardsHaveOwnThreads)
+      {
+         for(std::vector<TransactionController*>::iterator i=mShards.begin();
+               i!=mShards.end(); ++i)
+         {
+            (*i)->process(0);
+         }
+      }
+
       unsigned int nextTimer(mTimers.msTillNextTimer());
       timeout=resipMin((int)nextTimer, timeout);
       if(timeout==0)
@@ -114,8 +236,8 @@ TransactionController::process(int timeout)
       }
 
       // Check if Statistics Manager needs to be polled - note:  all statistic manager polls should happen from the 
-      // TransactionController thread / process loop
-      if(mStack.mStatisticsManagerEnabled)
+      // TransactionController thread / process loop (of the primary shard)
+      if(mStack.mStatisticsManagerEnabled && mOwnTransportSelector.get())
       {
          mStatsManager.process();
       }
@@ -147,7 +269,17 @@ TransactionController::process(int timeout)
          int runs=16;
          while(message)
          {
-            TransactionState::process(*this, message);
+            // Messages arriving from the transports land on the primary; 
+            // hand them to the shard that owns their transaction.
+            TransactionController& shard = selectShard(message);
+            if(&shard == this)
+            {
+               TransactionState::process(*this, message);
+            }
+            else
+            {
+               shard.mStateMacFifo.add(message);
+            }
             if(--runs==0)
             {
                break;
@@ -167,12 +299,31 @@ TransactionController::getTimeTillNextProcessMS()
    {
       return 0;
    }
-   return mTimers.msTillNextTimer();
+   unsigned int next = mTimers.msTillNextTimer();
+   if(!mShardsHaveOwnThreads)
+   {
+      for(std::vector<TransactionController*>::iterator i=mShards.begin();
+            i!=mShards.end(); ++i)
+      {
+         next = resipMin(next, (*i)->getTimeTillNextProcessMS());
+      }
+   }
+   return next;
 } 
 
 void
 TransactionController::send(SipMessage* msg)
 {
+   if(!mShards.empty())
+   {
+      TransactionController& shard = selectShard(msg);
+      if(&shard != this)
+      {
+         shard.send(msg);
+         return;
+      }
+   }
+
    if(msg->isRequest() && 
       msg->method() != ACK && 
       getRejectionBehavior()!=CongestionManager::NORMAL)
@@ -206,25 +357,108 @@ TransactionController::getTransactionFifoSize() const
 {
    // Should we include the stuff in mStateMacFifoOutBuffer here too? This is
    // likely to be called from other threads...
-   return mStateMacFifo.size();
+   unsigned int size = mStateMacFifo.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      size += (*i)->getTransactionFifoSize();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumClientTransactions() const
 {
-   return mClientTransactionMap.size();
+   unsigned int num = mClientTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      num += (*i)->getNumClientTransactions();
+   }
+   return num;
 }
 
 unsigned int 
 TransactionController::getNumServerTransactions() const
 {
-   return mServerTransactionMap.size();
+   unsigned int num = mServerTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      num += (*i)->getNumServerTransactions();
+   }
+   return num;
 }
 
 unsigned int 
 TransactionController::getTimerQueueSize() const
 {
-   return mTimers.size();
+   unsigned int size = mTimers.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      size += (*i)->getTimerQueueSize();
+   }
+   return size;
+}
+
+void
+TransactionController::setCongestionManager(CongestionManager* manager)
+{
+   mTransportSelector.setCongestionManager(manager);
+   registerStateMacFifo(manager);
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      (*i)->registerStateMacFifo(manager);
+   }
+}
+
+void
+TransactionController::registerStateMacFifo(CongestionManager* manager)
+{
+   if(mCongestionManager)
+   {
+      mCongestionManager->unregisterFifo(&mStateMacFifo);
+   }
+   mCongestionManager=manager;
+   if(mCongestionManager)
+   {
+      mCongestionManager->registerFifo(&mStateMacFifo);
+   }
+}
+
+void
+TransactionController::setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers)
+{
+   mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      (*i)->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+   }
+}
+
+void
+TransactionController::setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
+{
+   mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      (*i)->mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+   }
+}
+
+void
+TransactionController::useTimerWheel(bool enable)
+{
+   mTimers.useTimerWheel(enable);
+   for(std::vector<TransactionController*>::iterator i=mShards.begin();
+         i!=mShards.end(); ++i)
+   {
+      (*i)->mTimers.useTimerWheel(enable);
+   }
 }
 
 void 
@@ -253,13 +487,13 @@ void TransactionController::unregisterMarkListener(MarkListener* listener)
 void 
 TransactionController::abandonServerTransaction(const Data& tid)
 {
-   mStateMacFifo.add(new AbandonServerTransaction(tid));
+   selectShard(tid).mStateMacFifo.add(new AbandonServerTransaction(tid));
 }
 
 void 
 TransactionController::cancelClientInviteTransaction(const Data& tid)
 {
-   mStateMacFifo.add(new CancelClientInviteTransaction(tid));
+   selectShard(tid).mStateMacFifo.add(new CancelClientInviteTransaction(tid));
 }
 
 void 
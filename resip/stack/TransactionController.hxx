@@ -1,6 +1,8 @@
 #if !defined(RESIP_TRANSACTION_CONTROLLER_HXX)
 #define RESIP_TRANSACTION_CONTROLLER_HXX
 
+#include <vector>
+
 #include "resip/stack/TuSelector.hxx"
 #include "resip/stack/TransactionMap.hxx"
 #include "resip/stack/TransportSelector.hxx"
@@ -27,8 +29,19 @@ class TransactionController
       static unsigned int MaxTUFifoSize;
       static unsigned int MaxTUFifoTimeDepthSecs;
 
+      /**
+         @param numShards If greater than 1, this controller becomes the 
+            primary of numShards transaction-controller shards. Each shard 
+            owns its own TransactionMaps, timer queue and state machine fifo;
+            messages are assigned to a shard by hashing their transaction id 
+            (the Via branch), so a transaction is only ever touched by the 
+            thread that services its shard. The TransportSelector is owned by
+            the primary and shared by all shards.
+      */
       TransactionController(SipStack& stack, 
-                              AsyncProcessHandler* handler);
+                              AsyncProcessHandler* handler,
+                              unsigned int numShards=1,
+                              FifoMode stateMacFifoMode=FifoLocking);
       ~TransactionController();
 
       void process(int timeout=0);
@@ -44,6 +57,16 @@ class TransactionController
       
       void send(SipMessage* msg);
 
+      /// Number of shards (including this one); 1 if sharding is not in use.
+      unsigned int getNumShards() const { return (unsigned int)mShards.size() + 1; }
+
+      /// Returns shard i (0 is the primary controller itself).
+      TransactionController& getShard(unsigned int i);
+
+      /// Set when each shard is given cycles by its own thread; otherwise 
+      /// process() on the primary also gives cycles to the other shards.
+      void setShardsHaveOwnThreads(bool value) { mShardsHaveOwnThreads = value; }
+
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
       unsigned int getTransactionFifoSize() const;
@@ -53,19 +76,7 @@ class TransactionController
       void zeroOutStatistics();
       void pollStatistics();
       
-      void setCongestionManager( CongestionManager *manager ) 
-      { 
-         mTransportSelector.setCongestionManager(manager);
-         if(mCongestionManager)
-         {
-            mCongestionManager->unregisterFifo(&mStateMacFifo);
-         }
-         mCongestionManager=manager;
-         if(mCongestionManager)
-         {
-            mCongestionManager->registerFifo(&mStateMacFifo);
-         }
-      }
+      void setCongestionManager( CongestionManager *manager );
 
       CongestionManager::RejectionBehavior getRejectionBehavior() const
       {
@@ -84,16 +95,14 @@ class TransactionController
          return mFixBadDialogIdentifiers;
       }
 
-      inline void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
-      {
-         mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
-      }
+      void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers);
 
       inline bool getFixBadCSeqNumbers() const { return mFixBadCSeqNumbers;} 
-      inline void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
-      {
-         mFixBadCSeqNumbers = pFixBadCSeqNumbers;
-      }
+      void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers);
+
+      /// see TimerQueue::useTimerWheel(); applies to all shards. Only
+      /// before any transaction has been started.
+      void useTimerWheel(bool enable);
 
       void abandonServerTransaction(const Data& tid);
       void cancelClientInviteTransaction(const Data& tid);
@@ -104,8 +113,20 @@ class TransactionController
 
       void setInterruptor(AsyncProcessHandler* handler);
    private:
+      // Constructs a secondary shard of primary
+      TransactionController(TransactionController& primary,
+                              AsyncProcessHandler* handler,
+                              FifoMode stateMacFifoMode);
       TransactionController(const TransactionController& rhs);
       TransactionController& operator=(const TransactionController& rhs);
+
+      void registerStateMacFifo(CongestionManager* manager);
+
+      // Picks the shard that owns the transaction msg belongs to; returns 
+      // this controller for anything that is not transaction-specific.
+      TransactionController& selectShard(TransactionMessage* msg);
+      TransactionController& selectShard(const Data& tid);
+
       SipStack& mStack;
       
       // If true, indicate to the Transaction to ignore responses for which
@@ -137,8 +158,10 @@ class TransactionController
       // from the sipstack (for convenience)
       TuSelector& mTuSelector;
 
-      // Used to decide which transport to send a sip message on. 
-      TransportSelector mTransportSelector;
+      // Used to decide which transport to send a sip message on. Owned by the
+      // primary controller (0 in shards), and shared by all shards.
+      std::auto_ptr<TransportSelector> mOwnTransportSelector;
+      TransportSelector& mTransportSelector;
 
       // stores all of the transactions that are currently active in this stack 
       TransactionMap mClientTransactionMap;
@@ -151,6 +174,12 @@ class TransactionController
       bool mShuttingDown;
       
       StatisticsManager& mStatsManager;
+      // this shard's message counters in mStatsManager
+      unsigned int mStatsShard;
+
+      // Secondary shards; only populated on the primary controller.
+      std::vector<TransactionController*> mShards;
+      bool mShardsHaveOwnThreads;
       
       Data mHostname;
       
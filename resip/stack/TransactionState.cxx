@@ -20,6 +20,7 @@
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/SendData.hxx"
 #include "resip/stack/SipStack.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "resip/stack/StatisticsManager.hxx"
 #include "resip/stack/TimerMessage.hxx"
 #include "resip/stack/TransactionController.hxx"
@@ -496,11 +497,20 @@ TransactionState::process(TransactionController& controller,
 
    if(sip)
    {
+      if(sip->isExternal())
+      {
+         sip->traceHop(MessageTrace::Transaction);
+      }
       method=sip->method();
       // ?bwc? Should this come after checking for error conditions?
-      if(controller.mStack.statisticsManagerEnabled() && sip->isExternal())
+      if(sip->isExternal())
       {
-         controller.mStatsManager.received(sip);
+         StackStatistics::increment(sip->isRequest() ? StackStatistics::RequestsReceived
+                                                     : StackStatistics::ResponsesReceived);
+         if(controller.mStack.statisticsManagerEnabled())
+         {
+            controller.mStatsManager.received(sip, controller.mStatsShard);
+         }
       }
       
       // .bwc. Check for error conditions we can respond to.
@@ -2479,11 +2489,14 @@ TransactionState::sendCurrentToWire()
 {
    if(!mMsgToRetransmit.empty())
    {
+      StackStatistics::increment(isClient() ? StackStatistics::RequestsRetransmitted
+                                            : StackStatistics::ResponsesRetransmitted);
       if(mController.mStack.statisticsManagerEnabled())
       {
          mController.mStatsManager.retransmitted(mCurrentMethodType, 
                                                    isClient(), 
-                                                   mCurrentResponseCode);
+                                                   mCurrentResponseCode,
+                                                   mController.mStatsShard);
       }
 
       mController.mTransportSelector.retransmit(mMsgToRetransmit);
@@ -2606,9 +2619,11 @@ TransactionState::onSendSuccess()
 {
    SipMessage* sip=mNextTransmission;
 
+   StackStatistics::increment(sip->isRequest() ? StackStatistics::RequestsSent
+                                               : StackStatistics::ResponsesSent);
    if(mController.mStack.statisticsManagerEnabled())
    {
-      mController.mStatsManager.sent(sip);
+      mController.mStatsManager.sent(sip, mController.mStatsShard);
    }
 
    mCurrentMethodType = sip->method();
@@ -2732,6 +2747,10 @@ TransactionState::sendToTU(TransactionMessage* msg)
       }
    }
    
+   if(sipMsg)
+   {
+      sipMsg->traceHop(MessageTrace::TuQueued);
+   }
    TransactionState::sendToTU(mTransactionUser, mController, msg);
 }
 
@@ -1,5 +1,6 @@
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/stack/MessageFilterRule.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -25,6 +26,7 @@ TransactionUser::TransactionUser(TransactionTermination t,
   // Set a default Fifo description - should be modified by override class to be
   // more desriptive
    mFifo.setDescription("TransactionUser::mFifo");
+   mFifo.setWaitStatistic(&StackStatistics::statistics(), StackStatistics::TuFifo);
 }
 
 TransactionUser::TransactionUser(MessageFilterRuleList &mfrl, 
@@ -42,6 +44,7 @@ TransactionUser::TransactionUser(MessageFilterRuleList &mfrl,
   // Set a default Fifo description - should be modified by override class to be
   // more desriptive
    mFifo.setDescription("TransactionUser::mFifo");
+   mFifo.setWaitStatistic(&StackStatistics::statistics(), StackStatistics::TuFifo);
 }
 
 TransactionUser::~TransactionUser()
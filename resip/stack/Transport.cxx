@@ -439,6 +439,10 @@ Transport::pushRxMsgUp(SipMessage* message)
        handler->inboundMessage(message->getSource(), message->getReceivedTransportTuple(), *message);
    }
 
+   if (MessageTrace::sample())
+   {
+      message->startTrace();
+   }
    mStateMachineFifo.add(message);
 }
 
@@ -51,6 +51,16 @@ class FdPollGrp;
  *    Specifies whether this Transport object has its own thread (ie; if
  *    set, the TransportSelector should not run the select/poll loop for
  *    this transport, since that is another thread's job)
+ * BATCHIO:
+ *    On datagram transports that support it (UDP on platforms with
+ *    recvmmsg()/sendmmsg()), receive and transmit up to the transport's
+ *    batch size of datagrams per system call. Receive buffers are kept
+ *    preallocated between calls. Combine with RXALL/TXALL to keep going
+ *    until the socket or the transmit queue is drained.
+ * REUSEPORT:
+ *    Set SO_REUSEPORT on the socket before binding, so that further
+ *    sockets may be bound to the same address and have the kernel spread
+ *    incoming datagrams between them. See UdpTransport::addReceiveSockets().
  */
 #define RESIP_TRANSPORT_FLAG_NOBIND      (1<<0)
 #define RESIP_TRANSPORT_FLAG_RXALL       (1<<1)
@@ -58,6 +68,8 @@ class FdPollGrp;
 #define RESIP_TRANSPORT_FLAG_KEEP_BUFFER (1<<3)
 #define RESIP_TRANSPORT_FLAG_TXNOW       (1<<4)
 #define RESIP_TRANSPORT_FLAG_OWNTHREAD   (1<<5)
+#define RESIP_TRANSPORT_FLAG_BATCHIO     (1<<6)
+#define RESIP_TRANSPORT_FLAG_REUSEPORT   (1<<7)
 
 /**
    @brief The base class for Transport classes.
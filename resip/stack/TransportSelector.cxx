@@ -163,9 +163,20 @@ TransportSelector::isFinished() const
    return true;
 }
 
+void
+TransportSelector::enableMultiThreadedTransmit()
+{
+   if(!mTransportsMutex.get())
+   {
+      mTransportsMutex.reset(new RWMutex);
+      mSourceInterfaceMutex.reset(new Mutex);
+   }
+}
+
 void
 TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isStackRunning)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_WRITELOCK);
    Transport* transport = autoTransport.release();
 
    // !bwc! This is a multimap from TransportType/IpVersion to Transport*.
@@ -296,6 +307,7 @@ TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isS
 void
 TransportSelector::removeTransport(unsigned int transportKey)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_WRITELOCK);
    Transport* transportToRemove = 0;
 
    // Find transport in global map and remove it
@@ -485,6 +497,7 @@ TransportSelector::checkTransportAddRemoveQueue()
 void 
 TransportSelector::poke()
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    for(TransportList::iterator it = mHasOwnProcessTransports.begin(); it != mHasOwnProcessTransports.end(); it++)
    {
       try
@@ -718,6 +731,9 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
    assert( (!(msg->isRequest() && !via.sentHost().empty())) || (target.getType() == TLS || target.getType() == DTLS) );
    if (1)
    {
+      // The fake sockets are shared, and connect()/getsockname() on them must
+      // not interleave when several transaction shards are transmitting.
+      PtrLock lock(mSourceInterfaceMutex.get());
       Tuple source(target);
 #if defined(WIN32) && !defined(NO_IPHLPAPI)
       try
@@ -880,6 +896,7 @@ TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
    assert(msg);
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
 
    if(msg->mIsDecorated)
    {
@@ -1269,12 +1286,16 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
                                                    msg->getTransactionId(),
                                                    remoteSigcompId));
 
+         send->encodeStart = Timer::getTimeMicroSec();
          send->data.reserve(mAvgBufferSize + mAvgBufferSize/4);
 
          DataStream str(send->data);
          msg->encode(str);
          str.flush();
 
+         msg->traceHop(MessageTrace::Transmitted);
+         msg->endTrace();
+
          // !bwc! Moving average of message size. (Used to intelligently
          // predict how much space to reserve in the buffer, to minimize
          // dynamic resizing.)
@@ -1314,6 +1335,7 @@ void
 TransportSelector::retransmit(const SendData& data)
 {
    assert(data.destination.mTransportKey);
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    Transport* transport = findTransportByDest(data.destination);
 
    // !jf! The previous call to transmit may have blocked or failed (It seems to
@@ -1348,13 +1370,16 @@ TransportSelector::retransmit(const SendData& data)
          handler->outboundRetransmit(transport->getTuple(), data.destination, data);
       }
        
-      transport->send(std::auto_ptr<SendData>(data.clone()));
+      std::auto_ptr<SendData> send(data.clone());
+      send->encodeStart = Timer::getTimeMicroSec();
+      transport->send(send);
    }
 }
 
 void 
 TransportSelector::closeConnection(const Tuple& peer)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    Transport* t = findTransportByDest(peer);
    if(t)
    {
@@ -1387,6 +1412,7 @@ TransportSelector::terminateFlow(const resip::Tuple& flow)
 void 
 TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    Transport* t = findTransportByDest(flow);
    if(t)
    {
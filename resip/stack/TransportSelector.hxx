@@ -12,6 +12,9 @@
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/RWMutex.hxx"
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/SelectInterruptor.hxx"
@@ -54,7 +57,11 @@ the TransactionController Thread.  The TransportSelectorThread itself is used
 to provide cycles to the actual transports for sending data in their Fifo's and
 receiving data from the wire.  The mSharedProcessTransports list is one member that
 is expected to be accessed from TransportSelector processing loop only , all other 
-members are accessed from the TransactionController processing loop.
+members are accessed from the TransactionController processing loop.  When the
+TransactionController is split into several shards (each with its own thread),
+enableMultiThreadedTransmit() must be called; the transport maps are then
+guarded by a readers/writer lock, so the transmit path can run concurrently in
+every shard while add/remove of Transports is serialized.
 */
 class TransportSelector
 {
@@ -96,6 +103,11 @@ class TransportSelector
       /// their transmit fifos.
       void poke();
 
+      /// Allows transmit() and friends to be called from several threads at 
+      /// once (sharded TransactionController). Must be called before any 
+      /// Transports are added.
+      void enableMultiThreadedTransmit();
+
       /// Add/Remove a transport
       void addTransport(std::auto_ptr<Transport> transport, bool isStackRunning);
       void removeTransport(unsigned int transportKey);
@@ -254,6 +266,10 @@ class TransportSelector
       std::auto_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
+      // Only present when enableMultiThreadedTransmit() has been called
+      std::auto_ptr<RWMutex> mTransportsMutex;
+      std::auto_ptr<Mutex> mSourceInterfaceMutex;
+
       friend class TestTransportSelector;
       friend class SipStack; // for debug only
 };
@@ -2,34 +2,106 @@
 
 #include "resip/stack/MarkListener.hxx"
 #include "rutil/Lock.hxx"
+#include "rutil/MpscQueue.hxx"
 #include "rutil/Timer.hxx"
+#include "rutil/dns/DnsStub.hxx"
 
 namespace resip
 {
 
-TupleMarkManager::MarkType 
-TupleMarkManager::getMarkType(const Tuple& tuple)
+namespace
+{
+class ExpireCommand : public DnsStub::Command
+{
+   public:
+      ExpireCommand(TupleMarkManager& markManager) : mMarkManager(markManager) {}
+      virtual ~ExpireCommand() {}
+      virtual void execute() { mMarkManager.expire(); }
+   private:
+      TupleMarkManager& mMarkManager;
+};
+}
+
+TupleMarkManager::TupleMarkManager(DnsStub* dnsStub) :
+   mSize(0),
+   mNextExpiry(0),
+   mExpireQueued(0),
+   mEpoch(0),
+   mDrainSlot(0),
+   mDnsStub(dnsStub)
+{
+   for (unsigned int b = 0; b < Buckets; ++b)
+   {
+      mBuckets[b] = 0;
+   }
+   mReaders[0] = 0;
+   mReaders[1] = 0;
+}
+
+TupleMarkManager::~TupleMarkManager()
+{
+   for (unsigned int b = 0; b < Buckets; ++b)
+   {
+      Node* n = mBuckets[b];
+      while (n)
+      {
+         Node* next = n->mNext;
+         delete n;
+         n = next;
+      }
+   }
+   for (std::vector<Node*>::iterator i = mRetired.begin(); i != mRetired.end(); ++i)
+   {
+      delete *i;
+   }
+   for (std::vector<Node*>::iterator i = mDraining.begin(); i != mDraining.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+TupleMarkManager::ReadGuard::ReadGuard(TupleMarkManager& markManager) :
+   mMarkManager(markManager)
 {
-   ListEntry entry(tuple,0);
-   TupleList::iterator i=mList.find(entry);
-   
-   if(i!=mList.end())
+   for (;;)
    {
-      UInt64 now=Timer::getTimeMs();
-      if(i->first.mExpiry > now)
+      mSlot = MpscAtomic::load(&mMarkManager.mEpoch);
+      MpscAtomic::add(&mMarkManager.mReaders[mSlot], 1);
+      if (MpscAtomic::load(&mMarkManager.mEpoch) == mSlot)
       {
-         return i->second;
+         return;
       }
-      else
+      // the epoch flipped under us; the writer may not wait for us
+      MpscAtomic::sub(&mMarkManager.mReaders[mSlot], 1);
+   }
+}
+
+TupleMarkManager::ReadGuard::~ReadGuard()
+{
+   MpscAtomic::sub(&mMarkManager.mReaders[mSlot], 1);
+}
+
+TupleMarkManager::MarkType 
+TupleMarkManager::getMarkType(const Tuple& tuple)
+{
+   UInt64 now=Timer::getTimeMs();
+
+   // may be read torn where 64 bit loads are not atomic; that only moves
+   // the expiry early or late
+   UInt64 nextExpiry = mNextExpiry;
+   if (nextExpiry != 0 && nextExpiry <= now)
+   {
+      requestExpire();
+   }
+
+   ReadGuard guard(*this);
+   for (Node* n = MpscAtomic::loadPtr(&mBuckets[bucket(tuple)]); n; n = MpscAtomic::loadPtr(&n->mNext))
+   {
+      if (matches(*n, tuple))
       {
-         mList.erase(i);
-         // ?bwc? Should we do this?
-         UInt64 expiry = 0;
-         MarkType mark = OK;
-         notifyListeners(tuple,expiry,mark);
+         return n->mExpiry > now ? n->mMark : OK;
       }
    }
-   
    return OK;
 }
 
@@ -37,78 +109,155 @@ void TupleMarkManager::mark(const Tuple& tuple,UInt64 expiry,MarkType mark)
 {
    // .amr. Notify listeners first so they can change the entry if they want
    notifyListeners(tuple,expiry,mark);
-   ListEntry entry(tuple,expiry);
-   mList[entry]=mark;
-}
 
-void TupleMarkManager::registerMarkListener(MarkListener* listener)
-{
-   mListeners.insert(listener);
+   UInt64 now = Timer::getTimeMs();
+   Node** link = findLink(tuple);
+   Node* old = *link;
+   // readers may be on old, so it is replaced, not changed
+   MpscAtomic::storePtr(link, new Node(tuple, expiry, mark, old ? old->mNext : 0));
+   if (old)
+   {
+      mRetired.push_back(old);
+   }
+   else
+   {
+      ++mSize;
+   }
+   mExpiries.push(Expiry(tuple, expiry));
+
+   expire(now);
 }
 
-void TupleMarkManager::unregisterMarkListener(MarkListener* listener)
+void
+TupleMarkManager::expire()
 {
-   mListeners.erase(listener);
+   expire(Timer::getTimeMs());
 }
 
 void
-TupleMarkManager::notifyListeners(const resip::Tuple& tuple, UInt64& expiry, MarkType& mark)
+TupleMarkManager::expire(UInt64 now)
 {
-   for(Listeners::iterator i = mListeners.begin(); i!=mListeners.end(); ++i)
+   // before the work, so a mark falling due meanwhile queues another pass
+   MpscAtomic::store(&mExpireQueued, 0);
+
+   std::vector<Expiry> due;
+   if (!mExpiries.empty())
    {
-      (*i)->onMark(tuple,expiry,mark);
+      mExpiries.expire(now, due);
    }
-}
-
-TupleMarkManager::ListEntry::ListEntry(const Tuple& tuple, UInt64 expiry)
-   : mTuple(tuple),
-   mExpiry(expiry)
-{}
 
-TupleMarkManager::ListEntry::ListEntry(const TupleMarkManager::ListEntry& orig)
-   : mTuple(orig.mTuple),
-   mExpiry(orig.mExpiry)
-{}
+   std::vector<Tuple> expired;
+   for (std::vector<Expiry>::const_iterator i = due.begin(); i != due.end(); ++i)
+   {
+      Node** link = findLink(i->mTuple);
+      Node* n = *link;
+      // a later mark() may have replaced the one this expiry was for
+      if (n && n->mExpiry <= now)
+      {
+         MpscAtomic::storePtr(link, MpscAtomic::loadPtr(&n->mNext));
+         mRetired.push_back(n);
+         --mSize;
+         expired.push_back(n->mTuple);
+      }
+   }
 
-TupleMarkManager::ListEntry::~ListEntry()
-{}
+   mNextExpiry = mExpiries.empty() ? 0 : mExpiries.nextWhen();
+   freeRetired();
 
-bool 
-TupleMarkManager::ListEntry::operator<(const TupleMarkManager::ListEntry& rhs) const
-{
-   if(mTuple < rhs.mTuple)
+   if (!expired.empty())
    {
-      return true;
+      Lock lock(mListenersMutex);
+      for (Listeners::iterator i = mListeners.begin(); i != mListeners.end(); ++i)
+      {
+         (*i)->onExpired(expired);
+      }
    }
-   else if(rhs.mTuple < mTuple)
+}
+
+void
+TupleMarkManager::requestExpire()
+{
+   if (mDnsStub && MpscAtomic::add(&mExpireQueued, 1) == 1)
    {
-      return false;
+      mDnsStub->queueCommand(new ExpireCommand(*this));
    }
-   
-   return mTuple.getTargetDomain() < rhs.mTuple.getTargetDomain();
 }
 
-bool 
-TupleMarkManager::ListEntry::operator>(const TupleMarkManager::ListEntry& rhs) const
+void
+TupleMarkManager::freeRetired()
 {
-   if(rhs.mTuple < mTuple)
+   if (!mDraining.empty() && MpscAtomic::load(&mReaders[mDrainSlot]) == 0)
    {
-      return true;
+      for (std::vector<Node*>::iterator i = mDraining.begin(); i != mDraining.end(); ++i)
+      {
+         delete *i;
+      }
+      mDraining.clear();
+   }
+   if (mDraining.empty() && !mRetired.empty())
+   {
+      // Readers arriving from now on can not reach what is in mRetired;
+      // those already in the current slot may, so it has to drain first.
+      mDrainSlot = MpscAtomic::load(&mEpoch);
+      MpscAtomic::store(&mEpoch, mDrainSlot ^ 1);
+      mDraining.swap(mRetired);
+      if (MpscAtomic::load(&mReaders[mDrainSlot]) == 0)
+      {
+         for (std::vector<Node*>::iterator i = mDraining.begin(); i != mDraining.end(); ++i)
+         {
+            delete *i;
+         }
+         mDraining.clear();
+      }
    }
-   else if(mTuple < rhs.mTuple)
+}
+
+void TupleMarkManager::registerMarkListener(MarkListener* listener)
+{
+   Lock lock(mListenersMutex);
+   mListeners.insert(listener);
+}
+
+void TupleMarkManager::unregisterMarkListener(MarkListener* listener)
+{
+   Lock lock(mListenersMutex);
+   mListeners.erase(listener);
+}
+
+void
+TupleMarkManager::notifyListeners(const resip::Tuple& tuple, UInt64& expiry, MarkType& mark)
+{
+   Lock lock(mListenersMutex);
+   for(Listeners::iterator i = mListeners.begin(); i!=mListeners.end(); ++i)
    {
-      return false;
+      (*i)->onMark(tuple,expiry,mark);
    }
-   
-   return mTuple.getTargetDomain() > rhs.mTuple.getTargetDomain();
 }
 
-bool 
-TupleMarkManager::ListEntry::operator==(const TupleMarkManager::ListEntry& rhs) const
+unsigned int
+TupleMarkManager::bucket(const Tuple& tuple)
+{
+   // Tuple::hash() keeps the first octet of an IPv4 address in its low
+   // bits, so take the high bits of a multiplicative hash
+   return (UInt32(tuple.hash()) * 2654435761U) >> (32 - BucketBits);
+}
+
+bool
+TupleMarkManager::matches(const Node& node, const Tuple& tuple)
 {
-   return (mTuple==rhs.mTuple && mTuple.getTargetDomain()==rhs.mTuple.getTargetDomain());
+   return node.mTuple == tuple && node.mTuple.getTargetDomain() == tuple.getTargetDomain();
 }
 
+TupleMarkManager::Node**
+TupleMarkManager::findLink(const Tuple& tuple)
+{
+   Node** link = &mBuckets[bucket(tuple)];
+   while (*link && !matches(**link, tuple))
+   {
+      link = &(*link)->mNext;
+   }
+   return link;
+}
 
 }
 
@@ -1,21 +1,44 @@
 #ifndef TUPLE_MARK_MANAGER
 #define TUPLE_MARK_MANAGER
 
+#include "resip/stack/TimerWheel.hxx"
 #include "resip/stack/Tuple.hxx"
 #include "rutil/Mutex.hxx"
 #include <set>
-#include <map>
+#include <vector>
 
 namespace resip
 {
 
+class DnsStub;
 class MarkListener;
 
+/**
+   @brief Keeps the grey and black marks DnsResult puts on targets that
+   failed, until they expire.
+
+   Marks are kept in a fixed size hash table of immutable nodes.
+   getMarkType() takes no lock, so any thread can consult the marks while
+   choosing a target. mark() and expire() change the table; they must all
+   be called from one thread (the DNS thread, through DnsStub commands),
+   and replace a node rather than change it in place. Nodes unlinked from
+   the table are only freed once no reader can still be looking at them:
+   readers are counted in two epoch slots, as in SnapshotPtr, and unlinked
+   nodes wait for the readers of the epoch they were unlinked in to leave.
+   The writer never waits for them; it checks again on its next change or
+   expiry pass.
+
+   Expiries are kept in a TimerWheel. expire() removes every mark that has
+   expired and tells the MarkListeners about all of them at once. It runs
+   on each mark() and, if a DnsStub was given, as a command queued when
+   getMarkType() sees that a mark is due; an expired mark reads as OK
+   either way.
+*/
 class TupleMarkManager
 {
    public:
-      TupleMarkManager(){}
-      virtual ~TupleMarkManager(){}
+      TupleMarkManager(DnsStub* dnsStub = 0);
+      virtual ~TupleMarkManager();
       
       typedef enum
       {
@@ -25,37 +48,90 @@ class TupleMarkManager
       }
       MarkType;
 
+      /// Lock-free; may be called from any thread.
       MarkType getMarkType(const Tuple& tuple);
       
       void mark(const Tuple& tuple,UInt64 expiry,MarkType mark);
+      /// Removes the marks that have expired and notifies the listeners.
+      void expire();
       void registerMarkListener(MarkListener*);
       void unregisterMarkListener(MarkListener*);
 
+      /// Number of marks held, including expired ones not yet removed.
+      size_t size() const { return mSize; }
+
    private:
-      
-      class ListEntry
+      enum
+      {
+         BucketBits = 12,
+         Buckets = 1 << BucketBits
+      };
+
+      struct Node
+      {
+         Node(const Tuple& tuple, UInt64 expiry, MarkType mark, Node* next) :
+            mTuple(tuple), mExpiry(expiry), mMark(mark), mNext(next) {}
+         const Tuple mTuple;
+         const UInt64 mExpiry;
+         const MarkType mMark;
+         Node* mNext;
+      };
+
+      struct Expiry
+      {
+         Expiry(const Tuple& tuple, UInt64 when) : mTuple(tuple), mWhen(when) {}
+         UInt64 getWhen() const { return mWhen; }
+         Tuple mTuple;
+         UInt64 mWhen;
+      };
+
+      // Registers a reader in the current epoch for its lifetime.
+      class ReadGuard
       {
          public:
-            ListEntry(const Tuple& tuple, UInt64 expiry);
-            ListEntry(const ListEntry& orig);
-            ~ListEntry();
-            bool operator<(const ListEntry& rhs) const;
-            bool operator>(const ListEntry& rhs) const;
-            bool operator==(const ListEntry& rhs) const;
-            
-            Tuple mTuple;
-            UInt64 mExpiry;
+            ReadGuard(TupleMarkManager& markManager);
+            ~ReadGuard();
          private:
-            ListEntry();
+            TupleMarkManager& mMarkManager;
+            UInt32 mSlot;
       };
-      
-      typedef std::map<ListEntry,MarkType> TupleList;
-      TupleList mList;
-            
+      friend class ReadGuard;
+
+      static unsigned int bucket(const Tuple& tuple);
+      static bool matches(const Node& node, const Tuple& tuple);
+
+      /// Returns the link pointing at tuple's node, or at the end of its chain.
+      Node** findLink(const Tuple& tuple);
+      void expire(UInt64 now);
+      void requestExpire();
+      void freeRetired();
+
+      Node* mBuckets[Buckets];
+      size_t mSize;
+
+      TimerWheel<Expiry> mExpiries;
+      // earliest time expire() has something to do, 0 if nothing is marked
+      volatile UInt64 mNextExpiry;
+      volatile UInt32 mExpireQueued;
+      // readers in each epoch slot, and the current slot
+      volatile UInt32 mReaders[2];
+      volatile UInt32 mEpoch;
+      // unlinked in the current epoch
+      std::vector<Node*> mRetired;
+      // unlinked before the last epoch flip, freed once mDrainSlot is empty
+      std::vector<Node*> mDraining;
+      UInt32 mDrainSlot;
+      DnsStub* mDnsStub;
+
+      Mutex mListenersMutex;
       typedef std::set<MarkListener*> Listeners;
       Listeners mListeners;
       
       void notifyListeners(const resip::Tuple& tuple, UInt64& expiry, MarkType& mark);
+
+      // disabled
+      TupleMarkManager(const TupleMarkManager&);
+      TupleMarkManager& operator=(const TupleMarkManager&);
 };
 
 }
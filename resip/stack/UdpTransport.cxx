@@ -7,6 +7,8 @@
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SendData.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/TransportThread.hxx"
 #include "resip/stack/UdpTransport.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
@@ -22,11 +24,58 @@
 #include <osc/SigcompMessage.h>
 #endif
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define RESIP_UDP_BATCHIO
+#endif
+
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
 using namespace std;
 using namespace resip;
 
+#ifdef RESIP_UDP_BATCHIO
+/**
+   Arrays handed to recvmmsg()/sendmmsg(). The receive buffers form a ring
+   that survives between calls; a slot is only refilled once its buffer has
+   been adopted by a SipMessage.
+*/
+class UdpTransport::BatchIo
+{
+   public:
+      BatchIo(unsigned int size, const Tuple& tuple) :
+         mRxHdrs(size),
+         mRxIovs(size),
+         mRxBuffers(size, (char*)0),
+         mRxSenders(size, tuple),
+         mTxHdrs(size),
+         mTxIovs(size),
+         mTxData(size, (SendData*)0)
+      {
+      }
+
+      ~BatchIo()
+      {
+         for(std::vector<char*>::iterator i=mRxBuffers.begin(); i!=mRxBuffers.end(); ++i)
+         {
+            delete [] *i;
+         }
+      }
+
+      std::vector<mmsghdr> mRxHdrs;
+      std::vector<iovec> mRxIovs;
+      std::vector<char*> mRxBuffers;
+      std::vector<Tuple> mRxSenders;
+
+      std::vector<mmsghdr> mTxHdrs;
+      std::vector<iovec> mTxIovs;
+      std::vector<SendData*> mTxData;
+};
+#else
+class UdpTransport::BatchIo
+{
+};
+#endif
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -37,16 +86,43 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            unsigned transportFlags)
    : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags),
      mSigcompStack(0),
+     mRxFifo(fifo),
      mRxBuffer(0),
+     mBatchSize(DefaultBatchSize),
+     mBatchIo(0),
      mExternalUnknownDatagramHandler(0),
      mInWritable(false)
 {
    mPollEventCnt = 0;
    mTxTryCnt = mTxMsgCnt = mTxFailCnt = 0;
    mRxTryCnt = mRxMsgCnt = mRxKeepaliveCnt = mRxTransactionCnt = 0;
+   mRxBatchCnt = mRxBatchFullCnt = mTxBatchCnt = mTxBatchFullCnt = 0;
+#ifndef RESIP_UDP_BATCHIO
+   if (mTransportFlags & RESIP_TRANSPORT_FLAG_BATCHIO)
+   {
+      WarningLog(<< "recvmmsg/sendmmsg not available, ignoring BATCHIO transport flag");
+      mTransportFlags &= ~RESIP_TRANSPORT_FLAG_BATCHIO;
+   }
+#endif
    mTuple.setType(UDP);
    mFd = InternalTransport::socket(transport(), version);
    mTuple.mFlowKey=(FlowKey)mFd;
+   if (mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT)
+   {
+#if defined(SO_REUSEPORT)
+      int on = 1;
+      if ( ::setsockopt ( mFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) )
+      {
+         int e = getErrno();
+         InfoLog (<< "Couldn't set sockoptions SO_REUSEPORT: " << strerror(e));
+         error(e);
+         throw Exception("Failed setsockopt", __FILE__,__LINE__);
+      }
+#else
+      WarningLog(<< "SO_REUSEPORT not available, ignoring REUSEPORT transport flag");
+      mTransportFlags &= ~RESIP_TRANSPORT_FLAG_REUSEPORT;
+#endif
+   }
    bind();      // also makes it non-blocking
 
    InfoLog (<< "Creating UDP transport host=" << pinterface
@@ -72,6 +148,12 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
 
 UdpTransport::~UdpTransport()
 {
+   stopReceivers();
+   for (std::vector<UdpTransport*>::iterator i=mReceivers.begin(); i!=mReceivers.end(); ++i)
+   {
+      delete *i;
+   }
+
    InfoLog(<< "Shutting down " << mTuple
            <<" tf="<<mTransportFlags<<" evt="<<(mPollGrp?1:0)
            <<" stats:"
@@ -83,6 +165,10 @@ UdpTransport::~UdpTransport()
            <<" rxmsg="<<mRxMsgCnt
            <<" rxka="<<mRxKeepaliveCnt
            <<" rxtr="<<mRxTransactionCnt
+           <<" rxbatch="<<mRxBatchCnt
+           <<" rxbatchfull="<<mRxBatchFullCnt
+           <<" txbatch="<<mTxBatchCnt
+           <<" txbatchfull="<<mTxBatchFullCnt
            );
 #ifdef USE_SIGCOMP
    delete mSigcompStack;
@@ -91,9 +177,93 @@ UdpTransport::~UdpTransport()
    {
       delete[] mRxBuffer;
    }
+   delete mBatchIo;
    setPollGrp(0);
 }
 
+void
+UdpTransport::setBatchSize(unsigned int batchSize)
+{
+   assert(mBatchIo==0);
+   mBatchSize = resipMax(1U, batchSize);
+}
+
+void
+UdpTransport::addReceiveSockets(unsigned int count)
+{
+   assert(mReceivers.empty());
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT)==0 )
+   {
+      ErrLog(<< "Extra receive sockets need RESIP_TRANSPORT_FLAG_REUSEPORT on " << mTuple);
+      throw Exception("Transport not created with REUSEPORT flag", __FILE__,__LINE__);
+   }
+
+   for (unsigned int i=0; i < count; ++i)
+   {
+      // Bind to the port we actually got, in case we were asked for port 0
+      UdpTransport* receiver = new UdpTransport(mRxFifo,
+                                                mTuple.getPort(),
+                                                ipVersion(),
+                                                StunDisabled,
+                                                mInterface,
+                                                mSocketFunc,
+                                                mCompression,
+                                                mTransportFlags & ~RESIP_TRANSPORT_FLAG_OWNTHREAD);
+      // Messages read from the extra socket must carry our identity, so
+      // that the TransportSelector answers them through this transport.
+      receiver->setKey(getKey());
+      receiver->mTuple.mFlowKey = mTuple.mFlowKey;
+      receiver->mBatchSize = mBatchSize;
+      receiver->mExternalUnknownDatagramHandler = mExternalUnknownDatagramHandler;
+      if (mCongestionManager)
+      {
+         receiver->setCongestionManager(mCongestionManager);
+      }
+      mReceivers.push_back(receiver);
+      mReceiverThreads.push_back(new TransportThread(*receiver));
+   }
+
+   for (std::vector<TransportThread*>::iterator i=mReceiverThreads.begin(); i!=mReceiverThreads.end(); ++i)
+   {
+      (*i)->run();
+   }
+   InfoLog(<< "Receiving on " << getNumReceiveSockets() << " sockets for " << mTuple);
+}
+
+void
+UdpTransport::stopReceivers()
+{
+   for (std::vector<TransportThread*>::iterator i=mReceiverThreads.begin(); i!=mReceiverThreads.end(); ++i)
+   {
+      (*i)->shutdown();
+   }
+   for (std::vector<TransportThread*>::iterator i=mReceiverThreads.begin(); i!=mReceiverThreads.end(); ++i)
+   {
+      (*i)->join();
+      delete *i;
+   }
+   mReceiverThreads.clear();
+}
+
+void
+UdpTransport::shutdown()
+{
+   // Stop feeding the state machine fifo from the extra sockets; the
+   // sockets themselves are closed when we are destroyed.
+   stopReceivers();
+   InternalTransport::shutdown();
+}
+
+void
+UdpTransport::setCongestionManager(CongestionManager* manager)
+{
+   InternalTransport::setCongestionManager(manager);
+   for (std::vector<UdpTransport*>::iterator i=mReceivers.begin(); i!=mReceivers.end(); ++i)
+   {
+      (*i)->setCongestionManager(manager);
+   }
+}
+
 void
 UdpTransport::setPollGrp(FdPollGrp *grp)
 {
@@ -223,6 +393,12 @@ UdpTransport::process(FdSet& fdset)
 void
 UdpTransport::processTxAll()
 {
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_BATCHIO)!=0 )
+   {
+      processTxBatch();
+      return;
+   }
+
    SendData *msg;
    ++mTxTryCnt;
    while ( (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
@@ -297,6 +473,10 @@ UdpTransport::processTxOne(SendData *data)
          ErrLog (<< "UDPTransport - send buffer full" );
          fail(sendData->transactionId);
       }
+      else if (sendData->encodeStart)
+      {
+         StackStatistics::recordSince(StackStatistics::Transmit, sendData->encodeStart);
+      }
    }
 }
 
@@ -311,6 +491,12 @@ UdpTransport::processTxOne(SendData *data)
 void
 UdpTransport::processRxAll()
 {
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_BATCHIO)!=0 )
+   {
+      processRxBatch();
+      return;
+   }
+
    char *buffer = mRxBuffer;
    mRxBuffer = NULL;
    ++mRxTryCnt;
@@ -345,6 +531,201 @@ UdpTransport::processRxAll()
    }
 }
 
+/**
+   Batched version of processTxAll(): gathers up to mBatchSize messages from
+   the transmit fifo and hands them to the kernel with a single sendmmsg().
+**/
+void
+UdpTransport::processTxBatch()
+{
+#ifdef RESIP_UDP_BATCHIO
+   if (mBatchIo==NULL)
+   {
+      mBatchIo = new BatchIo(mBatchSize, mTuple);
+   }
+   BatchIo& batch = *mBatchIo;
+
+   ++mTxTryCnt;
+   for (;;)
+   {
+      unsigned int num = 0;
+      SendData* data;
+      while ( num < mBatchSize &&
+              (data=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
+      {
+#ifdef USE_SIGCOMP
+         // Compressed messages need their own buffer; send them on their own
+         if (mSigcompStack &&
+             data->sigcompId.size() > 0 &&
+             !data->isAlreadyCompressed )
+         {
+            processTxOne(data);
+            continue;
+         }
+#endif
+         assert( data->destination.getPort() != 0 );
+         batch.mTxData[num] = data;
+         batch.mTxIovs[num].iov_base = const_cast<char*>(data->data.data());
+         batch.mTxIovs[num].iov_len = data->data.size();
+         msghdr& hdr = batch.mTxHdrs[num].msg_hdr;
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_name = const_cast<sockaddr*>(&data->destination.getSockaddr());
+         hdr.msg_namelen = data->destination.length();
+         hdr.msg_iov = &batch.mTxIovs[num];
+         hdr.msg_iovlen = 1;
+         ++num;
+      }
+
+      if (num == 0)
+      {
+         break;
+      }
+
+      ++mTxBatchCnt;
+      StackStatistics::increment(StackStatistics::UdpTxBatches);
+      if (num == mBatchSize)
+      {
+         ++mTxBatchFullCnt;
+         StackStatistics::increment(StackStatistics::UdpTxBatchesFull);
+      }
+      mTxMsgCnt += num;
+      StackStatistics::increment(StackStatistics::UdpTxBatchDatagrams, num);
+
+      unsigned int done = 0;
+      while (done < num)
+      {
+         int count = sendmmsg(mFd, &batch.mTxHdrs[done], num-done, 0);
+         if ( count == SOCKET_ERROR )
+         {
+            // Only the first remaining datagram failed; skip it and carry on
+            int e = getErrno();
+            error(e);
+            InfoLog (<< "Failed (" << e << ") sending to " << batch.mTxData[done]->destination);
+            fail(batch.mTxData[done]->transactionId);
+            ++mTxFailCnt;
+            ++done;
+            continue;
+         }
+         for (int i=0; i < count; ++i, ++done)
+         {
+            if (batch.mTxHdrs[done].msg_len != batch.mTxIovs[done].iov_len)
+            {
+               ErrLog (<< "UDPTransport - send buffer full" );
+               fail(batch.mTxData[done]->transactionId);
+            }
+            else if (batch.mTxData[done]->encodeStart)
+            {
+               StackStatistics::recordSince(StackStatistics::Transmit, batch.mTxData[done]->encodeStart);
+            }
+         }
+      }
+
+      for (unsigned int i=0; i < num; ++i)
+      {
+         delete batch.mTxData[i];
+         batch.mTxData[i] = 0;
+      }
+
+      if ( num < mBatchSize || (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 )
+      {
+         break;
+      }
+   }
+#else
+   assert(0);
+#endif
+}
+
+/**
+   Batched version of processRxAll(): drains up to mBatchSize datagrams per
+   recvmmsg() into the preallocated buffer ring.
+**/
+void
+UdpTransport::processRxBatch()
+{
+#ifdef RESIP_UDP_BATCHIO
+   if (mBatchIo==NULL)
+   {
+      mBatchIo = new BatchIo(mBatchSize, mTuple);
+   }
+   BatchIo& batch = *mBatchIo;
+
+   ++mRxTryCnt;
+   for (;;)
+   {
+      for (unsigned int i=0; i < mBatchSize; ++i)
+      {
+         if (batch.mRxBuffers[i]==NULL)
+         {
+            batch.mRxBuffers[i] = MsgHeaderScanner::allocateBuffer(MaxBufferSize);
+         }
+         batch.mRxIovs[i].iov_base = batch.mRxBuffers[i];
+         batch.mRxIovs[i].iov_len = MaxBufferSize;
+         batch.mRxSenders[i] = mTuple;
+         msghdr& hdr = batch.mRxHdrs[i].msg_hdr;
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_name = &batch.mRxSenders[i].getMutableSockaddr();
+         hdr.msg_namelen = batch.mRxSenders[i].length();
+         hdr.msg_iov = &batch.mRxIovs[i];
+         hdr.msg_iovlen = 1;
+         batch.mRxHdrs[i].msg_len = 0;
+      }
+
+      int count = recvmmsg(mFd, &batch.mRxHdrs[0], mBatchSize, MSG_DONTWAIT, 0);
+      if ( count == SOCKET_ERROR )
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         break;
+      }
+      if ( count == 0 )
+      {
+         break;
+      }
+
+      ++mRxBatchCnt;
+      StackStatistics::increment(StackStatistics::UdpRxBatches);
+      if ((unsigned int)count == mBatchSize)
+      {
+         ++mRxBatchFullCnt;
+         StackStatistics::increment(StackStatistics::UdpRxBatchesFull);
+      }
+      StackStatistics::increment(StackStatistics::UdpRxBatchDatagrams, count);
+
+      for (int i=0; i < count; ++i)
+      {
+         int len = (int)batch.mRxHdrs[i].msg_len;
+         if (len <= 0)
+         {
+            continue;
+         }
+         if (len+1 >= MaxBufferSize || (batch.mRxHdrs[i].msg_hdr.msg_flags & MSG_TRUNC))
+         {
+            InfoLog(<<"Datagram exceeded max length "<<MaxBufferSize);
+            continue;
+         }
+         ++mRxMsgCnt;
+         if ( processRxParse(batch.mRxBuffers[i], len, batch.mRxSenders[i]) )
+         {
+            // buffer now belongs to the SipMessage
+            batch.mRxBuffers[i] = NULL;
+         }
+      }
+
+      if ( (unsigned int)count < mBatchSize ||
+           (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
+      {
+         break;
+      }
+   }
+#else
+   assert(0);
+#endif
+}
+
 /*
  * Receive from socket and store results into {buffer}. Updates
  * {buffer} with actual buffer (in case allocation required),
@@ -599,6 +980,9 @@ UdpTransport::processRxParse(char *buffer, int len, Tuple& sender)
       return origBufferConsumed;
    }
 
+   // the message was created right before scanning started
+   StackStatistics::recordSince(StackStatistics::Parse, message->getCreatedTimeMicroSec());
+
    // no pp error
    int used = int(unprocessedCharPtr - buffer);
 
@@ -746,12 +1130,20 @@ void
 UdpTransport::setExternalUnknownDatagramHandler(ExternalUnknownDatagramHandler *handler)
 {
    mExternalUnknownDatagramHandler = handler;
+   for (std::vector<UdpTransport*>::iterator i=mReceivers.begin(); i!=mReceivers.end(); ++i)
+   {
+      (*i)->mExternalUnknownDatagramHandler = handler;
+   }
 }
 
 void
 UdpTransport::setRcvBufLen(int buflen)
 {
    setSocketRcvBufLen(mFd, buflen);
+   for (std::vector<UdpTransport*>::iterator i=mReceivers.begin(); i!=mReceivers.end(); ++i)
+   {
+      (*i)->setRcvBufLen(buflen);
+   }
 }
 
 /* ====================================================================
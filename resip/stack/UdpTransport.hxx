@@ -2,6 +2,7 @@
 #define RESIP_UDPTRANSPORT_HXX
 
 #include <memory>
+#include <vector>
 #include "resip/stack/InternalTransport.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
@@ -12,6 +13,7 @@ namespace osc { class Stack; }
 namespace resip
 {
 class UdpTransport;
+class TransportThread;
 
 /** Interface functor for external unrecognized datagram handling.
   * User can catch datagram messages recevied that are not recognized by
@@ -75,6 +77,8 @@ public:
    virtual void buildFdSet( FdSet& fdset);
    virtual void setPollGrp(FdPollGrp *grp);
    virtual void setRcvBufLen(int buflen);
+   virtual void setCongestionManager(CongestionManager* manager);
+   virtual void shutdown();
 
    // FdPollItemIf
    // virtual Socket getPollSocket() const;
@@ -82,6 +86,33 @@ public:
 
    static const int MaxBufferSize = 8192;
 
+   /// Default number of datagrams per recvmmsg()/sendmmsg() call when
+   /// RESIP_TRANSPORT_FLAG_BATCHIO is set.
+   static const unsigned int DefaultBatchSize = 32;
+
+   /// Sets the number of datagrams moved per system call in BATCHIO mode. 
+   /// Must be called before the transport starts processing, and before
+   /// addReceiveSockets(). How full the batches get is counted in
+   /// StackStatistics (UdpRxBatches etc.).
+   void setBatchSize(unsigned int batchSize);
+   unsigned int getBatchSize() const { return mBatchSize; }
+
+   /**
+      Opens count additional sockets bound to this transport's address and
+      services each one from its own thread and FdPollGrp, letting the
+      kernel load-balance incoming datagrams across cores. Messages from
+      these sockets go into the same state machine fifo and look as if
+      they arrived on this transport, so responses are sent from this
+      transport's socket.
+
+      Requires RESIP_TRANSPORT_FLAG_REUSEPORT. Call once, after the
+      transport has been added to the stack (it needs the transport key).
+      setRcvBufLen(), setCongestionManager() and the unknown datagram
+      handler are applied to the extra sockets as well.
+   */
+   void addReceiveSockets(unsigned int count);
+   unsigned int getNumReceiveSockets() const { return (unsigned int)mReceivers.size()+1; }
+
    // STUN client functionality
    bool stunSendTest(const Tuple& dest);
    bool stunResult(Tuple& mappedAddress);
@@ -97,6 +128,11 @@ protected:
    void processTxAll();
    void processTxOne(SendData *data);
    void updateEvents();
+   void stopReceivers();
+
+   // RESIP_TRANSPORT_FLAG_BATCHIO versions of processRxAll()/processTxAll()
+   void processRxBatch();
+   void processTxBatch();
 
    osc::Stack *mSigcompStack;
 
@@ -109,8 +145,21 @@ protected:
    unsigned mRxMsgCnt;
    unsigned mRxKeepaliveCnt;
    unsigned mRxTransactionCnt;
+   // batch-fill statistics (BATCHIO); fill ratio is msgs/batches
+   unsigned mRxBatchCnt;
+   unsigned mRxBatchFullCnt;
+   unsigned mTxBatchCnt;
+   unsigned mTxBatchFullCnt;
 private:
+   Fifo<TransactionMessage>& mRxFifo;
+   // extra SO_REUSEPORT sockets and the threads servicing them
+   std::vector<UdpTransport*> mReceivers;
+   std::vector<TransportThread*> mReceiverThreads;
    char* mRxBuffer;
+   unsigned int mBatchSize;
+   // Preallocated system call state for BATCHIO; created on first use.
+   class BatchIo;
+   BatchIo* mBatchIo;
    MsgHeaderScanner mMsgHeaderScanner;
    mutable resip::Mutex  myMutex;
    Tuple mStunMappedAddress;
@@ -137,6 +137,9 @@ class DtlsTransport : public UdpTransport
 
       static const unsigned long DtlsReceiveTimeout = 250000 ;
 
+      /// see TimerQueue::useTimerWheel()
+      void useTimerWheel(bool enable) { mTimer.useTimerWheel(enable); }
+
    private:
 
 #if  defined(__INTEL_COMPILER ) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310))
@@ -4,15 +4,20 @@
 
 #ifdef USE_SSL
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 
 #include "rutil/compat.hxx"
+#include "rutil/AsyncProcessHandler.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/Logger.hxx"
 #include "resip/stack/ssl/TlsBaseTransport.hxx"
 #include "resip/stack/ssl/TlsConnection.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "resip/stack/ssl/TlsSessionCache.hxx"
 #include "resip/stack/ssl/Security.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -42,7 +47,9 @@ TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo,
    mSslType(sslType),
    mDomainCtx(0),
    mClientVerificationMode(cvm),
-   mUseEmailAsSIP(useEmailAsSIP)
+   mUseEmailAsSIP(useEmailAsSIP),
+   mHandshakePool(0),
+   mSessionCache(0)
 {
    setTlsDomain(sipDomain);   
    mTuple.setType(transportType);
@@ -72,12 +79,101 @@ TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo,
 
 TlsBaseTransport::~TlsBaseTransport()
 {
+   if (mHandshakePool)
+   {
+      // connections that are in the pool need it and this transport to
+      // take themselves out
+      closeConnections();
+      mHandshakePool->waitForHandbacks();
+   }
+
    if (mDomainCtx)
    {
       SSL_CTX_free(mDomainCtx);mDomainCtx=0;
    }
 }
 
+void
+TlsBaseTransport::process()
+{
+   processHandshakes();
+   TcpBaseTransport::process();
+}
+
+void
+TlsBaseTransport::process(FdSet& fdset)
+{
+   processHandshakes();
+   TcpBaseTransport::process(fdset);
+}
+
+void
+TlsBaseTransport::handshakeStepDone(TlsConnection* conn)
+{
+   {
+      Lock lock(mHandshakesMutex);
+      mHandshakesDone.push_back(conn);
+   }
+
+   if (shareStackProcessAndSelect())
+   {
+      if (mHandshakePool->getStackHandler())
+      {
+         mHandshakePool->getStackHandler()->handleProcessNotification();
+      }
+   }
+   else
+   {
+      mSelectInterruptor.handleProcessNotification();
+   }
+}
+
+void
+TlsBaseTransport::forgetHandshake(TlsConnection* conn)
+{
+   Lock lock(mHandshakesMutex);
+   std::deque<TlsConnection*>::iterator i = std::find(mHandshakesDone.begin(), mHandshakesDone.end(), conn);
+   if (i != mHandshakesDone.end())
+   {
+      mHandshakesDone.erase(i);
+   }
+}
+
+void
+TlsBaseTransport::processHandshakes()
+{
+   if (!mHandshakePool)
+   {
+      return;
+   }
+
+   // one at a time: finishing one may delete another that is still listed
+   while (true)
+   {
+      TlsConnection* conn;
+      {
+         Lock lock(mHandshakesMutex);
+         if (mHandshakesDone.empty())
+         {
+            return;
+         }
+         conn = mHandshakesDone.front();
+         mHandshakesDone.pop_front();
+      }
+      conn->handshakeStepFinished();
+   }
+}
+
+void
+TlsBaseTransport::setSessionCache(TlsSessionCache* cache)
+{
+   mSessionCache = cache;
+   if (mSessionCache)
+   {
+      mSessionCache->enable(getCtx());
+   }
+}
+
 SSL_CTX* 
 TlsBaseTransport::getCtx() const 
 { 
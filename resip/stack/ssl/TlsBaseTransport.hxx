@@ -10,7 +10,9 @@
 #include "resip/stack/SecurityTypes.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 #include "resip/stack/Compression.hxx"
+#include "rutil/Mutex.hxx"
 
+#include <deque>
 #include <openssl/ssl.h>
 
 namespace resip
@@ -19,6 +21,9 @@ namespace resip
 class Connection;
 class Message;
 class Security;
+class TlsConnection;
+class TlsHandshakePool;
+class TlsSessionCache;
 
 class TlsBaseTransport : public TcpBaseTransport
 {
@@ -42,8 +47,29 @@ class TlsBaseTransport : public TcpBaseTransport
                    const Data& privateKeyPassPhrase = "");
       virtual  ~TlsBaseTransport();
 
+      virtual void process();
+      virtual void process(FdSet& fdset);
+
       SSL_CTX* getCtx() const;
 
+      /** Runs the handshakes of this transport's connections on the
+          threads of pool (not owned); 0, the default, runs them on the
+          transport thread. Set before the transport starts. */
+      void setHandshakePool(TlsHandshakePool* pool) { mHandshakePool = pool; }
+      TlsHandshakePool* getHandshakePool() const { return mHandshakePool; }
+
+      /** Lets connections of this transport resume TLS sessions kept in
+          cache (not owned), and enables it on getCtx(); 0, the default,
+          leaves session handling to OpenSSL. Set before the transport
+          starts. */
+      void setSessionCache(TlsSessionCache* cache);
+      TlsSessionCache* getSessionCache() const { return mSessionCache; }
+
+      /// Called on a TlsHandshakePool thread when a step of conn is done.
+      void handshakeStepDone(TlsConnection* conn);
+      /// Drops conn from the finished steps; for a connection going away.
+      void forgetHandshake(TlsConnection* conn);
+
       SecurityTypes::TlsClientVerificationMode getClientVerificationMode() 
          { return mClientVerificationMode; };
       bool isUseEmailAsSIP()
@@ -85,6 +111,15 @@ class TlsBaseTransport : public TcpBaseTransport
          as if it were a SIP URI.  This is convenient because many commercial
          CAs offer email certificates but not sip: certificates */
       bool mUseEmailAsSIP;
+
+   private:
+      /// Hands the finished handshake steps back to their connections.
+      void processHandshakes();
+
+      TlsHandshakePool* mHandshakePool;
+      TlsSessionCache* mSessionCache;
+      Mutex mHandshakesMutex;
+      std::deque<TlsConnection*> mHandshakesDone;
 };
 
 }
@@ -6,8 +6,12 @@
 
 #include "resip/stack/ssl/TlsConnection.hxx"
 #include "resip/stack/ssl/TlsTransport.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "resip/stack/ssl/TlsSessionCache.hxx"
 #include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
 #include "resip/stack/Uri.hxx"
 #include "rutil/Socket.hxx"
 
@@ -61,7 +65,13 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    mServer(server),
    mSecurity(security),
    mSslType( sslType ),
-   mDomain(domain)
+   mDomain(domain),
+   mHandshakeQueued(false),
+   mHandshakeRet(0),
+   mHandshakeError(0),
+   mHandshakeErrno(0),
+   mHandshakeStart(0),
+   mWriteRetryPending(false)
 {
 #if defined(USE_SSL)
    InfoLog (<< "Creating TLS connection for domain " 
@@ -96,6 +106,29 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    
    mSsl = SSL_new(ctx);
    assert(mSsl);
+   // for TlsSessionCache's callbacks
+   SSL_set_app_data(mSsl, this);
+
+   TlsSessionCache* sessionCache = t->getSessionCache();
+   if (sessionCache)
+   {
+      if (mServer)
+      {
+         // sessions are only resumed with transports of the same domain
+         SSL_set_session_id_context(mSsl, (const unsigned char*)mDomain.data(),
+                                    (unsigned int)resipMin(mDomain.size(), (Data::size_type)SSL_MAX_SID_CTX_LENGTH));
+      }
+      else
+      {
+         SSL_SESSION* session = sessionCache->getClientSession(who());
+         if (session)
+         {
+            DebugLog(<< "Offering TLS session to resume with " << who());
+            SSL_set_session(mSsl, session);
+            SSL_SESSION_free(session);
+         }
+      }
+   }
 
    assert( mSecurity );
 
@@ -141,6 +174,13 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
 TlsConnection::~TlsConnection()
 {
 #if defined(USE_SSL)
+   if (mHandshakeQueued)
+   {
+      TlsBaseTransport* t = static_cast<TlsBaseTransport*>(transport());
+      t->getHandshakePool()->cancel(this);
+      t->forgetHandshake(this);
+   }
+
    ERR_clear_error();
    int ret = SSL_shutdown(mSsl);
    if(ret < 0)
@@ -191,10 +231,12 @@ TlsConnection::checkState()
       return mTlsState;
    }
    
-   int ok=0;
-   
-   ERR_clear_error();
-   
+   if (mHandshakeQueued)
+   {
+      // a TlsHandshakePool thread has mSsl until handshakeStepFinished()
+      return mTlsState;
+   }
+
    if (mTlsState != Handshaking)
    {
       if (mServer)
@@ -212,14 +254,105 @@ TlsConnection::checkState()
 
       InfoLog( << "TLS connected" ); 
       mTlsState = Handshaking;
+      mHandshakeStart = Timer::getTimeMicroSec();
    }
 
    mHandShakeWantsRead = false;
-   ok = SSL_do_handshake(mSsl);
-      
+
+   TlsHandshakePool* pool = static_cast<TlsBaseTransport*>(transport())->getHandshakePool();
+   if (pool)
+   {
+      mHandshakeQueued = true;
+      suspendPolling();
+      pool->add(this);
+      return mTlsState;
+   }
+
+   handshakeStep();
+   return checkHandshake();
+#endif // USE_SSL   
+   return mTlsState;
+}
+
+void
+TlsConnection::handshakeStep()
+{
+#if defined(USE_SSL)
+   UInt64 start = Timer::getTimeMicroSec();
+
+   ERR_clear_error();
+   mHandshakeRet = SSL_do_handshake(mSsl);
+   mHandshakeError = mHandshakeRet > 0 ? SSL_ERROR_NONE : SSL_get_error(mSsl, mHandshakeRet);
+   mHandshakeErrno = mHandshakeError == SSL_ERROR_SYSCALL ? getErrno() : 0;
+
+   StackStatistics::recordSince(StackStatistics::TlsHandshakeStep, start);
+
+   switch (mHandshakeError)
+   {
+      case SSL_ERROR_NONE:
+      case SSL_ERROR_WANT_READ:
+      case SSL_ERROR_WANT_WRITE:
+      case SSL_ERROR_ZERO_RETURN:
+      case SSL_ERROR_WANT_CONNECT:
+#if  ( OPENSSL_VERSION_NUMBER >= 0x0090702fL )
+      case SSL_ERROR_WANT_ACCEPT:
+#endif
+      case SSL_ERROR_WANT_X509_LOOKUP:
+         break;
+      case SSL_ERROR_SYSCALL:
+         switch (mHandshakeErrno)
+         {
+            case EINTR:
+            case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+            case EWOULDBLOCK:
+#endif
+               break;
+            default:
+               handleOpenSSLErrorQueue(mHandshakeRet, mHandshakeError, "SSL_do_handshake");
+               break;
+         }
+         break;
+      default:
+         // the error queue is per thread, so it is read out here
+         handleOpenSSLErrorQueue(mHandshakeRet, mHandshakeError, "SSL_do_handshake");
+         break;
+   }
+#endif // USE_SSL   
+}
+
+void
+TlsConnection::handshakeStepFinished()
+{
+#if defined(USE_SSL)
+   assert(mHandshakeQueued);
+   mHandshakeQueued = false;
+   resumePolling();
+
+   switch (checkHandshake())
+   {
+      case Broken:
+         delete this;
+         break;
+      case Up:
+         // the handshake may have left application data in mSsl, which
+         // the socket becoming readable would not tell us about
+         performReads();
+         break;
+      default:
+         break;
+   }
+#endif // USE_SSL   
+}
+
+TlsConnection::TlsState
+TlsConnection::checkHandshake()
+{
+#if defined(USE_SSL)
+   int ok = mHandshakeRet;
    if ( ok <= 0 )
    {
-      int err = SSL_get_error(mSsl,ok);
+      int err = mHandshakeError;
          
       switch (err)
       {
@@ -254,7 +387,7 @@ TlsConnection::checkState()
          default:
             if(err == SSL_ERROR_SYSCALL)
             {
-               int e = getErrno();
+               int e = mHandshakeErrno;
                switch(e)
                {
                   case EINTR:
@@ -319,7 +452,6 @@ TlsConnection::checkState()
                DebugLog(<<"unrecognised/unhandled SSL_get_error result: " << err);
             }
             ErrLog( << "TLS handshake failed ");
-            handleOpenSSLErrorQueue(ok, err, "SSL_do_handshake");
             mBio = NULL;
             mTlsState = Broken;
             return mTlsState;
@@ -358,8 +490,12 @@ TlsConnection::checkState()
       }
    }
 
-   InfoLog( << "TLS handshake done for peer " << getPeerNamesData()); 
+   InfoLog( << "TLS handshake done for peer " << getPeerNamesData()
+            << (SSL_session_reused(mSsl) ? " (resumed)" : "")); 
    mTlsState = Up;
+   StackStatistics::recordSince(StackStatistics::TlsHandshake, mHandshakeStart);
+   StackStatistics::increment(SSL_session_reused(mSsl) ? StackStatistics::TlsSessionsResumed
+                                                       : StackStatistics::TlsSessionsFull);
    if (!mOutstandingSends.empty())
    {
       ensureWritable();
@@ -523,6 +659,7 @@ TlsConnection::write( const char* buf, int count )
    }
         
    ret = SSL_write(mSsl,(const char*)buf,count);
+   mWriteRetryPending = false;
    if (ret < 0 )
    {
       int err = SSL_get_error(mSsl,ret);
@@ -530,6 +667,8 @@ TlsConnection::write( const char* buf, int count )
       {
          case SSL_ERROR_WANT_READ:
          case SSL_ERROR_WANT_WRITE:
+            mWriteRetryPending = true;
+            // fall through
          case SSL_ERROR_NONE:
          {
             StackLog( << "Got TLS write got condition of " << err  );
@@ -554,6 +693,36 @@ TlsConnection::write( const char* buf, int count )
    return -1;
 }
 
+int
+TlsConnection::writeBuffers(const WriteBuffer* buffers, int count)
+{
+   if (mWriteRetryPending && mCoalesceBuffer.empty())
+   {
+      // an SSL_write of the front message alone is outstanding; it has to
+      // be completed with the very same buffer before we can gather
+      return write(buffers[0].mData, buffers[0].mLength);
+   }
+
+   if (mCoalesceBuffer.empty())
+   {
+      for (int i = 0; i < count; ++i)
+      {
+         mCoalesceBuffer.append(buffers[i].mData, buffers[i].mLength);
+      }
+   }
+   // else: a retry; the queue has not moved, so the buffer still matches
+   // the start of what we were asked to write
+
+   int ret = write(mCoalesceBuffer.data(), (int)mCoalesceBuffer.size());
+   if (ret > 0)
+   {
+      // without SSL_MODE_ENABLE_PARTIAL_WRITE it is all or nothing
+      assert(ret == (int)mCoalesceBuffer.size());
+      mCoalesceBuffer.clear();
+   }
+   return ret;
+}
+
 
 bool 
 TlsConnection::hasDataToRead() // has data that can be read 
@@ -586,6 +755,11 @@ TlsConnection::isGood() // has data that can be read
       return false;
    }
 
+   if ( mHandshakeQueued )
+   {
+      return true;
+   }
+
    int mode = SSL_get_shutdown(mSsl);
    if ( mode < 0 )
    {
@@ -43,6 +43,7 @@ class TlsConnection : public Connection
 
       int read( char* buf, const int count );
       int write( const char* buf, const int count );
+      virtual int writeBuffers(const WriteBuffer* buffers, int count);
       virtual bool hasDataToRead(); // has data that can be read 
       virtual bool isGood(); // has valid connection
       virtual bool isWritable();
@@ -61,6 +62,16 @@ class TlsConnection : public Connection
       Data getPeerNamesData() const;
       TlsState checkState();
 
+      /// one SSL_do_handshake(), on a TlsHandshakePool thread if there is a pool
+      void handshakeStep();
+      /// acts on the result of handshakeStep()
+      TlsState checkHandshake();
+      /// back on the transport thread after a pooled step; may delete this
+      void handshakeStepFinished();
+      friend class TlsHandshakePool;
+      friend class TlsBaseTransport;
+      friend class TlsSessionCacheCallbacks;
+
       bool mServer;
       Security* mSecurity;
       SecurityTypes::SSLType mSslType;
@@ -69,9 +80,23 @@ class TlsConnection : public Connection
       TlsState mTlsState;
       bool mHandShakeWantsRead;
 
+      // mSsl belongs to a TlsHandshakePool thread while this is set
+      bool mHandshakeQueued;
+      // outcome of the last handshakeStep()
+      int mHandshakeRet;
+      int mHandshakeError;
+      int mHandshakeErrno;
+      UInt64 mHandshakeStart;
+
       SSL* mSsl;
       BIO* mBio;
       std::list<BaseSecurity::PeerName> mPeerNames;
+
+      // SSL_write takes one buffer, so gathered writes are copied here; it
+      // is kept untouched until written since a retry must repeat the call
+      Data mCoalesceBuffer;
+      // last SSL_write wants to be retried with the same arguments
+      bool mWriteRetryPending;
 };
  
 }
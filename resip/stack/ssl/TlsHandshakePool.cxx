@@ -0,0 +1,183 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#ifdef USE_SSL
+
+#include <algorithm>
+#include <cassert>
+
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/ssl/TlsBaseTransport.hxx"
+#include "resip/stack/ssl/TlsConnection.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
+
+using namespace resip;
+
+TlsHandshakePool::TlsHandshakePool(unsigned int numThreads, AsyncProcessHandler* stackHandler) :
+   mStackHandler(stackHandler),
+   mQueueDepth(0),
+   mShutdown(false)
+{
+   for (unsigned int i = 0; i < numThreads; ++i)
+   {
+      Worker* worker = new Worker(*this);
+      mWorkers.push_back(worker);
+      worker->run();
+   }
+   InfoLog(<< "Started " << numThreads << " TLS handshake threads");
+}
+
+TlsHandshakePool::~TlsHandshakePool()
+{
+   {
+      Lock lock(mMutex);
+      // the transports, and with them every connection, are gone by now
+      assert(mJobs.empty() && mRunning.empty());
+      mShutdown = true;
+      mWork.broadcast();
+   }
+   for (std::vector<Worker*>::iterator i = mWorkers.begin(); i != mWorkers.end(); ++i)
+   {
+      (*i)->join();
+      delete *i;
+   }
+}
+
+void
+TlsHandshakePool::add(TlsConnection* conn)
+{
+   Job job;
+   job.mConnection = conn;
+   job.mQueued = Timer::getTimeMicroSec();
+
+   Lock lock(mMutex);
+   mJobs.push_back(job);
+   mQueueDepth = mJobs.size();
+   mWork.signal();
+}
+
+void
+TlsHandshakePool::cancel(TlsConnection* conn)
+{
+   Lock lock(mMutex);
+   for (std::deque<Job>::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+   {
+      if (i->mConnection == conn)
+      {
+         mJobs.erase(i);
+         mQueueDepth = mJobs.size();
+         return;
+      }
+   }
+   while (std::find(mRunning.begin(), mRunning.end(), conn) != mRunning.end())
+   {
+      mDone.wait(mMutex);
+   }
+}
+
+void
+TlsHandshakePool::waitForHandbacks()
+{
+   Lock lock(mMutex);
+}
+
+bool
+TlsHandshakePool::runOne()
+{
+   Job job;
+   {
+      Lock lock(mMutex);
+      while (mJobs.empty() && !mShutdown)
+      {
+         mWork.wait(mMutex);
+      }
+      if (mShutdown)
+      {
+         return false;
+      }
+      job = mJobs.front();
+      mJobs.pop_front();
+      mQueueDepth = mJobs.size();
+      mRunning.push_back(job.mConnection);
+   }
+
+   StackStatistics::recordSince(StackStatistics::TlsHandshakeQueue, job.mQueued);
+   job.mConnection->handshakeStep();
+
+   // handed back under mMutex: cancel() finds the connection either
+   // running or in the transport's list, and the transport cannot be
+   // gone before waitForHandbacks() returns
+   Lock lock(mMutex);
+   TlsBaseTransport* transport = static_cast<TlsBaseTransport*>(job.mConnection->transport());
+   transport->handshakeStepDone(job.mConnection);
+   mRunning.erase(std::find(mRunning.begin(), mRunning.end(), job.mConnection));
+   mDone.broadcast();
+   return true;
+}
+
+void
+TlsHandshakePool::Worker::thread()
+{
+   while (mPool.runOne())
+   {
+   }
+}
+
+#endif // USE_SSL
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,158 @@
+#if !defined(RESIP_TLSHANDSHAKEPOOL_HXX)
+#define RESIP_TLSHANDSHAKEPOOL_HXX
+
+#if defined(HAVE_CONFIG_H)
+  #include "config.h"
+#endif
+
+#include <deque>
+#include <vector>
+
+#include "rutil/compat.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+class AsyncProcessHandler;
+class TlsConnection;
+
+/**
+   @brief Worker threads that run the SSL_do_handshake() calls of
+   TlsConnections, so the public key operations of a handshake do not
+   stall the transport thread.
+
+   A TlsConnection stays owned by its transport. When its handshake needs
+   to make progress the transport thread hands the connection to add(),
+   stops polling its socket and leaves its SSL object alone. A worker runs
+   one handshake step and gives the connection back to the transport with
+   TlsBaseTransport::handshakeStepDone(), which wakes the transport thread
+   to act on the result. A connection is never in the pool twice.
+
+   Time spent waiting in the queue and handshake durations are recorded in
+   StackStatistics; getQueueDepth() returns the current queue length.
+*/
+class TlsHandshakePool
+{
+   public:
+      /**
+         @param numThreads Worker threads, started right away.
+         @param stackHandler Woken when a step finishes on a transport that
+                shares the stack's process loop.
+      */
+      TlsHandshakePool(unsigned int numThreads, AsyncProcessHandler* stackHandler);
+      ~TlsHandshakePool();
+
+      /// Queues the next handshake step of conn. Transport thread only.
+      void add(TlsConnection* conn);
+
+      /**
+         Forgets conn: removes it from the queue, or waits for the worker
+         running it to finish. Transport thread only.
+      */
+      void cancel(TlsConnection* conn);
+
+      /**
+         Returns once no worker is in the middle of handing a step back to
+         a transport; for a transport that is going away and has no
+         connections left.
+      */
+      void waitForHandbacks();
+
+      /// Handshake steps waiting for a worker; takes no lock.
+      size_t getQueueDepth() const { return mQueueDepth; }
+
+      AsyncProcessHandler* getStackHandler() const { return mStackHandler; }
+
+   private:
+      class Worker : public ThreadIf
+      {
+         public:
+            Worker(TlsHandshakePool& pool) : mPool(pool) {}
+            virtual void thread();
+
+         private:
+            TlsHandshakePool& mPool;
+      };
+
+      struct Job
+      {
+         TlsConnection* mConnection;
+         UInt64 mQueued;
+      };
+
+      /// Waits for a job and runs it; false once the pool is shutting down.
+      bool runOne();
+
+      AsyncProcessHandler* mStackHandler;
+
+      Mutex mMutex;
+      Condition mWork; // a job was queued, or shutdown
+      Condition mDone; // a worker finished a job
+      std::deque<Job> mJobs;
+      volatile size_t mQueueDepth; // mJobs.size(), for readers without mMutex
+      std::vector<TlsConnection*> mRunning;
+      bool mShutdown;
+
+      std::vector<Worker*> mWorkers;
+
+      // disabled
+      TlsHandshakePool(const TlsHandshakePool&);
+      TlsHandshakePool& operator=(const TlsHandshakePool&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,312 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#ifdef USE_SSL
+
+#include <ctime>
+
+#include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "resip/stack/ssl/TlsConnection.hxx"
+#include "resip/stack/ssl/TlsSessionCache.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
+
+using namespace resip;
+
+// the SSL_CTX ex data slot holding the TlsSessionCache of the context
+static int
+cacheIndex()
+{
+   static int index = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+   return index;
+}
+
+static TlsSessionCache*
+cacheOf(SSL_CTX* ctx)
+{
+   return static_cast<TlsSessionCache*>(SSL_CTX_get_ex_data(ctx, cacheIndex()));
+}
+
+namespace resip
+{
+
+// OpenSSL's session cache callbacks; the SSL app data is the TlsConnection
+class TlsSessionCacheCallbacks
+{
+   public:
+      static int newSession(SSL* ssl, SSL_SESSION* session)
+      {
+         TlsSessionCache* cache = cacheOf(SSL_get_SSL_CTX(ssl));
+         TlsConnection* conn = static_cast<TlsConnection*>(SSL_get_app_data(ssl));
+         if (cache && conn)
+         {
+            if (conn->mServer)
+            {
+               cache->addServerSession(session);
+            }
+            else
+            {
+               cache->addClientSession(conn->who(), session);
+            }
+         }
+         return 0; // not keeping a reference to session
+      }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+      static SSL_SESSION* getSession(SSL* ssl, const unsigned char* id, int length, int* copy)
+#else
+      static SSL_SESSION* getSession(SSL* ssl, unsigned char* id, int length, int* copy)
+#endif
+      {
+         *copy = 0; // the caller gets our reference
+         TlsSessionCache* cache = cacheOf(SSL_get_SSL_CTX(ssl));
+         return cache ? cache->getServerSession(id, length) : 0;
+      }
+
+      static void removeSession(SSL_CTX* ctx, SSL_SESSION* session)
+      {
+         TlsSessionCache* cache = cacheOf(ctx);
+         if (cache)
+         {
+            cache->removeServerSession(session);
+         }
+      }
+};
+
+}
+
+TlsSessionCache::TlsSessionCache(unsigned int maxSessions, bool tickets) :
+   mTickets(tickets),
+   mServer(maxSessions),
+   mClient(maxSessions)
+{
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+}
+
+void
+TlsSessionCache::enable(SSL_CTX* ctx)
+{
+   TlsSessionCache* current = cacheOf(ctx);
+   if (current)
+   {
+      if (current != this)
+      {
+         WarningLog(<< "SSL_CTX already uses another TLS session cache");
+      }
+      return;
+   }
+
+   SSL_CTX_set_ex_data(ctx, cacheIndex(), this);
+   SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH | SSL_SESS_CACHE_NO_INTERNAL);
+   SSL_CTX_sess_set_new_cb(ctx, TlsSessionCacheCallbacks::newSession);
+   SSL_CTX_sess_set_get_cb(ctx, TlsSessionCacheCallbacks::getSession);
+   SSL_CTX_sess_set_remove_cb(ctx, TlsSessionCacheCallbacks::removeSession);
+   if (mTickets)
+   {
+      SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+   }
+   else
+   {
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+   }
+   DebugLog(<< "TLS session cache enabled, tickets " << (mTickets ? "on" : "off"));
+}
+
+static Data
+sessionId(SSL_SESSION* session)
+{
+   unsigned int length;
+   const unsigned char* id = SSL_SESSION_get_id(session, &length);
+   return Data(id, length);
+}
+
+void
+TlsSessionCache::addServerSession(SSL_SESSION* session)
+{
+   mServer.add(sessionId(session), session);
+}
+
+SSL_SESSION*
+TlsSessionCache::getServerSession(const unsigned char* id, unsigned int length)
+{
+   return mServer.get(Data(id, length));
+}
+
+void
+TlsSessionCache::removeServerSession(SSL_SESSION* session)
+{
+   mServer.remove(sessionId(session));
+}
+
+Data
+TlsSessionCache::clientKey(const Tuple& peer)
+{
+   Data key;
+   {
+      DataStream strm(key);
+      strm << Tuple::inet_ntop(peer) << ':' << peer.getPort() << '/' << peer.getTargetDomain();
+   }
+   return key;
+}
+
+void
+TlsSessionCache::addClientSession(const Tuple& peer, SSL_SESSION* session)
+{
+   mClient.add(clientKey(peer), session);
+}
+
+SSL_SESSION*
+TlsSessionCache::getClientSession(const Tuple& peer)
+{
+   return mClient.get(clientKey(peer));
+}
+
+TlsSessionCache::Store::Store(unsigned int maxSessions) :
+   mMaxPerShard(maxSessions > Shards ? (maxSessions + Shards - 1) / Shards : 1)
+{
+}
+
+void
+TlsSessionCache::Store::add(const Data& key, SSL_SESSION* session)
+{
+   int length = i2d_SSL_SESSION(session, 0);
+   if (length <= 0)
+   {
+      return;
+   }
+   char* buffer = new char[length];
+   unsigned char* p = reinterpret_cast<unsigned char*>(buffer);
+   i2d_SSL_SESSION(session, &p);
+
+   Entry entry;
+   entry.mKey = key;
+   entry.mSession = Data(Data::Take, buffer, length);
+   entry.mExpires = SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+
+   Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   std::map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+   if (i != s.mIndex.end())
+   {
+      s.mEntries.erase(i->second);
+   }
+   s.mEntries.push_front(entry);
+   s.mIndex[key] = s.mEntries.begin();
+
+   while (s.mEntries.size() > mMaxPerShard)
+   {
+      s.mIndex.erase(s.mEntries.back().mKey);
+      s.mEntries.pop_back();
+   }
+}
+
+SSL_SESSION*
+TlsSessionCache::Store::get(const Data& key)
+{
+   Data encoded;
+   {
+      Shard& s = shard(key);
+      Lock lock(s.mMutex);
+      std::map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+      if (i == s.mIndex.end())
+      {
+         return 0;
+      }
+      if (i->second->mExpires <= time(0))
+      {
+         s.mEntries.erase(i->second);
+         s.mIndex.erase(i);
+         return 0;
+      }
+      s.mEntries.splice(s.mEntries.begin(), s.mEntries, i->second);
+      encoded = i->second->mSession;
+   }
+
+   const unsigned char* p = reinterpret_cast<const unsigned char*>(encoded.data());
+   return d2i_SSL_SESSION(0, &p, (long)encoded.size());
+}
+
+void
+TlsSessionCache::Store::remove(const Data& key)
+{
+   Shard& s = shard(key);
+   Lock lock(s.mMutex);
+   std::map<Data, Entries::iterator>::iterator i = s.mIndex.find(key);
+   if (i != s.mIndex.end())
+   {
+      s.mEntries.erase(i->second);
+      s.mIndex.erase(i);
+   }
+}
+
+size_t
+TlsSessionCache::Store::size() const
+{
+   size_t n = 0;
+   for (unsigned int i = 0; i < Shards; ++i)
+   {
+      Lock lock(mShards[i].mMutex);
+      n += mShards[i].mIndex.size();
+   }
+   return n;
+}
+
+#endif // USE_SSL
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,175 @@
+#if !defined(RESIP_TLSSESSIONCACHE_HXX)
+#define RESIP_TLSSESSIONCACHE_HXX
+
+#if defined(HAVE_CONFIG_H)
+  #include "config.h"
+#endif
+
+#include <list>
+#include <map>
+
+#include "rutil/compat.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+
+#include <openssl/ssl.h>
+
+namespace resip
+{
+
+class Tuple;
+
+/**
+   @brief Keeps TLS sessions so that reconnecting peers can resume them
+   instead of running a full handshake.
+
+   As a server, sessions are looked up by their session id on behalf of
+   OpenSSL (see enable()); as a client, the last session with each peer is
+   kept under the peer's address and target domain (the name its
+   certificate is checked against) and offered on the next connection to
+   it. With tickets the server hands clients its encrypted session state
+   instead, and the server side of the cache is only used by clients that
+   do not support them.
+
+   Sessions are stored encoded, so the cache owns no OpenSSL objects, in
+   a fixed number of shards, each with its own lock and least recently
+   used list; each side holds at most maxSessions sessions, rounded up to
+   a multiple of Shards. Expired sessions are dropped when they are looked
+   up or pushed out.
+
+   Any thread may use the cache; TlsConnections update it from whatever
+   thread runs their handshake.
+*/
+class TlsSessionCache
+{
+   public:
+      enum { Shards = 16 };
+
+      /**
+         @param maxSessions Bound on the server sessions, and separately on
+                the client sessions, kept.
+         @param tickets Issue and accept session tickets (RFC 5077) as a
+                server.
+      */
+      TlsSessionCache(unsigned int maxSessions, bool tickets = true);
+      ~TlsSessionCache();
+
+      /**
+         Has OpenSSL keep the sessions of ctx in this cache, and turns
+         tickets on or off. Safe to call more than once for the same ctx;
+         a ctx keeps the first cache enabled on it.
+      */
+      void enable(SSL_CTX* ctx);
+
+      /// Stores session, made as a server.
+      void addServerSession(SSL_SESSION* session);
+      /// Returns a new session with the given id, or 0; the caller owns it.
+      SSL_SESSION* getServerSession(const unsigned char* id, unsigned int length);
+      void removeServerSession(SSL_SESSION* session);
+
+      /// Stores session, made as a client with peer, replacing the last one.
+      void addClientSession(const Tuple& peer, SSL_SESSION* session);
+      /// Returns a new session to offer peer, or 0; the caller owns it.
+      SSL_SESSION* getClientSession(const Tuple& peer);
+
+      size_t getServerSessions() const { return mServer.size(); }
+      size_t getClientSessions() const { return mClient.size(); }
+
+   private:
+      /// Encoded sessions by key, in Shards independently locked parts.
+      class Store
+      {
+         public:
+            Store(unsigned int maxSessions);
+
+            void add(const Data& key, SSL_SESSION* session);
+            SSL_SESSION* get(const Data& key);
+            void remove(const Data& key);
+            size_t size() const;
+
+         private:
+            struct Entry
+            {
+               Data mKey;
+               Data mSession; // i2d_SSL_SESSION() encoding
+               time_t mExpires;
+            };
+            typedef std::list<Entry> Entries;
+
+            struct Shard
+            {
+               mutable Mutex mMutex;
+               Entries mEntries; // most recently used first
+               std::map<Data, Entries::iterator> mIndex;
+            };
+
+            Shard& shard(const Data& key) { return mShards[key.hash() % Shards]; }
+
+            unsigned int mMaxPerShard;
+            Shard mShards[Shards];
+      };
+
+      static Data clientKey(const Tuple& peer);
+
+      bool mTickets;
+      Store mServer;
+      Store mClient;
+
+      // disabled
+      TlsSessionCache(const TlsSessionCache&);
+      TlsSessionCache& operator=(const TlsSessionCache&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,177 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509v3.h>
+
+#include "resip/stack/test/TlsTestCertificates.hxx"
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+using namespace resip;
+
+const Data TlsTestCertificates::Domain("localhost");
+
+static const char* const Files[] =
+{
+   "root_cert_localhost.pem",
+   "domain_cert_localhost.pem",
+   "domain_key_localhost.pem",
+   0
+};
+
+static Data
+writePem(X509* cert, EVP_PKEY* key)
+{
+   BIO* bio = BIO_new(BIO_s_mem());
+   if (cert)
+   {
+      PEM_write_bio_X509(bio, cert);
+   }
+   else
+   {
+      PEM_write_bio_PrivateKey(bio, key, 0, 0, 0, 0, 0);
+   }
+   char* data;
+   long len = BIO_get_mem_data(bio, &data);
+   Data pem(data, (Data::size_type)len);
+   BIO_free(bio);
+   return pem;
+}
+
+static void
+addExtension(X509* cert, int nid, const char* value)
+{
+   X509V3_CTX ctx;
+   X509V3_set_ctx(&ctx, cert, cert, 0, 0, 0);
+   X509_EXTENSION* ext = X509V3_EXT_conf_nid(0, &ctx, nid, const_cast<char*>(value));
+   assert(ext);
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+}
+
+static void
+writeFile(const Data& path, const Data& contents)
+{
+   FILE* f = fopen(path.c_str(), "w");
+   assert(f);
+   fwrite(contents.data(), 1, contents.size(), f);
+   fclose(f);
+}
+
+TlsTestCertificates::TlsTestCertificates(const Data& name)
+{
+   Data pattern = Data("/tmp/") + name + "XXXXXX";
+   std::vector<char> dir(pattern.data(), pattern.data() + pattern.size());
+   dir.push_back(0);
+   if (!mkdtemp(&dir[0]))
+   {
+      return;
+   }
+   mDirectory = Data(&dir[0]) + "/";
+
+   EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, 0);
+   EVP_PKEY* key = 0;
+   EVP_PKEY_keygen_init(kctx);
+   EVP_PKEY_CTX_set_rsa_keygen_bits(kctx, 2048);
+   EVP_PKEY_keygen(kctx, &key);
+   EVP_PKEY_CTX_free(kctx);
+   assert(key);
+
+   X509* cert = X509_new();
+   X509_set_version(cert, 2);
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_get_notBefore(cert), -3600);
+   X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+   X509_set_pubkey(cert, key);
+   X509_NAME* subject = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, (const unsigned char*)Domain.c_str(), -1, -1, 0);
+   X509_set_issuer_name(cert, subject);
+   addExtension(cert, NID_basic_constraints, "critical,CA:TRUE");
+   addExtension(cert, NID_subject_alt_name, (Data("DNS:") + Domain).c_str());
+   X509_sign(cert, key, EVP_sha256());
+
+   Data certPem = writePem(cert, 0);
+   Data keyPem = writePem(0, key);
+   X509_free(cert);
+   EVP_PKEY_free(key);
+
+   writeFile(mDirectory + Files[0], certPem);
+   writeFile(mDirectory + Files[1], certPem);
+   writeFile(mDirectory + Files[2], keyPem);
+}
+
+TlsTestCertificates::~TlsTestCertificates()
+{
+   if (mDirectory.empty())
+   {
+      return;
+   }
+   for (const char* const* f = Files; *f; ++f)
+   {
+      unlink((mDirectory + *f).c_str());
+   }
+   rmdir(mDirectory.c_str());
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000-2005 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
+
+// vim: softtabstop=3:shiftwidth=3:expandtab
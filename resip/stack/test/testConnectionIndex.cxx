@@ -0,0 +1,262 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "resip/stack/ConnectionIndex.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+/*
+   Checks TupleIndex/FdIndex (the ConnectionManager tables) and compares
+   them with the std::maps they replaced, opening, looking up and closing
+   a large number of synthetic connections. Argument: [connections]
+*/
+
+// stands in for Connection; the index only needs who()
+class FakeConnection
+{
+   public:
+      FakeConnection(const Tuple& who, Socket fd) : mWho(who)
+      {
+         mWho.mFlowKey = (FlowKey)fd;
+      }
+      const Tuple& who() const { return mWho; }
+      Socket getSocket() const { return (Socket)mWho.mFlowKey; }
+
+   private:
+      Tuple mWho;
+};
+
+// phones behind a modest number of NAT addresses, many ports each
+static Tuple
+makeTuple(unsigned int n, TransportType type)
+{
+   in_addr addr;
+   addr.s_addr = htonl(0x0a000000 | (n / 40000));
+   return Tuple(addr, 1024 + (n % 40000), type);
+}
+
+static void
+testIndex()
+{
+   TupleIndex<FakeConnection> index;
+   FdIndex<FakeConnection> fds;
+   std::vector<FakeConnection*> conns;
+   for (unsigned int i = 0; i < 5000; ++i)
+   {
+      conns.push_back(new FakeConnection(makeTuple(i, i % 2 ? TCP : TLS), i + 3));
+      index.insert(conns.back());
+      fds.insert(conns.back()->getSocket(), conns.back());
+   }
+   // beyond the directly indexed range
+   FakeConnection big(makeTuple(999999, TCP), (Socket)((1 << 22) + 5));
+   index.insert(&big);
+   fds.insert(big.getSocket(), &big);
+   assert(index.size() == 5001);
+   assert(fds.size() == 5001);
+
+   for (unsigned int i = 0; i < conns.size(); ++i)
+   {
+      assert(index.find(conns[i]->who()) == conns[i]);
+      assert(fds.find(conns[i]->getSocket()) == conns[i]);
+      // same address and port, other transport
+      Tuple other(makeTuple(i, i % 2 ? TLS : TCP));
+      assert(index.find(other) == 0);
+   }
+   assert(index.find(big.who()) == &big);
+   assert(fds.find(big.getSocket()) == &big);
+   assert(fds.find((Socket)70000) == 0);
+
+   // remove every third one, in an order unrelated to the table layout
+   for (unsigned int i = 0; i < conns.size(); i += 3)
+   {
+      assert(index.erase(conns[i]));
+      assert(!index.erase(conns[i]));
+      fds.erase(conns[i]->getSocket());
+   }
+   for (unsigned int i = 0; i < conns.size(); ++i)
+   {
+      FakeConnection* expected = (i % 3 == 0) ? 0 : conns[i];
+      assert(index.find(conns[i]->who()) == expected);
+      assert(fds.find(conns[i]->getSocket()) == expected);
+   }
+
+   ConnectionTableStats stats;
+   index.getStats(stats);
+   fds.getStats(stats);
+   assert(stats.mSize == index.size());
+   assert(stats.loadFactor() <= 0.7);
+   assert(stats.mFdOverflow == 1);
+   assert(stats.mFdDirect + stats.mFdOverflow == fds.size());
+
+   std::vector<FakeConnection*> all;
+   index.values(all);
+   assert(all.size() == index.size());
+
+   for (unsigned int i = 0; i < conns.size(); ++i)
+   {
+      delete conns[i];
+   }
+   cerr << "TupleIndex/FdIndex OK: " << stats << endl;
+}
+
+typedef std::map<Tuple, FakeConnection*> OldAddrMap;
+typedef std::map<Socket, FakeConnection*> OldIdMap;
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int count = 500000;
+   if (argc > 1)
+   {
+      count = atoi(argv[1]);
+   }
+
+   testIndex();
+
+   std::vector<FakeConnection*> conns;
+   std::vector<Tuple> dests;
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      conns.push_back(new FakeConnection(makeTuple(i, TCP), i + 10));
+      // what a send looks up: the address without the connection id
+      dests.push_back(makeTuple((i * 7919) % count, TCP));
+   }
+
+   UInt64 start = Timer::getTimeMs();
+   OldAddrMap oldAddr;
+   OldIdMap oldId;
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      oldAddr[conns[i]->who()] = conns[i];
+      oldId[conns[i]->getSocket()] = conns[i];
+   }
+   UInt64 mapOpen = Timer::getTimeMs() - start;
+
+   start = Timer::getTimeMs();
+   TupleIndex<FakeConnection> addr;
+   FdIndex<FakeConnection> id;
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      addr.insert(conns[i]);
+      id.insert(conns[i]->getSocket(), conns[i]);
+   }
+   UInt64 indexOpen = Timer::getTimeMs() - start;
+
+   size_t found = 0;
+   start = Timer::getTimeMs();
+   for (int round = 0; round < 4; ++round)
+   {
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         OldAddrMap::const_iterator a = oldAddr.find(dests[i]);
+         found += (a != oldAddr.end());
+         OldIdMap::const_iterator f = oldId.find(conns[i]->getSocket());
+         found += (f != oldId.end());
+      }
+   }
+   UInt64 mapFind = Timer::getTimeMs() - start;
+   assert(found == 8*size_t(count));
+
+   found = 0;
+   start = Timer::getTimeMs();
+   for (int round = 0; round < 4; ++round)
+   {
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         found += (addr.find(dests[i]) != 0);
+         found += (id.find(conns[i]->getSocket()) != 0);
+      }
+   }
+   UInt64 indexFind = Timer::getTimeMs() - start;
+   assert(found == 8*size_t(count));
+
+   start = Timer::getTimeMs();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      oldAddr.erase(conns[i]->who());
+      oldId.erase(conns[i]->getSocket());
+   }
+   UInt64 mapClose = Timer::getTimeMs() - start;
+
+   ConnectionTableStats stats;
+   addr.getStats(stats);
+   id.getStats(stats);
+
+   start = Timer::getTimeMs();
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      addr.erase(conns[i]);
+      id.erase(conns[i]->getSocket());
+   }
+   UInt64 indexClose = Timer::getTimeMs() - start;
+   assert(addr.empty());
+   assert(id.size() == 0);
+
+   cout << count << " connections, open / 4x lookup by address and fd / close (ms):" << endl
+        << "  std::map:        " << mapOpen << " / " << mapFind << " / " << mapClose << endl
+        << "  TupleIndex etc.: " << indexOpen << " / " << indexFind << " / " << indexClose << endl
+        << "  " << stats << endl;
+
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      delete conns[i];
+   }
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,314 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// Checks that every MsgHeaderScanner implementation available on this CPU
+// splits messages exactly like the scalar one, then measures throughput.
+//
+// usage: testMsgHeaderScanner [corpus-dir [iterations]]
+//
+// The corpus is the RFC 4475 torture test messages kept next to this file,
+// plus a few typical messages in case they cannot be found.
+
+static const char* corpusFiles[] =
+{
+   "badaspec", "badbranch", "baddate", "baddn", "badinv01", "badvers",
+   "bcast", "bext01", "bigcode", "clerr", "cparam01", "cparam02", "dblreq",
+   "esc01", "esc02", "escnull", "escruri", "insuf", "intmeth", "inv2543",
+   "invut", "longreq", "ltgtruri", "lwsdisp", "lwsruri", "lwsstart", "mcl01",
+   "mismatch01", "mismatch02", "mpart01", "multi01", "ncl", "noreason",
+   "novelsc", "quotbal", "regaut01", "regbadct", "regescrt", "scalar02",
+   "scalarlg", "sdp01", "semiuri", "test", "transports", "trws", "unkscm",
+   "unksm2", "unreason", "wsinv", "zeromf"
+};
+
+static const char* builtinMessages[] =
+{
+   "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101\r\n"
+   "Via: SIP/2.0/UDP proxy.example.com:5060;branch=z9hG4bK4b43c2ff8.1;rport\r\n"
+   "Max-Forwards: 70\r\n"
+   "From: \"Alice \\\"A\\\" Liddell\" <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:alice@client.atlanta.example.com;transport=tcp>\r\n"
+   "Record-Route: <sip:proxy.example.com;lr>,<sip:edge.example.com;lr>\r\n"
+   "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY\r\n"
+   "Supported: timer, 100rel, replaces\r\n"
+   "Subject: a folded\r\n"
+   "  subject line (with 50% more text)\r\n"
+   "User-Agent: testMsgHeaderScanner/1.0\r\n"
+   "Content-Type: application/sdp\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n",
+
+   "SIP/2.0 200 OK\r\n"
+   "Via: SIP/2.0/UDP proxy.example.com:5060;branch=z9hG4bK4b43c2ff8.1;rport=5060;received=192.0.2.3\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101\r\n"
+   "From: Alice <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>;tag=8321234356\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:bob@client.biloxi.example.com;transport=tcp>\r\n"
+   "Record-Route: <sip:proxy.example.com;lr>\r\n"
+   "X-Unknown-Header: value with \"quotes, and commas\" <and angles>\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n"
+};
+
+static const char* implNames[] = { "scalar", "sse2", "avx2" };
+
+static Data
+readFile(const Data& path)
+{
+   ifstream is(path.c_str(), ios::in | ios::binary);
+   if (!is)
+   {
+      return Data::Empty;
+   }
+   ostringstream os;
+   os << is.rdbuf();
+   return Data(os.str());
+}
+
+// The outcome of scanning one message, with all header field values as
+// offsets into the scanned buffer.
+struct ScanOutcome
+{
+   MsgHeaderScanner::ScanChunkResult result;
+   long unprocessed;
+   int numHeaders;
+   vector<long> fields;
+
+   bool operator==(const ScanOutcome& rhs) const
+   {
+      return (result == rhs.result &&
+              unprocessed == rhs.unprocessed &&
+              numHeaders == rhs.numHeaders &&
+              fields == rhs.fields);
+   }
+};
+
+static void
+addFields(ScanOutcome& outcome, const char* buffer, const HeaderFieldValueList* hfvs)
+{
+   for (HeaderFieldValueList::const_iterator i = hfvs->begin(); i != hfvs->end(); ++i)
+   {
+      outcome.fields.push_back(i->getBuffer() ? i->getBuffer() - buffer : -1);
+      outcome.fields.push_back(i->getLength());
+   }
+}
+
+static ScanOutcome
+scan(const Data& text, unsigned int length)
+{
+   SipMessage msg;
+   char* buffer = MsgHeaderScanner::allocateBuffer(length);
+   msg.addBuffer(buffer);
+   memcpy(buffer, text.data(), length);
+
+   MsgHeaderScanner scanner;
+   scanner.prepareForMessage(&msg);
+   char* unprocessed = 0;
+   ScanOutcome outcome;
+   outcome.result = scanner.scanChunk(buffer, length, &unprocessed);
+   outcome.unprocessed = (long)(unprocessed - buffer);
+   outcome.numHeaders = scanner.getHeaderCount();
+   for (int t = 0; t < Headers::MAX_HEADERS; ++t)
+   {
+      const HeaderFieldValueList* hfvs = msg.getRawHeader(Headers::Type(t));
+      if (hfvs)
+      {
+         outcome.fields.push_back(t);
+         addFields(outcome, buffer, hfvs);
+      }
+   }
+   const SipMessage::UnknownHeaders& unknowns = msg.getRawUnknownHeaders();
+   for (SipMessage::UnknownHeaders::const_iterator i = unknowns.begin(); i != unknowns.end(); ++i)
+   {
+      outcome.fields.push_back(Headers::UNKNOWN);
+      addFields(outcome, buffer, i->second);
+   }
+   return outcome;
+}
+
+static int
+checkEquivalence(const vector<Data>& corpus, const vector<Data>& names)
+{
+   int failures = 0;
+   for (int impl = MsgHeaderScanner::siSse2; impl <= MsgHeaderScanner::siAvx2; ++impl)
+   {
+      if (!MsgHeaderScanner::isScanImplSupported(MsgHeaderScanner::ScanImpl(impl)))
+      {
+         cerr << implNames[impl] << ": not supported here" << endl;
+         continue;
+      }
+      int compared = 0;
+      for (size_t m = 0; m < corpus.size(); ++m)
+      {
+         // the whole message, and every prefix of it, to exercise the
+         // handling of the end of a chunk
+         for (unsigned int length = (unsigned int)corpus[m].size(); length > 0; --length)
+         {
+            MsgHeaderScanner::setScanImpl(MsgHeaderScanner::siScalar);
+            ScanOutcome expected = scan(corpus[m], length);
+            MsgHeaderScanner::setScanImpl(MsgHeaderScanner::ScanImpl(impl));
+            ScanOutcome actual = scan(corpus[m], length);
+            ++compared;
+            if (!(expected == actual))
+            {
+               cerr << implNames[impl] << ": " << names[m]
+                    << " scanned differently at length " << length << endl;
+               ++failures;
+               break;
+            }
+         }
+      }
+      cerr << implNames[impl] << ": " << compared << " scans match scalar" << endl;
+   }
+   return failures;
+}
+
+static void
+benchmark(const vector<Data>& corpus, int iterations)
+{
+   size_t bytes = 0;
+   for (size_t m = 0; m < corpus.size(); ++m)
+   {
+      bytes += corpus[m].size();
+   }
+
+   for (int impl = MsgHeaderScanner::siScalar; impl <= MsgHeaderScanner::siAvx2; ++impl)
+   {
+      if (!MsgHeaderScanner::setScanImpl(MsgHeaderScanner::ScanImpl(impl)))
+      {
+         continue;
+      }
+      UInt64 start = Timer::getTimeMicroSec();
+      for (int i = 0; i < iterations; ++i)
+      {
+         for (size_t m = 0; m < corpus.size(); ++m)
+         {
+            scan(corpus[m], (unsigned int)corpus[m].size());
+         }
+      }
+      UInt64 elapsed = resipMax(UInt64(1), Timer::getTimeMicroSec() - start);
+      double seconds = elapsed / 1000000.0;
+      cout << implNames[impl] << ": "
+           << (bytes * iterations) / seconds / (1024 * 1024) << " MB/s, "
+           << (corpus.size() * iterations) / seconds << " msgs/s" << endl;
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Data dir(".");
+   int iterations = 2000;
+   if (argc > 1)
+   {
+      dir = argv[1];
+   }
+   if (argc > 2)
+   {
+      iterations = atoi(argv[2]);
+   }
+
+   vector<Data> corpus;
+   vector<Data> names;
+   for (size_t i = 0; i < sizeof(corpusFiles)/sizeof(corpusFiles[0]); ++i)
+   {
+      Data name = Data(corpusFiles[i]) + ".dat";
+      Data text = readFile(dir + "/" + name);
+      if (!text.empty())
+      {
+         corpus.push_back(text);
+         names.push_back(name);
+      }
+   }
+   for (size_t i = 0; i < sizeof(builtinMessages)/sizeof(builtinMessages[0]); ++i)
+   {
+      corpus.push_back(Data(builtinMessages[i]));
+      names.push_back("builtin" + Data((UInt32)i));
+   }
+   cerr << corpus.size() << " messages in corpus" << endl;
+
+   MsgHeaderScanner::ScanImpl best = MsgHeaderScanner::getScanImpl();
+   assert(MsgHeaderScanner::isScanImplSupported(best));
+   assert(MsgHeaderScanner::isScanImplSupported(MsgHeaderScanner::siScalar));
+
+   int failures = checkEquivalence(corpus, names);
+   benchmark(corpus, iterations);
+   MsgHeaderScanner::setScanImpl(best);
+
+   if (failures)
+   {
+      cerr << failures << " FAILED" << endl;
+      return -1;
+   }
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
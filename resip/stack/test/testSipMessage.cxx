@@ -3,6 +3,7 @@
 
 #include "rutil/DataStream.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/Helper.hxx"
@@ -2246,6 +2247,112 @@ main(int argc, char** argv)
       assert(embeddedMsg2.header(h_Requires).find(Token(Symbols::Replaces)));
    }
 
+   {
+      // a trace is shared by copies and reported once, when it ends
+      Data txt("OPTIONS sip:bob@biloxi.example.com SIP/2.0\r\n"
+               "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bKnashds8\r\n"
+               "To: Bob <sip:bob@biloxi.example.com>\r\n"
+               "From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+               "Call-ID: a84b4c76e66710\r\n"
+               "CSeq: 63104 OPTIONS\r\n"
+               "Max-Forwards: 70\r\n"
+               "Content-Length: 0\r\n"
+               "\r\n");
+
+      UInt64 buckets[ThreadStatistics::Buckets];
+      UInt64 before = 0;
+      UInt64 after = 0;
+      UInt64 sum = 0;
+      StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, before, sum);
+
+      auto_ptr<SipMessage> msg(TestSupport::makeMessage(txt));
+      assert(!msg->isTraced());
+      msg->traceHop(MessageTrace::Transaction);
+      msg->startTrace();
+      assert(msg->isTraced());
+      msg->traceHop(MessageTrace::Transaction);
+
+      // copying shares the trace and leaves the (const) source traced
+      const SipMessage& source = *msg;
+      SipMessage copy(source);
+      assert(copy.isTraced());
+      assert(msg->isTraced());
+      SipMessage assigned;
+      assigned = copy;
+      assert(assigned.isTraced());
+      msg.reset();
+      StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, after, sum);
+      assert(after == before);
+
+      // the first copy transmitted reports, once
+      copy.traceHop(MessageTrace::Transmitted);
+      copy.endTrace();
+      assert(!copy.isTraced());
+      StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, after, sum);
+      assert(after == before + 1);
+      assigned.endTrace();
+      StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, after, sum);
+      assert(after == before + 1);
+
+      {
+         // a trace that is never transmitted is reported by the last copy
+         StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, before, sum);
+         auto_ptr<SipMessage> msg(TestSupport::makeMessage(txt));
+         msg->startTrace();
+         auto_ptr<SipMessage> copy(new SipMessage(*msg));
+         msg.reset();
+         StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, after, sum);
+         assert(after == before);
+         copy.reset();
+         StackStatistics::statistics().getHistogram(StackStatistics::TraceTotal, buckets, after, sum);
+         assert(after == before + 1);
+      }
+
+      {
+         // only intervals between adjacent stamped hops are recorded
+         UInt64 hops[MessageTrace::MaxHop] = { 0 };
+         hops[MessageTrace::Received] = 1000;
+         hops[MessageTrace::Parsed] = 1100;
+         hops[MessageTrace::TuReceived] = 5000;
+         hops[MessageTrace::Processed] = 5300;
+
+         UInt64 count[StackStatistics::TraceTotal + 1];
+         UInt64 sums[StackStatistics::TraceTotal + 1];
+         for (int h = StackStatistics::TraceParse; h <= StackStatistics::TraceTotal; ++h)
+         {
+            StackStatistics::statistics().getHistogram(h, buckets, count[h], sums[h]);
+         }
+
+         auto_ptr<SipMessage> msg(TestSupport::makeMessage(txt));
+         MessageTrace::report(*msg, hops);
+
+         for (int h = StackStatistics::TraceParse; h <= StackStatistics::TraceTotal; ++h)
+         {
+            StackStatistics::statistics().getHistogram(h, buckets, after, sum);
+            UInt64 expected = 0;
+            if (h == StackStatistics::TraceParse)
+            {
+               expected = 100;
+            }
+            else if (h == StackStatistics::TraceParse + MessageTrace::Processed - 1)
+            {
+               expected = 300;
+            }
+            else if (h == StackStatistics::TraceTotal)
+            {
+               expected = 4300;
+            }
+            else
+            {
+               assert(after == count[h]);
+               continue;
+            }
+            assert(after == count[h] + 1);
+            assert(sum == sums[h] + expected);
+         }
+      }
+   }
+
    resipCerr << "\nTEST OK" << endl;
    return 0;
 }
@@ -0,0 +1,288 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "resip/stack/HeaderFieldValueList.hxx"
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+static const Data Invite(
+   "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+   "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds;rport\r\n"
+   "Via: SIP/2.0/TCP edge.atlanta.example.com;branch=z9hG4bK4b43c2ff8.1\r\n"
+   "Max-Forwards: 70\r\n"
+   "Route: <sip:proxy.biloxi.example.com;lr>\r\n"
+   "Route: <sip:core.biloxi.example.com;lr>\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>\r\n"
+   "f: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+   "Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+   "CSeq: 314159 INVITE\r\n"
+   "Contact: <sip:alice@pc33.atlanta.example.com>\r\n"
+   "Supported: timer, 100rel,replaces\r\n"
+   "Allow: INVITE, ACK, CANCEL, BYE, OPTIONS\r\n"
+   "Subject :  lunch\r\n"
+   "User-Agent: softphone/1.0\r\n"
+   "P-Asserted-Identity: <sip:alice@atlanta.example.com>\r\n"
+   "X-Account:   4711\r\n"
+   "Content-Type: application/sdp\r\n"
+   "Content-Length: 149\r\n"
+   "\r\n"
+   "v=0\r\n"
+   "o=alice 2890844526 2890844526 IN IP4 pc33.atlanta.example.com\r\n"
+   "s=-\r\n"
+   "c=IN IP4 192.0.2.101\r\n"
+   "t=0 0\r\n"
+   "m=audio 49172 RTP/AVP 0\r\n"
+   "a=rtpmap:0 PCMU/8000\r\n");
+
+static Data
+encode(const SipMessage& msg)
+{
+   Data out;
+   {
+      DataStream ds(out);
+      msg.encode(ds);
+   }
+   return out;
+}
+
+static bool
+contains(const Data& text, const char* line)
+{
+   return text.find(Data(line)) != Data::npos;
+}
+
+// What a proxy does to a request it forwards, and the reads the stack and
+// the proxy make along the way.
+static void
+forward(SipMessage& msg)
+{
+   const SipMessage& reader = msg;
+   reader.header(h_From).uri();
+   reader.header(h_To).uri();
+   reader.header(h_CallId).value();
+   reader.header(h_CSeq).method();
+
+   Via via;
+   via.sentHost() = "proxy.biloxi.example.com";
+   via.sentPort() = 5060;
+   via.transport() = "UDP";
+   via.param(p_branch).reset("z9hG4bK-d87543-1a2b3c4d");
+   msg.header(h_Vias).push_front(via);
+
+   msg.header(h_Routes).pop_front();
+   msg.header(h_RecordRoutes).push_front(NameAddr("<sip:proxy.biloxi.example.com;lr>"));
+   msg.header(h_MaxForwards).value()--;
+}
+
+// Bytes of the headers that are copied as received.
+static size_t
+verbatimBytes(const SipMessage& msg)
+{
+   size_t bytes = 0;
+   for (int i = 0; i < Headers::MAX_HEADERS; ++i)
+   {
+      if (i == Headers::ContentLength)
+      {
+         continue;
+      }
+      const HeaderFieldValueList* hfvl = msg.getRawHeader((Headers::Type)i);
+      if (hfvl && hfvl->getWire())
+      {
+         bytes += hfvl->getWire()->getLength() + 2;
+      }
+   }
+   return bytes;
+}
+
+static void
+testVerbatim()
+{
+   auto_ptr<SipMessage> msg(SipMessage::make(Invite));
+   assert(msg.get());
+
+   // untouched: every header line goes out exactly as it came in
+   Data out = encode(*msg);
+   assert(contains(out, "f: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"));
+   assert(contains(out, "Subject :  lunch\r\n"));
+   assert(contains(out, "X-Account:   4711\r\n"));
+   assert(contains(out, "Supported: timer, 100rel,replaces\r\n"));
+   assert(contains(out, "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds;rport\r\n"
+                        "Via: SIP/2.0/TCP edge.atlanta.example.com;branch=z9hG4bK4b43c2ff8.1\r\n"));
+   assert(msg->getRawHeader(Headers::Via)->getWire());
+
+   // reading a header leaves it verbatim
+   const SipMessage& reader = *msg;
+   assert(reader.header(h_Supporteds).size() == 3);
+   assert(reader.header(h_From).param(p_tag) == "1928301774");
+   assert(msg->getRawHeader(Headers::From)->getWire());
+   assert(contains(encode(*msg), "f: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"));
+
+   // forwarding re-encodes just what it changes, in copies as well
+   SipMessage fwd(*msg);
+   forward(fwd);
+   SipMessage copy(fwd);
+   out = encode(fwd);
+   assert(out == encode(copy));
+   assert(contains(out, "\r\nVia: SIP/2.0/UDP proxy.biloxi.example.com:5060;branch="));
+   assert(contains(out, "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds;rport\r\n"));
+   assert(contains(out, "Max-Forwards: 69\r\n"));
+   assert(!contains(out, "proxy.biloxi.example.com;lr>\r\nRoute"));
+   assert(contains(out, "Route: <sip:core.biloxi.example.com;lr>\r\n"));
+   assert(contains(out, "Record-Route: <sip:proxy.biloxi.example.com;lr>\r\n"));
+   assert(contains(out, "f: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"));
+   assert(contains(out, "Subject :  lunch\r\n"));
+   assert(!fwd.getRawHeader(Headers::Via)->getWire());
+   assert(copy.getRawHeader(Headers::CallID)->getWire());
+
+   auto_ptr<SipMessage> reparsed(SipMessage::make(out));
+   assert(reparsed.get());
+   assert(reparsed->header(h_Vias).size() == 3);
+   assert(reparsed->header(h_Routes).size() == 1);
+   assert(reparsed->header(h_MaxForwards).value() == 69);
+   assert(reparsed->header(h_From).param(p_tag) == "1928301774");
+   assert(reparsed->header(h_Supporteds).size() == 3);
+   assert(reparsed->getContents()->getBodyData() == msg->getContents()->getBodyData());
+
+   // removed and replaced headers are gone from the output
+   fwd.remove(h_Subject);
+   fwd.header(h_UserAgent).value() = "proxy/2.0";
+   out = encode(fwd);
+   assert(!contains(out, "lunch"));
+   assert(contains(out, "User-Agent: proxy/2.0\r\n"));
+   assert(!contains(out, "softphone"));
+
+   // lines of one header that are not adjacent cannot be copied as one
+   auto_ptr<SipMessage> split(SipMessage::make(
+      "OPTIONS sip:bob@biloxi.example.com SIP/2.0\r\n"
+      "Via: SIP/2.0/UDP a.example.com;branch=z9hG4bK1\r\n"
+      "Call-ID: 1234@a.example.com\r\n"
+      "Via: SIP/2.0/UDP b.example.com;branch=z9hG4bK2\r\n"
+      "CSeq: 1 OPTIONS\r\n"
+      "Content-Length: 0\r\n"
+      "\r\n"));
+   assert(split.get());
+   assert(!split->getRawHeader(Headers::Via)->getWire());
+   assert(split->getRawHeader(Headers::CSeq)->getWire());
+   SipMessage splitCopy(*split);
+   out = encode(splitCopy);
+   assert(contains(out, "Via: SIP/2.0/UDP a.example.com;branch=z9hG4bK1\r\n"
+                        "Via: SIP/2.0/UDP b.example.com;branch=z9hG4bK2\r\n"));
+
+   cerr << "Verbatim encoding OK" << endl;
+}
+
+/**
+   Copies, modifies and encodes a request the way a proxy forwarding it
+   does, and reports how much of each forwarded request is copied from the
+   received text and how much is written out from values and parsers.
+*/
+static void
+benchForward(int runs)
+{
+   auto_ptr<SipMessage> msg(SipMessage::make(Invite));
+   const SipMessage& received = *msg;
+   received.header(h_CallId);
+
+   size_t total = 0;
+   size_t verbatim = 0;
+   UInt64 start = Timer::getTimeMicroSec();
+   for (int i = 0; i < runs; ++i)
+   {
+      SipMessage fwd(*msg);
+      forward(fwd);
+      Data out;
+      out.reserve(1024);
+      {
+         DataStream ds(out);
+         fwd.encode(ds);
+      }
+      total += out.size();
+      if (i == 0)
+      {
+         verbatim = verbatimBytes(fwd);
+      }
+   }
+   UInt64 elapsed = Timer::getTimeMicroSec() - start;
+
+   size_t body = msg->getContents()->getBodyData().size();
+   size_t perRequest = total / runs;
+   cout << runs << " forwarded requests of " << perRequest << " bytes ("
+        << body << " bytes of body):" << endl
+        << "  headers copied as received: " << verbatim << " bytes" << endl
+        << "  start line, Content-Length and the rest, encoded from values or parsers: "
+        << perRequest - body - verbatim << " bytes" << endl
+        << "  " << (double)elapsed / runs << " us per copy, forward and encode" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   int runs = 20000;
+   if (argc > 1)
+   {
+      runs = atoi(argv[1]);
+   }
+
+   testVerbatim();
+   benchForward(runs);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
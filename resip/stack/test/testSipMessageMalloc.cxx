@@ -0,0 +1,274 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SdpContents.hxx"
+#include "resip/stack/test/TestSupport.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// Counts calls to the global operator new while gCounting is set, and
+// keeps track of how many blocks are outstanding. Array new and the
+// library's own allocations all end up here.
+static bool gCounting = false;
+static unsigned long gMallocs = 0;
+static long gLive = 0;
+
+void* operator new(size_t size)
+{
+   if (gCounting)
+   {
+      ++gMallocs;
+   }
+   void* p = malloc(size ? size : 1);
+   if (!p)
+   {
+      throw std::bad_alloc();
+   }
+   ++gLive;
+   return p;
+}
+
+void operator delete(void* p) throw()
+{
+   if (p)
+   {
+      --gLive;
+   }
+   free(p);
+}
+
+static const char* invite =
+   "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101\r\n"
+   "Via: SIP/2.0/UDP proxy.example.com:5060;branch=z9hG4bK4b43c2ff8.1;rport\r\n"
+   "Max-Forwards: 70\r\n"
+   "From: Alice <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:alice@client.atlanta.example.com;transport=tcp>\r\n"
+   "Record-Route: <sip:proxy.example.com;lr>\r\n"
+   "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY\r\n"
+   "Supported: timer, 100rel, replaces\r\n"
+   "User-Agent: testSipMessageMalloc/1.0\r\n"
+   "Content-Type: application/sdp\r\n"
+   "Content-Length: 151\r\n"
+   "\r\n"
+   "v=0\r\n"
+   "o=alice 2890844526 2890844526 IN IP4 client.atlanta.example.com\r\n"
+   "s=-\r\n"
+   "c=IN IP4 192.0.2.101\r\n"
+   "t=0 0\r\n"
+   "m=audio 49172 RTP/AVP 0\r\n"
+   "a=rtpmap:0 PCMU/8000\r\n";
+
+// what a proxy or UA typically looks at in an incoming INVITE
+static void
+touchHeaders(SipMessage& msg)
+{
+   msg.header(h_RequestLine).uri().user();
+   msg.header(h_Vias).front().param(p_branch).getTransactionId();
+   msg.header(h_Vias).back().sentHost();
+   msg.header(h_MaxForwards).value();
+   msg.header(h_From).uri().host();
+   msg.header(h_From).param(p_tag);
+   msg.header(h_To).uri().user();
+   msg.header(h_CallId).value();
+   msg.header(h_CSeq).sequence();
+   msg.header(h_Contacts).front().uri().param(p_transport);
+   msg.header(h_RecordRoutes).front().uri().exists(p_lr);
+   msg.header(h_Allows).size();
+   msg.header(h_Supporteds).size();
+}
+
+static void
+touchBody(SipMessage& msg)
+{
+   SdpContents* sdp = dynamic_cast<SdpContents*>(msg.getContents());
+   assert(sdp);
+   assert(sdp->session().media().size() == 1);
+}
+
+static void
+testContentsOwnership()
+{
+   // the parsed Contents lives in the message's pool; these must still work
+   auto_ptr<SipMessage> msg(TestSupport::makeMessage(invite));
+   touchBody(*msg);
+
+   auto_ptr<SipMessage> copy(new SipMessage(*msg));
+   touchBody(*copy);
+   *copy = *msg;
+   touchBody(*copy);
+
+   auto_ptr<Contents> released = msg->releaseContents();
+   assert(released.get());
+   assert(dynamic_cast<SdpContents*>(released.get()));
+   assert(msg->getContents() == 0);
+
+   copy->setContents(released);
+   touchBody(*copy);
+   copy->setContents(auto_ptr<Contents>(0));
+   assert(copy->getContents() == 0);
+   resipCerr << "Pooled contents OK" << endl;
+}
+
+static void
+testLongLived()
+{
+   // a message that is kept around and mutated or reassigned (eg. the last
+   // REGISTER of a client registration) must not keep growing its pool
+   auto_ptr<SipMessage> msg(TestSupport::makeMessage(invite));
+   touchHeaders(*msg);
+   touchBody(*msg);
+   SipMessage kept(*msg);
+
+   long live = 0;
+   for (int i = 0; i < 1000; ++i)
+   {
+      kept = *msg;
+      touchHeaders(kept);
+      touchBody(kept);
+      for (int j = 0; j < 4; ++j)
+      {
+         kept.header(h_Contacts).clear();
+         NameAddr contact("<sip:alice@client.atlanta.example.com;transport=tcp>;expires=3600");
+         kept.header(h_Contacts).push_back(contact);
+         kept.header(h_Vias).front().param(p_branch).reset(Data(i));
+      }
+      if (i == 10)
+      {
+         live = gLive;
+      }
+   }
+   assert(gLive == live);
+   resipCerr << "Long-lived message OK" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   int runs = 100000;
+   if (argc > 1)
+   {
+      runs = atoi(argv[1]);
+   }
+
+   testContentsOwnership();
+   testLongLived();
+
+   const Data wire(invite);
+   // warm up anything that is allocated once per process
+   {
+      auto_ptr<SipMessage> msg(SipMessage::make(wire));
+      touchHeaders(*msg);
+      touchBody(*msg);
+   }
+
+   gMallocs = 0;
+   gCounting = true;
+   {
+      auto_ptr<SipMessage> msg(SipMessage::make(wire));
+   }
+   gCounting = false;
+   unsigned long scanOnly = gMallocs;
+
+   gMallocs = 0;
+   gCounting = true;
+   {
+      auto_ptr<SipMessage> msg(SipMessage::make(wire));
+      touchHeaders(*msg);
+   }
+   gCounting = false;
+   unsigned long headers = gMallocs;
+
+   gMallocs = 0;
+   gCounting = true;
+   {
+      auto_ptr<SipMessage> msg(SipMessage::make(wire));
+      touchHeaders(*msg);
+      touchBody(*msg);
+   }
+   gCounting = false;
+   unsigned long withBody = gMallocs;
+
+   gMallocs = 0;
+   gCounting = true;
+   UInt64 start = Timer::getTimeMicroSec();
+   for (int i = 0; i < runs; ++i)
+   {
+      auto_ptr<SipMessage> msg(SipMessage::make(wire));
+      touchHeaders(*msg);
+      touchBody(*msg);
+   }
+   UInt64 elapsed = Timer::getTimeMicroSec() - start;
+   gCounting = false;
+   assert(gMallocs == (unsigned long)runs * withBody);
+
+   resipCout << "mallocs per INVITE (" << wire.size() << " bytes, sizeof(SipMessage)="
+             << sizeof(SipMessage) << "):" << endl
+             << "  scanned only:         " << scanOnly << endl
+             << "  headers parsed:       " << headers << endl
+             << "  headers and SDP body: " << withBody << endl
+             << runs << " INVITEs parsed in " << elapsed/1000 << " ms ("
+             << (runs ? elapsed*1000/runs : 0) << " ns each)" << endl;
+
+   resipCout << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
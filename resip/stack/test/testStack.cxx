@@ -22,9 +22,11 @@
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/SipStack.hxx"
+#include "resip/stack/StackStatistics.hxx"
 #include "resip/stack/StackThread.hxx"
 #include "rutil/SelectInterruptor.hxx"
 #include "resip/stack/TransportThread.hxx"
+#include "resip/stack/UdpTransport.hxx"
 #include "resip/stack/InterruptableStackThread.hxx"
 #include "resip/stack/EventStackThread.hxx"
 #include "resip/stack/Uri.hxx"
@@ -155,7 +157,10 @@ class SipStackAndThread
    public:
       SipStackAndThread(const char *tType,
         AsyncProcessHandler *notifyDn=0,
-        AsyncProcessHandler *notifyUp=0);
+        AsyncProcessHandler *notifyUp=0,
+        int tcShards=1,
+        bool timerWheel=false,
+        bool lockFreeFifo=false);
          ~SipStackAndThread() {
          destroy();
       }
@@ -203,7 +208,8 @@ class SipStackAndThread
 
 
 SipStackAndThread::SipStackAndThread(const char *tType,
- AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp)
+ AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp, int tcShards,
+ bool timerWheel, bool lockFreeFifo)
   : mStack(0), 
       mThread(0), 
       mSelIntr(0), 
@@ -249,6 +255,9 @@ SipStackAndThread::SipStackAndThread(const char *tType,
    options.mAsyncProcessHandler = mEventIntr?mEventIntr
       :(mSelIntr?mSelIntr:notifyDn);
    options.mPollGrp = mPollGrp;
+   options.mTransactionControllerShards = tcShards;
+   options.mUseTimerWheel = timerWheel;
+   options.mLockFreeStateMachineFifo = lockFreeFifo;
    mStack = new SipStack(options);
    
    mStack->setFallbackPostNotify(notifyUp);
@@ -568,6 +577,13 @@ performTest(int verbose, int runs, int window, int invite,
         <<" Rsp="<<rxRspHitCnt<<"/"<<rxRspTryCnt
         <<" ("<<(rxRspHitCnt*100/rxRspTryCnt)<<"%)"
         << endl;
+
+      Data metrics;
+      {
+         DataStream ds(metrics);
+         StackStatistics::encodePrometheus(ds);
+      }
+      cout << metrics;
    }
 }
 
@@ -594,6 +610,12 @@ main(int argc, char* argv[])
    int sendSleepMs = 0;
    int cManager=0;
    int statisticsInterval=60;
+   int tcShards=1;
+   int rxSockets=1;
+   int batchSize=0;
+   int timerWheel=0;
+   int lockFreeFifo=0;
+   int asyncLogBytes=0;
 
 #if defined(HAVE_POPT_H)
 
@@ -604,6 +626,7 @@ main(int argc, char* argv[])
    struct poptOption table[] = {
       {"log-type",    'l', POPT_ARG_STRING, &logType,   0, "where to send logging messages", "syslog|cerr|cout"},
       {"log-level",   'v', POPT_ARG_STRING, &logLevel,  0, "specify the default log level", "DEBUG|INFO|WARNING|ALERT"},
+      {"log-async",   0,   POPT_ARG_INT,    &asyncLogBytes, 0, "write the log from a background thread, buffering up to this many bytes per thread", 0},
       {"num-runs",    'r', POPT_ARG_INT,    &runs,      0, "number of runs (SIP requests) in test", 0},
       {"window-size", 'w', POPT_ARG_INT,    &window,    0, "number of concurrent transactions", 0},
       {"select-time", 's', POPT_ARG_INT,    &seltime,   0, "polling interval (ms) for stack thread", 0},
@@ -620,6 +643,11 @@ main(int argc, char* argv[])
       {"sleep",       0,   POPT_ARG_INT,    &sendSleepMs,0, "time (ms) to sleep after each sent request", 0},
       {"use-congestion-manager",0, POPT_ARG_NONE, &cManager ,   0, "use a CongestionManager", 0},
       {"statistics-interval",       0,   POPT_ARG_INT,    &statisticsInterval,0, "time in seconds between statistics logging", 0},
+      {"tc-shards",   0,   POPT_ARG_INT,    &tcShards,  0, "number of TransactionController shards (with multithreadedstack)", 0},
+      {"timer-wheel", 0,   POPT_ARG_NONE,   &timerWheel,0, "keep stack timers in timing wheels instead of heaps", 0},
+      {"lockfree-fifo", 0, POPT_ARG_NONE,   &lockFreeFifo,0, "use a lock-free state machine fifo", 0},
+      {"rx-sockets",  0,   POPT_ARG_INT,    &rxSockets, 0, "number of SO_REUSEPORT receive sockets/threads for the registrar's UDP transports", 0},
+      {"batch-size",  0,   POPT_ARG_INT,    &batchSize, 0, "move this many datagrams per recvmmsg/sendmmsg on UDP transports (0 disables batching)", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -630,6 +658,10 @@ main(int argc, char* argv[])
    assert( poptGetArg(context)==NULL);
 #endif  // popt
    Log::initialize(logType, logLevel, argv[0]);
+   if (asyncLogBytes > 0)
+   {
+      Log::setAsynchronous(asyncLogBytes);
+   }
 
    Data bindIfAddr(bindAddr);
    if ( bindIfAddr.size()==0 )
@@ -646,6 +678,11 @@ main(int argc, char* argv[])
      <<" bindIf="<<bindIfAddr
      <<" listen="<<doListen
      <<" tf="<<tpFlags
+     <<" shards="<<tcShards
+     <<" rxsockets="<<rxSockets
+     <<" batchsize="<<batchSize
+     <<" timerwheel="<<timerWheel
+     <<" lockfreefifo="<<lockFreeFifo
      <<"." << endl;
 
    const char *eachThreadType = threadType;
@@ -678,8 +715,8 @@ main(int argc, char* argv[])
    {
       notifyUp = &sharedUp;
    }
-   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp);
-   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp);
+   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp, tcShards, timerWheel!=0, lockFreeFifo!=0);
+   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp, tcShards, timerWheel!=0, lockFreeFifo!=0);
    receiver.getStack().setStatisticsInterval(statisticsInterval);
    sender.getStack().setStatisticsInterval(statisticsInterval);
 
@@ -707,6 +744,8 @@ main(int argc, char* argv[])
    }
    int registrarPort = senderPort + numPorts;
 
+   unsigned udpFlags = tpFlags|(batchSize>0?RESIP_TRANSPORT_FLAG_BATCHIO:0);
+
    int idx;
    std::vector<Transport*> transports;
    for (idx=0; idx < numPorts; idx++)
@@ -719,7 +758,11 @@ main(int argc, char* argv[])
                            /*sipDomain*/Data::Empty, 
                            /*keypass*/Data::Empty, 
                            SecurityTypes::TLSv1,
-                           tpFlags));
+                           udpFlags));
+      if(batchSize>0)
+      {
+         dynamic_cast<UdpTransport*>(transports.back())->setBatchSize(batchSize);
+      }
 
       // NOBIND doesn't make sense for UDP
       transports.push_back(sender->addTransport(TCP, 
@@ -742,7 +785,15 @@ main(int argc, char* argv[])
                              /*sipDomain*/Data::Empty, 
                              /*keypass*/Data::Empty, 
                              SecurityTypes::TLSv1,
-                             tpFlags));
+                             udpFlags|(rxSockets>1?RESIP_TRANSPORT_FLAG_REUSEPORT:0)));
+      if(batchSize>0)
+      {
+         dynamic_cast<UdpTransport*>(transports.back())->setBatchSize(batchSize);
+      }
+      if(rxSockets>1)
+      {
+         dynamic_cast<UdpTransport*>(transports.back())->addReceiveSockets(rxSockets-1);
+      }
 
       transports.push_back(receiver->addTransport(TCP, 
                              registrarPort+idx, 
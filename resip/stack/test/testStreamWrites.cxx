@@ -0,0 +1,200 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "resip/stack/Transport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+#ifdef USE_SSL
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "resip/stack/test/TlsTestCertificates.hxx"
+#endif
+
+using namespace resip;
+using namespace std;
+
+/*
+   Queues a burst of requests on a TCP (and, with USE_SSL, a TLS)
+   connection over the loopback interface before it is writable, and
+   checks that all of them arrive and that the stream write counters saw
+   them go out in fewer writes than messages.
+*/
+
+static const unsigned int Burst = 50;
+
+static UInt64
+counter(StackStatistics::Counter c)
+{
+   return StackStatistics::statistics().getCounter(c);
+}
+
+static void
+burst(Transport& sender, Transport& receiver, Fifo<TransactionMessage>& rxFifo,
+      const Data& host)
+{
+   UInt64 writesBefore = counter(StackStatistics::StreamWrites);
+   UInt64 bytesBefore = counter(StackStatistics::StreamWriteBytes);
+   UInt64 messagesBefore = counter(StackStatistics::StreamWriteMessages);
+
+   in_addr loopback;
+   DnsUtil::inet_pton("127.0.0.1", loopback);
+   Tuple dest(loopback, receiver.port(), sender.transport());
+   dest.setTargetDomain(host);
+
+   NameAddr target;
+   target.uri().scheme() = "sip";
+   target.uri().user() = "stream";
+   target.uri().host() = host;
+   target.uri().port() = receiver.port();
+   target.uri().param(p_transport) = Tuple::toDataLower(sender.transport());
+   NameAddr from(target);
+   from.uri().port() = sender.port();
+
+   UInt64 bytes = 0;
+   for (unsigned int i = 0; i < Burst; ++i)
+   {
+      auto_ptr<SipMessage> msg(Helper::makeRegister(target, from));
+      // normally filled in by the TransportSelector
+      Via& via = msg->header(h_Vias).front();
+      via.transport() = Tuple::toData(sender.transport());
+      via.sentHost() = "127.0.0.1";
+      via.sentPort() = sender.port();
+      Data encoded;
+      {
+         DataStream strm(encoded);
+         msg->encode(strm);
+      }
+      bytes += encoded.size();
+      auto_ptr<SendData> toSend(sender.makeSendData(dest, encoded, Data(i), Data::Empty));
+      sender.send(toSend);
+   }
+
+   unsigned int received = 0;
+   UInt64 end = Timer::getTimeMs() + 10000;
+   while (received < Burst && Timer::getTimeMs() < end)
+   {
+      FdSet fdset;
+      sender.buildFdSet(fdset);
+      receiver.buildFdSet(fdset);
+      fdset.selectMilliSeconds(100);
+      sender.process(fdset);
+      receiver.process(fdset);
+
+      while (rxFifo.messageAvailable())
+      {
+         auto_ptr<TransactionMessage> msg(rxFifo.getNext());
+         SipMessage* sip = dynamic_cast<SipMessage*>(msg.get());
+         if (sip)
+         {
+            assert(sip->isRequest());
+            assert(sip->method() == REGISTER);
+            assert(sip->header(h_To).uri().user() == "stream");
+            ++received;
+         }
+      }
+   }
+   cout << Tuple::toData(sender.transport()) << ": received " << received << " of " << Burst << endl;
+   assert(received == Burst);
+
+   UInt64 writes = counter(StackStatistics::StreamWrites) - writesBefore;
+   cout << Burst << " messages, " << bytes << " bytes in " << writes << " writes" << endl;
+   assert(counter(StackStatistics::StreamWriteMessages) - messagesBefore == Burst);
+   assert(counter(StackStatistics::StreamWriteBytes) - bytesBefore == bytes);
+   assert(writes > 0 && writes < Burst);
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   {
+      Fifo<TransactionMessage> txFifo;
+      TcpTransport sender(txFifo, 0, V4, "127.0.0.1");
+      Fifo<TransactionMessage> rxFifo;
+      TcpTransport receiver(rxFifo, 0, V4, "127.0.0.1");
+      burst(sender, receiver, rxFifo, "127.0.0.1");
+   }
+
+#ifdef USE_SSL
+   TlsTestCertificates certificates("testStreamWrites");
+   assert(!certificates.directory().empty());
+   {
+      Security security(certificates.directory());
+      security.preload();
+
+      int port = 26060 + (rand() & 0x0fff);
+      Fifo<TransactionMessage> txFifo;
+      TlsTransport sender(txFifo, port, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23);
+      Fifo<TransactionMessage> rxFifo;
+      TlsTransport receiver(rxFifo, port + 1, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23);
+      burst(sender, receiver, rxFifo, TlsTestCertificates::Domain);
+   }
+#endif
+
+   cout << "PASSED" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,292 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include "resip/stack/TimerQueue.hxx"
+#include "resip/stack/TimerWheel.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Timer.hxx"
+
+#ifdef WIN32
+#include <windows.h>
+#define usleep(x) Sleep(x/1000)
+#else
+#include <unistd.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+// A timer whose expiry is given in absolute simulated time, so that the
+// wheel and the heap can be driven faster than real time.
+class SimTimer
+{
+   public:
+      SimTimer(UInt64 when, const Data& tid) : mWhen(when), mTid(tid) {}
+      UInt64 getWhen() const { return mWhen; }
+      bool operator>(const SimTimer& rhs) const { return mWhen > rhs.mWhen; }
+
+      UInt64 mWhen;
+      Data mTid;
+};
+
+typedef std::priority_queue<SimTimer, std::vector<SimTimer>, std::greater<SimTimer> > SimHeap;
+
+// RFC 3261 timer durations with the default T1/T2/T4
+static const unsigned long Durations[] = { 500,     // A, E, G
+                                           32000,   // B, F, H
+                                           5000,    // D(UDP), K, I
+                                           32000 }; // J
+static const int NumDurations = sizeof(Durations)/sizeof(Durations[0]);
+
+static void
+testAgainstHeap()
+{
+   TimerWheel<SimTimer> wheel;
+   SimHeap heap;
+   UInt64 now = Timer::getTimeMs();
+   const Data tid("z9hG4bK-test");
+
+   srand(4711);
+   for (int round = 0; round < 20000; ++round)
+   {
+      int adds = rand() % 8;
+      for (int i = 0; i < adds; ++i)
+      {
+         UInt64 when;
+         switch (rand() % 4)
+         {
+            case 0:
+               when = now - (rand() % 10);                 // already due
+               break;
+            case 1:
+               when = now + (rand() % 300);                // level 0
+               break;
+            case 2:
+               when = now + (rand() % 20000000);           // upper levels
+               break;
+            default:
+               when = now + Durations[rand() % NumDurations];
+               break;
+         }
+         wheel.push(SimTimer(when, tid));
+         heap.push(SimTimer(when, tid));
+      }
+      if (round == 10000)
+      {
+         // beyond the reach of the wheels
+         wheel.push(SimTimer(now + (UInt64(1) << 33), tid));
+         heap.push(SimTimer(now + (UInt64(1) << 33), tid));
+      }
+
+      assert(wheel.size() == heap.size());
+      if (!heap.empty())
+      {
+         // may be early, never late
+         assert(wheel.nextWhen() <= heap.top().getWhen());
+      }
+
+      now += (rand() % 3 == 0) ? rand() % 100000 : rand() % 50;
+
+      std::vector<SimTimer> fired;
+      wheel.expire(now, fired);
+      for (std::vector<SimTimer>::iterator i = fired.begin(); i != fired.end(); ++i)
+      {
+         assert(i->getWhen() <= now);
+         assert(!heap.empty() && heap.top().getWhen() <= now);
+         heap.pop();
+      }
+      // nothing that is due may be left behind
+      assert(heap.empty() || heap.top().getWhen() > now);
+   }
+
+   // jump far ahead; everything including the overflow timer fires
+   std::vector<SimTimer> fired;
+   wheel.expire(now + (UInt64(1) << 34), fired);
+   assert(fired.size() == heap.size());
+   assert(wheel.empty());
+
+   wheel.push(SimTimer(now + (UInt64(1) << 40), tid));
+   wheel.push(SimTimer(now + 1000, tid));
+   std::vector<SimTimer> drained;
+   wheel.drain(drained);
+   assert(drained.size() == 2);
+   assert(wheel.empty());
+   cerr << "TimerWheel matches heap" << endl;
+}
+
+static void
+testTransactionTimerQueue()
+{
+   Fifo<TimerMessage> fifo;
+   TransactionTimerQueue timers(fifo);
+   timers.useTimerWheel(true);
+   assert(timers.usingTimerWheel());
+   assert(timers.msTillNextTimer() == INT_MAX);
+
+   timers.add(Timer::TimerA, "first", 50);
+   timers.add(Timer::TimerB, "second", 150);
+   timers.add(Timer::TimerE1, "third", 0);
+   assert(timers.size() == 3);
+   assert(timers.msTillNextTimer() <= 50);
+
+   UInt64 start = Timer::getTimeMs();
+   while (fifo.size() < 3)
+   {
+      assert(Timer::getTimeMs() - start < 2000);
+      timers.process();
+      usleep(1000*resipMin(10U, timers.msTillNextTimer()));
+   }
+   assert(timers.empty());
+   assert(Timer::getTimeMs() - start >= 150);
+
+   delete fifo.getNext();
+   delete fifo.getNext();
+   delete fifo.getNext();
+   cerr << "TransactionTimerQueue with TimerWheel OK" << endl;
+}
+
+/**
+   Steady state with a given number of live transaction timers: every
+   simulated millisecond some timers are added and all that are due are
+   removed. Returns the wall clock time taken in ms.
+*/
+static UInt64
+benchHeap(unsigned int live, unsigned int ticks, size_t& fired)
+{
+   SimHeap heap;
+   unsigned long avg = 0;
+   for (int i = 0; i < NumDurations; ++i) avg += Durations[i];
+   avg /= NumDurations;
+   unsigned int perTick = resipMax(1U, (unsigned int)(live / avg));
+
+   const Data tid("z9hG4bK-74bf9.8d3e9b1c.0");
+   UInt64 sim = Timer::getTimeMs();
+   UInt64 start = Timer::getTimeMs();
+   fired = 0;
+   for (unsigned int t = 0; t < ticks; ++t, ++sim)
+   {
+      for (unsigned int i = 0; i < perTick; ++i)
+      {
+         heap.push(SimTimer(sim + Durations[(t+i) % NumDurations], tid));
+      }
+      while (!heap.empty() && heap.top().getWhen() <= sim)
+      {
+         heap.pop();
+         ++fired;
+      }
+   }
+   return Timer::getTimeMs() - start;
+}
+
+static UInt64
+benchWheel(unsigned int live, unsigned int ticks, size_t& fired)
+{
+   TimerWheel<SimTimer> wheel;
+   unsigned long avg = 0;
+   for (int i = 0; i < NumDurations; ++i) avg += Durations[i];
+   avg /= NumDurations;
+   unsigned int perTick = resipMax(1U, (unsigned int)(live / avg));
+
+   const Data tid("z9hG4bK-74bf9.8d3e9b1c.0");
+   std::vector<SimTimer> expired;
+   UInt64 sim = Timer::getTimeMs();
+   UInt64 start = Timer::getTimeMs();
+   fired = 0;
+   for (unsigned int t = 0; t < ticks; ++t, ++sim)
+   {
+      for (unsigned int i = 0; i < perTick; ++i)
+      {
+         wheel.push(SimTimer(sim + Durations[(t+i) % NumDurations], tid));
+      }
+      wheel.expire(sim, expired);
+      fired += expired.size();
+      expired.clear();
+   }
+   return Timer::getTimeMs() - start;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int live = 100000;
+   unsigned int ticks = 64000;
+   if (argc > 1)
+   {
+      live = atoi(argv[1]);
+   }
+   if (argc > 2)
+   {
+      ticks = atoi(argv[2]);
+   }
+
+   testAgainstHeap();
+   testTransactionTimerQueue();
+
+   size_t heapFired = 0;
+   size_t wheelFired = 0;
+   UInt64 heapMs = benchHeap(live, ticks, heapFired);
+   UInt64 wheelMs = benchWheel(live, ticks, wheelFired);
+   assert(heapFired == wheelFired);
+
+   cout << "~" << live << " live timers, " << ticks << " simulated ms, "
+        << heapFired << " timers fired:" << endl
+        << "  heap:  " << heapMs << " ms" << endl
+        << "  wheel: " << wheelMs << " ms" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,247 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <signal.h>
+#include <vector>
+
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/Uri.hxx"
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "resip/stack/test/TlsTestCertificates.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/SelectInterruptor.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const int Senders = 8;
+static const int MessagesPerSender = 5;
+
+static UInt64
+histogramCount(StackStatistics::Histogram histogram)
+{
+   UInt64 buckets[ThreadStatistics::Buckets];
+   UInt64 count;
+   UInt64 sum;
+   StackStatistics::statistics().getHistogram(histogram, buckets, count, sum);
+   return count;
+}
+
+// Senders TLS transports each open a connection to one receiving transport
+// and send MessagesPerSender requests over it; all of them have to arrive.
+static void
+run(Security& security, int port, unsigned int handshakeThreads)
+{
+   SelectInterruptor interruptor;
+   TlsHandshakePool* pool = handshakeThreads ? new TlsHandshakePool(handshakeThreads, &interruptor) : 0;
+
+   Fifo<TransactionMessage> rxFifo;
+   TlsTransport* receiver = new TlsTransport(rxFifo, port, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23);
+   receiver->setHandshakePool(pool);
+
+   Fifo<TransactionMessage> txFifo;
+   std::vector<TlsTransport*> senders;
+   for (int i = 0; i < Senders; ++i)
+   {
+      senders.push_back(new TlsTransport(txFifo, port + 1 + i, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23));
+      senders.back()->setHandshakePool(pool);
+   }
+
+   UInt64 handshakes = histogramCount(StackStatistics::TlsHandshake);
+   UInt64 queued = histogramCount(StackStatistics::TlsHandshakeQueue);
+
+   NameAddr target;
+   target.uri().scheme() = "sip";
+   target.uri().user() = "fluffy";
+   target.uri().host() = TlsTestCertificates::Domain;
+   target.uri().port() = port;
+   target.uri().param(p_transport) = "tls";
+
+   in_addr in;
+   DnsUtil::inet_pton("127.0.0.1", in);
+   Tuple dest(in, port, TLS);
+   dest.setTargetDomain(TlsTestCertificates::Domain);
+
+   UInt64 start = Timer::getTimeMs();
+   int tid = 1;
+   for (int i = 0; i < Senders; ++i)
+   {
+      for (int m = 0; m < MessagesPerSender; ++m)
+      {
+         NameAddr from(target);
+         from.uri().port() = senders[i]->port();
+         SipMessage* msg = Helper::makeRegister(target, from);
+         msg->header(h_Vias).front().transport() = Tuple::toData(TLS);
+         msg->header(h_Vias).front().sentHost() = "127.0.0.1";
+         msg->header(h_Vias).front().sentPort() = senders[i]->port();
+         Data encoded;
+         {
+            DataStream strm(encoded);
+            msg->encode(strm);
+         }
+         delete msg;
+         std::auto_ptr<SendData> toSend(senders[i]->makeSendData(dest, encoded, Data(tid++), Data::Empty));
+         senders[i]->send(toSend);
+      }
+   }
+
+   int received = 0;
+   while (received < Senders * MessagesPerSender)
+   {
+      assert(Timer::getTimeMs() - start < 20000);
+
+      FdSet fdset;
+      interruptor.buildFdSet(fdset);
+      receiver->buildFdSet(fdset);
+      for (int i = 0; i < Senders; ++i)
+      {
+         senders[i]->buildFdSet(fdset);
+      }
+      fdset.selectMilliSeconds(100);
+
+      interruptor.process(fdset);
+      receiver->process(fdset);
+      for (int i = 0; i < Senders; ++i)
+      {
+         senders[i]->process(fdset);
+      }
+
+      while (rxFifo.messageAvailable())
+      {
+         Message* msg = rxFifo.getNext();
+         if (dynamic_cast<SipMessage*>(msg))
+         {
+            ++received;
+         }
+         delete msg;
+      }
+      while (txFifo.messageAvailable())
+      {
+         delete txFifo.getNext();
+      }
+   }
+
+   cout << handshakeThreads << " handshake threads: " << received << " requests over "
+        << Senders << " connections in " << Timer::getTimeMs() - start << " ms" << endl;
+
+   // both ends of every connection
+   assert(histogramCount(StackStatistics::TlsHandshake) - handshakes == 2 * Senders);
+   if (pool)
+   {
+      assert(histogramCount(StackStatistics::TlsHandshakeQueue) > queued);
+      assert(pool->getQueueDepth() == 0);
+   }
+   else
+   {
+      assert(histogramCount(StackStatistics::TlsHandshakeQueue) == queued);
+   }
+
+   // the connections go with their transports, and must be gone from the
+   // pool before it is
+   for (int i = 0; i < Senders; ++i)
+   {
+      delete senders[i];
+   }
+   delete receiver;
+   delete pool;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef _WIN32
+   if ( signal( SIGPIPE, SIG_IGN) == SIG_ERR)
+   {
+      cerr << "Couldn't install signal handler for SIGPIPE" << endl;
+      exit(-1);
+   }
+#endif
+
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   TlsTestCertificates certificates("testTlsHandshakePool");
+   if (certificates.directory().empty())
+   {
+      cerr << "Couldn't create a directory for the certificates" << endl;
+      return -1;
+   }
+
+   {
+      Security security(certificates.directory());
+      security.preload();
+
+      int port = 26060 + (rand() & 0x0fff);
+      run(security, port, 0);
+      run(security, port + 2 * Senders, 2);
+      run(security, port + 4 * Senders, 1);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000-2005 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
+
+// vim: softtabstop=3:shiftwidth=3:expandtab
@@ -0,0 +1,242 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/Uri.hxx"
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsSessionCache.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "resip/stack/test/TlsTestCertificates.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const int Connections = 4;
+
+static UInt64
+counter(StackStatistics::Counter counter)
+{
+   return StackStatistics::statistics().getCounter(counter);
+}
+
+// Opens a new connection from a new transport at port to receiver, sends a
+// request over it and closes it again once the request has arrived.
+static void
+connectOnce(Security& security, TlsTransport* receiver, Fifo<TransactionMessage>& rxFifo,
+            int port, TlsSessionCache* clientCache)
+{
+   Fifo<TransactionMessage> txFifo;
+   TlsTransport* sender = new TlsTransport(txFifo, port, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23);
+   sender->setSessionCache(clientCache);
+
+   NameAddr target;
+   target.uri().scheme() = "sip";
+   target.uri().user() = "fluffy";
+   target.uri().host() = TlsTestCertificates::Domain;
+   target.uri().port() = receiver->port();
+   target.uri().param(p_transport) = "tls";
+   NameAddr from(target);
+   from.uri().port() = port;
+
+   SipMessage* msg = Helper::makeRegister(target, from);
+   msg->header(h_Vias).front().transport() = Tuple::toData(TLS);
+   msg->header(h_Vias).front().sentHost() = "127.0.0.1";
+   msg->header(h_Vias).front().sentPort() = port;
+   Data encoded;
+   {
+      DataStream strm(encoded);
+      msg->encode(strm);
+   }
+   delete msg;
+
+   in_addr in;
+   DnsUtil::inet_pton("127.0.0.1", in);
+   Tuple dest(in, receiver->port(), TLS);
+   dest.setTargetDomain(TlsTestCertificates::Domain);
+   std::auto_ptr<SendData> toSend(sender->makeSendData(dest, encoded, Data(port), Data::Empty));
+   sender->send(toSend);
+
+   UInt64 start = Timer::getTimeMs();
+   UInt64 receivedAt = 0;
+   // TLS 1.3 servers send the session after the handshake, so wait a little
+   // for it to reach the client once the request is in
+   while (!receivedAt || Timer::getTimeMs() - receivedAt < 200)
+   {
+      assert(Timer::getTimeMs() - start < 20000);
+
+      FdSet fdset;
+      receiver->buildFdSet(fdset);
+      sender->buildFdSet(fdset);
+      fdset.selectMilliSeconds(50);
+      receiver->process(fdset);
+      sender->process(fdset);
+
+      while (rxFifo.messageAvailable())
+      {
+         Message* m = rxFifo.getNext();
+         if (dynamic_cast<SipMessage*>(m))
+         {
+            receivedAt = Timer::getTimeMs();
+         }
+         delete m;
+      }
+      while (txFifo.messageAvailable())
+      {
+         delete txFifo.getNext();
+      }
+   }
+
+   delete sender;
+}
+
+// Connects Connections times, one after the other, to a receiving
+// transport; with a cache, all but the first connection should resume a
+// session.
+static void
+run(Security& security, int port, unsigned int cacheSize, bool tickets)
+{
+   TlsSessionCache* serverCache = cacheSize ? new TlsSessionCache(cacheSize, tickets) : 0;
+   TlsSessionCache* clientCache = cacheSize ? new TlsSessionCache(cacheSize, tickets) : 0;
+
+   Fifo<TransactionMessage> rxFifo;
+   TlsTransport* receiver = new TlsTransport(rxFifo, port, V4, "127.0.0.1", security, TlsTestCertificates::Domain, SecurityTypes::SSLv23);
+   receiver->setSessionCache(serverCache);
+
+   UInt64 full = counter(StackStatistics::TlsSessionsFull);
+   UInt64 resumed = counter(StackStatistics::TlsSessionsResumed);
+
+   UInt64 start = Timer::getTimeMs();
+   for (int i = 0; i < Connections; ++i)
+   {
+      connectOnce(security, receiver, rxFifo, port + 1 + i, clientCache);
+   }
+
+   full = counter(StackStatistics::TlsSessionsFull) - full;
+   resumed = counter(StackStatistics::TlsSessionsResumed) - resumed;
+   cout << "cache " << cacheSize << (tickets ? " with" : " without") << " tickets: "
+        << full << " full and " << resumed << " resumed handshakes in "
+        << Timer::getTimeMs() - start << " ms" << endl;
+
+   // both ends of every connection
+   if (cacheSize)
+   {
+      assert(full == 2);
+      assert(resumed == 2 * (Connections - 1));
+      assert(clientCache->getClientSessions() == 1);
+      if (!tickets)
+      {
+         assert(serverCache->getServerSessions() > 0);
+      }
+   }
+   else
+   {
+      assert(full == 2 * Connections);
+      assert(resumed == 0);
+   }
+
+   delete receiver;
+   delete clientCache;
+   delete serverCache;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef _WIN32
+   if ( signal( SIGPIPE, SIG_IGN) == SIG_ERR)
+   {
+      cerr << "Couldn't install signal handler for SIGPIPE" << endl;
+      exit(-1);
+   }
+#endif
+
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   TlsTestCertificates certificates("testTlsSessionCache");
+   if (certificates.directory().empty())
+   {
+      cerr << "Couldn't create a directory for the certificates" << endl;
+      return -1;
+   }
+
+   {
+      Security security(certificates.directory());
+      security.preload();
+
+      int port = 26060 + (rand() & 0x0fff);
+      run(security, port, 0, false);
+      run(security, port + 2 * Connections, 16, false);
+      run(security, port + 4 * Connections, 16, true);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000-2005 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
+
+// vim: softtabstop=3:shiftwidth=3:expandtab
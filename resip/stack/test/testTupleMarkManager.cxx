@@ -0,0 +1,252 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/MarkListener.hxx"
+#include "resip/stack/TupleMarkManager.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+#ifdef WIN32
+#include <windows.h>
+#define usleep(x) Sleep(x/1000)
+#else
+#include <unistd.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+class CountingListener : public MarkListener
+{
+   public:
+      CountingListener() : mMarks(0), mOks(0), mBatches(0) {}
+
+      virtual void onMark(const Tuple& target, UInt64& expiry, TupleMarkManager::MarkType& mark)
+      {
+         if (mark == TupleMarkManager::OK)
+         {
+            ++mOks;
+         }
+         else
+         {
+            ++mMarks;
+         }
+      }
+
+      virtual void onExpired(const std::vector<Tuple>& targets)
+      {
+         ++mBatches;
+         MarkListener::onExpired(targets);
+      }
+
+      int mMarks;
+      int mOks;
+      int mBatches;
+};
+
+static Tuple
+gateway(int i, const Data& domain = Data::Empty)
+{
+   Data address("10.");
+   address += Data(i / 65536 % 256) + "." + Data(i / 256 % 256) + "." + Data(i % 256);
+   return Tuple(address, 5060, V4, UDP, domain);
+}
+
+static void
+testMarks()
+{
+   TupleMarkManager marks;
+   CountingListener listener;
+   marks.registerMarkListener(&listener);
+   UInt64 now = Timer::getTimeMs();
+
+   assert(marks.getMarkType(gateway(1)) == TupleMarkManager::OK);
+
+   marks.mark(gateway(1), now + 60000, TupleMarkManager::BLACK);
+   marks.mark(gateway(2), now + 60000, TupleMarkManager::GREY);
+   assert(marks.size() == 2);
+   assert(listener.mMarks == 2);
+   assert(marks.getMarkType(gateway(1)) == TupleMarkManager::BLACK);
+   assert(marks.getMarkType(gateway(2)) == TupleMarkManager::GREY);
+   assert(marks.getMarkType(gateway(3)) == TupleMarkManager::OK);
+
+   // the target domain is part of the key
+   assert(marks.getMarkType(gateway(1, "example.com")) == TupleMarkManager::OK);
+   marks.mark(gateway(1, "example.com"), now + 60000, TupleMarkManager::GREY);
+   assert(marks.getMarkType(gateway(1, "example.com")) == TupleMarkManager::GREY);
+   assert(marks.getMarkType(gateway(1)) == TupleMarkManager::BLACK);
+   assert(marks.size() == 3);
+
+   // marking again replaces the mark
+   marks.mark(gateway(2), now + 60000, TupleMarkManager::BLACK);
+   assert(marks.getMarkType(gateway(2)) == TupleMarkManager::BLACK);
+   assert(marks.size() == 3);
+
+   marks.unregisterMarkListener(&listener);
+}
+
+static void
+testExpiry()
+{
+   TupleMarkManager marks;
+   CountingListener listener;
+   marks.registerMarkListener(&listener);
+   UInt64 now = Timer::getTimeMs();
+
+   for (int i = 0; i < 100; ++i)
+   {
+      marks.mark(gateway(i), now + 50, TupleMarkManager::BLACK);
+   }
+   marks.mark(gateway(1000), now + 60000, TupleMarkManager::BLACK);
+   // shortened and extended marks expire at their latest expiry
+   marks.mark(gateway(1), now + 60000, TupleMarkManager::GREY);
+   assert(marks.size() == 101);
+
+   usleep(100*1000);
+   // expired marks read as OK before they are removed
+   assert(marks.getMarkType(gateway(0)) == TupleMarkManager::OK);
+   assert(marks.getMarkType(gateway(1)) == TupleMarkManager::GREY);
+   assert(marks.size() == 101);
+
+   marks.expire();
+   assert(marks.size() == 2);
+   assert(listener.mBatches == 1);
+   assert(listener.mOks == 99);
+   assert(marks.getMarkType(gateway(1)) == TupleMarkManager::GREY);
+   assert(marks.getMarkType(gateway(1000)) == TupleMarkManager::BLACK);
+
+   marks.unregisterMarkListener(&listener);
+}
+
+class Reader : public ThreadIf
+{
+   public:
+      Reader(TupleMarkManager& marks, int gateways) :
+         mMarks(marks), mGateways(gateways), mLookups(0), mBlack(0) {}
+
+      virtual void thread()
+      {
+         vector<Tuple> targets;
+         for (int i = 0; i < mGateways; ++i)
+         {
+            targets.push_back(gateway(i));
+         }
+         while (!isShutdown())
+         {
+            for (int i = 0; i < mGateways; ++i)
+            {
+               TupleMarkManager::MarkType mark = mMarks.getMarkType(targets[i]);
+               assert(mark == TupleMarkManager::OK || mark == TupleMarkManager::BLACK);
+               if (mark == TupleMarkManager::BLACK)
+               {
+                  ++mBlack;
+               }
+            }
+            mLookups += mGateways;
+         }
+      }
+
+      TupleMarkManager& mMarks;
+      int mGateways;
+      UInt64 mLookups;
+      UInt64 mBlack;
+};
+
+static void
+testConcurrentReaders()
+{
+   const int gateways = 5000;
+   TupleMarkManager marks;
+   Reader reader1(marks, gateways);
+   Reader reader2(marks, gateways);
+   reader1.run();
+   reader2.run();
+
+   // keep re-marking and expiring while the readers look
+   UInt64 start = Timer::getTimeMs();
+   int round = 0;
+   while (Timer::getTimeMs() - start < 2000)
+   {
+      UInt64 now = Timer::getTimeMs();
+      for (int i = round % 2; i < gateways; i += 2)
+      {
+         marks.mark(gateway(i), now + 10 + i % 20, TupleMarkManager::BLACK);
+      }
+      marks.expire();
+      usleep(1000);
+      ++round;
+   }
+
+   reader1.shutdown();
+   reader2.shutdown();
+   reader1.join();
+   reader2.join();
+   assert(reader1.mBlack > 0);
+
+   UInt64 lookups = reader1.mLookups + reader2.mLookups;
+   cerr << gateways << " gateways, " << round << " marking rounds: "
+        << lookups / 2000 << " lookups/ms from 2 reader threads" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   testMarks();
+   testExpiry();
+   testConcurrentReaders();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
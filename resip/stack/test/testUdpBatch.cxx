@@ -0,0 +1,193 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <iostream>
+
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/StackStatistics.hxx"
+#include "resip/stack/Transport.hxx"
+#include "resip/stack/UdpTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+/*
+   Sends a burst of requests between two UdpTransports in BATCHIO mode
+   (recvmmsg/sendmmsg) over the loopback interface and checks that all of
+   them arrive, parsed, and that they moved in batches.
+*/
+
+static const unsigned int BatchSize = 8;
+static const unsigned int Burst = 50;
+
+static UInt64
+counter(StackStatistics::Counter c)
+{
+   return StackStatistics::statistics().getCounter(c);
+}
+
+static UInt64
+histogramCount(StackStatistics::Histogram h)
+{
+   UInt64 buckets[ThreadStatistics::Buckets];
+   UInt64 count;
+   UInt64 sum;
+   StackStatistics::statistics().getHistogram(h, buckets, count, sum);
+   return count;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   Fifo<TransactionMessage> txFifo;
+   UdpTransport sender(txFifo, 0, V4, StunDisabled, "127.0.0.1", 0, Compression::Disabled,
+                       RESIP_TRANSPORT_FLAG_BATCHIO|RESIP_TRANSPORT_FLAG_TXALL);
+   sender.setBatchSize(BatchSize);
+
+   Fifo<TransactionMessage> rxFifo;
+   UdpTransport receiver(rxFifo, 0, V4, StunDisabled, "127.0.0.1", 0, Compression::Disabled,
+                         RESIP_TRANSPORT_FLAG_BATCHIO);
+   receiver.setBatchSize(BatchSize);
+   assert(receiver.getBatchSize() == BatchSize);
+
+   in_addr loopback;
+   DnsUtil::inet_pton("127.0.0.1", loopback);
+   Tuple dest(loopback, receiver.port(), UDP);
+
+   NameAddr target;
+   target.uri().scheme() = "sip";
+   target.uri().user() = "batch";
+   target.uri().host() = "127.0.0.1";
+   target.uri().port() = receiver.port();
+   NameAddr from(target);
+   from.uri().port() = sender.port();
+
+   for (unsigned int i = 0; i < Burst; ++i)
+   {
+      auto_ptr<SipMessage> msg(Helper::makeRegister(target, from));
+      // normally filled in by the TransportSelector
+      Via& via = msg->header(h_Vias).front();
+      via.transport() = "UDP";
+      via.sentHost() = "127.0.0.1";
+      via.sentPort() = sender.port();
+      Data encoded;
+      {
+         DataStream strm(encoded);
+         msg->encode(strm);
+      }
+      auto_ptr<SendData> toSend(sender.makeSendData(dest, encoded, Data(i), Data::Empty));
+      // as TransportSelector does, so that the send is timed
+      toSend->encodeStart = Timer::getTimeMicroSec();
+      sender.send(toSend);
+   }
+
+   // with TXALL the whole burst goes out on the first writable event
+   unsigned int received = 0;
+   UInt64 end = Timer::getTimeMs() + 5000;
+   while (received < Burst && Timer::getTimeMs() < end)
+   {
+      FdSet fdset;
+      sender.buildFdSet(fdset);
+      receiver.buildFdSet(fdset);
+      fdset.selectMilliSeconds(100);
+      sender.process(fdset);
+      receiver.process(fdset);
+
+      while (rxFifo.messageAvailable())
+      {
+         auto_ptr<TransactionMessage> msg(rxFifo.getNext());
+         SipMessage* sip = dynamic_cast<SipMessage*>(msg.get());
+         if (sip)
+         {
+            assert(sip->isRequest());
+            assert(sip->method() == REGISTER);
+            assert(sip->header(h_To).uri().user() == "batch");
+            ++received;
+         }
+      }
+   }
+   cout << "received " << received << " of " << Burst << endl;
+   assert(received == Burst);
+
+   // every datagram sent is timed, batched or not
+   assert(histogramCount(StackStatistics::Transmit) == Burst);
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+   cout << "tx batches " << counter(StackStatistics::UdpTxBatches)
+        << " (" << counter(StackStatistics::UdpTxBatchesFull) << " full), "
+        << "rx batches " << counter(StackStatistics::UdpRxBatches)
+        << " (" << counter(StackStatistics::UdpRxBatchesFull) << " full)" << endl;
+
+   assert(counter(StackStatistics::UdpTxBatchDatagrams) == Burst);
+   assert(counter(StackStatistics::UdpTxBatches) == (Burst + BatchSize - 1) / BatchSize);
+   assert(counter(StackStatistics::UdpTxBatchesFull) == Burst / BatchSize);
+   assert(counter(StackStatistics::UdpRxBatchDatagrams) == Burst);
+   assert(counter(StackStatistics::UdpRxBatches) >= (Burst + BatchSize - 1) / BatchSize);
+   assert(counter(StackStatistics::UdpRxBatches) < Burst);
+#else
+   cout << "recvmmsg/sendmmsg not available, checked the unbatched fallback" << endl;
+#endif
+
+   cout << "PASSED" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
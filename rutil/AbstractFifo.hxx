@@ -8,6 +8,7 @@
 #include "rutil/Condition.hxx"
 #include "rutil/Lock.hxx"
 #include "rutil/CongestionManager.hxx"
+#include "rutil/MpscQueue.hxx"
 
 #include "rutil/compat.hxx"
 #include "rutil/Timer.hxx"
@@ -110,12 +111,31 @@ class FifoStatsInterface
 #define RESIP_FIFO_NOWAIT	-1
 #define RESIP_FIFO_FOREVER	0
 
+/**
+   How an AbstractFifo synchronizes its producers and consumers.
+   - FifoLocking: a std::deque guarded by a Mutex. Any number of threads may
+     add and get concurrently. This is the default.
+   - FifoLockFreeMpsc: producers append to a lock-free list with a single
+     atomic exchange and never touch the mutex unless the consumer is
+     asleep. Only ONE thread may ever consume (getNext()/getMultiple()/
+     clear()); use this for fifos with a single dedicated consumer, such
+     as the TransactionController's state machine fifo. Falls back to
+     FifoLocking on compilers without RESIP_HAVE_MPSC_QUEUE.
+*/
+typedef enum
+{
+   FifoLocking,
+   FifoLockFreeMpsc
+} FifoMode;
+
 /**
    @brief The base class from which various templated Fifo classes are derived.
 
    (aka template hoist) 
    AbstractFifo's get operations are all threadsafe; AbstractFifo does not 
-   define any put operations (these are defined in subclasses).
+   define any put operations (these are defined in subclasses). In 
+   FifoLockFreeMpsc mode the get operations must all be called from the
+   same thread.
    @note Users of the resip stack will not need to interact with this class 
       directly in most cases. Look at Fifo and TimeLimitFifo instead.
 
@@ -127,18 +147,35 @@ class AbstractFifo : public FifoStatsInterface
    public:
      /** 
       * @brief Constructor
-      * @param maxSize max number of messages to keep
+      * @param mode whether this fifo may be consumed by more than one thread
+      * @see FifoMode
       **/
-      AbstractFifo()
+      AbstractFifo(FifoMode mode=FifoLocking)
          : FifoStatsInterface(),
             mLastSampleTakenMicroSec(0),
             mCounter(0),
             mAverageServiceTimeMicroSec(0),
-            mSize(0)
-      {}
+            mSize(0),
+            mMpsc(0),
+            mConsumerWaiting(0)
+      {
+#ifdef RESIP_HAVE_MPSC_QUEUE
+         if(mode == FifoLockFreeMpsc)
+         {
+            mMpsc = new MpscQueue<T>;
+         }
+#endif
+      }
 
       virtual ~AbstractFifo()
       {
+         delete mMpsc;
+      }
+
+      /// @return the mode this fifo actually runs in
+      FifoMode getMode() const
+      {
+         return mMpsc ? FifoLockFreeMpsc : FifoLocking;
       }
 
       /** 
@@ -147,6 +184,10 @@ class AbstractFifo : public FifoStatsInterface
        **/
       bool empty() const
       {
+         if(mMpsc)
+         {
+            return sizeLockFree() == 0;
+         }
          Lock lock(mMutex); (void)lock;
          return mFifo.empty();
       }
@@ -160,6 +201,10 @@ class AbstractFifo : public FifoStatsInterface
        */
       virtual unsigned int size() const
       {
+         if(mMpsc)
+         {
+            return sizeLockFree();
+         }
          Lock lock(mMutex); (void)lock;
          return (unsigned int)mFifo.size();
       }
@@ -171,6 +216,10 @@ class AbstractFifo : public FifoStatsInterface
        
       bool messageAvailable() const
       {
+         if(mMpsc)
+         {
+            return sizeLockFree() != 0;
+         }
          Lock lock(mMutex); (void)lock;
          return !mFifo.empty();
       }
@@ -215,6 +264,15 @@ class AbstractFifo : public FifoStatsInterface
        */
       T getNext()
       {
+         if(mMpsc)
+         {
+            onFifoPolled();
+            waitLockFree(RESIP_FIFO_FOREVER);
+            T firstMessage(popLockFree());
+            onMessagePopped();
+            return firstMessage;
+         }
+
          Lock lock(mMutex); (void)lock;
          onFifoPolled();
 
@@ -250,6 +308,18 @@ class AbstractFifo : public FifoStatsInterface
             return true;
          }
 
+         if(mMpsc)
+         {
+            onFifoPolled();
+            if(ms > 0 ? !waitLockFree(ms) : sizeLockFree() == 0)
+            {
+               return false;
+            }
+            toReturn = popLockFree();
+            onMessagePopped();
+            return true;
+         }
+
          if(ms < 0)
          {
             Lock lock(mMutex); (void)lock;
@@ -258,6 +328,7 @@ class AbstractFifo : public FifoStatsInterface
               return false;
             toReturn = mFifo.front();
             mFifo.pop_front();
+            onMessagePopped();
             return true;
          }
 
@@ -301,6 +372,15 @@ class AbstractFifo : public FifoStatsInterface
 
       void getMultiple(Messages& other, unsigned int max)
       {
+         if(mMpsc)
+         {
+            onFifoPolled();
+            assert(other.empty());
+            waitLockFree(RESIP_FIFO_FOREVER);
+            popMultipleLockFree(other, max);
+            return;
+         }
+
          Lock lock(mMutex); (void)lock;
          onFifoPolled();
          assert(other.empty());
@@ -335,6 +415,17 @@ class AbstractFifo : public FifoStatsInterface
          }
 
          assert(other.empty());
+         if(mMpsc)
+         {
+            onFifoPolled();
+            if(ms > 0 ? !waitLockFree(ms) : sizeLockFree() == 0)
+            {
+               return false;
+            }
+            popMultipleLockFree(other, max);
+            return true;
+         }
+
          const UInt64 begin(Timer::getTimeMs());
          const UInt64 end(begin + (unsigned int)(ms)); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
@@ -383,6 +474,14 @@ class AbstractFifo : public FifoStatsInterface
 
       size_t add(const T& item)
       {
+         if(mMpsc)
+         {
+            size_t size = reserveLockFree(1);
+            mMpsc->push(item);
+            wakeLockFree();
+            return size;
+         }
+
          Lock lock(mMutex); (void)lock;
          mFifo.push_back(item);
          mCondition.signal();
@@ -392,6 +491,18 @@ class AbstractFifo : public FifoStatsInterface
 
       size_t addMultiple(Messages& items)
       {
+         if(mMpsc)
+         {
+            size_t size = reserveLockFree((UInt32)items.size());
+            for(typename Messages::const_iterator i=items.begin(); i!=items.end(); ++i)
+            {
+               mMpsc->push(*i);
+            }
+            items.clear();
+            wakeLockFree();
+            return size;
+         }
+
          Lock lock(mMutex); (void)lock;
          size_t size=items.size();
          if(mFifo.empty())
@@ -426,14 +537,118 @@ class AbstractFifo : public FifoStatsInterface
       // std::deque has to perform some amount of traversal to calculate its 
       // size; we maintain this count so that it can be queried without locking, 
       // in situations where it being off by a small amount is ok.
-      UInt32 mSize;
+      // In FifoLockFreeMpsc mode this is the authoritative, atomically 
+      // maintained element count; it is raised before an element is linked 
+      // in and lowered after it has been taken out.
+      volatile UInt32 mSize;
+
+      /** @brief lock-free storage; only set in FifoLockFreeMpsc mode */
+      MpscQueue<T>* mMpsc;
+      /** @brief non-zero while the consumer (may) sleep on mCondition */
+      volatile UInt32 mConsumerWaiting;
+
+      bool emptyInternal() const
+      {
+         return mMpsc ? sizeLockFree() == 0 : mFifo.empty();
+      }
+
+      UInt32 sizeLockFree() const
+      {
+         return MpscAtomic::load(&mSize);
+      }
+
+      /**
+         Counts num new elements in (before they are pushed); returns the new
+         size. Also starts a service time sample when the fifo was empty.
+      */
+      UInt32 reserveLockFree(UInt32 num)
+      {
+         UInt32 size = MpscAtomic::add(&mSize, num);
+         if(size == num && mLastSampleTakenMicroSec == 0)
+         {
+            // Only a statistic; a rare lost update with the consumer is fine
+            mLastSampleTakenMicroSec=Timer::getTimeMicroSec();
+         }
+         return size;
+      }
+
+      /// Wakes the consumer if it went to sleep on an empty fifo.
+      void wakeLockFree()
+      {
+         // Paired with waitLockFree(): either we see mConsumerWaiting set, or
+         // the consumer sees our increment of mSize before going to sleep.
+         if(MpscAtomic::load(&mConsumerWaiting))
+         {
+            Lock lock(mMutex); (void)lock;
+            mCondition.signal();
+         }
+      }
+
+      /**
+         Consumer only. Waits until mSize is non-zero, at most ms milliseconds
+         (or forever if ms is RESIP_FIFO_FOREVER).
+         @return true if there is something to pop
+      */
+      bool waitLockFree(int ms)
+      {
+         if(sizeLockFree() != 0)
+         {
+            return true;
+         }
+
+         const UInt64 end(Timer::getTimeMs() + (unsigned int)(ms));
+         Lock lock(mMutex); (void)lock;
+         MpscAtomic::store(&mConsumerWaiting, 1);
+         while(sizeLockFree() == 0)
+         {
+            if(ms == RESIP_FIFO_FOREVER)
+            {
+               mCondition.wait(mMutex);
+               continue;
+            }
+            const UInt64 now(Timer::getTimeMs());
+            if(now >= end || !mCondition.wait(mMutex, (unsigned int)(end - now)))
+            {
+               break;
+            }
+         }
+         MpscAtomic::store(&mConsumerWaiting, 0);
+         return sizeLockFree() != 0;
+      }
+
+      /**
+         Consumer only, with sizeLockFree() != 0. Takes the oldest element out
+         without adjusting mSize; if its producer has reserved but not yet 
+         linked it, waits for it to show up.
+      */
+      T popLockFree()
+      {
+         const T* front = 0;
+         while((front = mMpsc->front()) == 0)
+         {
+            MpscAtomic::yield();
+         }
+         T item(*front);
+         mMpsc->pop(item);
+         return item;
+      }
+
+      void popMultipleLockFree(Messages& other, unsigned int max)
+      {
+         UInt32 num = resipMin(sizeLockFree(), (UInt32)max);
+         for(UInt32 i=0; i<num; ++i)
+         {
+            other.push_back(popLockFree());
+         }
+         onMessagePopped(num);
+      }
 
       virtual void onFifoPolled()
       {
          // !bwc! TODO allow this sampling frequency to be tweaked
          if(mLastSampleTakenMicroSec &&
             mCounter &&
-            (mCounter >= 64 || mFifo.empty()))
+            (mCounter >= 64 || emptyInternal()))
          {
             UInt64 now(Timer::getTimeMicroSec());
             UInt64 diff = now-mLastSampleTakenMicroSec;
@@ -451,7 +666,7 @@ class AbstractFifo : public FifoStatsInterface
                      4096U);
             }
             mCounter=0;
-            if(mFifo.empty())
+            if(emptyInternal())
             {
                mLastSampleTakenMicroSec=0;
             }
@@ -469,6 +684,11 @@ class AbstractFifo : public FifoStatsInterface
       virtual void onMessagePopped(unsigned int num=1)
       {
          mCounter+=num;
+         if(mMpsc)
+         {
+            MpscAtomic::sub(&mSize, num);
+            return;
+         }
          mSize-=num;
       }
 
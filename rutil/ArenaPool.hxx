@@ -0,0 +1,265 @@
+#ifndef ArenaPool_Include_Guard
+#define ArenaPool_Include_Guard
+
+#include <limits>
+#include <memory>
+#include <stddef.h>
+
+#include "rutil/PoolBase.hxx"
+
+namespace resip
+{
+/**
+   A growing variant of DinkyPool, meant for short-lifetime objects that own
+   a lot of small pieces (ie; a SipMessage and everything parsed out of it).
+   The first S bytes are carved from a buffer inside the ArenaPool itself.
+   Once that is used up, further allocations are carved from heap chunks of
+   C bytes, so a burst of small allocations costs one malloc per chunk
+   rather than one each. Everything is released in one go when the
+   ArenaPool goes away.
+
+   Deallocating does not make room for reuse piecemeal, but the inline
+   buffer and each chunk count what is still live in them. A chunk is
+   freed once everything carved from it has been deallocated (the chunk
+   being carved is rewound instead), and so is the inline buffer, so a
+   long-lived message that keeps re-parsing or being reassigned does not
+   grow without bound. An allocation too big to share a chunk (more than
+   C/4 bytes) gets a chunk of its own which is freed as soon as it is
+   deallocated, so that a growing vector does not leave a trail of
+   abandoned buffers behind.
+*/
+template<unsigned int S, unsigned int C=4096>
+class ArenaPool : public PoolBase
+{
+   public:
+      ArenaPool() :
+         count(0),
+         mBufLive(0),
+         mChunks(0),
+         mLarge(0),
+         mChunkUsed(0),
+         mHeapBytes(0),
+         mChunkCount(0)
+      {}
+
+      ~ArenaPool()
+      {
+         freeList(mChunks);
+         freeList(mLarge);
+      }
+
+      void* allocate(size_t size)
+      {
+         size_t bytes = ((size+7)/8)*8;
+         if((8*count)+size <= S)
+         {
+            void* result=mBuf[count];
+            count+=(size+7)/8;
+            ++mBufLive;
+            return result;
+         }
+
+         if(bytes > C/4)
+         {
+            Chunk* chunk = newChunk(bytes);
+            chunk->mNext = mLarge;
+            mLarge = chunk;
+            return chunk->data();
+         }
+
+         if(mChunks == 0 || mChunkUsed + bytes > mChunks->mSize)
+         {
+            Chunk* chunk = newChunk(C);
+            chunk->mNext = mChunks;
+            mChunks = chunk;
+            mChunkUsed = 0;
+         }
+         void* result = mChunks->data() + mChunkUsed;
+         mChunkUsed += bytes;
+         ++mChunks->mLive;
+         return result;
+      }
+
+      void deallocate(void* ptr)
+      {
+         if(inBuf(ptr))
+         {
+            if(--mBufLive == 0)
+            {
+               count = 0;
+            }
+            return;
+         }
+         for(Chunk** c = &mLarge; *c; c = &(*c)->mNext)
+         {
+            if((*c)->data() == ptr)
+            {
+               Chunk* chunk = *c;
+               *c = chunk->mNext;
+               mHeapBytes -= chunk->mSize;
+               ::operator delete(chunk);
+               return;
+            }
+         }
+         for(Chunk** c = &mChunks; *c; c = &(*c)->mNext)
+         {
+            if(contains(*c, ptr))
+            {
+               Chunk* chunk = *c;
+               if(--chunk->mLive == 0)
+               {
+                  if(chunk == mChunks)
+                  {
+                     mChunkUsed = 0;
+                  }
+                  else
+                  {
+                     *c = chunk->mNext;
+                     mHeapBytes -= chunk->mSize;
+                     ::operator delete(chunk);
+                  }
+               }
+               return;
+            }
+         }
+         // not ours (eg. a ParserContainer clone()d with plain new)
+         ::operator delete(ptr);
+      }
+
+      size_t max_size() const
+      {
+         return std::numeric_limits<size_t>::max();
+      }
+
+      /// true if ptr points into memory handed out by this pool
+      bool owns(const void* ptr) const
+      {
+         return inBuf(ptr) || inList(mChunks, ptr) || inList(mLarge, ptr);
+      }
+
+      size_t getHeapBytes() const { return mHeapBytes; }
+      size_t getPoolBytes() const { return count*8; }
+      size_t getPoolSizeBytes() const { return sizeof(mBuf); }
+      /// number of times this pool has gone to the heap
+      size_t getChunkCount() const { return mChunkCount; }
+
+   private:
+      // disabled
+      ArenaPool& operator=(const ArenaPool& rhs);
+      ArenaPool(const ArenaPool& other);
+
+      // header of a heap chunk; the usable bytes follow it
+      struct Chunk
+      {
+         Chunk* mNext;
+         size_t mSize;
+         size_t mLive; // allocations carved from this chunk not yet deallocated
+         char* data() { return reinterpret_cast<char*>(this) + HeaderSize; }
+         const char* data() const { return reinterpret_cast<const char*>(this) + HeaderSize; }
+      };
+      static const size_t HeaderSize = ((sizeof(Chunk)+7)/8)*8;
+
+      Chunk* newChunk(size_t size)
+      {
+         Chunk* chunk = static_cast<Chunk*>(::operator new(HeaderSize + size));
+         chunk->mNext = 0;
+         chunk->mSize = size;
+         chunk->mLive = 0;
+         mHeapBytes += size;
+         ++mChunkCount;
+         return chunk;
+      }
+
+      static void freeList(Chunk* chunk)
+      {
+         while(chunk)
+         {
+            Chunk* next = chunk->mNext;
+            ::operator delete(chunk);
+            chunk = next;
+         }
+      }
+
+      bool inBuf(const void* ptr) const
+      {
+         return ptr >= (const void*)mBuf[0] && ptr < (const void*)mBuf[(S+7)/8];
+      }
+
+      static bool contains(const Chunk* chunk, const void* ptr)
+      {
+         return ptr >= (const void*)chunk->data() && ptr < (const void*)(chunk->data() + chunk->mSize);
+      }
+
+      static bool inList(const Chunk* chunk, const void* ptr)
+      {
+         for(; chunk; chunk = chunk->mNext)
+         {
+            if(contains(chunk, ptr))
+            {
+               return true;
+            }
+         }
+         return false;
+      }
+
+      size_t count; // 8-byte chunks of mBuf alloced so far
+      size_t mBufLive; // allocations from mBuf not yet deallocated
+      char mBuf[(S+7)/8][8]; // 8-byte chunks for alignment
+      Chunk* mChunks; // shared chunks, newest (the one being carved) first
+      Chunk* mLarge;  // chunks holding a single large allocation
+      size_t mChunkUsed; // bytes carved from mChunks so far
+      size_t mHeapBytes;
+      size_t mChunkCount;
+};
+
+}
+#endif
+
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
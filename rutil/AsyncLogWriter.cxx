@@ -0,0 +1,224 @@
+#include <cassert>
+
+#include "rutil/AsyncLogWriter.hxx"
+#include "rutil/Lock.hxx"
+
+using namespace resip;
+
+// how long the writer sleeps when no buffer is half full
+static const unsigned int FlushIntervalMs = 50;
+
+AsyncLogWriter::AsyncLogWriter(Sink* sink, unsigned int maxBytes) :
+   mSink(sink),
+   mMaxBytes(maxBytes),
+   mKey(0),
+   mBuffers(0),
+   mWakePending(false)
+{
+   int res = ThreadIf::tlsKeyCreate(mKey, 0);
+   assert(res == 0);
+   (void)res;
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+   shutdown();
+   join();
+   drain();
+   ThreadIf::tlsKeyDelete(mKey);
+   Buffer* b = mBuffers;
+   while (b)
+   {
+      Buffer* next = b->mNext;
+      delete b;
+      b = next;
+   }
+}
+
+AsyncLogWriter::Buffer&
+AsyncLogWriter::addBuffer()
+{
+   Buffer* b = new Buffer;
+   {
+      Lock lock(mBuffersMutex);
+      b->mNext = mBuffers;
+      mBuffers = b;
+   }
+   ThreadIf::tlsSetValue(mKey, b);
+   return *b;
+}
+
+void
+AsyncLogWriter::append(const Data& line)
+{
+   Buffer& b = buffer();
+   bool wake;
+   {
+      Lock lock(b.mMutex);
+      if (b.mActive.size() + line.size() + 1 > mMaxBytes)
+      {
+         ++b.mDropped;
+         wake = true;
+      }
+      else
+      {
+         b.mActive.append(line.data(), line.size());
+         b.mActive += '\n';
+         ++b.mLineCount;
+         wake = b.mActive.size() > mMaxBytes / 2;
+      }
+   }
+   if (wake && !mWakePending)
+   {
+      Lock lock(mWakeMutex);
+      mWakePending = true;
+      mWake.signal();
+   }
+}
+
+void
+AsyncLogWriter::flush()
+{
+   drain();
+}
+
+UInt64
+AsyncLogWriter::getDropped() const
+{
+   Buffer* b;
+   {
+      Lock lock(mBuffersMutex);
+      b = mBuffers;
+   }
+   UInt64 dropped = 0;
+   for (; b; b = b->mNext)
+   {
+      Lock lock(b->mMutex);
+      dropped += b->mDropped;
+   }
+   return dropped;
+}
+
+void
+AsyncLogWriter::thread()
+{
+   while (!isShutdown())
+   {
+      {
+         Lock lock(mWakeMutex);
+         if (!mWakePending)
+         {
+            mWake.wait(mWakeMutex, FlushIntervalMs);
+         }
+         mWakePending = false;
+      }
+      drain();
+   }
+   drain();
+}
+
+void
+AsyncLogWriter::shutdown()
+{
+   ThreadIf::shutdown();
+   Lock lock(mWakeMutex);
+   mWakePending = true;
+   mWake.signal();
+}
+
+void
+AsyncLogWriter::drain()
+{
+   Lock drainLock(mDrainMutex);
+
+   // buffers are only ever added at the head, so the rest of the list
+   // can be walked without the lock
+   Buffer* b;
+   {
+      Lock lock(mBuffersMutex);
+      b = mBuffers;
+   }
+
+   for (; b; b = b->mNext)
+   {
+      Data lines;
+      unsigned int lineCount;
+      UInt64 dropped;
+      {
+         Lock lock(b->mMutex);
+         if (b->mActive.empty() && b->mDropped == b->mDroppedReported)
+         {
+            continue;
+         }
+         // swap in the spare buffer, keeping the capacity of both
+         lines.takeBuf(b->mActive);
+         b->mActive.takeBuf(b->mSpare);
+         lineCount = b->mLineCount;
+         b->mLineCount = 0;
+         dropped = b->mDropped;
+      }
+
+      if (dropped != b->mDroppedReported)
+      {
+         lines += "Log buffer full, dropped ";
+         lines += Data(dropped - b->mDroppedReported);
+         lines += " lines\n";
+         ++lineCount;
+         b->mDroppedReported = dropped;
+      }
+
+      mSink(lines, lineCount);
+      lines.clear();
+      b->mSpare.takeBuf(lines);
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,148 @@
+#if !defined(RESIP_ASYNCLOGWRITER_HXX)
+#define RESIP_ASYNCLOGWRITER_HXX
+
+#include "rutil/compat.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Collects log lines from any number of threads and hands them,
+   in batches, to a sink running on a thread of its own.
+
+   Each thread that appends gets its own pair of buffers. append() copies
+   the line into the thread's active buffer under a mutex that only that
+   thread and the writer ever take; the writer swaps the active buffer
+   with the spare one and passes the full one to the sink with no lock
+   held, so a thread never waits for I/O. Lines from one thread stay in
+   order; lines from different threads are only ordered batch by batch.
+
+   A thread's buffer holds at most maxBytes. Lines that do not fit are
+   dropped and counted; the writer reports the count as a line of its own
+   after the lines that were kept.
+
+   Thread buffers live until the AsyncLogWriter is destroyed.
+*/
+class AsyncLogWriter : public ThreadIf
+{
+   public:
+      /// Called on the writer thread with newline terminated lines.
+      typedef void Sink(const Data& lines, unsigned int lineCount);
+
+      AsyncLogWriter(Sink* sink, unsigned int maxBytes);
+      virtual ~AsyncLogWriter();
+
+      /// Queues line (without a newline) for the writer thread.
+      void append(const Data& line);
+
+      /// Writes everything appended so far before returning.
+      void flush();
+
+      void setMaxBytes(unsigned int maxBytes) { mMaxBytes = maxBytes; }
+      unsigned int getMaxBytes() const { return mMaxBytes; }
+
+      /// Lines dropped because their thread's buffer was full.
+      UInt64 getDropped() const;
+
+      virtual void thread();
+      virtual void shutdown();
+
+   private:
+      struct Buffer
+      {
+         Buffer() : mLineCount(0), mDropped(0), mDroppedReported(0), mNext(0) {}
+
+         Mutex mMutex;
+         Data mActive; // appended to by the owning thread
+         unsigned int mLineCount;
+         UInt64 mDropped;
+
+         Data mSpare; // only touched by whoever holds mDrainMutex
+         UInt64 mDroppedReported;
+         Buffer* mNext;
+      };
+
+      Buffer& buffer()
+      {
+         Buffer* b = static_cast<Buffer*>(ThreadIf::tlsGetValue(mKey));
+         return b ? *b : addBuffer();
+      }
+      Buffer& addBuffer();
+
+      void drain();
+
+      Sink* mSink;
+      volatile unsigned int mMaxBytes;
+      ThreadIf::TlsKey mKey;
+
+      mutable Mutex mBuffersMutex;
+      Buffer* mBuffers;
+
+      Mutex mDrainMutex;
+
+      Mutex mWakeMutex;
+      Condition mWake;
+      volatile bool mWakePending;
+
+      // disabled
+      AsyncLogWriter(const AsyncLogWriter&);
+      AsyncLogWriter& operator=(const AsyncLogWriter&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
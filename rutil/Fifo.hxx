@@ -10,12 +10,15 @@ namespace resip
 
 /**
    @brief A templated, threadsafe message-queue class.
+
+   Pass FifoLockFreeMpsc to the constructor for a fifo that is only ever
+   consumed by a single thread; producers then do not contend on a mutex.
 */
 template < class Msg >
 class Fifo : public AbstractFifo<Msg*>
 {
    public:
-      Fifo(AsyncProcessHandler* interruptor=0);
+      Fifo(AsyncProcessHandler* interruptor=0, FifoMode mode=FifoLocking);
       virtual ~Fifo();
       
       using AbstractFifo<Msg*>::mFifo;
@@ -63,8 +66,8 @@ class Fifo : public AbstractFifo<Msg*>
 
 
 template <class Msg>
-Fifo<Msg>::Fifo(AsyncProcessHandler* interruptor) : 
-   AbstractFifo<Msg*>(),
+Fifo<Msg>::Fifo(AsyncProcessHandler* interruptor, FifoMode mode) : 
+   AbstractFifo<Msg*>(mode),
    mInterruptor(interruptor)
 {
 }
@@ -88,6 +91,16 @@ template <class Msg>
 void
 Fifo<Msg>::clear()
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      Msg* msg(0);
+      while(AbstractFifo<Msg*>::getNext(RESIP_FIFO_NOWAIT, msg))
+      {
+         delete msg;
+      }
+      return;
+   }
+
    Lock lock(mMutex); (void)lock;
    while ( ! mFifo.empty() )
    {
@@ -13,8 +13,10 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "rutil/AsyncLogWriter.hxx"
 #include "rutil/Log.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/MpscQueue.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Subsystem.hxx"
@@ -40,6 +42,9 @@ pid_t Log::mPid=0;
 
 volatile short Log::touchCount = 0;
 
+AsyncLogWriter* Log::mAsyncWriter = 0;
+AsyncLogWriter* Log::mAsyncWriterStorage = 0;
+
 
 /// DEPRECATED! Left for backward compatibility - use localLoggers instead
 #ifdef LOG_ENABLE_THREAD_SETTING
@@ -231,6 +236,9 @@ Log::initialize(Type type, Level level, const Data& appName,
                 ExternalLogger* externalLogger,
                 const Data& syslogFacilityName)
 {
+   // lines already queued go where they were logged to
+   flush();
+
    Lock lock(_mutex);
    mDefaultLoggerData.reset();   
    
@@ -709,6 +717,86 @@ int Log::setThreadLocalLogger(Log::LocalLoggerId loggerId)
    return (loggerId == 0) || (pData != NULL)?0:1;
 }
 
+void
+Log::setAsynchronous(unsigned int maxBytesPerThread)
+{
+   AsyncLogWriter* writer;
+   {
+      Lock lock(_mutex);
+      if (maxBytesPerThread && !mAsyncWriterStorage)
+      {
+         mAsyncWriterStorage = new AsyncLogWriter(writeBuffered, maxBytesPerThread);
+         mAsyncWriterStorage->run();
+         // write what is left before mDefaultLoggerData goes away
+         atexit(stopAsynchronous);
+      }
+      writer = mAsyncWriterStorage;
+   }
+
+   if (maxBytesPerThread)
+   {
+      writer->setMaxBytes(maxBytesPerThread);
+      MpscAtomic::storePtr(&mAsyncWriter, writer);
+   }
+   else if (writer)
+   {
+      MpscAtomic::storePtr(&mAsyncWriter, (AsyncLogWriter*)0);
+      writer->flush();
+   }
+}
+
+bool
+Log::isAsynchronous()
+{
+   return MpscAtomic::loadPtr(&mAsyncWriter) != 0;
+}
+
+UInt64
+Log::getDroppedLines()
+{
+   Lock lock(_mutex);
+   return mAsyncWriterStorage ? mAsyncWriterStorage->getDropped() : 0;
+}
+
+void
+Log::flush()
+{
+   AsyncLogWriter* writer = MpscAtomic::loadPtr(&mAsyncWriter);
+   if (writer)
+   {
+      writer->flush();
+   }
+}
+
+void
+Log::writeBuffered(const Data& lines, unsigned int lineCount)
+{
+   Lock lock(_mutex);
+   std::ostream& strm = mDefaultLoggerData.Instance((unsigned int)lines.size());
+   // Instance() counted one line
+   mDefaultLoggerData.mLineCount += lineCount - 1;
+   strm.write(lines.data(), lines.size());
+   strm.flush();
+}
+
+void
+Log::stopAsynchronous()
+{
+   AsyncLogWriter* writer;
+   {
+      Lock lock(_mutex);
+      writer = mAsyncWriterStorage;
+   }
+   if (writer)
+   {
+      MpscAtomic::storePtr(&mAsyncWriter, (AsyncLogWriter*)0);
+      // not deleted: a thread may still be appending to it
+      writer->shutdown();
+      writer->join();
+      writer->flush();
+   }
+}
+
 std::ostream&
 Log::Instance(unsigned int bytesToWrite)
 {
@@ -891,6 +979,18 @@ Log::Guard::~Guard()
       return;
    }
 
+   if (logType == resip::Log::Cout ||
+       logType == resip::Log::Cerr ||
+       logType == resip::Log::File)
+   {
+      AsyncLogWriter* writer = MpscAtomic::loadPtr(&mAsyncWriter);
+      if (writer && &resip::Log::getLoggerData() == &mDefaultLoggerData)
+      {
+         writer->append(mData);
+         return;
+      }
+   }
+
    resip::Lock lock(resip::Log::_mutex);
    // !dlb! implement VSDebugWindow as an external logger
    if (logType == resip::Log::VSDebugWindow)
@@ -42,6 +42,7 @@ extern "C"
 namespace resip
 {
 
+class AsyncLogWriter;
 class ExternalLogger;
 class Subsystem;
 
@@ -255,6 +256,21 @@ class Log
       static int setThreadLocalLogger(LocalLoggerId loggerId);
 
 
+      /**
+         Writes the lines of the default logger (Cout, Cerr and File types)
+         from a background thread, so threads that log do not wait for the
+         output; see AsyncLogWriter. Each logging thread buffers up to
+         maxBytesPerThread bytes, lines that do not fit are dropped. 0 goes
+         back to writing synchronously. Threads with a local logger always
+         write synchronously.
+      */
+      static void setAsynchronous(unsigned int maxBytesPerThread);
+      static bool isAsynchronous();
+      /// Lines dropped because an asynchronous buffer was full.
+      static UInt64 getDroppedLines();
+      /// Returns once everything logged asynchronously so far is written.
+      static void flush();
+
       static std::ostream& Instance(unsigned int bytesToWrite);
       static bool isLogging(Log::Level level, const Subsystem&);
       static void OutputToWin32DebugWindow(const Data& result);      
@@ -326,6 +342,7 @@ class Log
 
          protected:
             friend class Guard;
+            friend class Log;
             const LocalLoggerId mId;
             Type mType;
             Data mLogFileName;
@@ -344,6 +361,11 @@ class Log
 #endif
       static const char mDescriptions[][32];
 
+      static AsyncLogWriter* mAsyncWriter; ///< 0 unless logging asynchronously
+      static AsyncLogWriter* mAsyncWriterStorage; ///< created on first use
+      static void writeBuffered(const Data& lines, unsigned int lineCount);
+      static void stopAsynchronous();
+
       static ThreadData &getLoggerData()
       {
          ThreadData* pData = static_cast<ThreadData*>(ThreadIf::tlsGetValue(*Log::mLocalLoggerKey));
@@ -0,0 +1,284 @@
+#if !defined(RESIP_MPSCQUEUE_HXX)
+#define RESIP_MPSCQUEUE_HXX
+
+#include <cassert>
+
+#include "rutil/compat.hxx"
+
+#if defined(WIN32)
+#  include <windows.h>
+#else
+#  include <sched.h>
+#endif
+
+#if defined(__GNUC__) || defined(_MSC_VER)
+/// Defined when MpscQueue (and with it AbstractFifo's FifoLockFreeMpsc mode)
+/// is usable with this compiler.
+#define RESIP_HAVE_MPSC_QUEUE 1
+#endif
+
+namespace resip
+{
+
+/**
+   @internal
+   @brief The handful of atomic operations MpscQueue and AbstractFifo need.
+
+   All of them are sequentially consistent, except storePtr() (release) and
+   loadPtr() (acquire). Without RESIP_HAVE_MPSC_QUEUE these are plain memory
+   accesses, just good enough to compile; nothing may use them then.
+*/
+struct MpscAtomic
+{
+#if defined(__GNUC__)
+   template <typename P>
+   static P* exchange(P** target, P* value)
+   {
+      return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+   }
+   static UInt32 add(volatile UInt32* target, UInt32 value)
+   {
+      return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+   }
+   static UInt32 sub(volatile UInt32* target, UInt32 value)
+   {
+      return __atomic_sub_fetch(target, value, __ATOMIC_SEQ_CST);
+   }
+   static void store(volatile UInt32* target, UInt32 value)
+   {
+      __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+   }
+   static UInt32 load(const volatile UInt32* target)
+   {
+      return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+   }
+   template <typename P>
+   static void storePtr(P** target, P* value)
+   {
+      __atomic_store_n(target, value, __ATOMIC_RELEASE);
+   }
+   template <typename P>
+   static P* loadPtr(P* const* target)
+   {
+      return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+   }
+#elif defined(_MSC_VER)
+   template <typename P>
+   static P* exchange(P** target, P* value)
+   {
+      return (P*)InterlockedExchangePointer((PVOID volatile*)target, value);
+   }
+   static UInt32 add(volatile UInt32* target, UInt32 value)
+   {
+      return (UInt32)InterlockedExchangeAdd((volatile LONG*)target, (LONG)value) + value;
+   }
+   static UInt32 sub(volatile UInt32* target, UInt32 value)
+   {
+      return (UInt32)InterlockedExchangeAdd((volatile LONG*)target, -(LONG)value) - value;
+   }
+   static void store(volatile UInt32* target, UInt32 value)
+   {
+      InterlockedExchange((volatile LONG*)target, (LONG)value);
+   }
+   static UInt32 load(const volatile UInt32* target)
+   {
+      MemoryBarrier();
+      return *target;
+   }
+   template <typename P>
+   static void storePtr(P** target, P* value)
+   {
+      InterlockedExchangePointer((PVOID volatile*)target, value);
+   }
+   template <typename P>
+   static P* loadPtr(P* const* target)
+   {
+      P* value = *(P* const volatile*)target;
+      MemoryBarrier();
+      return value;
+   }
+#else
+   template <typename P>
+   static P* exchange(P** target, P* value)
+   {
+      P* old = *target;
+      *target = value;
+      return old;
+   }
+   static UInt32 add(volatile UInt32* target, UInt32 value) { return *target += value; }
+   static UInt32 sub(volatile UInt32* target, UInt32 value) { return *target -= value; }
+   static void store(volatile UInt32* target, UInt32 value) { *target = value; }
+   static UInt32 load(const volatile UInt32* target) { return *target; }
+   template <typename P>
+   static void storePtr(P** target, P* value) { *target = value; }
+   template <typename P>
+   static P* loadPtr(P* const* target) { return *target; }
+#endif
+
+   /// Gives up the cpu while waiting on another thread to finish a push.
+   static void yield()
+   {
+#if defined(WIN32)
+      SwitchToThread();
+#else
+      sched_yield();
+#endif
+   }
+};
+
+/**
+   @internal
+   @brief An unbounded multi-producer/single-consumer queue.
+
+   push() may be called from any number of threads at once and costs one
+   allocation and one atomic exchange; it never blocks and never takes a
+   lock. pop() and front() may only ever be called from one thread at a
+   time (the consumer).
+
+   This is the node based queue described by Dmitry Vyukov: producers swing
+   mHead to their new node and then link the previous head to it, while the
+   consumer follows the links from mTail. Between those two steps of a push
+   the new element is not yet reachable, so pop() can return false although
+   a push has already started; callers that need to know that an element is
+   on its way have to count pushes themselves (AbstractFifo does).
+
+   Used by AbstractFifo in FifoLockFreeMpsc mode.
+*/
+template <typename T>
+class MpscQueue
+{
+   public:
+      MpscQueue() : mHead(&mStub), mTail(&mStub)
+      {
+         mStub.mNext = 0;
+      }
+
+      /// Frees whatever is still queued; all pushes must have completed.
+      ~MpscQueue()
+      {
+         Node* n = mTail;
+         while (n)
+         {
+            Node* next = n->mNext;
+            release(n);
+            n = next;
+         }
+      }
+
+      void push(const T& item)
+      {
+         Node* n = new ValueNode(item);
+         Node* prev = MpscAtomic::exchange(&mHead, n);
+         MpscAtomic::storePtr(&prev->mNext, n);
+      }
+
+      /// Consumer only. Returns false if no (completely pushed) element is there.
+      bool pop(T& item)
+      {
+         Node* tail = mTail;
+         ValueNode* next = static_cast<ValueNode*>(MpscAtomic::loadPtr(&tail->mNext));
+         if (next == 0)
+         {
+            return false;
+         }
+         // next becomes the new stub; its value is dead from here on
+         item = next->mValue;
+         mTail = next;
+         release(tail);
+         return true;
+      }
+
+      /// Consumer only. The oldest element, or 0 if pop() would fail.
+      const T* front() const
+      {
+         ValueNode* next = static_cast<ValueNode*>(MpscAtomic::loadPtr(&mTail->mNext));
+         return next ? &next->mValue : 0;
+      }
+
+   private:
+      struct Node
+      {
+         Node* mNext;
+      };
+
+      struct ValueNode : public Node
+      {
+         ValueNode(const T& value) : mValue(value)
+         {
+            this->mNext = 0;
+         }
+         T mValue;
+      };
+
+      void release(Node* n)
+      {
+         if (n != &mStub)
+         {
+            delete static_cast<ValueNode*>(n);
+         }
+      }
+
+      // producers only touch mHead, the consumer only mTail
+      Node* mHead;
+      char mPad[64];
+      Node* mTail;
+      Node mStub;
+
+      // disabled
+      MpscQueue(const MpscQueue&);
+      MpscQueue& operator=(const MpscQueue&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -1,3 +1,7 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "rutil/SelectInterruptor.hxx"
 
 #include <cassert>
@@ -7,6 +11,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(HAVE_SYS_EVENTFD_H) && !defined(WIN32)
+#include <sys/eventfd.h>
+#define RESIP_SELECTINTERRUPTOR_EVENTFD
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -32,6 +41,12 @@ SelectInterruptor::SelectInterruptor()
    error= connect(mSocket, &mWakeupAddr, sizeof(mWakeupAddr));
    assert(error == 0);
    mReadThing = mSocket;
+#elif defined(RESIP_SELECTINTERRUPTOR_EVENTFD)
+   mPipe[0] = mPipe[1] = eventfd(0, 0);
+   assert(mPipe[0] != -1);
+   // non-blocking for the same reasons as the pipe below
+   makeSocketNonBlocking(mPipe[0]);
+   mReadThing = mPipe[0];
 #else
    int x = pipe(mPipe);
    (void)x;
@@ -51,7 +66,10 @@ SelectInterruptor::~SelectInterruptor()
    closesocket(mSocket);
 #else
    close(mPipe[0]);
-   close(mPipe[1]);
+   if(mPipe[1] != mPipe[0])
+   {
+      close(mPipe[1]);
+   }
 #endif
 }
 
@@ -77,6 +95,11 @@ SelectInterruptor::processCleanup()
 #ifdef WIN32
   char rdBuf[16];
   recv(mSocket, rdBuf, sizeof(rdBuf), 0);
+#elif defined(RESIP_SELECTINTERRUPTOR_EVENTFD)
+  // one read resets the counter, however many times we were woken
+  UInt64 count;
+  ssize_t x = read(mPipe[0], &count, sizeof(count));
+  (void)x;
 #else
   char rdBuf[16];
   int x;
@@ -120,8 +143,14 @@ SelectInterruptor::interrupt()
       int count = send(mSocket, wakeUp, sizeof(wakeUp), 0);
       assert(count == sizeof(wakeUp));
    }
+#else
+#ifdef RESIP_SELECTINTERRUPTOR_EVENTFD
+   UInt64 one = 1;
+   ssize_t res = write(mPipe[1], &one, sizeof(one));
+   (void)wakeUp;
 #else
    ssize_t res = write(mPipe[1], wakeUp, sizeof(wakeUp));
+#endif
 
    if ( res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) )   // Treat EGAIN and EWOULDBLOCK as the same: http://stackoverflow.com/questions/7003234/which-systems-define-eagain-and-ewouldblock-as-different-values
    {
@@ -132,7 +161,11 @@ SelectInterruptor::interrupt()
    } 
    else 
    {
+#ifdef RESIP_SELECTINTERRUPTOR_EVENTFD
+      assert(res == sizeof(UInt64));
+#else
       assert(res == sizeof(wakeUp));
+#endif
    }
 #endif
 }
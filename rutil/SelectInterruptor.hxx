@@ -10,6 +10,11 @@ namespace resip
 
 /**
     Used to 'artificially' interrupt a select call
+
+    Where eventfd(2) is available (HAVE_SYS_EVENTFD_H) a single eventfd is
+    used instead of a pipe: waking costs one 8 byte write to a counter, any
+    number of wake-ups are drained with one read, and it uses one fd
+    instead of two.
 */
 class SelectInterruptor : public AsyncProcessHandler, public FdPollItemIf
 {
@@ -58,6 +63,7 @@ class SelectInterruptor : public AsyncProcessHandler, public FdPollItemIf
       void processCleanup();
    private:
 #ifndef WIN32
+      // with eventfd, both are the same fd
       int mPipe[2];
 #else
       Socket mSocket;
@@ -0,0 +1,197 @@
+#if !defined(RESIP_SNAPSHOTPTR_HXX)
+#define RESIP_SNAPSHOTPTR_HXX
+
+#include "rutil/Lock.hxx"
+#include "rutil/MpscQueue.hxx"
+#include "rutil/Mutex.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Holds the current version of a read-mostly, immutable object.
+
+   Readers take a SnapshotPtr::Reader, which pins the current snapshot for
+   its lifetime without taking a lock: entering costs two atomic counter
+   updates. publish() installs a new snapshot, waits until no reader can
+   still see the previous one and deletes it. Writers are serialized among
+   themselves, and are expected to be rare (configuration edits and the
+   like), since a publish spins while readers of the old snapshot finish.
+
+   Readers are counted in two slots; a reader registers in the slot of the
+   current epoch, and publish() flips the epoch and then waits for the old
+   slot to drain. Without atomic operations (no RESIP_HAVE_MPSC_QUEUE)
+   readers take a mutex instead.
+
+   @code
+   SnapshotPtr<RouteTable> mTable;
+   ...
+   SnapshotPtr<RouteTable>::Reader table(mTable);
+   table->lookup(...);
+   @endcode
+*/
+template <class T>
+class SnapshotPtr
+{
+   public:
+      explicit SnapshotPtr(T* initial = 0) :
+         mCurrent(initial),
+         mEpoch(0)
+      {
+         mReaders[0] = 0;
+         mReaders[1] = 0;
+      }
+
+      /// No Reader may be alive any more.
+      ~SnapshotPtr()
+      {
+         delete mCurrent;
+      }
+
+      /// Takes ownership of next, and deletes the previous snapshot.
+      void publish(T* next)
+      {
+         Lock lock(mWriterMutex);
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+         T* old = mCurrent;
+         MpscAtomic::storePtr(&mCurrent, next);
+         UInt32 oldEpoch = MpscAtomic::load(&mEpoch);
+         MpscAtomic::store(&mEpoch, oldEpoch ^ 1);
+         while (MpscAtomic::load(&mReaders[oldEpoch]) != 0)
+         {
+            MpscAtomic::yield();
+         }
+         delete old;
+#else
+         Lock readers(mReaderMutex);
+         delete mCurrent;
+         mCurrent = next;
+#endif
+      }
+
+      /// Pins the snapshot that is current when it is constructed.
+      class Reader
+      {
+         public:
+            explicit Reader(const SnapshotPtr& ptr) : mPtr(ptr)
+            {
+               mSlot = mPtr.enter();
+               mSnapshot = MpscAtomic::loadPtr(&mPtr.mCurrent);
+            }
+            ~Reader()
+            {
+               mPtr.leave(mSlot);
+            }
+
+            const T* get() const { return mSnapshot; }
+            const T* operator->() const { return mSnapshot; }
+            const T& operator*() const { return *mSnapshot; }
+
+         private:
+            const SnapshotPtr& mPtr;
+            UInt32 mSlot;
+            const T* mSnapshot;
+
+            // disabled
+            Reader(const Reader&);
+            Reader& operator=(const Reader&);
+      };
+
+   private:
+      friend class Reader;
+
+      UInt32 enter() const
+      {
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+         for (;;)
+         {
+            UInt32 slot = MpscAtomic::load(&mEpoch);
+            MpscAtomic::add(&mReaders[slot], 1);
+            if (MpscAtomic::load(&mEpoch) == slot)
+            {
+               return slot;
+            }
+            // a publish flipped the epoch under us; it may not wait for us
+            MpscAtomic::sub(&mReaders[slot], 1);
+         }
+#else
+         mReaderMutex.lock();
+         return 0;
+#endif
+      }
+
+      void leave(UInt32 slot) const
+      {
+#if defined(RESIP_HAVE_MPSC_QUEUE)
+         MpscAtomic::sub(&mReaders[slot], 1);
+#else
+         mReaderMutex.unlock();
+#endif
+      }
+
+      T* mCurrent;
+      volatile UInt32 mEpoch;
+      mutable volatile UInt32 mReaders[2];
+      Mutex mWriterMutex;
+#if !defined(RESIP_HAVE_MPSC_QUEUE)
+      mutable Mutex mReaderMutex;
+#endif
+
+      // disabled
+      SnapshotPtr(const SnapshotPtr&);
+      SnapshotPtr& operator=(const SnapshotPtr&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,215 @@
+#include <cassert>
+#include <cstring>
+
+#include "rutil/ThreadStatistics.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/MpscQueue.hxx"
+
+using namespace resip;
+
+namespace
+{
+const size_t CacheLine = 64;
+
+// microseconds as decimal seconds, without going through floating point
+void
+encodeSeconds(EncodeStream& strm, UInt64 microSeconds)
+{
+   char frac[7];
+   UInt64 us = microSeconds % 1000000;
+   for (int i = 5; i >= 0; --i)
+   {
+      frac[i] = char('0' + us % 10);
+      us /= 10;
+   }
+   frac[6] = 0;
+   strm << microSeconds / 1000000 << "." << frac;
+}
+}
+
+ThreadStatistics::ThreadStatistics() :
+   mKey(0),
+   mBlocks(0),
+   mNumCounters(0),
+   mNumHistograms(0)
+{
+   int res = ThreadIf::tlsKeyCreate(mKey, 0);
+   assert(res == 0);
+   (void)res;
+}
+
+ThreadStatistics::~ThreadStatistics()
+{
+   ThreadIf::tlsKeyDelete(mKey);
+   Block* b = mBlocks;
+   while (b)
+   {
+      Block* next = b->mNext;
+      delete [] b->mAllocation;
+      b = next;
+   }
+}
+
+unsigned int
+ThreadStatistics::addCounter(const Data& name, const Data& help)
+{
+   assert(mNumCounters < MaxCounters);
+   mCounterNames[mNumCounters] = name;
+   mCounterHelp[mNumCounters] = help;
+   return mNumCounters++;
+}
+
+unsigned int
+ThreadStatistics::addHistogram(const Data& name, const Data& help)
+{
+   assert(mNumHistograms < MaxHistograms);
+   mHistogramNames[mNumHistograms] = name;
+   mHistogramHelp[mNumHistograms] = help;
+   return mNumHistograms++;
+}
+
+ThreadStatistics::Block&
+ThreadStatistics::addBlock()
+{
+   // Round up to whole cache lines so no two threads' blocks (nor
+   // anything else on the heap) share one.
+   size_t size = (sizeof(Block) + CacheLine - 1) / CacheLine * CacheLine;
+   char* allocation = new char[size + CacheLine];
+   char* aligned = allocation + (CacheLine - (size_t)allocation % CacheLine) % CacheLine;
+   memset(aligned, 0, size);
+   Block* b = reinterpret_cast<Block*>(aligned);
+   b->mAllocation = allocation;
+
+   {
+      Lock lock(mBlocksMutex);
+      b->mNext = mBlocks;
+      MpscAtomic::storePtr(&mBlocks, b);
+   }
+   ThreadIf::tlsSetValue(mKey, b);
+   return *b;
+}
+
+UInt64
+ThreadStatistics::getCounter(unsigned int counter) const
+{
+   assert(counter < mNumCounters);
+   UInt64 total = 0;
+   for (const Block* b = MpscAtomic::loadPtr(&mBlocks); b; b = b->mNext)
+   {
+      total += b->mCounters[counter];
+   }
+   return total;
+}
+
+void
+ThreadStatistics::getHistogram(unsigned int histogram,
+                               UInt64* buckets,
+                               UInt64& count,
+                               UInt64& sum) const
+{
+   assert(histogram < mNumHistograms);
+   for (unsigned int i = 0; i < Buckets; ++i)
+   {
+      buckets[i] = 0;
+   }
+   count = 0;
+   sum = 0;
+   for (const Block* b = MpscAtomic::loadPtr(&mBlocks); b; b = b->mNext)
+   {
+      const volatile UInt64* h = b->mHistograms[histogram];
+      for (unsigned int i = 0; i < Buckets; ++i)
+      {
+         UInt64 n = h[i];
+         buckets[i] += n;
+         count += n;
+      }
+      sum += h[Buckets];
+   }
+}
+
+EncodeStream&
+ThreadStatistics::encodePrometheus(EncodeStream& strm, const Data& prefix) const
+{
+   for (unsigned int c = 0; c < mNumCounters; ++c)
+   {
+      strm << "# HELP " << prefix << mCounterNames[c] << "_total " << mCounterHelp[c] << "\n"
+           << "# TYPE " << prefix << mCounterNames[c] << "_total counter\n"
+           << prefix << mCounterNames[c] << "_total " << getCounter(c) << "\n";
+   }
+
+   UInt64 buckets[Buckets];
+   for (unsigned int h = 0; h < mNumHistograms; ++h)
+   {
+      UInt64 count;
+      UInt64 sum;
+      getHistogram(h, buckets, count, sum);
+
+      const Data& name = mHistogramNames[h];
+      strm << "# HELP " << prefix << name << "_seconds " << mHistogramHelp[h] << "\n"
+           << "# TYPE " << prefix << name << "_seconds histogram\n";
+      UInt64 cumulative = 0;
+      for (unsigned int i = 0; i < Buckets - 1; ++i)
+      {
+         cumulative += buckets[i];
+         strm << prefix << name << "_seconds_bucket{le=\"";
+         encodeSeconds(strm, bucketLimit(i));
+         strm << "\"} " << cumulative << "\n";
+      }
+      strm << prefix << name << "_seconds_bucket{le=\"+Inf\"} " << count << "\n"
+           << prefix << name << "_seconds_sum ";
+      encodeSeconds(strm, sum);
+      strm << "\n"
+           << prefix << name << "_seconds_count " << count << "\n";
+   }
+   return strm;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
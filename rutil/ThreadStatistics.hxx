@@ -0,0 +1,202 @@
+#if !defined(RESIP_THREADSTATISTICS_HXX)
+#define RESIP_THREADSTATISTICS_HXX
+
+#include "rutil/compat.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Counters and latency histograms that any number of threads can
+   update without locks or atomic read-modify-write instructions.
+
+   Every thread that updates a ThreadStatistics gets its own block of
+   counters, aligned and padded to whole cache lines, which only that
+   thread ever writes. The first update from a thread allocates its block
+   and links it into a list (the only time a lock is taken); blocks live
+   until the ThreadStatistics is destroyed, so counts from threads that
+   have exited are kept. Readers walk the list without locking and sum
+   the blocks, so a snapshot is not atomic across counters, and on
+   platforms without native 64 bit stores a value may be read torn.
+
+   Counters and histograms are registered up front with addCounter() and
+   addHistogram(), before any thread updates them; the ids returned are
+   dense and start at 0. Histogram buckets are powers of two of
+   microseconds: bucket i counts values up to 2^i us, the last bucket
+   everything larger.
+*/
+class ThreadStatistics
+{
+   public:
+      enum
+      {
+         MaxCounters = 32,
+         MaxHistograms = 16,
+         Buckets = 28
+      };
+
+      ThreadStatistics();
+      ~ThreadStatistics();
+
+      /// Returns the id of the new counter. Not thread-safe.
+      unsigned int addCounter(const Data& name, const Data& help);
+      /// Returns the id of the new histogram. Not thread-safe.
+      unsigned int addHistogram(const Data& name, const Data& help);
+
+      unsigned int numCounters() const { return mNumCounters; }
+      unsigned int numHistograms() const { return mNumHistograms; }
+      const Data& counterName(unsigned int counter) const { return mCounterNames[counter]; }
+      const Data& histogramName(unsigned int histogram) const { return mHistogramNames[histogram]; }
+
+      void increment(unsigned int counter, UInt64 n = 1)
+      {
+         volatile UInt64& c = block().mCounters[counter];
+         c = c + n;
+      }
+
+      void record(unsigned int histogram, UInt64 microSeconds)
+      {
+         volatile UInt64* h = block().mHistograms[histogram];
+         volatile UInt64& b = h[bucket(microSeconds)];
+         b = b + 1;
+         h[Buckets] = h[Buckets] + microSeconds;
+      }
+
+      /// Sum of the counter over all threads.
+      UInt64 getCounter(unsigned int counter) const;
+
+      /**
+         Sums the histogram over all threads. buckets receives Buckets
+         (non-cumulative) counts; count is their total and sum the total
+         of all recorded values in microseconds.
+      */
+      void getHistogram(unsigned int histogram,
+                        UInt64* buckets,
+                        UInt64& count,
+                        UInt64& sum) const;
+
+      /// Upper bound of bucket i in microseconds; the last bucket has none.
+      static UInt64 bucketLimit(unsigned int i) { return UInt64(1) << i; }
+
+      static unsigned int bucket(UInt64 microSeconds)
+      {
+         if (microSeconds <= 1)
+         {
+            return 0;
+         }
+         unsigned int b = 64 - leadingZeros(microSeconds - 1);
+         return b < Buckets - 1 ? b : Buckets - 1;
+      }
+
+      /**
+         Writes everything in the Prometheus text exposition format, each
+         name prefixed with prefix. Counters get a _total suffix,
+         histograms a _seconds suffix and their values in seconds.
+      */
+      EncodeStream& encodePrometheus(EncodeStream& strm, const Data& prefix) const;
+
+   private:
+      struct Block
+      {
+         volatile UInt64 mCounters[MaxCounters];
+         // Buckets buckets followed by the sum
+         volatile UInt64 mHistograms[MaxHistograms][Buckets + 1];
+         Block* mNext;
+         char* mAllocation;
+      };
+
+      Block& block()
+      {
+         Block* b = static_cast<Block*>(ThreadIf::tlsGetValue(mKey));
+         return b ? *b : addBlock();
+      }
+
+      Block& addBlock();
+
+      static unsigned int leadingZeros(UInt64 v)
+      {
+#if defined(__GNUC__)
+         return (unsigned int)__builtin_clzll(v);
+#else
+         unsigned int n = 0;
+         while ((v & (UInt64(1) << 63)) == 0)
+         {
+            v <<= 1;
+            ++n;
+         }
+         return n;
+#endif
+      }
+
+      ThreadIf::TlsKey mKey;
+      Mutex mBlocksMutex;
+      Block* mBlocks;
+
+      unsigned int mNumCounters;
+      unsigned int mNumHistograms;
+      Data mCounterNames[MaxCounters];
+      Data mCounterHelp[MaxCounters];
+      Data mHistogramNames[MaxHistograms];
+      Data mHistogramHelp[MaxHistograms];
+
+      // disabled
+      ThreadStatistics(const ThreadStatistics&);
+      ThreadStatistics& operator=(const ThreadStatistics&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -4,6 +4,8 @@
 #include <cassert>
 #include <memory>
 #include "rutil/AbstractFifo.hxx"
+#include "rutil/ThreadStatistics.hxx"
+#include "rutil/Timer.hxx"
 #include <iostream>
 #if defined( WIN32 )
 #include <time.h>
@@ -24,18 +26,22 @@ template<typename Payload>
 class Timestamped
 {
    public:
-      Timestamped(const Payload& msg, time_t n)
+      Timestamped(const Payload& msg, time_t n, UInt64 us = 0)
          : mMsg(msg),
-           mTime(n)
+           mTime(n),
+           mMicroSec(us)
       {}
 
       inline const Payload& getMsg() const { return mMsg;} 
       inline void setMsg(const Payload& pMsg) { mMsg = pMsg;}
       inline const time_t& getTime() const { return mTime;} 
+      /// Timer::getTimeMicroSec() when queued, if the fifo measures waits.
+      inline UInt64 getMicroSec() const { return mMicroSec;}
 
    private:
       Payload mMsg;
       time_t mTime;
+      UInt64 mMicroSec;
 };
 
 /**
@@ -94,8 +100,12 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       typedef enum {EnforceTimeDepth, IgnoreTimeDepth, InternalElement} DepthUsage;
 
       /// After it runs out of the lesser of these limits it will start to refuse messages
+      /// In FifoLockFreeMpsc mode the limits are checked without a lock, so
+      /// concurrent producers may overshoot them slightly, and timeDepth()
+      /// is tracked by the consumer as it pops.
       TimeLimitFifo(unsigned int maxDurationSecs,
-                    unsigned int maxSize);
+                    unsigned int maxSize,
+                    FifoMode mode=FifoLocking);
 
       virtual ~TimeLimitFifo();
 
@@ -206,24 +216,42 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       */
       virtual void setTimeDepthTolerance(unsigned int maxSecs);
 
+      /**
+      @brief records in stats' histogram how long (in microseconds) each
+      message waited in the FIFO; costs a clock read on add and getNext.
+      Set this before the FIFO is used, and pass 0 to stop.
+      */
+      void setWaitStatistic(ThreadStatistics* stats, unsigned int histogram);
+
    private:
       time_t timeDepthInternal() const;
       inline bool wouldAcceptInteral(DepthUsage usage) const;
+      size_t sizeInternal() const;
+      void updateFrontTime();
+      void recordWait(const Timestamped<Msg*>& tm);
       TimeLimitFifo(const TimeLimitFifo& rhs);
       TimeLimitFifo& operator=(const TimeLimitFifo& rhs);
 
       time_t mMaxDurationSecs;
       unsigned int mMaxSize;
       unsigned int mUnreservedMaxSize;
+      // FifoLockFreeMpsc only: timestamp of the (approximately) oldest element
+      volatile time_t mFrontTime;
+      ThreadStatistics* mWaitStats;
+      unsigned int mWaitHistogram;
 };
 
 template <class Msg>
 TimeLimitFifo<Msg>::TimeLimitFifo(unsigned int maxDurationSecs,
-                                  unsigned int maxSize)
-   : AbstractFifo< Timestamped<Msg*> >(),
+                                  unsigned int maxSize,
+                                  FifoMode mode)
+   : AbstractFifo< Timestamped<Msg*> >(mode),
      mMaxDurationSecs(maxDurationSecs),
      mMaxSize(maxSize),
-     mUnreservedMaxSize((int)((maxSize*8)/10)) // !dlb! random guess
+     mUnreservedMaxSize((int)((maxSize*8)/10)), // !dlb! random guess
+     mFrontTime(0),
+     mWaitStats(0),
+     mWaitHistogram(0)
 {}
 
 template <class Msg>
@@ -238,12 +266,28 @@ bool
 TimeLimitFifo<Msg>::add(Msg* msg,
                         DepthUsage usage)
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      if (!wouldAcceptInteral(usage))
+      {
+         return false;
+      }
+      time_t n = time(0);
+      UInt64 us = mWaitStats ? Timer::getTimeMicroSec() : 0;
+      if(AbstractFifo< Timestamped<Msg*> >::add(Timestamped<Msg*>(msg, n, us)) == 1)
+      {
+         mFrontTime = n;
+      }
+      return true;
+   }
+
    Lock lock(mMutex); (void)lock;
 
    if (wouldAcceptInteral(usage))
    {
       time_t n = time(0);
-      mFifo.push_back(Timestamped<Msg*>(msg, n));
+      UInt64 us = mWaitStats ? Timer::getTimeMicroSec() : 0;
+      mFifo.push_back(Timestamped<Msg*>(msg, n, us));
       onMessagePushed(1);
       mCondition.signal();
       return true;
@@ -258,6 +302,10 @@ template <class Msg>
 bool
 TimeLimitFifo<Msg>::wouldAccept(DepthUsage usage) const
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      return wouldAcceptInteral(usage);
+   }
    Lock lock(mMutex); (void)lock;
 
    return wouldAcceptInteral(usage);
@@ -268,6 +316,8 @@ Msg*
 TimeLimitFifo<Msg>::getNext()
 {
    Timestamped<Msg*> tm(AbstractFifo< Timestamped<Msg*> >::getNext());
+   updateFrontTime();
+   recordWait(tm);
    return tm.getMsg();
 }
 
@@ -278,6 +328,8 @@ TimeLimitFifo<Msg>::getNext(int ms)
    Timestamped<Msg*> tm(0,0);
    if(AbstractFifo< Timestamped<Msg*> >::getNext(ms, tm))
    {
+      updateFrontTime();
+      recordWait(tm);
       return tm.getMsg();
    }
    return 0;
@@ -287,6 +339,11 @@ template <class Msg>
 time_t
 TimeLimitFifo<Msg>::timeDepthInternal() const
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      return sizeInternal() == 0 ? 0 : time(0) - mFrontTime;
+   }
+
    if(mFifo.empty())
    {
       return 0;
@@ -295,12 +352,44 @@ TimeLimitFifo<Msg>::timeDepthInternal() const
    return time(0) - mFifo.front().getTime();
 }
 
+template <class Msg>
+size_t
+TimeLimitFifo<Msg>::sizeInternal() const
+{
+   return this->getMode() == FifoLockFreeMpsc ? this->mSize : mFifo.size();
+}
+
+template <class Msg>
+void
+TimeLimitFifo<Msg>::updateFrontTime()
+{
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      // Called by the consumer after a pop. If the next element is still
+      // being linked in by its producer, it was stamped just now.
+      const Timestamped<Msg*>* front = this->mMpsc->front();
+      mFrontTime = front ? front->getTime() : time(0);
+   }
+}
+
+template <class Msg>
+void
+TimeLimitFifo<Msg>::recordWait(const Timestamped<Msg*>& tm)
+{
+   // messages queued before the statistic was set carry no stamp
+   if (mWaitStats && tm.getMicroSec())
+   {
+      UInt64 now = Timer::getTimeMicroSec();
+      mWaitStats->record(mWaitHistogram, now > tm.getMicroSec() ? now - tm.getMicroSec() : 0);
+   }
+}
+
 template <class Msg>
 bool
 TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 {
    if ((mMaxSize != 0 &&
-        mFifo.size() >= mMaxSize))
+        sizeInternal() >= mMaxSize))
    {
       return false;
    }
@@ -311,7 +400,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
    }
 
    if (mUnreservedMaxSize != 0 &&
-       mFifo.size() >= mUnreservedMaxSize)
+       sizeInternal() >= mUnreservedMaxSize)
    {
       return false;
    }
@@ -323,7 +412,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 
    assert(usage == EnforceTimeDepth);
 
-   if (mFifo.size() == 0 ||
+   if (sizeInternal() == 0 ||
        mMaxDurationSecs == 0 ||
        timeDepthInternal() < mMaxDurationSecs)
    {
@@ -337,6 +426,10 @@ template <class Msg>
 time_t
 TimeLimitFifo<Msg>::timeDepth() const
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      return timeDepthInternal();
+   }
    Lock lock(mMutex); (void)lock;
    return timeDepthInternal();
 }
@@ -345,6 +438,16 @@ template <class Msg>
 void
 TimeLimitFifo<Msg>::clear()
 {
+   if(this->getMode() == FifoLockFreeMpsc)
+   {
+      Msg* msg(0);
+      while((msg = getNext(RESIP_FIFO_NOWAIT)) != 0)
+      {
+         delete msg;
+      }
+      return;
+   }
+
    Lock lock(mMutex); (void)lock;
 
    while (!mFifo.empty())
@@ -399,6 +502,14 @@ TimeLimitFifo<Msg>::setTimeDepthTolerance(unsigned int maxSecs)
    mMaxDurationSecs=maxSecs;
 }
 
+template <class Msg>
+void
+TimeLimitFifo<Msg>::setWaitStatistic(ThreadStatistics* stats, unsigned int histogram)
+{
+   mWaitHistogram = histogram;
+   mWaitStats = stats;
+}
+
 
 } // namespace resip
 
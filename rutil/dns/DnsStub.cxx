@@ -25,6 +25,8 @@
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/Inserter.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
 #include "rutil/dns/DnsStub.hxx"
 #include "rutil/dns/ExternalDns.hxx"
 #include "rutil/dns/ExternalDnsFactory.hxx"
@@ -88,7 +90,13 @@ DnsStub::DnsStub(const NameserverList& additional,
    mTransform(0),
    mDnsProvider(ExternalDnsFactory::createExternalDns()),
    mPollGrp(0),
-   mAsyncProcessHandler(asyncProcessHandler)
+   mQueriesSent(0),
+   mQueriesCoalesced(0),
+   mQueriesPending(0),
+   mAsyncProcessHandler(asyncProcessHandler),
+   mSnapshotInterval(0),
+   mNextSnapshot(0),
+   mSnapshotWriter(0)
 {
    setPollGrp(pollGrp);
 
@@ -111,10 +119,25 @@ DnsStub::DnsStub(const NameserverList& additional,
 
 DnsStub::~DnsStub()
 {
+   if (mSnapshotWriter)
+   {
+      // lets a periodic snapshot still being written finish first
+      mSnapshotWriter->shutdown();
+      mSnapshotWriter->join();
+      delete mSnapshotWriter;
+   }
+   if (!mSnapshotPath.empty())
+   {
+      doSaveDnsCache(mSnapshotPath);
+   }
    for (set<Query*>::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
    {
       delete *it;
    }
+   for (SharedLookupMap::iterator it = mSharedLookups.begin(); it != mSharedLookups.end(); ++it)
+   {
+      delete it->second;
+   }
 
    setPollGrp(0);
    delete mDnsProvider;
@@ -124,7 +147,17 @@ unsigned int
 DnsStub::getTimeTillNextProcessMS()
 {
     if(mCommandFifo.size() > 0) return 0;
-    return mDnsProvider->getTimeTillNextProcessMS();
+    unsigned int ms = mDnsProvider->getTimeTillNextProcessMS();
+    if (mSnapshotInterval)
+    {
+       UInt64 now = Timer::getTimeMs();
+       UInt64 tillSnapshot = mNextSnapshot > now ? mNextSnapshot - now : 0;
+       if (tillSnapshot < ms)
+       {
+          ms = (unsigned int)tillSnapshot;
+       }
+    }
+    return ms;
 }
 
 void
@@ -159,6 +192,7 @@ DnsStub::processTimers()
    // the fifo is captures as a timer within getTimeTill... above
    processFifo();
    mDnsProvider->processTimers();
+   saveSnapshotIfDue();
 }
 
 void 
@@ -468,8 +502,9 @@ DnsStub::Query::go()
    DnsResourceRecordsByPtr records;
    int status = 0;
    bool cached = false;
+   bool refresh = false;
    Data targetToQuery = mTarget;
-   cached = mStub.mRRCache.lookup(mTarget, mRRType, mProto, records, status);
+   cached = mStub.mRRCache.lookup(mTarget, mRRType, mProto, records, status, refresh);
 
    if (!cached)
    {
@@ -490,7 +525,7 @@ DnsStub::Query::go()
    if (targetToQuery != mTarget)
    {
       StackLog(<< mTarget << " mapped to CNAME " << targetToQuery);
-      cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status);
+      cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status, refresh);
    }
 
    if (!cached)
@@ -531,6 +566,10 @@ DnsStub::Query::go()
    }
    else // is cached
    {
+      if (refresh)
+      {
+         mStub.refresh(targetToQuery, mRRType);
+      }
       if (mTransform && !records.empty())
       {
          mTransform->transform(mTarget, mRRType, records);
@@ -547,6 +586,28 @@ DnsStub::Query::process(int status, const unsigned char* abuf, const int alen)
 {
    if (status != 0)
    {
+      if (status == ARES_ETIMEOUT || status == ARES_ECONNREFUSED ||
+          status == ARES_ESERVFAIL || status == ARES_EREFUSED)
+      {
+         // The resolver could not answer; an expired answer beats none.
+         DnsResourceRecordsByPtr result;
+         int queryStatus = 0;
+         if (mStub.mRRCache.lookupStale(mTarget, mRRType, mProto, result, queryStatus))
+         {
+            InfoLog(<< "Serving stale " << typeToData(mRRType) << " records for " << mTarget 
+                    << " after: " << mStub.errorMessage(status));
+            if (mTransform && !result.empty())
+            {
+               mTransform->transform(mTarget, mRRType, result);
+            }
+            mResultConverter->notifyUser(mTarget, queryStatus, mStub.errorMessage(queryStatus), result, mSink);
+            mReQuery = 0;
+            mStub.removeQuery(this);
+            delete this;
+            return;
+         }
+      }
+
       switch (status)
       {
          case ARES_ENODATA:
@@ -774,7 +835,59 @@ DnsStub::errorMessage(int status)
 void
 DnsStub::lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink)
 {
-   mDnsProvider->lookup(target.c_str(), type, this, sink);
+   Data name(target);
+   SharedLookup::Key key(type, name.lowercase());
+   SharedLookupMap::iterator it = mSharedLookups.find(key);
+   if (it != mSharedLookups.end())
+   {
+      StackLog(<< "Joining outstanding query for " << target << " " << typeToData(type));
+      it->second->mSinks.push_back(sink);
+      ++mQueriesCoalesced;
+      return;
+   }
+
+   // registered before the lookup, since the answer may come back from within it
+   SharedLookup* lookup = new SharedLookup(*this, key);
+   lookup->mSinks.push_back(sink);
+   mSharedLookups[key] = lookup;
+   ++mQueriesSent;
+   ++mQueriesPending;
+   mDnsProvider->lookup(target.c_str(), type, this, lookup);
+}
+
+DnsStub::SharedLookup::SharedLookup(DnsStub& stub, const Key& key)
+   : mStub(stub),
+     mKey(key)
+{
+}
+
+void
+DnsStub::SharedLookup::onDnsRaw(int status, const unsigned char* abuf, int alen)
+{
+   // Forget this lookup first: a sink that needs to query again (a CNAME,
+   // say) must get a query of its own.
+   mStub.mSharedLookups.erase(mKey);
+   --mStub.mQueriesPending;
+
+   std::vector<DnsRawSink*> sinks;
+   sinks.swap(mSinks);
+   bool refresh = false;
+   for (std::vector<DnsRawSink*>::iterator it = sinks.begin(); it != sinks.end(); ++it)
+   {
+      if (*it)
+      {
+         (*it)->onDnsRaw(status, abuf, alen);
+      }
+      else
+      {
+         refresh = true;
+      }
+   }
+   if (refresh)
+   {
+      mStub.cacheRefreshed(mKey.second, status, abuf, alen);
+   }
+   delete this;
 }
 
 void
@@ -784,6 +897,53 @@ DnsStub::handleDnsRaw(ExternalDnsRawResult res)
    mDnsProvider->freeResult(res);
 }
 
+void
+DnsStub::refresh(const Data& target, int rrType)
+{
+   if (mDnsProvider->hostFileLookupLookupOnlyMode())
+   {
+      return;
+   }
+   DebugLog(<< "Refreshing " << typeToData(rrType) << " records for " << target << " before they expire");
+   lookupRecords(target, rrType, 0);
+}
+
+void
+DnsStub::cacheRefreshed(const Data& target, int status, const unsigned char* abuf, int alen)
+{
+   // Only a fresh answer replaces the entry; on failure it expires as usual
+   // (and may still be served stale).
+   if (status == 0 && DNS_HEADER_ANCOUNT(abuf) > 0)
+   {
+      try
+      {
+         const unsigned char* aptr = abuf + HFIXEDSZ;
+         int qdcount = DNS_HEADER_QDCOUNT(abuf);
+         for (int i = 0; i < qdcount && aptr; ++i)
+         {
+            aptr = skipDNSQuestion(aptr, abuf, alen);
+         }
+
+         char* name = 0;
+         long len = 0;
+         if (ARES_SUCCESS == ares_expand_name(aptr, abuf, alen, &name, &len))
+         {
+            Data answerName(name);
+            free(name);
+            cache(answerName, abuf, alen);
+         }
+      }
+      catch (BaseException& e)
+      {
+         ErrLog(<< "Failed to refresh cached records for " << target << ": " << e.getMessage());
+      }
+   }
+   else
+   {
+      DebugLog(<< "Refresh of " << target << " failed: " << errorMessage(status));
+   }
+}
+
 void
 DnsStub::setEnumSuffixes(const std::vector<Data>& suffixes)
 {
@@ -864,6 +1024,140 @@ DnsStub::doGetDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCa
    handler->onDnsCacheDumpRetrieved(key, dnsCacheDump);
 }
 
+void
+DnsStub::setDnsCacheSnapshot(const Data& path, int saveIntervalSecs)
+{
+   queueCommand(new SetDnsCacheSnapshotCommand(*this, path, saveIntervalSecs));
+}
+
+void
+DnsStub::doSetDnsCacheSnapshot(const Data& path, int saveIntervalSecs)
+{
+   mSnapshotPath = path;
+   mSnapshotInterval = (!path.empty() && saveIntervalSecs > 0) ? UInt64(saveIntervalSecs) * 1000 : 0;
+   mNextSnapshot = Timer::getTimeMs() + mSnapshotInterval;
+   if (!path.empty())
+   {
+      doLoadDnsCache(path);
+   }
+}
+
+void
+DnsStub::saveSnapshotIfDue()
+{
+   if (mSnapshotInterval && Timer::getTimeMs() >= mNextSnapshot)
+   {
+      if (!mSnapshotWriter)
+      {
+         mSnapshotWriter = new SnapshotWriter;
+         mSnapshotWriter->run();
+      }
+      if (mSnapshotWriter->busy())
+      {
+         WarningLog(<< "Previous DNS cache snapshot is still being written to " << mSnapshotPath << ", skipping this one");
+      }
+      else
+      {
+         UInt64 start = Timer::getTimeMicroSec();
+         Data snapshot;
+         mRRCache.encodeSnapshot(snapshot);
+         DebugLog(<< "Encoded " << mRRCache.size() << " DNS cache entries (" << snapshot.size()
+                  << " bytes) in " << (Timer::getTimeMicroSec() - start) << "us");
+         mSnapshotWriter->write(mSnapshotPath, snapshot);
+      }
+      mNextSnapshot = Timer::getTimeMs() + mSnapshotInterval;
+   }
+}
+
+DnsStub::SnapshotWriter::SnapshotWriter()
+   : mBusy(false)
+{
+}
+
+bool
+DnsStub::SnapshotWriter::busy() const
+{
+   Lock lock(mMutex);
+   return mBusy;
+}
+
+void
+DnsStub::SnapshotWriter::write(const Data& path, Data& snapshot)
+{
+   Lock lock(mMutex);
+   assert(!mBusy);
+   mPath = path;
+   mSnapshot.takeBuf(snapshot);
+   mBusy = true;
+   mCondition.signal();
+}
+
+void
+DnsStub::SnapshotWriter::thread()
+{
+   for (;;)
+   {
+      {
+         Lock lock(mMutex);
+         while (!mBusy && !isShutdown())
+         {
+            mCondition.wait(mMutex);
+         }
+         if (!mBusy)
+         {
+            break;
+         }
+      }
+      // write() leaves mPath and mSnapshot alone while mBusy is set
+      if (RRCache::writeSnapshot(mPath, mSnapshot))
+      {
+         DebugLog(<< "Saved DNS cache snapshot to " << mPath);
+      }
+      Lock lock(mMutex);
+      mSnapshot.clear();
+      mBusy = false;
+   }
+}
+
+void
+DnsStub::SnapshotWriter::shutdown()
+{
+   ThreadIf::shutdown();
+   Lock lock(mMutex);
+   mCondition.signal();
+}
+
+void
+DnsStub::saveDnsCache(const Data& path)
+{
+   queueCommand(new SaveDnsCacheCommand(*this, path));
+}
+
+void
+DnsStub::doSaveDnsCache(const Data& path)
+{
+   if (mRRCache.save(path))
+   {
+      DebugLog(<< "Saved " << mRRCache.size() << " DNS cache entries to " << path);
+   }
+}
+
+void
+DnsStub::loadDnsCache(const Data& path)
+{
+   queueCommand(new LoadDnsCacheCommand(*this, path));
+}
+
+void
+DnsStub::doLoadDnsCache(const Data& path)
+{
+   int loaded = mRRCache.load(path);
+   if (loaded >= 0)
+   {
+      InfoLog(<< "Loaded " << loaded << " DNS cache entries from " << path);
+   }
+}
+
 void
 DnsStub::setDnsCacheTTL(int ttl)
 {
@@ -876,6 +1170,18 @@ DnsStub::setDnsCacheSize(int size)
    mRRCache.setSize(size);
 }
 
+void
+DnsStub::setDnsCachePrefetch(int percent)
+{
+   mRRCache.setPrefetch(percent);
+}
+
+void
+DnsStub::setDnsCacheStaleTTL(int secs)
+{
+   mRRCache.setStaleTTL(secs);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
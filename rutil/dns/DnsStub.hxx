@@ -12,10 +12,13 @@
 #include <set>
 
 #include "rutil/FdPoll.hxx"
+#include "rutil/Condition.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/SelectInterruptor.hxx"
 #include "rutil/Socket.hxx"
+#include "rutil/ThreadIf.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
 #include "rutil/dns/DnsAAAARecord.hxx"
 #include "rutil/dns/DnsCnameRecord.hxx"
@@ -175,9 +178,34 @@ class DnsStub : public ExternalDnsHandler
       void getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler);
       void setDnsCacheTTL(int ttl);
       void setDnsCacheSize(int size);
+      // see RRCache::setPrefetch() and RRCache::setStaleTTL()
+      void setDnsCachePrefetch(int percent);
+      void setDnsCacheStaleTTL(int secs);
+      /**
+         Loads the cache from path, then saves it back to path every
+         saveIntervalSecs (0 to save only on destruction). An empty path
+         turns this off. See RRCache::save(). Periodic snapshots are
+         encoded on the DNS thread (on the order of 100ms for 100k
+         entries) and written to disk from a thread of their own; the one
+         taken on destruction is written before the destructor returns.
+      */
+      void setDnsCacheSnapshot(const Data& path, int saveIntervalSecs);
+      void saveDnsCache(const Data& path);
+      void loadDnsCache(const Data& path);
       bool checkDnsChange();
       bool supportedType(int);
 
+      /** 
+         Wire queries are shared: a lookup for a target and type that is
+         already outstanding waits for that query's answer instead of
+         sending its own. These count queries sent, lookups that joined an
+         outstanding query, and queries currently outstanding. They are
+         updated by the DNS thread only and may be read from any thread.
+      */
+      unsigned int getQueriesSent() const { return mQueriesSent; }
+      unsigned int getQueriesCoalesced() const { return mQueriesCoalesced; }
+      unsigned int getQueriesPending() const { return mQueriesPending; }
+
       template<class QueryType> void lookup(const Data& target, DnsResultSink* sink)
       {
          lookup<QueryType>(target, Protocol::Reserved, sink);
@@ -277,6 +305,26 @@ class DnsStub : public ExternalDnsHandler
             bool mFollowCname;
       };
 
+      // A wire query and everyone waiting for its answer.
+      class SharedLookup : public DnsRawSink
+      {
+         public:
+            typedef std::pair<unsigned short, Data> Key;  // type, lowercase target
+
+            SharedLookup(DnsStub& stub, const Key& key);
+            void onDnsRaw(int status, const unsigned char* abuf, int alen);
+
+            DnsStub& mStub;
+            Key mKey;
+            std::vector<DnsRawSink*> mSinks;  // 0 for a refresh
+      };
+      friend class SharedLookup;
+
+      // Refreshes a cache entry ahead of its expiry; nobody waits for the
+      // answer, which just goes into the cache.
+      void refresh(const Data& target, int rrType);
+      void cacheRefreshed(const Data& target, int status, const unsigned char* abuf, int alen);
+
    private:
       DnsStub(const DnsStub&);   // disable copy ctor.
       DnsStub& operator=(const DnsStub&);
@@ -423,6 +471,84 @@ class DnsStub : public ExternalDnsHandler
             GetDnsCacheDumpHandler* mHandler;
       };
 
+      void doSetDnsCacheSnapshot(const Data& path, int saveIntervalSecs);
+      void doSaveDnsCache(const Data& path);
+      void doLoadDnsCache(const Data& path);
+      void saveSnapshotIfDue();
+
+      // Writes periodic cache snapshots to disk, so that the DNS thread
+      // only pays for encoding them.
+      class SnapshotWriter : public ThreadIf
+      {
+         public:
+            SnapshotWriter();
+            /// true while the last snapshot handed over is not written yet
+            bool busy() const;
+            /// takes over snapshot (leaving it empty) to be written to path
+            void write(const Data& path, Data& snapshot);
+            virtual void thread();
+            virtual void shutdown();
+
+         private:
+            mutable Mutex mMutex;
+            Condition mCondition;
+            bool mBusy;
+            Data mPath;
+            Data mSnapshot;
+      };
+
+      class SetDnsCacheSnapshotCommand : public Command
+      {
+         public:
+            SetDnsCacheSnapshotCommand(DnsStub& stub, const Data& path, int saveIntervalSecs)
+               : mStub(stub), mPath(path), mSaveIntervalSecs(saveIntervalSecs)
+            {}
+            ~SetDnsCacheSnapshotCommand() {}
+            void execute()
+            {
+               mStub.doSetDnsCacheSnapshot(mPath, mSaveIntervalSecs);
+            }
+
+         private:
+            DnsStub& mStub;
+            Data mPath;
+            int mSaveIntervalSecs;
+      };
+
+      class SaveDnsCacheCommand : public Command
+      {
+         public:
+            SaveDnsCacheCommand(DnsStub& stub, const Data& path)
+               : mStub(stub), mPath(path)
+            {}
+            ~SaveDnsCacheCommand() {}
+            void execute()
+            {
+               mStub.doSaveDnsCache(mPath);
+            }
+
+         private:
+            DnsStub& mStub;
+            Data mPath;
+      };
+
+      class LoadDnsCacheCommand : public Command
+      {
+         public:
+            LoadDnsCacheCommand(DnsStub& stub, const Data& path)
+               : mStub(stub), mPath(path)
+            {}
+            ~LoadDnsCacheCommand() {}
+            void execute()
+            {
+               mStub.doLoadDnsCache(mPath);
+            }
+
+         private:
+            DnsStub& mStub;
+            Data mPath;
+      };
+
       SelectInterruptor mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
@@ -445,6 +571,12 @@ class DnsStub : public ExternalDnsHandler
       FdPollGrp* mPollGrp;
       std::set<Query*> mQueries;
 
+      typedef std::map<SharedLookup::Key, SharedLookup*> SharedLookupMap;
+      SharedLookupMap mSharedLookups;
+      unsigned int mQueriesSent;
+      unsigned int mQueriesCoalesced;
+      unsigned int mQueriesPending;
+
       std::vector<Data> mEnumSuffixes; // where to do enum lookups
       std::map<Data,Data> mEnumDomains;
 
@@ -457,6 +589,11 @@ class DnsStub : public ExternalDnsHandler
 
       /// Dns Cache
       RRCache mRRCache;
+
+      Data mSnapshotPath;
+      UInt64 mSnapshotInterval; // in ms, 0 if only saved on destruction
+      UInt64 mNextSnapshot;     // in ms
+      SnapshotWriter* mSnapshotWriter; // started with the first periodic snapshot
 };
 
 typedef DnsStub::Protocol Protocol;
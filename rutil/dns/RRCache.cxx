@@ -23,13 +23,16 @@
 #endif
 #endif
 
-#include <set>
 #include <vector>
 #include <list>
 #include <map>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/RROverlay.hxx"
@@ -46,11 +49,173 @@
 using namespace resip;
 using namespace std;
 
+#define RESIPROCATE_SUBSYSTEM Subsystem::DNS
+
+namespace
+{
+// snapshot file layout, all integers in network order:
+//   "RESIPDNS" version(16)
+//   per entry: type(16) status(32) remaining ttl(32) key length(16) key
+//              record count(16), then per record: length(16) wire RR
+const char SnapshotMagic[] = "RESIPDNS";
+const size_t SnapshotMagicSize = 8;
+const unsigned short SnapshotVersion = 1;
+
+void put16(Data& out, unsigned int v)
+{
+   out += (char)((v >> 8) & 0xFF);
+   out += (char)(v & 0xFF);
+}
+
+void put32(Data& out, UInt32 v)
+{
+   put16(out, v >> 16);
+   put16(out, v & 0xFFFF);
+}
+
+bool putCharString(Data& out, const Data& str)
+{
+   if (str.size() > 255)
+   {
+      return false;
+   }
+   out += (char)str.size();
+   out += str;
+   return true;
+}
+
+// uncompressed wire format name
+bool putName(Data& out, const Data& name)
+{
+   const char* p = name.data();
+   const char* end = p + name.size();
+   while (p < end)
+   {
+      const char* dot = (const char*)memchr(p, '.', end - p);
+      const char* labelEnd = dot ? dot : end;
+      size_t len = labelEnd - p;
+      if (len == 0 || len > 63)
+      {
+         return false;
+      }
+      out += (char)len;
+      out.append(p, len);
+      p = dot ? dot + 1 : end;
+   }
+   out += (char)0;
+   return true;
+}
+
+unsigned int get16(const unsigned char* p)
+{
+   return (p[0] << 8) | p[1];
+}
+
+UInt32 get32(const unsigned char* p)
+{
+   return ((UInt32)get16(p) << 16) | get16(p + 2);
+}
+
+// NAPTR regexps are kept split into pattern and replacement; rejoin them
+// with a delimiter that occurs in neither
+Data joinRegexp(const DnsNaptrRecord::RegExp& re)
+{
+   if (re.regexp().empty() && re.replacement().empty())
+   {
+      return Data::Empty;
+   }
+   static const char delims[] = "!#|/%@";
+   for (const char* d = delims; *d; ++d)
+   {
+      if (re.regexp().find(Data(*d)) == Data::npos &&
+          re.replacement().find(Data(*d)) == Data::npos)
+      {
+         return Data(*d) + re.regexp() + Data(*d) + re.replacement() + Data(*d);
+      }
+   }
+   return Data::Empty;
+}
+
+bool encodeRecord(Data& out, int type, const DnsResourceRecord& rr, UInt32 ttl)
+{
+   Data rdata;
+   switch (type)
+   {
+      case T_A:
+      {
+         in_addr addr = static_cast<const DnsHostRecord&>(rr).addr();
+         rdata.append((const char*)&addr, 4);
+         break;
+      }
+#ifdef USE_IPV6
+      case T_AAAA:
+         rdata.append((const char*)&static_cast<const DnsAAAARecord&>(rr).v6Address(), 16);
+         break;
+#endif
+      case T_SRV:
+      {
+         const DnsSrvRecord& srv = static_cast<const DnsSrvRecord&>(rr);
+         put16(rdata, srv.priority());
+         put16(rdata, srv.weight());
+         put16(rdata, srv.port());
+         if (!putName(rdata, srv.target()))
+         {
+            return false;
+         }
+         break;
+      }
+      case T_NAPTR:
+      {
+         const DnsNaptrRecord& naptr = static_cast<const DnsNaptrRecord&>(rr);
+         put16(rdata, naptr.order());
+         put16(rdata, naptr.preference());
+         if (!putCharString(rdata, naptr.flags()) ||
+             !putCharString(rdata, naptr.service()) ||
+             !putCharString(rdata, joinRegexp(naptr.regexp())))
+         {
+            return false;
+         }
+         if (naptr.replacement().empty())
+         {
+            rdata += (char)0;
+         }
+         else if (!putName(rdata, naptr.replacement()))
+         {
+            return false;
+         }
+         break;
+      }
+      case T_CNAME:
+         if (!putName(rdata, static_cast<const DnsCnameRecord&>(rr).cname()))
+         {
+            return false;
+         }
+         break;
+      default:
+         return false;
+   }
+
+   if (!putName(out, rr.name()) || rdata.size() > 0xFFFF)
+   {
+      return false;
+   }
+   put16(out, type);
+   put16(out, C_IN);
+   put32(out, ttl);
+   put16(out, (unsigned int)rdata.size());
+   out += rdata;
+   return true;
+}
+}
+
 RRCache::RRCache() 
    : mHead(),
      mLruHead(LruListType::makeList(&mHead)),
+     mCount(0),
      mUserDefinedTTL(DEFAULT_USER_DEFINED_TTL),
-     mSize(DEFAULT_SIZE)
+     mSize(DEFAULT_SIZE),
+     mPrefetchPercent(0),
+     mStaleTTL(0)
 {
    mFactoryMap[T_CNAME] = &mCnameRecordFactory;
    mFactoryMap[T_NAPTR] = &mNaptrRecordFacotry;
@@ -66,26 +231,70 @@ RRCache::~RRCache()
    cleanup();
 }
 
+RRList*
+RRCache::find(const Data& target, const int type)
+{
+   RRMaps::iterator m = mRRMaps.find(type);
+   if (m == mRRMaps.end())
+   {
+      return 0;
+   }
+   RRMap::iterator it = m->second.find(target);
+   return it == m->second.end() ? 0 : it->second;
+}
+
+void
+RRCache::insert(RRList* node)
+{
+   RRMap& map = mRRMaps[node->rrType()];
+   RRMap::iterator it = map.find(node->key());
+   if (it != map.end())
+   {
+      delete it->second;
+      it->second = node;
+   }
+   else
+   {
+      map[node->key()] = node;
+      ++mCount;
+   }
+   mLruHead->push_back(node);
+   purge();
+}
+
+void
+RRCache::erase(RRList* node)
+{
+   RRMaps::iterator m = mRRMaps.find(node->rrType());
+   assert(m != mRRMaps.end());
+   RRMap::iterator it = m->second.find(node->key());
+   if (it != m->second.end() && it->second == node)
+   {
+      m->second.erase(it);
+   }
+   --mCount;
+   delete node;  // takes it off the LRU list
+}
+
+bool
+RRCache::isDead(const RRList* node, UInt64 now) const
+{
+   return now >= node->absoluteExpiry() + mStaleTTL;
+}
+
 void 
 RRCache::updateCacheFromHostFile(const DnsHostRecord &record)
 {
-   //FactoryMap::iterator it = mFactoryMap.find(T_A);
-   RRList* key = new RRList(record, 3600);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRList* node = find(record.name(), T_A);
+   if (node)
    {
-      (*lb)->update(record, 3600);
-      touch(*lb);
+      node->update(record, 3600);
+      touch(node);
    }
    else
    {
-      RRList* val = new RRList(record, 3600);
-      mRRSet.insert(val);
-      mLruHead->push_back(val);
-      purge();
+      insert(new RRList(record, 3600));
    }
-   delete key;
 }
 
 void 
@@ -97,22 +306,16 @@ RRCache::updateCache(const Data& target,
    Data domain = (*begin).domain();
    FactoryMap::iterator it = mFactoryMap.find(rrType);
    assert(it != mFactoryMap.end());
-   RRList* key = new RRList(domain, rrType);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRList* node = find(domain, rrType);
+   if (node)
    {
-      (*lb)->update(it->second, begin, end, mUserDefinedTTL);
-      touch(*lb);
+      node->update(it->second, begin, end, mUserDefinedTTL);
+      touch(node);
    }
    else
    {
-      RRList* val = new RRList(it->second, domain, rrType, begin, end, mUserDefinedTTL);
-      mRRSet.insert(val);
-      mLruHead->push_back(val);
-      purge();
+      insert(new RRList(it->second, domain, rrType, begin, end, mUserDefinedTTL));
    }
-   delete key;
 }
 
 void 
@@ -133,17 +336,7 @@ RRCache::cacheTTL(const Data& target,
       ttl = mUserDefinedTTL;
    }
 
-   RRList* val = new RRList(target, rrType, ttl, status);
-   RRSet::iterator it = mRRSet.find(val);
-   if (it != mRRSet.end())
-   {
-      (*it)->remove();
-      delete *it;
-      mRRSet.erase(it);
-   }
-   mRRSet.insert(val);
-   mLruHead->push_back(val);
-   purge();
+   insert(new RRList(target, rrType, ttl, status));
 }
 
 bool 
@@ -153,31 +346,68 @@ RRCache::lookup(const Data& target,
                 Result& records, 
                 int& status)
 {
-   records.empty();
+   bool refresh;
+   return lookup(target, type, protocol, records, status, refresh);
+}
+
+bool 
+RRCache::lookup(const Data& target, 
+                const int type, 
+                const int protocol,
+                Result& records, 
+                int& status,
+                bool& refresh)
+{
+   records.clear();
    status = 0;
-   RRList* key = new RRList(target, type);
-   RRSet::iterator it = mRRSet.find(key);
-   delete key;
-   if (it == mRRSet.end())
+   refresh = false;
+   RRList* node = find(target, type);
+   if (!node)
    {
       return false;
    }
-   else
+
+   UInt64 now = Timer::getTimeSecs();
+   if (now >= node->absoluteExpiry())
    {
-      if (Timer::getTimeSecs() >= (*it)->absoluteExpiry())
+      if (isDead(node, now))
       {
-         delete *it;
-         mRRSet.erase(it);
-         return false;
-      }
-      else
-      {
-         records = (*it)->records(protocol);
-         status = (*it)->status();
-         touch(*it);
-         return true;
+         erase(node);
       }
+      return false;
+   }
+
+   records = node->records(protocol);
+   status = node->status();
+   touch(node);
+
+   if (mPrefetchPercent && !node->refreshRequested() && node->ttl() < 0xFFFFFFFF &&
+       node->absoluteExpiry() - now <= node->ttl() * mPrefetchPercent / 100)
+   {
+      node->refreshRequested() = true;
+      refresh = true;
    }
+   return true;
+}
+
+bool 
+RRCache::lookupStale(const Data& target, 
+                     const int type, 
+                     const int protocol,
+                     Result& records, 
+                     int& status)
+{
+   records.clear();
+   status = 0;
+   RRList* node = find(target, type);
+   if (!node || isDead(node, Timer::getTimeSecs()))
+   {
+      return false;
+   }
+   records = node->records(protocol);
+   status = node->status();
+   touch(node);
+   return true;
 }
 
 void 
@@ -196,12 +426,15 @@ RRCache::touch(RRList* node)
 void 
 RRCache::cleanup()
 {
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); it++)
+   for (RRMaps::iterator m = mRRMaps.begin(); m != mRRMaps.end(); ++m)
    {
-      (*it)->remove();
-      delete *it;
+      for (RRMap::iterator it = m->second.begin(); it != m->second.end(); ++it)
+      {
+         delete it->second;
+      }
    }
-   mRRSet.clear();
+   mRRMaps.clear();
+   mCount = 0;
 }
 
 int 
@@ -226,30 +459,29 @@ RRCache::getTTL(const RROverlay& overlay)
 void 
 RRCache::purge()
 {
-   if (mRRSet.size() < mSize) return;
-   RRList* lst = *(mLruHead->begin());
-   RRSet::iterator it = mRRSet.find(lst);
-   assert(it != mRRSet.end());
-   lst->remove();
-   delete *it;
-   mRRSet.erase(it);
+   while (mCount > mSize && mLruHead->begin() != mLruHead->end())
+   {
+      erase(*(mLruHead->begin()));
+   }
 }
 
 void 
 RRCache::logCache()
 {
    UInt64 now = Timer::getTimeSecs();
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   for (RRMaps::iterator m = mRRMaps.begin(); m != mRRMaps.end(); ++m)
    {
-      if (now >= (*it)->absoluteExpiry())
+      for (RRMap::iterator it = m->second.begin(); it != m->second.end(); )
       {
-         delete *it;
-         mRRSet.erase(it++);
-      }
-      else
-      {
-         (*it)->log();
-         ++it;
+         RRList* node = (it++)->second;
+         if (isDead(node, now))
+         {
+            erase(node);
+         }
+         else if (now < node->absoluteExpiry())
+         {
+            node->log();
+         }
       }
    }
 }
@@ -259,20 +491,206 @@ RRCache::getCacheDump(Data& dnsCacheDump)
 {
    UInt64 now = Timer::getTimeSecs();
    DataStream strm(dnsCacheDump);
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   for (RRMaps::iterator m = mRRMaps.begin(); m != mRRMaps.end(); ++m)
+   {
+      for (RRMap::iterator it = m->second.begin(); it != m->second.end(); )
+      {
+         RRList* node = (it++)->second;
+         if (isDead(node, now))
+         {
+            erase(node);
+         }
+         else if (now < node->absoluteExpiry())
+         {
+            node->encodeRRList(strm);
+         }
+      }
+   }
+   strm.flush();
+}
+
+bool
+RRCache::save(const Data& path)
+{
+   Data snapshot;
+   encodeSnapshot(snapshot);
+   return writeSnapshot(path, snapshot);
+}
+
+bool
+RRCache::writeSnapshot(const Data& path, const Data& snapshot)
+{
+   Data tmp = path + ".tmp";
    {
-      if (now >= (*it)->absoluteExpiry())
+      ofstream os(tmp.c_str(), ios::binary | ios::trunc);
+      if (!os.is_open())
       {
-         delete *it;
-         mRRSet.erase(it++);
+         WarningLog(<< "Could not open " << tmp << " to save the DNS cache");
+         return false;
       }
-      else
+      os.write(snapshot.data(), snapshot.size());
+      os.close();
+      if (os.fail())
       {
-         (*it)->encodeRRList(strm);
-         ++it;
+         WarningLog(<< "Could not write the DNS cache to " << tmp);
+         remove(tmp.c_str());
+         return false;
       }
    }
-   strm.flush();
+#ifdef WIN32
+   remove(path.c_str());
+#endif
+   if (rename(tmp.c_str(), path.c_str()) != 0)
+   {
+      WarningLog(<< "Could not rename " << tmp << " to " << path);
+      remove(tmp.c_str());
+      return false;
+   }
+   return true;
+}
+
+int
+RRCache::load(const Data& path)
+{
+   Data snapshot;
+   try
+   {
+      snapshot = Data::fromFile(path);
+   }
+   catch (BaseException&)
+   {
+      InfoLog(<< "No DNS cache snapshot in " << path);
+      return -1;
+   }
+
+   int loaded = decodeSnapshot(snapshot);
+   if (loaded < 0)
+   {
+      WarningLog(<< "Ignoring malformed DNS cache snapshot " << path);
+   }
+   return loaded;
+}
+
+void
+RRCache::encodeSnapshot(Data& snapshot)
+{
+   snapshot.append(SnapshotMagic, SnapshotMagicSize);
+   put16(snapshot, SnapshotVersion);
+
+   UInt64 now = Timer::getTimeSecs();
+   for (RRMaps::iterator m = mRRMaps.begin(); m != mRRMaps.end(); ++m)
+   {
+      for (RRMap::iterator it = m->second.begin(); it != m->second.end(); ++it)
+      {
+         RRList* node = it->second;
+         if (now >= node->absoluteExpiry() || node->key().size() > 0xFFFF)
+         {
+            continue;
+         }
+         UInt64 remaining = node->absoluteExpiry() - now;
+         if (remaining > 0x7FFFFFFF)
+         {
+            remaining = 0x7FFFFFFF;
+         }
+
+         Data records;
+         unsigned int count = 0;
+         Result rrs = node->records(RRList::Protocol::Reserved);
+         for (Result::const_iterator r = rrs.begin(); r != rrs.end() && count < 0xFFFF; ++r)
+         {
+            Data rr;
+            if (encodeRecord(rr, node->rrType(), **r, (UInt32)remaining))
+            {
+               put16(records, (unsigned int)rr.size());
+               records += rr;
+               ++count;
+            }
+         }
+         if (count == 0 && !rrs.empty())
+         {
+            continue;
+         }
+
+         put16(snapshot, node->rrType());
+         put32(snapshot, (UInt32)node->status());
+         put32(snapshot, (UInt32)remaining);
+         put16(snapshot, (unsigned int)node->key().size());
+         snapshot += node->key();
+         put16(snapshot, count);
+         snapshot += records;
+      }
+   }
+}
+
+int
+RRCache::decodeSnapshot(const Data& snapshot)
+{
+   const unsigned char* p = (const unsigned char*)snapshot.data();
+   const unsigned char* end = p + snapshot.size();
+   if (snapshot.size() < SnapshotMagicSize + 2 ||
+       memcmp(p, SnapshotMagic, SnapshotMagicSize) != 0 ||
+       get16(p + SnapshotMagicSize) != SnapshotVersion)
+   {
+      return -1;
+   }
+   p += SnapshotMagicSize + 2;
+
+   UInt64 now = Timer::getTimeSecs();
+   int loaded = 0;
+   while (p < end)
+   {
+      if (end - p < 12)
+      {
+         return -1;
+      }
+      int rrType = get16(p);
+      int status = (int)get32(p + 2);
+      UInt32 remaining = get32(p + 6);
+      unsigned int keyLen = get16(p + 10);
+      p += 12;
+      if ((unsigned int)(end - p) < keyLen + 2)
+      {
+         return -1;
+      }
+      Data key(p, keyLen);
+      p += keyLen;
+      unsigned int count = get16(p);
+      p += 2;
+
+      std::vector<RROverlay> overlays;
+      try
+      {
+         for (unsigned int i = 0; i < count; ++i)
+         {
+            if (end - p < 2 || (unsigned int)(end - p - 2) < get16(p))
+            {
+               return -1;
+            }
+            int len = get16(p);
+            overlays.push_back(RROverlay(p + 2, p + 2, len));
+            p += 2 + len;
+         }
+      }
+      catch (BaseException&)
+      {
+         return -1;
+      }
+
+      FactoryMap::iterator factory = mFactoryMap.find(rrType);
+      if (remaining == 0 || factory == mFactoryMap.end() || find(key, rrType))
+      {
+         // expired, unsupported here, or already known to be fresher
+         continue;
+      }
+
+      RRList* node = overlays.empty()
+         ? new RRList(key, rrType, (int)remaining, status)
+         : new RRList(factory->second, key, rrType, overlays.begin(), overlays.end(), (int)remaining);
+      node->absoluteExpiry() = now + remaining;
+      insert(node);
+      ++loaded;
+   }
+   return loaded;
 }
 
 /* ====================================================================
@@ -2,9 +2,9 @@
 #define RESIP_RRCACHE_HXX
 
 #include <map>
-#include <set>
 #include <memory>
 
+#include "rutil/HashMap.hxx"
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
 #include "rutil/dns/DnsAAAARecord.hxx"
@@ -18,6 +18,23 @@ namespace resip
 {
 class RROverlay;
 
+/**
+   Records are kept in one hash table per record type, with an LRU list
+   across all of them that bounds the total number of entries.
+
+   Two things keep expiring records off the request path:
+   - prefetch: a lookup that hits an entry in the last part of its
+     lifetime (see setPrefetch()) tells the caller to refresh the entry in
+     the background, once per entry.
+   - serve-stale: expired entries are kept for a while longer (see
+     setStaleTTL()). lookup() does not return them, but lookupStale()
+     does, for use when the resolver fails to answer.
+
+   The unexpired part of the cache can be written to a file with save()
+   and read back with load(), so that a restarted process does not start
+   cold. Each record is stored as an uncompressed wire format RR carrying
+   its remaining TTL, and is parsed back by the usual record factories.
+*/
 class RRCache
 {
    public:
@@ -31,6 +48,10 @@ class RRCache
       ~RRCache();
       void setTTL(int ttl) { if (ttl > 0) mUserDefinedTTL = ttl * MIN_TO_SEC; }
       void setSize(int size) { mSize = size; }
+      /// refresh entries looked up in the last percent of their TTL; 0 disables
+      void setPrefetch(int percent) { mPrefetchPercent = (percent > 0 && percent < 100) ? percent : 0; }
+      /// keep expired entries for secs for lookupStale(); 0 disables
+      void setStaleTTL(int secs) { mStaleTTL = secs > 0 ? secs : 0; }
       // Update existing cache record, or add a new one
       void updateCache(const Data& target,
                        const int rrType,
@@ -43,46 +64,47 @@ class RRCache
                     const int status,
                     RROverlay overlay);
       bool lookup(const Data& target, const int type, const int proto, Result& records, int& status);
+      /// as above; refresh is set if the caller should refresh the entry now
+      bool lookup(const Data& target, const int type, const int proto, Result& records, int& status, bool& refresh);
+      /// finds an entry even if it expired within the stale TTL
+      bool lookupStale(const Data& target, const int type, const int proto, Result& records, int& status);
       void clearCache();
       void logCache();
       void getCacheDump(Data& dnsCacheDump);
+      size_t size() const { return mCount; }
+      /// writes unexpired entries to path (via a temporary file); false on error
+      bool save(const Data& path);
+      /// save() in two steps, so that the file can be written on another thread
+      void encodeSnapshot(Data& snapshot);
+      static bool writeSnapshot(const Data& path, const Data& snapshot);
+      /// adds the unexpired entries found in path; returns how many, or -1 on error
+      int load(const Data& path);
 
    private:
       static const int MIN_TO_SEC = 60;
       static const int DEFAULT_USER_DEFINED_TTL = 10; // in seconds.
 
       static const int DEFAULT_SIZE = 512;
-      class CompareT  : public std::binary_function<const RRList*, const RRList*, bool>
-      {
-         public:
-            bool operator()(RRList* lhs, RRList* rhs) const
-            {
-               if (lhs->rrType() < rhs->rrType())
-               {
-                  return true;
-               }
-               else if (lhs->rrType() > rhs->rrType())
-               {
-                  return false;
-               }
-               else
-               {
-                  return lhs->key() < rhs->key();
-               }
-            }
-      };
 
+      typedef HashMap<Data, RRList*> RRMap;
+      typedef std::map<int, RRMap> RRMaps; // by type
+
+      RRList* find(const Data& target, const int type);
+      void insert(RRList* node);
+      void erase(RRList* node);
       void touch(RRList* node);
       void cleanup();
       int getTTL(const RROverlay& overlay);
       void purge();
+      bool isDead(const RRList* node, UInt64 now) const;
+      int decodeSnapshot(const Data& snapshot);
 
       RRList mHead;
       LruListType* mLruHead;                     
       Result Empty;
 
-      typedef std::set<RRList*, CompareT> RRSet;
-      RRSet mRRSet;
+      RRMaps mRRMaps;
+      size_t mCount;
 
       RRFactory<DnsHostRecord> mHostRecordFactory;
       RRFactory<DnsSrvRecord> mSrvRecordFactory;
@@ -95,6 +117,8 @@ class RRCache
       
       int mUserDefinedTTL; // used when the ttl in RR is 0 or less than default(60). in seconds.
       unsigned int mSize;
+      int mPrefetchPercent;
+      int mStaleTTL; // in seconds
 };
 
 }
@@ -52,6 +52,9 @@ class RRList : public IntrusiveListElement<RRList*>
       int rrType() const { return mRRType; }
       UInt64 absoluteExpiry() const { return mAbsoluteExpiry; }
       UInt64& absoluteExpiry() { return mAbsoluteExpiry; }
+      UInt64 ttl() const { return mTTL; } // as of the last update, in seconds
+      bool refreshRequested() const { return mRefreshRequested; }
+      bool& refreshRequested() { return mRefreshRequested; }
       void log();
       EncodeStream& encodeRRList(EncodeStream& strm);
 
@@ -73,6 +76,8 @@ class RRList : public IntrusiveListElement<RRList*>
 
       int mStatus; // dns query status.
       UInt64 mAbsoluteExpiry;
+      UInt64 mTTL;
+      bool mRefreshRequested; // cleared by updates
 
       RecordItr find(const Data&);
       void clear();
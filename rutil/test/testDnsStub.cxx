@@ -0,0 +1,520 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Time.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/dns/DnsStub.hxx"
+#include "rutil/dns/ExternalDns.hxx"
+#include "rutil/dns/ExternalDnsFactory.hxx"
+#include "rutil/dns/QueryTypes.hxx"
+#include "rutil/dns/RRCache.hxx"
+#include "rutil/dns/RROverlay.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Records the queries DnsStub sends, so that the test can answer them.
+class FakeDns : public ExternalDns
+{
+   public:
+      struct Sent
+      {
+         Data target;
+         unsigned short type;
+         ExternalDnsHandler* handler;
+         void* userData;
+      };
+
+      virtual int init(const std::vector<GenericIPAddress>&, AfterSocketCreationFuncPtr,
+                       int, int, unsigned int) { return Success; }
+      virtual bool checkDnsChange() { return false; }
+      virtual unsigned int getTimeTillNextProcessMS() { return 1000; }
+      virtual void buildFdSet(fd_set&, fd_set&, int&) {}
+      virtual void process(fd_set&, fd_set&) {}
+      virtual void setPollGrp(FdPollGrp*) {}
+      virtual void processTimers() {}
+      virtual void freeResult(ExternalDnsRawResult) {}
+      virtual void freeResult(ExternalDnsHostResult) {}
+      virtual char* errorMessage(long errorCode)
+      {
+         char* msg = new char[32];
+         snprintf(msg, 32, "error %ld", errorCode);
+         return msg;
+      }
+      virtual void lookup(const char* target, unsigned short type, ExternalDnsHandler* handler, void* userData)
+      {
+         Sent s;
+         s.target = target;
+         s.type = type;
+         s.handler = handler;
+         s.userData = userData;
+         mSent.push_back(s);
+      }
+      virtual bool hostFileLookup(const char*, in_addr&) { return false; }
+      virtual bool hostFileLookupLookupOnlyMode() { return false; }
+
+      // answers the oldest outstanding query
+      void answer(const std::vector<unsigned char>& response, int status = 0)
+      {
+         assert(!mSent.empty());
+         Sent s = mSent.front();
+         mSent.erase(mSent.begin());
+         s.handler->handleDnsRaw(ExternalDnsRawResult(status, (unsigned char*)&response[0], (int)response.size(), s.userData));
+      }
+
+      std::vector<Sent> mSent;
+};
+
+static FakeDns* fakeDns = 0;
+
+class FakeDnsCreator : public ExternalDnsCreator
+{
+   public:
+      virtual ExternalDns* createExternalDns()
+      {
+         fakeDns = new FakeDns;
+         return fakeDns;
+      }
+};
+
+class CountingSink : public DnsResultSink
+{
+   public:
+      CountingSink() : mResults(0), mRecords(0), mStatus(-1) {}
+      virtual void onDnsResult(const DNSResult<DnsHostRecord>& r) { ++mResults; mRecords += (int)r.records.size(); mStatus = r.status; }
+      virtual void onDnsResult(const DNSResult<DnsAAAARecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsSrvRecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsNaptrRecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsCnameRecord>&) { assert(0); }
+      int mResults;
+      int mRecords;
+      int mStatus;
+};
+
+static void
+put16(std::vector<unsigned char>& buf, unsigned int v)
+{
+   buf.push_back((unsigned char)(v >> 8));
+   buf.push_back((unsigned char)v);
+}
+
+static void
+putName(std::vector<unsigned char>& buf, const char* name)
+{
+   const char* label = name;
+   while (*label)
+   {
+      const char* dot = strchr(label, '.');
+      size_t len = dot ? (size_t)(dot - label) : strlen(label);
+      buf.push_back((unsigned char)len);
+      buf.insert(buf.end(), label, label + len);
+      label += len + (dot ? 1 : 0);
+   }
+   buf.push_back(0);
+}
+
+static void
+putString(std::vector<unsigned char>& buf, const char* str)
+{
+   buf.push_back((unsigned char)strlen(str));
+   buf.insert(buf.end(), str, str + strlen(str));
+}
+
+static const int ServFail = 3; // ARES_ESERVFAIL
+
+// A response to an A query for name, with one answer if addr is given.
+static std::vector<unsigned char>
+makeResponse(const char* name, const unsigned char* addr, unsigned int ttl = 300)
+{
+   std::vector<unsigned char> buf;
+   put16(buf, 0x1234);            // id
+   put16(buf, 0x8180);            // response, recursion desired/available
+   put16(buf, 1);                 // qdcount
+   put16(buf, addr ? 1 : 0);      // ancount
+   put16(buf, 0);                 // nscount
+   put16(buf, 0);                 // arcount
+
+   putName(buf, name);
+   put16(buf, 1);                 // A
+   put16(buf, 1);                 // IN
+
+   if (addr)
+   {
+      put16(buf, 0xC00C);         // name of the question
+      put16(buf, 1);
+      put16(buf, 1);
+      put16(buf, ttl >> 16);
+      put16(buf, ttl & 0xFFFF);
+      put16(buf, 4);
+      buf.insert(buf.end(), addr, addr + 4);
+   }
+   return buf;
+}
+
+// A lone resource record, which is all an RROverlay needs if the names in
+// it are not compressed.
+static std::vector<unsigned char>
+makeRecord(const char* name, int type, const std::vector<unsigned char>& rdata)
+{
+   std::vector<unsigned char> buf;
+   putName(buf, name);
+   put16(buf, type);
+   put16(buf, 1);                 // IN
+   put16(buf, 0);
+   put16(buf, 300);               // ttl
+   put16(buf, (unsigned int)rdata.size());
+   buf.insert(buf.end(), rdata.begin(), rdata.end());
+   return buf;
+}
+
+// Every record type kept by RRCache survives save() and load().
+static void
+testSnapshotRecords(const Data& path)
+{
+   RRCache cache;
+
+   std::vector<unsigned char> srv;
+   put16(srv, 10);
+   put16(srv, 60);
+   put16(srv, 5060);
+   putName(srv, "proxy1.example.com");
+   std::vector<unsigned char> srvRR = makeRecord("_sip._udp.example.com", RR_SRV::getRRType(), srv);
+
+   std::vector<unsigned char> naptr;
+   put16(naptr, 100);
+   put16(naptr, 10);
+   putString(naptr, "u");
+   putString(naptr, "E2U+sip");
+   putString(naptr, "!^.*$!sip:info@example.com!");
+   naptr.push_back(0);
+   std::vector<unsigned char> naptrRR = makeRecord("4.3.2.1.e164.arpa", RR_NAPTR::getRRType(), naptr);
+
+   std::vector<unsigned char> cname;
+   putName(cname, "real.example.com");
+   std::vector<unsigned char> cnameRR = makeRecord("alias.example.com", RR_CNAME::getRRType(), cname);
+
+   std::vector<RROverlay> overlays;
+   overlays.push_back(RROverlay(&srvRR[0], &srvRR[0], (int)srvRR.size()));
+   cache.updateCache("_sip._udp.example.com", RR_SRV::getRRType(), overlays.begin(), overlays.end());
+   overlays.clear();
+   overlays.push_back(RROverlay(&naptrRR[0], &naptrRR[0], (int)naptrRR.size()));
+   cache.updateCache("4.3.2.1.e164.arpa", RR_NAPTR::getRRType(), overlays.begin(), overlays.end());
+   overlays.clear();
+   overlays.push_back(RROverlay(&cnameRR[0], &cnameRR[0], (int)cnameRR.size()));
+   cache.updateCache("alias.example.com", RR_CNAME::getRRType(), overlays.begin(), overlays.end());
+   assert(cache.save(path));
+
+   RRCache restored;
+   assert(restored.load(path) == 3);
+   assert(restored.load(path) == 0);  // nothing fresher in the file
+
+   RRCache::Result records;
+   int status;
+   assert(restored.lookup("_sip._udp.example.com", RR_SRV::getRRType(), Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   const DnsSrvRecord* s = static_cast<const DnsSrvRecord*>(records[0]);
+   assert(s->priority() == 10 && s->weight() == 60 && s->port() == 5060);
+   assert(s->target() == "proxy1.example.com");
+
+   assert(restored.lookup("4.3.2.1.e164.arpa", RR_NAPTR::getRRType(), Protocol::Enum, records, status));
+   assert(records.size() == 1);
+   const DnsNaptrRecord* n = static_cast<const DnsNaptrRecord*>(records[0]);
+   assert(n->order() == 100 && n->preference() == 10);
+   assert(n->flags() == "u" && n->service() == "E2U+sip");
+   assert(n->regexp().regexp() == "^.*$");
+   assert(n->regexp().replacement() == "sip:info@example.com");
+
+   assert(restored.lookup("alias.example.com", RR_CNAME::getRRType(), Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   assert(static_cast<const DnsCnameRecord*>(records[0])->cname() == "real.example.com");
+
+   const char junk[] = "RESIPDNS\0\1\0";
+   {
+      FILE* f = fopen(path.c_str(), "wb");
+      fwrite(junk, 1, sizeof(junk), f);
+      fclose(f);
+   }
+   RRCache broken;
+   assert(broken.load(path) == -1);
+   assert(broken.size() == 0);
+   remove(path.c_str());
+   assert(broken.load(path) == -1);
+}
+
+// What a snapshot of a large cache costs: encoding it (done on the DNS
+// thread), writing it (done by the snapshot writer) and loading it at
+// startup, against sending one query per name to warm up.
+static void
+testSnapshotCost(const Data& path, unsigned int entries)
+{
+   RRCache cache;
+   cache.setSize(entries);
+   const unsigned char addr[] = { 192, 0, 2, 1 };
+   std::vector<unsigned char> rdata(addr, addr + sizeof(addr));
+   for (unsigned int i = 0; i < entries; ++i)
+   {
+      Data name(Data("host") + Data(i) + ".example.com");
+      std::vector<unsigned char> rr = makeRecord(name.c_str(), RR_A::getRRType(), rdata);
+      std::vector<RROverlay> overlays;
+      overlays.push_back(RROverlay(&rr[0], &rr[0], (int)rr.size()));
+      cache.updateCache(name, RR_A::getRRType(), overlays.begin(), overlays.end());
+   }
+   assert(cache.size() == entries);
+
+   UInt64 start = Timer::getTimeMicroSec();
+   Data snapshot;
+   cache.encodeSnapshot(snapshot);
+   UInt64 encoded = Timer::getTimeMicroSec();
+   assert(RRCache::writeSnapshot(path, snapshot));
+   UInt64 written = Timer::getTimeMicroSec();
+
+   RRCache restored;
+   restored.setSize(entries);
+   assert(restored.load(path) == (int)entries);
+   UInt64 loaded = Timer::getTimeMicroSec();
+   remove(path.c_str());
+
+   resipCerr << entries << " entries, " << snapshot.size() << " bytes: encoded in "
+             << (encoded - start)/1000 << "ms, written in " << (written - encoded)/1000
+             << "ms, loaded in " << (loaded - written)/1000 << "ms instead of "
+             << entries << " queries" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   FakeDnsCreator creator;
+   ExternalDnsFactory::setExternalCreator(&creator);
+   DnsStub stub;
+   assert(fakeDns);
+
+   const unsigned char addr[4] = { 192, 0, 2, 1 };
+   const int Sinks = 50;
+
+   {
+      // a burst of lookups for one name shares a single query
+      CountingSink sinks[Sinks];
+      for (int i = 0; i < Sinks; ++i)
+      {
+         stub.lookup<RR_A>(i % 2 ? "Carrier.Example.com" : "carrier.example.com", &sinks[i]);
+      }
+      stub.processTimers();
+      assert(fakeDns->mSent.size() == 1);
+      assert(stub.getQueriesSent() == 1);
+      assert(stub.getQueriesCoalesced() == Sinks - 1);
+      assert(stub.getQueriesPending() == 1);
+
+      fakeDns->answer(makeResponse("carrier.example.com", addr));
+      assert(stub.getQueriesPending() == 0);
+      for (int i = 0; i < Sinks; ++i)
+      {
+         assert(sinks[i].mResults == 1);
+         assert(sinks[i].mRecords == 1);
+         assert(sinks[i].mStatus == 0);
+      }
+
+      // now cached; no query at all
+      CountingSink late;
+      stub.lookup<RR_A>("carrier.example.com", &late);
+      stub.processTimers();
+      assert(fakeDns->mSent.empty());
+      assert(late.mResults == 1 && late.mRecords == 1);
+   }
+
+   {
+      // different types or names are not shared, and an empty answer is
+      // passed on to everyone waiting
+      CountingSink a1, a2, other;
+      stub.lookup<RR_A>("empty.example.com", &a1);
+      stub.lookup<RR_A>("other.example.com", &other);
+      stub.lookup<RR_A>("empty.example.com", &a2);
+      stub.processTimers();
+      assert(fakeDns->mSent.size() == 2);
+      assert(stub.getQueriesSent() == 3);
+      assert(stub.getQueriesCoalesced() == Sinks);
+
+      fakeDns->answer(makeResponse("empty.example.com", 0));
+      assert(a1.mResults == 1 && a1.mRecords == 0);
+      assert(a2.mResults == 1 && a2.mRecords == 0);
+      assert(other.mResults == 0);
+
+      fakeDns->answer(makeResponse("other.example.com", addr));
+      assert(other.mResults == 1 && other.mRecords == 1);
+      assert(stub.getQueriesPending() == 0);
+   }
+
+   {
+      // Popular records are refreshed before they expire, and used for a
+      // while after they expired if the server stops answering. TTLs are
+      // at least 10s, so this takes a while.
+      stub.setDnsCachePrefetch(90);
+      stub.setDnsCacheStaleTTL(60);
+      UInt64 start = Timer::getTimeMs();
+
+      CountingSink first;
+      stub.lookup<RR_A>("hot.example.com", &first);
+      stub.processTimers();
+      fakeDns->answer(makeResponse("hot.example.com", addr, 10));
+      assert(first.mRecords == 1);
+
+      sleepSeconds(2);
+      CountingSink second;
+      stub.lookup<RR_A>("hot.example.com", &second);
+      stub.processTimers();
+      assert(second.mResults == 1 && second.mRecords == 1);
+      assert(fakeDns->mSent.size() == 1);  // the refresh
+
+      // only one refresh per entry
+      CountingSink third;
+      stub.lookup<RR_A>("hot.example.com", &third);
+      stub.processTimers();
+      assert(third.mRecords == 1);
+      assert(fakeDns->mSent.size() == 1);
+      fakeDns->answer(makeResponse("hot.example.com", 0), ServFail);
+
+      while (Timer::getTimeMs() - start < 11000)
+      {
+         sleepMs(100);
+      }
+      CountingSink stale;
+      stub.lookup<RR_A>("hot.example.com", &stale);
+      stub.processTimers();
+      assert(stale.mResults == 0);
+      assert(fakeDns->mSent.size() == 1);  // expired, so asked again
+      fakeDns->answer(makeResponse("hot.example.com", 0), ServFail);
+      assert(stale.mResults == 1 && stale.mRecords == 1 && stale.mStatus == 0);
+   }
+
+   {
+      // a restarted stub picks up where the last one stopped
+      const Data path("testDnsStub.cache");
+      testSnapshotRecords(path);
+
+      stub.saveDnsCache(path);
+      stub.processTimers();
+
+      FakeDns* first = fakeDns;
+      DnsStub* restarted = new DnsStub;
+      FakeDns* second = fakeDns;
+      restarted->setDnsCacheSnapshot(path, 3600);
+      restarted->processTimers();
+
+      CountingSink warm;
+      restarted->lookup<RR_A>("carrier.example.com", &warm);
+      restarted->lookup<RR_A>("other.example.com", &warm);
+      restarted->processTimers();
+      assert(second->mSent.empty());
+      assert(warm.mResults == 2 && warm.mRecords == 2);
+
+      // and saves what it learnt when it goes away
+      CountingSink fresh;
+      restarted->lookup<RR_A>("new.example.com", &fresh);
+      restarted->processTimers();
+      second->answer(makeResponse("new.example.com", addr));
+      delete restarted;
+      fakeDns = first;
+
+      RRCache saved;
+      assert(saved.load(path) >= 3);
+      RRCache::Result records;
+      int status;
+      assert(saved.lookup("new.example.com", RR_A::getRRType(), Protocol::Sip, records, status));
+      remove(path.c_str());
+   }
+
+   {
+      // periodic snapshots are written by a thread of the stub's own
+      const Data path("testDnsStub.periodic");
+      remove(path.c_str());
+      stub.setDnsCacheSnapshot(path, 1);
+      stub.processTimers();
+      sleepMs(1100);
+      stub.processTimers();
+
+      RRCache saved;
+      UInt64 end = Timer::getTimeMs() + 5000;
+      while (saved.load(path) < 0 && Timer::getTimeMs() < end)
+      {
+         sleepMs(10);
+      }
+      RRCache::Result records;
+      int status;
+      assert(saved.lookup("carrier.example.com", RR_A::getRRType(), Protocol::Sip, records, status));
+
+      stub.setDnsCacheSnapshot(Data::Empty, 0);
+      stub.processTimers();
+      remove(path.c_str());
+   }
+
+   testSnapshotCost("testDnsStub.large", 100000);
+
+   {
+      // a query still outstanding when the stub goes away is cleaned up
+      CountingSink s;
+      stub.lookup<RR_A>("slow.example.com", &s);
+      stub.processTimers();
+      assert(stub.getQueriesPending() == 1);
+   }
+
+   resipCerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
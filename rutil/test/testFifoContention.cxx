@@ -0,0 +1,253 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Fifo.hxx"
+#include "rutil/TimeLimitFifo.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+/*
+   Checks the FifoLockFreeMpsc mode of Fifo/TimeLimitFifo and compares it
+   with the locking mode with several producer threads hammering one
+   consumer. Arguments: [producers [messages per producer]]
+*/
+
+class Item
+{
+   public:
+      Item(unsigned int producer, unsigned int seq) : mProducer(producer), mSeq(seq) {}
+      unsigned int mProducer;
+      unsigned int mSeq;
+};
+
+class Producer : public ThreadIf
+{
+   public:
+      Producer(Fifo<Item>& fifo, unsigned int id, unsigned int count)
+         : mFifo(fifo), mId(id), mCount(count)
+      {}
+
+      void thread()
+      {
+         for (unsigned int i = 0; i < mCount; ++i)
+         {
+            if (i % 64 == 63)
+            {
+               Fifo<Item>::Messages batch;
+               batch.push_back(new Item(mId, i));
+               mFifo.addMultiple(batch);
+            }
+            else
+            {
+               mFifo.add(new Item(mId, i));
+            }
+         }
+      }
+
+   private:
+      Fifo<Item>& mFifo;
+      unsigned int mId;
+      unsigned int mCount;
+};
+
+/**
+   Runs producers against a single consumer which alternates between the
+   different get flavours; checks that every message arrives exactly once
+   and in order per producer. Returns the wall clock time in ms.
+*/
+static UInt64
+contend(FifoMode mode, unsigned int producers, unsigned int count)
+{
+   Fifo<Item> fifo(0, mode);
+   assert(fifo.getMode() == mode);
+   std::vector<unsigned int> next(producers, 0);
+   std::vector<Producer*> threads;
+
+   UInt64 start = Timer::getTimeMs();
+   for (unsigned int p = 0; p < producers; ++p)
+   {
+      threads.push_back(new Producer(fifo, p, count));
+      threads.back()->run();
+   }
+
+   const unsigned int total = producers*count;
+   unsigned int received = 0;
+   unsigned int round = 0;
+   while (received < total)
+   {
+      Fifo<Item>::Messages batch;
+      switch (round++ % 4)
+      {
+         case 0:
+            batch.push_back(fifo.getNext());
+            break;
+         case 1:
+         {
+            Item* item = fifo.getNext(100);
+            if (item)
+            {
+               batch.push_back(item);
+            }
+            break;
+         }
+         case 2:
+         {
+            Item* item = fifo.getNext(RESIP_FIFO_NOWAIT);
+            if (item)
+            {
+               batch.push_back(item);
+            }
+            break;
+         }
+         default:
+            fifo.getMultiple(100, batch, 32);
+            break;
+      }
+
+      for (Fifo<Item>::Messages::iterator i = batch.begin(); i != batch.end(); ++i)
+      {
+         Item* item = *i;
+         assert(item->mProducer < producers);
+         assert(item->mSeq == next[item->mProducer]);
+         ++next[item->mProducer];
+         ++received;
+         delete item;
+      }
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+
+   for (unsigned int p = 0; p < producers; ++p)
+   {
+      threads[p]->join();
+      delete threads[p];
+      assert(next[p] == count);
+   }
+   assert(fifo.empty());
+   assert(fifo.size() == 0);
+   assert(fifo.getCountDepth() == 0);
+   return elapsed;
+}
+
+static void
+testTimeLimitFifo()
+{
+   TimeLimitFifo<Item> tlf(5, 10, FifoLockFreeMpsc);
+   assert(tlf.getMode() == FifoLockFreeMpsc);
+   assert(tlf.empty());
+   assert(tlf.timeDepth() == 0);
+
+   // 8 of 10 are unreserved
+   for (unsigned int i = 0; i < 8; ++i)
+   {
+      assert(tlf.add(new Item(0, i), TimeLimitFifo<Item>::EnforceTimeDepth));
+   }
+   assert(!tlf.wouldAccept(TimeLimitFifo<Item>::IgnoreTimeDepth));
+   Item* rejected = new Item(0, 8);
+   assert(!tlf.add(rejected, TimeLimitFifo<Item>::EnforceTimeDepth));
+   delete rejected;
+   assert(tlf.add(new Item(0, 8), TimeLimitFifo<Item>::InternalElement));
+   assert(tlf.add(new Item(0, 9), TimeLimitFifo<Item>::InternalElement));
+   assert(!tlf.wouldAccept(TimeLimitFifo<Item>::InternalElement));
+   assert(tlf.size() == 10);
+   assert(tlf.getCountDepth() == 10);
+   assert(tlf.timeDepth() <= 1);
+
+   Item* item = tlf.getNext();
+   assert(item->mSeq == 0);
+   delete item;
+   item = tlf.getNext(10);
+   assert(item->mSeq == 1);
+   delete item;
+   assert(tlf.size() == 8);
+
+   tlf.clear();
+   assert(tlf.empty());
+   assert(tlf.getNext(RESIP_FIFO_NOWAIT) == 0);
+   assert(tlf.getNext(10) == 0);
+   assert(tlf.timeDepth() == 0);
+
+   // the destructor cleans up what is left
+   tlf.add(new Item(0, 0), TimeLimitFifo<Item>::IgnoreTimeDepth);
+   cerr << "TimeLimitFifo with FifoLockFreeMpsc OK" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int producers = 4;
+   unsigned int count = 200000;
+   if (argc > 1)
+   {
+      producers = atoi(argv[1]);
+   }
+   if (argc > 2)
+   {
+      count = atoi(argv[2]);
+   }
+
+   testTimeLimitFifo();
+
+   UInt64 locking = contend(FifoLocking, producers, count);
+   UInt64 lockFree = contend(FifoLockFreeMpsc, producers, count);
+   cout << producers << " producers x " << count << " messages, one consumer:" << endl
+        << "  FifoLocking:      " << locking << " ms" << endl
+        << "  FifoLockFreeMpsc: " << lockFree << " ms" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
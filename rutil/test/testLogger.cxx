@@ -1,4 +1,8 @@
 
+#include <cassert>
+#include <fstream>
+#include <vector>
+
 #include "rutil/Logger.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/ThreadIf.hxx"
@@ -130,6 +134,94 @@ testThreadLocalLoggers(const char *appname)
    }
 }
 
+class FloodThread : public ThreadIf
+{
+   public:
+      FloodThread(int lines) : mLines(lines) {}
+
+      void thread()
+      {
+         for (int i = 0; i < mLines; ++i)
+         {
+            InfoLog(<< "flood line " << i << " from a thread logging as fast as it can");
+         }
+      }
+   private:
+      int mLines;
+};
+
+static int
+countLines(const char* fileName)
+{
+   ifstream in(fileName);
+   int lines = 0;
+   string line;
+   while (getline(in, line))
+   {
+      ++lines;
+   }
+   return lines;
+}
+
+static UInt64
+flood(int threads, int lines)
+{
+   vector<FloodThread*> flooders;
+   UInt64 start = Timer::getTimeMs();
+   for (int t = 0; t < threads; ++t)
+   {
+      flooders.push_back(new FloodThread(lines));
+      flooders.back()->run();
+   }
+   for (int t = 0; t < threads; ++t)
+   {
+      flooders[t]->join();
+      delete flooders[t];
+   }
+   return Timer::getTimeMs() - start;
+}
+
+void
+testAsynchronous(const char *appname)
+{
+   const char* fileName = "testLogger-async.txt";
+   const int threads = 4;
+   const int lines = 20000;
+
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, appname, fileName);
+   UInt64 syncMs = flood(threads, lines);
+   assert(countLines(fileName) == threads * lines);
+
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, appname, fileName);
+   Log::setAsynchronous(4*1024*1024);
+   assert(Log::isAsynchronous());
+   UInt64 asyncMs = flood(threads, lines);
+   Log::flush();
+   assert(Log::getDroppedLines() == 0);
+   assert(countLines(fileName) == threads * lines);
+
+   cerr << threads << " threads logging " << lines << " lines each: "
+        << syncMs << " ms synchronously, " << asyncMs << " ms asynchronously" << endl;
+
+   // lines that do not fit in the buffer are dropped, and the writer says so
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, appname, fileName);
+   Log::setAsynchronous(64);
+   flood(1, 1000);
+   Log::flush();
+   assert(Log::getDroppedLines() == 1000);
+   int written = countLines(fileName);
+   assert(written > 0);
+
+   Log::setAsynchronous(0);
+   assert(!Log::isAsynchronous());
+   InfoLog(<< "written synchronously");
+   assert(countLines(fileName) == written + 1);
+   remove(fileName);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -248,6 +340,9 @@ main(int argc, char* argv[])
    cout << endl;
    testThreadLocalLoggers(argv[0]);
 
+   testAsynchronous(argv[0]);
+   Log::initialize(Log::Cout, Log::Info, argv[0]);
+
    return 0;
 }
 
@@ -0,0 +1,240 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "rutil/SnapshotPtr.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+/*
+   Checks that SnapshotPtr never lets a Reader see a snapshot that has
+   been deleted, with several reader threads running while another
+   publishes new snapshots as fast as it can.
+   Arguments: [readers [publishes]]
+*/
+
+// Snapshots come out of one slab that is only freed at the end of the
+// test, so that a reader that got hold of a deleted one finds it poisoned
+// rather than reused.
+class Table
+{
+   public:
+      enum { Values = 64 };
+      static const UInt32 Alive = 0x600dcafe;
+      static const UInt32 Dead = 0xdeadbeef;
+
+      explicit Table(UInt32 version) : mMagic(Alive), mVersion(version)
+      {
+         for (unsigned int i = 0; i < Values; ++i)
+         {
+            mValues[i] = version;
+         }
+         Lock lock(sMutex);
+         ++sCreated;
+      }
+
+      ~Table()
+      {
+         mMagic = Dead;
+         for (unsigned int i = 0; i < Values; ++i)
+         {
+            mValues[i] = Dead;
+         }
+         Lock lock(sMutex);
+         ++sDeleted;
+      }
+
+      static void reserve(unsigned int count)
+      {
+         sSlab = static_cast<char*>(malloc(count * sizeof(Table)));
+         sSlots = count;
+         sUsed = 0;
+      }
+
+      static void* operator new(size_t size)
+      {
+         Lock lock(sMutex);
+         if (!sSlab || size != sizeof(Table) || sUsed == sSlots)
+         {
+            throw std::bad_alloc();
+         }
+         return sSlab + sizeof(Table) * sUsed++;
+      }
+
+      static void operator delete(void*)
+      {
+      }
+
+      static void freeSlab()
+      {
+         free(sSlab);
+         sSlab = 0;
+      }
+
+      volatile UInt32 mMagic;
+      UInt32 mVersion;
+      volatile UInt32 mValues[Values];
+
+      static Mutex sMutex;
+      static unsigned int sCreated;
+      static unsigned int sDeleted;
+      static char* sSlab;
+      static unsigned int sSlots;
+      static unsigned int sUsed;
+};
+
+Mutex Table::sMutex;
+unsigned int Table::sCreated = 0;
+unsigned int Table::sDeleted = 0;
+char* Table::sSlab = 0;
+unsigned int Table::sSlots = 0;
+unsigned int Table::sUsed = 0;
+
+class Reader : public ThreadIf
+{
+   public:
+      Reader(SnapshotPtr<Table>& ptr) : mPtr(ptr), mReads(0), mBad(0) {}
+
+      void thread()
+      {
+         UInt32 last = 0;
+         while (!isShutdown())
+         {
+            SnapshotPtr<Table>::Reader table(mPtr);
+            // hold on to it for a little while
+            for (unsigned int i = 0; i < Table::Values; ++i)
+            {
+               if (table->mMagic != Table::Alive || table->mValues[i] != table->mVersion)
+               {
+                  ++mBad;
+               }
+            }
+            // snapshots only ever get newer
+            if (table->mVersion < last)
+            {
+               ++mBad;
+            }
+            last = table->mVersion;
+            ++mReads;
+         }
+      }
+
+      SnapshotPtr<Table>& mPtr;
+      unsigned int mReads;
+      unsigned int mBad;
+};
+
+int
+main(int argc, char** argv)
+{
+   unsigned int readers = argc > 1 ? atoi(argv[1]) : 4;
+   unsigned int publishes = argc > 2 ? atoi(argv[2]) : 20000;
+
+   Table::reserve(publishes + 1);
+   {
+      SnapshotPtr<Table> ptr(new Table(0));
+      {
+         SnapshotPtr<Table>::Reader table(ptr);
+         assert(table->mVersion == 0);
+         assert((*table).mMagic == Table::Alive);
+         assert(table.get()->mValues[0] == 0);
+      }
+
+      vector<Reader*> threads;
+      for (unsigned int i = 0; i < readers; ++i)
+      {
+         threads.push_back(new Reader(ptr));
+         threads.back()->run();
+      }
+
+      UInt64 start = Timer::getTimeMs();
+      for (unsigned int v = 1; v <= publishes; ++v)
+      {
+         ptr.publish(new Table(v));
+         // every snapshot but the current one is gone as soon as publish returns
+         Lock lock(Table::sMutex);
+         assert(Table::sDeleted == v);
+      }
+      UInt64 elapsed = Timer::getTimeMs() - start;
+
+      unsigned int reads = 0;
+      for (vector<Reader*>::iterator i = threads.begin(); i != threads.end(); ++i)
+      {
+         (*i)->shutdown();
+         (*i)->join();
+         reads += (*i)->mReads;
+         assert((*i)->mBad == 0);
+         delete *i;
+      }
+
+      SnapshotPtr<Table>::Reader table(ptr);
+      assert(table->mVersion == publishes);
+
+      cerr << publishes << " publishes against " << readers << " readers in "
+           << elapsed << " ms, " << reads << " reads" << endl;
+   }
+
+   assert(Table::sCreated == publishes + 1);
+   assert(Table::sDeleted == publishes + 1);
+   Table::freeSlab();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
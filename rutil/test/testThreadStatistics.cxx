@@ -0,0 +1,260 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "rutil/ThreadStatistics.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+/*
+   Checks ThreadStatistics with several threads updating while another
+   one reads, and compares the update cost with a mutex protected counter.
+   Arguments: [threads [updates per thread]]
+*/
+
+class Updater : public ThreadIf
+{
+   public:
+      Updater(ThreadStatistics& stats, unsigned int counter, unsigned int histogram, unsigned int count)
+         : mStats(stats), mCounter(counter), mHistogram(histogram), mCount(count)
+      {}
+
+      void thread()
+      {
+         for (unsigned int i = 0; i < mCount; ++i)
+         {
+            mStats.increment(mCounter);
+            mStats.record(mHistogram, i % 4096);
+         }
+      }
+
+   private:
+      ThreadStatistics& mStats;
+      unsigned int mCounter;
+      unsigned int mHistogram;
+      unsigned int mCount;
+};
+
+class LockedUpdater : public ThreadIf
+{
+   public:
+      LockedUpdater(Mutex& mutex, UInt64& counter, unsigned int count)
+         : mMutex(mutex), mCounter(counter), mCount(count)
+      {}
+
+      void thread()
+      {
+         for (unsigned int i = 0; i < mCount; ++i)
+         {
+            Lock lock(mMutex);
+            ++mCounter;
+         }
+      }
+
+   private:
+      Mutex& mMutex;
+      UInt64& mCounter;
+      unsigned int mCount;
+};
+
+static void
+testBuckets()
+{
+   assert(ThreadStatistics::bucket(0) == 0);
+   assert(ThreadStatistics::bucket(1) == 0);
+   assert(ThreadStatistics::bucket(2) == 1);
+   assert(ThreadStatistics::bucket(3) == 2);
+   assert(ThreadStatistics::bucket(4) == 2);
+   assert(ThreadStatistics::bucket(5) == 3);
+   assert(ThreadStatistics::bucket(1024) == 10);
+   assert(ThreadStatistics::bucket(1025) == 11);
+   assert(ThreadStatistics::bucket(UInt64(1) << 40) == ThreadStatistics::Buckets - 1);
+   for (unsigned int i = 0; i < ThreadStatistics::Buckets - 1; ++i)
+   {
+      assert(ThreadStatistics::bucket(ThreadStatistics::bucketLimit(i)) == i);
+      assert(ThreadStatistics::bucket(ThreadStatistics::bucketLimit(i) + 1) == i + 1);
+   }
+   cerr << "buckets OK" << endl;
+}
+
+static void
+testExport()
+{
+   ThreadStatistics stats;
+   unsigned int sent = stats.addCounter("sent", "Messages sent.");
+   unsigned int received = stats.addCounter("received", "Messages received.");
+   unsigned int parse = stats.addHistogram("parse", "Time spent parsing.");
+   assert(sent == 0 && received == 1 && parse == 0);
+
+   stats.increment(sent, 3);
+   stats.record(parse, 1);
+   stats.record(parse, 3);
+   stats.record(parse, 1500000);
+
+   // a second instance must not see the first one's blocks
+   ThreadStatistics other;
+   unsigned int c = other.addCounter("c", "c");
+   other.increment(c);
+   assert(other.getCounter(c) == 1);
+   assert(stats.getCounter(sent) == 3);
+   assert(stats.getCounter(received) == 0);
+
+   Data out;
+   {
+      DataStream strm(out);
+      stats.encodePrometheus(strm, "resip_");
+   }
+   cerr << out;
+   assert(out.find("# TYPE resip_sent_total counter\nresip_sent_total 3\n") != Data::npos);
+   assert(out.find("resip_received_total 0\n") != Data::npos);
+   assert(out.find("# TYPE resip_parse_seconds histogram\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"0.000001\"} 1\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"0.000002\"} 1\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"0.000004\"} 2\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"1.048576\"} 2\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"2.097152\"} 3\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_bucket{le=\"+Inf\"} 3\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_sum 1.500004\n") != Data::npos);
+   assert(out.find("resip_parse_seconds_count 3\n") != Data::npos);
+   cerr << "export OK" << endl;
+}
+
+static void
+testThreads(unsigned int threads, unsigned int count)
+{
+   ThreadStatistics stats;
+   unsigned int counter = stats.addCounter("updates", "Updates.");
+   unsigned int histogram = stats.addHistogram("values", "Values.");
+
+   vector<Updater*> updaters;
+   UInt64 start = Timer::getTimeMs();
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      updaters.push_back(new Updater(stats, counter, histogram, count));
+      updaters.back()->run();
+   }
+
+   // scrape while the updaters run; totals may only grow
+   UInt64 last = 0;
+   UInt64 buckets[ThreadStatistics::Buckets];
+   for (int i = 0; i < 1000; ++i)
+   {
+      UInt64 now = stats.getCounter(counter);
+      assert(now >= last);
+      last = now;
+      UInt64 n;
+      UInt64 sum;
+      stats.getHistogram(histogram, buckets, n, sum);
+   }
+
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      updaters[t]->join();
+      delete updaters[t];
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+
+   UInt64 expected = UInt64(threads) * count;
+   assert(stats.getCounter(counter) == expected);
+   UInt64 n;
+   UInt64 sum;
+   stats.getHistogram(histogram, buckets, n, sum);
+   assert(n == expected);
+   UInt64 total = 0;
+   for (unsigned int i = 0; i < ThreadStatistics::Buckets; ++i)
+   {
+      total += buckets[i];
+   }
+   assert(total == expected);
+
+   Mutex mutex;
+   UInt64 locked = 0;
+   vector<LockedUpdater*> lockedUpdaters;
+   start = Timer::getTimeMs();
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      lockedUpdaters.push_back(new LockedUpdater(mutex, locked, count));
+      lockedUpdaters.back()->run();
+   }
+   for (unsigned int t = 0; t < threads; ++t)
+   {
+      lockedUpdaters[t]->join();
+      delete lockedUpdaters[t];
+   }
+   UInt64 lockedElapsed = Timer::getTimeMs() - start;
+   assert(locked == expected);
+
+   cerr << threads << " threads x " << count << " updates: per-thread counters and histogram "
+        << elapsed << " ms, mutex counter alone " << lockedElapsed << " ms" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int threads = argc > 1 ? atoi(argv[1]) : 4;
+   unsigned int count = argc > 2 ? atoi(argv[2]) : 1000000;
+
+   testBuckets();
+   testExport();
+   testThreads(threads, count);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */